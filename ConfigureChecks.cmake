@@ -21,6 +21,7 @@ check_include_files("sys/types.h;ifaddrs.h" HAVE_IFADDRS_H)
 check_include_file("netinet/in.h"           HAVE_NETINET_IN_H)
 check_include_file("netdb.h"                HAVE_NETDB_H)
 check_include_file("pwd.h"                  HAVE_PWD_H)
+check_include_file("sys/mman.h"             HAVE_SYS_MMAN_H)
 check_include_file("sys/select.h"           HAVE_SYS_SELECT_H)
 check_include_file("sys/socket.h"           HAVE_SYS_SOCKET_H)
 check_include_file("sys/time.h"             HAVE_SYS_TIME_H)
@@ -105,6 +106,8 @@ include(CheckStructHasMember)
 check_struct_has_member("struct stat"     st_blksize     sys/stat.h   HAVE_STRUCT_STAT_ST_BLKSIZE)
 check_struct_has_member("struct stat"     st_birthtime   sys/stat.h   HAVE_STRUCT_STAT_ST_BIRTHTIME)
 check_struct_has_member("struct stat"     __st_birthtime sys/stat.h   HAVE_STRUCT_STAT___ST_BIRTHTIME)
+check_struct_has_member("struct stat"     st_mtim        sys/stat.h   HAVE_STRUCT_STAT_ST_MTIM)
+check_struct_has_member("struct stat"     st_mtimespec   sys/stat.h   HAVE_STRUCT_STAT_ST_MTIMESPEC)
 check_struct_has_member("struct tm"       tm_zone        time.h       HAVE_STRUCT_TM_TM_ZONE)
 
 #Symbols but NOT enums or types
@@ -20,6 +20,7 @@
 #include "capture_opts.h"
 
 #include <wsutil/processes.h>
+#include <wsutil/live_feed.h>
 
 #include "cfile.h"
 
@@ -62,6 +63,13 @@ typedef void (*new_packets_fn)(capture_session *cap_session, int to_read);
 typedef void (*drops_fn)(capture_session *cap_session, guint32 dropped,
                          const char *interface_name);
 
+/**
+ * Capture child told us how many packets it has waiting to be written
+ * for an interface, and the most it has had at once.
+ */
+typedef void (*queued_fn)(capture_session *cap_session, guint32 queued,
+                          guint32 queued_max, const char *interface_name);
+
 /**
  * Capture child told us that an error has occurred while starting
  * the capture.
@@ -104,6 +112,8 @@ struct _capture_session {
     Buffer buf;                           /**< Buffer we're reading packet data into */
     struct wtap *wtap;                    /**< current wtap file */
     struct _info_data *cap_data_info;     /**< stats for this capture */
+    live_feed_t *live_feed;               /**< what the child writes to the capture file, or NULL */
+    gchar *live_feed_path;                /**< file backing live_feed */
 
     /*
      * Routines supplied by our caller; we call them back to notify them
@@ -112,6 +122,7 @@ struct _capture_session {
     new_file_fn new_file;
     new_packets_fn new_packets;
     drops_fn drops;
+    queued_fn queued;
     error_fn error;
     cfilter_error_fn cfilter_error;
     closed_fn closed;
@@ -120,7 +131,7 @@ struct _capture_session {
 extern void
 capture_session_init(capture_session *cap_session, capture_file *cf,
                      new_file_fn new_file, new_packets_fn new_packets,
-                     drops_fn drops, error_fn error,
+                     drops_fn drops, queued_fn queued, error_fn error,
                      cfilter_error_fn cfilter_error, closed_fn closed);
 #else
 
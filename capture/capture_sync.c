@@ -119,7 +119,7 @@ static void free_argv(char** argv, int argc)
 void
 capture_session_init(capture_session *cap_session, capture_file *cf,
                      new_file_fn new_file, new_packets_fn new_packets,
-                     drops_fn drops, error_fn error,
+                     drops_fn drops, queued_fn queued, error_fn error,
                      cfilter_error_fn cfilter_error, closed_fn closed)
 {
     cap_session->cf                              = cf;
@@ -138,9 +138,28 @@ capture_session_init(capture_session *cap_session, capture_file *cf,
     cap_session->new_file                        = new_file;
     cap_session->new_packets                     = new_packets;
     cap_session->drops                           = drops;
+    cap_session->queued                          = queued;
     cap_session->error                           = error;
     cap_session->cfilter_error                   = cfilter_error;
     cap_session->closed                          = closed;
+    cap_session->live_feed                       = NULL;
+    cap_session->live_feed_path                  = NULL;
+}
+
+/* Done with the live feed from the capture child, if any. Readers of
+   the capture file that are still using it keep their own reference. */
+static void
+sync_pipe_free_live_feed(capture_session *cap_session)
+{
+    if (cap_session->live_feed != NULL) {
+        live_feed_unref(cap_session->live_feed);
+        cap_session->live_feed = NULL;
+    }
+    if (cap_session->live_feed_path != NULL) {
+        ws_unlink(cap_session->live_feed_path);
+        g_free(cap_session->live_feed_path);
+        cap_session->live_feed_path = NULL;
+    }
 }
 
 /* Append an arg (realloc) to an argc/argv array */
@@ -580,10 +599,22 @@ sync_pipe_start(capture_options *capture_opts, GPtrArray *capture_comments,
     cap_session->signal_pipe_write_fd = signal_pipe_write_fd;
 
 #else /* _WIN32 */
+    /* Have the child also hand us what it writes to the capture file
+       through shared memory, so that we needn't read it back from the
+       file while it's still in the live feed. If we can't, we'll just
+       read the file. */
+    sync_pipe_free_live_feed(cap_session);
+    cap_session->live_feed = live_feed_create(&cap_session->live_feed_path, NULL);
+    if (cap_session->live_feed != NULL) {
+        argv = sync_pipe_add_arg(argv, &argc, "--live-feed");
+        argv = sync_pipe_add_arg(argv, &argc, cap_session->live_feed_path);
+    }
+
     if (pipe(sync_pipe) < 0) {
         /* Couldn't create the pipe between parent and child. */
         report_failure("Couldn't create sync pipe: %s", g_strerror(errno));
         free_argv(argv, argc);
+        sync_pipe_free_live_feed(cap_session);
         return FALSE;
     }
 
@@ -636,6 +667,7 @@ sync_pipe_start(capture_options *capture_opts, GPtrArray *capture_comments,
 #ifdef _WIN32
         ws_close(cap_session->signal_pipe_write_fd);
 #endif
+        sync_pipe_free_live_feed(cap_session);
         return FALSE;
     }
 
@@ -1678,6 +1710,7 @@ sync_pipe_input_cb(gint source, gpointer user_data)
         extcap_if_cleanup(cap_session->capture_opts, &primary_msg);
         cap_session->closed(cap_session, primary_msg);
         g_free(primary_msg);
+        sync_pipe_free_live_feed(cap_session);
         return FALSE;
     }
 
@@ -1705,6 +1738,7 @@ sync_pipe_input_cb(gint source, gpointer user_data)
                "standard output", as the capture file. */
             sync_pipe_stop(cap_session);
             cap_session->closed(cap_session, NULL);
+            sync_pipe_free_live_feed(cap_session);
             return FALSE;
         }
         break;
@@ -1753,6 +1787,21 @@ sync_pipe_input_cb(gint source, gpointer user_data)
         cap_session->drops(cap_session, num, name);
         break;
         }
+    case SP_QUEUED: {
+        /* "queued:queued_max:interface name" */
+        const char *name = NULL;
+        const gchar* end;
+        guint32 queued = 0;
+        guint32 queued_max = 0;
+
+        if (ws_strtou32(buffer, &end, &queued) && end[0] == ':' &&
+            ws_strtou32(end + 1, &end, &queued_max) && end[0] == ':') {
+            name = end + 1;
+        }
+
+        cap_session->queued(cap_session, queued, queued_max, name);
+        break;
+        }
     default:
         ws_assert_not_reached();
     }
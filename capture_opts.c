@@ -36,6 +36,14 @@
 
 #include "ui/filter_files.h"
 
+#ifdef HAVE_LZ4
+#include <lz4.h>
+/* ringbuffer.c needs the LZ4 frame API of LZ4 1.7.3 or later */
+#if LZ4_VERSION_NUMBER >= 10703
+#define USE_LZ4
+#endif
+#endif
+
 static gboolean capture_opts_output_to_pipe(const char *save_file, gboolean *is_pipe);
 
 
@@ -987,8 +995,23 @@ capture_opts_add_opt(capture_options *capture_opts, int opt, const char *optarg_
             ;
         } else if (strcmp(optarg_str_p, "gzip") == 0) {
             ;
+#ifdef HAVE_ZSTD
+        } else if (strcmp(optarg_str_p, "zstd") == 0) {
+            ;
+#endif
+#ifdef USE_LZ4
+        } else if (strcmp(optarg_str_p, "lz4") == 0) {
+            ;
+#endif
         } else {
-            cmdarg_err("parameter of --compress-type can be 'none' or 'gzip'");
+            cmdarg_err("parameter of --compress-type can be 'none', 'gzip'"
+#ifdef HAVE_ZSTD
+                       ", 'zstd'"
+#endif
+#ifdef USE_LZ4
+                       ", 'lz4'"
+#endif
+                       );
             return 1;
         }
         capture_opts->compress_type = g_strdup(optarg_str_p);
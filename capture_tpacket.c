@@ -0,0 +1,731 @@
+/* capture_tpacket.c
+ * Routines for capturing on a Linux interface through a fanout group
+ * of packet sockets with memory-mapped TPACKET_V3 rings
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#endif
+
+#include <glib.h>
+
+#include "ws_attributes.h"
+#include "capture_tpacket.h"
+
+#ifdef __linux__
+
+/*
+ * The kernel never puts a packet in a block that it doesn't fit in, so
+ * a block has to hold the largest snapshot length we allow, with room
+ * for the headers.
+ */
+#define TPACKET_BLOCK_SIZE      (1024 * 1024)
+#define TPACKET_MIN_BLOCKS      4
+/* Not used with TPACKET_V3, but the kernel checks it. */
+#define TPACKET_FRAME_SIZE      (TPACKET_ALIGNMENT << 7)
+/* Room left before each packet to put back a VLAN tag taken out by the kernel. */
+#define VLAN_TAG_LEN            4
+
+/* Older kernels reject it, and we fall back on choosing a group ID ourselves. */
+#ifndef PACKET_FANOUT_FLAG_UNIQUEID
+#define PACKET_FANOUT_FLAG_UNIQUEID     0x2000
+#endif
+
+struct tpacket_socket {
+    tpacket_capture_t         *cap;
+    int                        fd;
+    guint8                    *map;
+    guint                      num_blocks;      /* a power of 2 */
+    GThread                   *tid;
+
+    /*
+     * handed counts the blocks the thread has handed to the writer
+     * and returned the blocks the writer has given back to the kernel;
+     * the block for count N is block N & (num_blocks - 1).
+     */
+    gint                       handed;
+    gint                       returned;
+    GMutex                     mutex;
+    GCond                      cond;            /* signalled when a block is returned */
+    gint                       thread_waiting;
+
+    /* The writer's position in the block it's reading, if any. */
+    struct tpacket3_hdr       *pkt;
+    guint32                    pkts_left;
+    gboolean                   have_packet;     /* phdr and pd are for pkt */
+    struct pcap_pkthdr         phdr;
+    const u_char              *pd;
+};
+
+struct tpacket_capture {
+    int                        ifindex;
+    gboolean                   loopback;
+    int                        linktype;
+    int                        snaplen;
+    int                        timeout;
+    guint                      num_sockets;
+    struct tpacket_socket     *socks;
+    gint                       running;
+    tpacket_capture_ready_func ready_func;
+    void                      *ready_data;
+    gchar                     *err_str;         /* set by the first thread to fail */
+    guint64                    received;
+    guint64                    dropped;
+};
+
+static void
+tpacket_errno_msg(char *errmsg, size_t errmsg_len, const char *what, int err)
+{
+    g_snprintf(errmsg, (gulong)errmsg_len, "Couldn't %s: %s", what, g_strerror(err));
+}
+
+static struct tpacket_block_desc *
+tpacket_block(const struct tpacket_socket *sock, guint n)
+{
+    return (struct tpacket_block_desc *)(sock->map + (size_t)(n & (sock->num_blocks - 1)) * TPACKET_BLOCK_SIZE);
+}
+
+static gboolean
+tpacket_block_is_ours(const struct tpacket_socket *sock, guint n)
+{
+    struct tpacket_block_desc *desc = tpacket_block(sock, n);
+
+    return (g_atomic_int_get((volatile gint *)&desc->hdr.bh1.block_status) & TP_STATUS_USER) != 0;
+}
+
+/* Have the kernel truncate packets to snaplen, and do nothing else to them. */
+static gboolean
+tpacket_attach_filter(int fd, struct sock_filter *insns, unsigned short len)
+{
+    struct sock_fprog prog;
+
+    prog.len = len;
+    prog.filter = insns;
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof prog) == 0;
+}
+
+static gboolean
+tpacket_socket_open(tpacket_capture_t *cap, struct tpacket_socket *sock,
+                    gboolean promisc, int buffer_size,
+                    int *err, char *errmsg, size_t errmsg_len)
+{
+    struct sock_filter snaplen_insn = BPF_STMT(BPF_RET|BPF_K, (guint32)cap->snaplen);
+    struct tpacket_req3 req;
+    struct packet_mreq mr;
+    int version = TPACKET_V3;
+    unsigned int reserve = VLAN_TAG_LEN;
+    guint num_blocks;
+    void *map;
+
+    /*
+     * Use protocol 0, so that nothing's captured until we bind the
+     * socket, after the capture filter is on it.
+     */
+    sock->fd = socket(AF_PACKET, SOCK_RAW, 0);
+    if (sock->fd == -1) {
+        *err = errno;
+        tpacket_errno_msg(errmsg, errmsg_len, "create a packet socket", *err);
+        return FALSE;
+    }
+    if (setsockopt(sock->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof version) == -1) {
+        *err = errno;
+        tpacket_errno_msg(errmsg, errmsg_len, "use TPACKET_V3", *err);
+        return FALSE;
+    }
+    if (setsockopt(sock->fd, SOL_PACKET, PACKET_RESERVE, &reserve, sizeof reserve) == -1) {
+        *err = errno;
+        tpacket_errno_msg(errmsg, errmsg_len, "reserve room for VLAN tags", *err);
+        return FALSE;
+    }
+    if (!tpacket_attach_filter(sock->fd, &snaplen_insn, 1)) {
+        *err = errno;
+        tpacket_errno_msg(errmsg, errmsg_len, "set the snapshot length", *err);
+        return FALSE;
+    }
+
+    num_blocks = TPACKET_MIN_BLOCKS;
+    while (num_blocks < (guint64)buffer_size * 1024 * 1024 / TPACKET_BLOCK_SIZE)
+        num_blocks *= 2;
+    memset(&req, 0, sizeof req);
+    req.tp_block_size = TPACKET_BLOCK_SIZE;
+    req.tp_block_nr = num_blocks;
+    req.tp_frame_size = TPACKET_FRAME_SIZE;
+    req.tp_frame_nr = (TPACKET_BLOCK_SIZE / TPACKET_FRAME_SIZE) * num_blocks;
+    req.tp_retire_blk_tov = cap->timeout;
+    if (setsockopt(sock->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof req) == -1) {
+        *err = errno;
+        tpacket_errno_msg(errmsg, errmsg_len, "set up the packet ring", *err);
+        return FALSE;
+    }
+    map = mmap(NULL, (size_t)num_blocks * TPACKET_BLOCK_SIZE,
+               PROT_READ|PROT_WRITE, MAP_SHARED, sock->fd, 0);
+    if (map == MAP_FAILED) {
+        *err = errno;
+        tpacket_errno_msg(errmsg, errmsg_len, "map the packet ring", *err);
+        return FALSE;
+    }
+    sock->map = (guint8 *)map;
+    sock->num_blocks = num_blocks;
+
+    if (promisc) {
+        memset(&mr, 0, sizeof mr);
+        mr.mr_ifindex = cap->ifindex;
+        mr.mr_type = PACKET_MR_PROMISC;
+        if (setsockopt(sock->fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mr, sizeof mr) == -1) {
+            *err = errno;
+            tpacket_errno_msg(errmsg, errmsg_len, "turn on promiscuous mode", *err);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+gboolean
+tpacket_capture_is_interface(const char *ifname)
+{
+    return if_nametoindex(ifname) != 0;
+}
+
+tpacket_capture_t *
+tpacket_capture_open(const char *ifname, guint num_sockets, int snaplen,
+                     gboolean promisc, int buffer_size, int timeout,
+                     int *err, char *errmsg, size_t errmsg_len)
+{
+    tpacket_capture_t *cap;
+    struct ifreq ifr;
+    guint i;
+
+    cap = g_new0(tpacket_capture_t, 1);
+    cap->snaplen = snaplen;
+    cap->timeout = timeout;
+    cap->num_sockets = num_sockets;
+    cap->socks = g_new0(struct tpacket_socket, num_sockets);
+    for (i = 0; i < num_sockets; i++) {
+        cap->socks[i].cap = cap;
+        cap->socks[i].fd = -1;
+        g_mutex_init(&cap->socks[i].mutex);
+        g_cond_init(&cap->socks[i].cond);
+    }
+
+    cap->ifindex = if_nametoindex(ifname);
+    if (cap->ifindex == 0) {
+        *err = errno;
+        tpacket_errno_msg(errmsg, errmsg_len, "find the interface", *err);
+        goto fail;
+    }
+
+    for (i = 0; i < num_sockets; i++) {
+        if (!tpacket_socket_open(cap, &cap->socks[i], promisc, buffer_size,
+                                 err, errmsg, errmsg_len))
+            goto fail;
+    }
+
+    /* Only link-layer types whose headers the kernel gives us as is. */
+    memset(&ifr, 0, sizeof ifr);
+    g_strlcpy(ifr.ifr_name, ifname, sizeof ifr.ifr_name);
+    if (ioctl(cap->socks[0].fd, SIOCGIFHWADDR, &ifr) == -1) {
+        *err = errno;
+        tpacket_errno_msg(errmsg, errmsg_len, "get the link-layer type", *err);
+        goto fail;
+    }
+    switch (ifr.ifr_hwaddr.sa_family) {
+
+    case ARPHRD_ETHER:
+        cap->linktype = DLT_EN10MB;
+        break;
+
+    case ARPHRD_LOOPBACK:
+        cap->linktype = DLT_EN10MB;
+        cap->loopback = TRUE;
+        break;
+
+    default:
+        *err = EOPNOTSUPP;
+        g_snprintf(errmsg, (gulong)errmsg_len,
+                   "Only Ethernet and loopback interfaces can be captured on with a fanout group");
+        goto fail;
+    }
+    return cap;
+
+fail:
+    tpacket_capture_close(cap);
+    return NULL;
+}
+
+int
+tpacket_capture_linktype(const tpacket_capture_t *cap)
+{
+    return cap->linktype;
+}
+
+int
+tpacket_capture_snaplen(const tpacket_capture_t *cap)
+{
+    return cap->snaplen;
+}
+
+guint
+tpacket_capture_num_sockets(const tpacket_capture_t *cap)
+{
+    return cap->num_sockets;
+}
+
+gboolean
+tpacket_capture_set_filter(tpacket_capture_t *cap, const struct bpf_program *fcode,
+                           char *errmsg, size_t errmsg_len)
+{
+    guint i;
+
+    if (fcode->bf_len > G_MAXUSHORT) {
+        g_snprintf(errmsg, (gulong)errmsg_len, "The capture filter is too long");
+        return FALSE;
+    }
+    /* A struct bpf_insn is laid out the same way as a struct sock_filter. */
+    for (i = 0; i < cap->num_sockets; i++) {
+        if (!tpacket_attach_filter(cap->socks[i].fd, (struct sock_filter *)fcode->bf_insns,
+                                   (unsigned short)fcode->bf_len)) {
+            tpacket_errno_msg(errmsg, errmsg_len, "set the capture filter", errno);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+static void
+tpacket_capture_fail(tpacket_capture_t *cap, int err)
+{
+    gchar *msg;
+
+    /* Use libpcap's messages, so they're reported the same way. */
+    if (err == ENETDOWN)
+        msg = g_strdup("The interface went down");
+    else if (err == ENXIO || err == ENODEV)
+        msg = g_strdup("The interface disappeared");
+    else
+        msg = g_strdup_printf("poll: %s", g_strerror(err));
+    if (!g_atomic_pointer_compare_and_exchange(&cap->err_str, NULL, msg))
+        g_free(msg);
+    cap->ready_func(cap->ready_data);
+}
+
+static void *
+tpacket_socket_thread(void *arg)
+{
+    struct tpacket_socket *sock = (struct tpacket_socket *)arg;
+    tpacket_capture_t *cap = sock->cap;
+    struct pollfd pfd;
+    guint handed, returned;
+    int err;
+    socklen_t errlen;
+
+    while (g_atomic_int_get(&cap->running)) {
+        handed = (guint)sock->handed;   /* only we change it */
+        returned = (guint)g_atomic_int_get(&sock->returned);
+
+        if (handed - returned < sock->num_blocks && tpacket_block_is_ours(sock, handed)) {
+            /* Hand over every block the kernel is done with. */
+            do {
+                handed++;
+            } while (handed - returned < sock->num_blocks && tpacket_block_is_ours(sock, handed));
+            g_atomic_int_set(&sock->handed, (gint)handed);
+            cap->ready_func(cap->ready_data);
+            continue;
+        }
+
+        if (handed == returned) {
+            /*
+             * The kernel has every block, so it'll wake us up when it's
+             * done with the next one.
+             */
+            pfd.fd = sock->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, cap->timeout) == -1) {
+                if (errno != EINTR) {
+                    tpacket_capture_fail(cap, errno);
+                    break;
+                }
+                continue;
+            }
+            if (pfd.revents & (POLLERR|POLLHUP|POLLNVAL)) {
+                errlen = sizeof err;
+                if (getsockopt(sock->fd, SOL_SOCKET, SO_ERROR, &err, &errlen) == -1)
+                    err = errno;
+                else if (err == 0)
+                    err = ENETDOWN;
+                tpacket_capture_fail(cap, err);
+                break;
+            }
+        } else {
+            /*
+             * The writer has some of the blocks, and the socket stays
+             * readable until it gives them back, so wait for it to
+             * give one back instead.
+             */
+            g_mutex_lock(&sock->mutex);
+            g_atomic_int_set(&sock->thread_waiting, 1);
+            if ((guint)g_atomic_int_get(&sock->returned) == returned) {
+                g_cond_wait_until(&sock->cond, &sock->mutex,
+                                  g_get_monotonic_time() + cap->timeout * G_TIME_SPAN_MILLISECOND);
+            }
+            g_atomic_int_set(&sock->thread_waiting, 0);
+            g_mutex_unlock(&sock->mutex);
+        }
+    }
+    return NULL;
+}
+
+gboolean
+tpacket_capture_start(tpacket_capture_t *cap, tpacket_capture_ready_func ready_func,
+                      void *user_data, char *errmsg, size_t errmsg_len)
+{
+    struct sockaddr_ll sll;
+    int fanout_arg, fanout_id = 0;
+    socklen_t len;
+    guint i;
+
+    cap->ready_func = ready_func;
+    cap->ready_data = user_data;
+
+    memset(&sll, 0, sizeof sll);
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = cap->ifindex;
+    for (i = 0; i < cap->num_sockets; i++) {
+        if (bind(cap->socks[i].fd, (struct sockaddr *)&sll, sizeof sll) == -1) {
+            tpacket_errno_msg(errmsg, errmsg_len, "bind the packet socket", errno);
+            return FALSE;
+        }
+        if (cap->num_sockets == 1)
+            break;
+
+        /*
+         * Spread packets over the sockets by flow, so that the packets
+         * of a flow stay in order; IP fragments are put back together
+         * first, so that they all go to the same socket.  If we can,
+         * have the kernel choose a group ID nobody else is using.
+         */
+        if (i == 0) {
+            fanout_arg = (PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG | PACKET_FANOUT_FLAG_UNIQUEID) << 16;
+            if (setsockopt(cap->socks[i].fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof fanout_arg) == 0) {
+                len = sizeof fanout_arg;
+                if (getsockopt(cap->socks[i].fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, &len) == -1) {
+                    tpacket_errno_msg(errmsg, errmsg_len, "get the fanout group", errno);
+                    return FALSE;
+                }
+                fanout_id = fanout_arg & 0xffff;
+                continue;
+            }
+            if (errno != EINVAL) {
+                tpacket_errno_msg(errmsg, errmsg_len, "create a fanout group", errno);
+                return FALSE;
+            }
+            /* The kernel predates PACKET_FANOUT_FLAG_UNIQUEID. */
+            fanout_id = (getpid() ^ cap->ifindex) & 0xffff;
+        }
+        fanout_arg = fanout_id | ((PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG) << 16);
+        if (setsockopt(cap->socks[i].fd, SOL_PACKET, PACKET_FANOUT, &fanout_arg, sizeof fanout_arg) == -1) {
+            tpacket_errno_msg(errmsg, errmsg_len, "join the fanout group", errno);
+            return FALSE;
+        }
+    }
+
+    g_atomic_int_set(&cap->running, 1);
+    for (i = 0; i < cap->num_sockets; i++)
+        cap->socks[i].tid = g_thread_new("Capture read", tpacket_socket_thread, &cap->socks[i]);
+    return TRUE;
+}
+
+static void
+tpacket_socket_return_block(struct tpacket_socket *sock)
+{
+    struct tpacket_block_desc *desc = tpacket_block(sock, (guint)sock->returned);
+
+    g_atomic_int_set((volatile gint *)&desc->hdr.bh1.block_status, TP_STATUS_KERNEL);
+    g_atomic_int_inc(&sock->returned);
+    if (g_atomic_int_get(&sock->thread_waiting)) {
+        g_mutex_lock(&sock->mutex);
+        g_cond_signal(&sock->cond);
+        g_mutex_unlock(&sock->mutex);
+    }
+}
+
+/*
+ * Fill in sock->phdr and sock->pd for the packet at sock->pkt; returns
+ * FALSE if it's not one to write.
+ */
+static gboolean
+tpacket_socket_set_packet(const tpacket_capture_t *cap, struct tpacket_socket *sock)
+{
+    struct tpacket3_hdr *pkt = sock->pkt;
+    const struct sockaddr_ll *sll;
+    u_char *pd = (u_char *)pkt + pkt->tp_mac;
+    guint32 caplen = pkt->tp_snaplen;
+    guint32 len = pkt->tp_len;
+    guint16 tpid;
+
+    /* On the loopback device, each packet is seen going out and coming in. */
+    sll = (const struct sockaddr_ll *)((guint8 *)pkt + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+    if (cap->loopback && sll->sll_pkttype == PACKET_OUTGOING)
+        return FALSE;
+
+    /*
+     * The kernel takes VLAN tags out of the packets; put them back,
+     * in the room we had it leave in front of them.
+     */
+    if (cap->linktype == DLT_EN10MB && (pkt->tp_status & TP_STATUS_VLAN_VALID) &&
+        caplen >= 2 * ETH_ALEN) {
+#ifdef TP_STATUS_VLAN_TPID_VALID
+        tpid = (pkt->tp_status & TP_STATUS_VLAN_TPID_VALID) ? pkt->hv1.tp_vlan_tpid : ETH_P_8021Q;
+#else
+        tpid = ETH_P_8021Q;
+#endif
+        memmove(pd - VLAN_TAG_LEN, pd, 2 * ETH_ALEN);
+        pd -= VLAN_TAG_LEN;
+        pd[2 * ETH_ALEN] = tpid >> 8;
+        pd[2 * ETH_ALEN + 1] = tpid & 0xff;
+        pd[2 * ETH_ALEN + 2] = pkt->hv1.tp_vlan_tci >> 8;
+        pd[2 * ETH_ALEN + 3] = pkt->hv1.tp_vlan_tci & 0xff;
+        caplen = MIN(caplen + VLAN_TAG_LEN, (guint32)cap->snaplen);
+        len += VLAN_TAG_LEN;
+    }
+
+    sock->phdr.ts.tv_sec = pkt->tp_sec;
+    sock->phdr.ts.tv_usec = pkt->tp_nsec;    /* we use nanosecond time stamps */
+    sock->phdr.caplen = caplen;
+    sock->phdr.len = len;
+    sock->pd = pd;
+    return TRUE;
+}
+
+/* Move past the current packet, giving its block back if it's the last one. */
+static void
+tpacket_socket_advance(struct tpacket_socket *sock)
+{
+    sock->have_packet = FALSE;
+    if (--sock->pkts_left == 0) {
+        sock->pkt = NULL;
+        tpacket_socket_return_block(sock);
+    } else {
+        sock->pkt = (struct tpacket3_hdr *)((guint8 *)sock->pkt + sock->pkt->tp_next_offset);
+    }
+}
+
+const struct pcap_pkthdr *
+tpacket_capture_peek(tpacket_capture_t *cap, guint i, const u_char **pd)
+{
+    struct tpacket_socket *sock = &cap->socks[i];
+    struct tpacket_block_desc *desc;
+
+    while (!sock->have_packet) {
+        if (sock->pkt == NULL) {
+            /* Start on the next block the socket's thread handed us, if any. */
+            if (sock->returned == g_atomic_int_get(&sock->handed))
+                return NULL;
+            desc = tpacket_block(sock, (guint)sock->returned);
+            if (desc->hdr.bh1.num_pkts == 0) {
+                tpacket_socket_return_block(sock);
+                continue;
+            }
+            sock->pkts_left = desc->hdr.bh1.num_pkts;
+            sock->pkt = (struct tpacket3_hdr *)((guint8 *)desc + desc->hdr.bh1.offset_to_first_pkt);
+        }
+        if (tpacket_socket_set_packet(cap, sock))
+            sock->have_packet = TRUE;
+        else
+            tpacket_socket_advance(sock);
+    }
+    *pd = sock->pd;
+    return &sock->phdr;
+}
+
+void
+tpacket_capture_next(tpacket_capture_t *cap, guint i)
+{
+    struct tpacket_socket *sock = &cap->socks[i];
+
+    if (sock->have_packet)
+        tpacket_socket_advance(sock);
+}
+
+const char *
+tpacket_capture_geterr(tpacket_capture_t *cap)
+{
+    return (const char *)g_atomic_pointer_get(&cap->err_str);
+}
+
+gboolean
+tpacket_capture_stats(tpacket_capture_t *cap, guint64 *received, guint64 *dropped)
+{
+    struct tpacket_stats_v3 stats;
+    socklen_t len;
+    guint i;
+
+    /* The kernel zeroes the counts each time we get them. */
+    for (i = 0; i < cap->num_sockets; i++) {
+        len = sizeof stats;
+        if (getsockopt(cap->socks[i].fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len) == -1)
+            return FALSE;
+        cap->received += stats.tp_packets;
+        cap->dropped += stats.tp_drops;
+    }
+    *received = cap->received;
+    *dropped = cap->dropped;
+    return TRUE;
+}
+
+void
+tpacket_capture_stop(tpacket_capture_t *cap)
+{
+    guint i;
+
+    if (!g_atomic_int_get(&cap->running))
+        return;
+    g_atomic_int_set(&cap->running, 0);
+    for (i = 0; i < cap->num_sockets; i++) {
+        g_mutex_lock(&cap->socks[i].mutex);
+        g_cond_signal(&cap->socks[i].cond);
+        g_mutex_unlock(&cap->socks[i].mutex);
+        g_thread_join(cap->socks[i].tid);
+        cap->socks[i].tid = NULL;
+    }
+}
+
+void
+tpacket_capture_close(tpacket_capture_t *cap)
+{
+    guint i;
+
+    tpacket_capture_stop(cap);
+    for (i = 0; i < cap->num_sockets; i++) {
+        if (cap->socks[i].map != NULL)
+            munmap(cap->socks[i].map, (size_t)cap->socks[i].num_blocks * TPACKET_BLOCK_SIZE);
+        if (cap->socks[i].fd != -1)
+            close(cap->socks[i].fd);
+        g_mutex_clear(&cap->socks[i].mutex);
+        g_cond_clear(&cap->socks[i].cond);
+    }
+    g_free(cap->socks);
+    g_free(cap->err_str);
+    g_free(cap);
+}
+
+#else /* __linux__ */
+
+gboolean
+tpacket_capture_is_interface(const char *ifname _U_)
+{
+    return FALSE;
+}
+
+tpacket_capture_t *
+tpacket_capture_open(const char *ifname _U_, guint num_sockets _U_, int snaplen _U_,
+                     gboolean promisc _U_, int buffer_size _U_, int timeout _U_,
+                     int *err, char *errmsg, size_t errmsg_len)
+{
+    *err = ENOTSUP;
+    g_snprintf(errmsg, (gulong)errmsg_len,
+               "Capturing with a fanout group is only supported on Linux");
+    return NULL;
+}
+
+int
+tpacket_capture_linktype(const tpacket_capture_t *cap _U_)
+{
+    return -1;
+}
+
+int
+tpacket_capture_snaplen(const tpacket_capture_t *cap _U_)
+{
+    return 0;
+}
+
+guint
+tpacket_capture_num_sockets(const tpacket_capture_t *cap _U_)
+{
+    return 0;
+}
+
+gboolean
+tpacket_capture_set_filter(tpacket_capture_t *cap _U_, const struct bpf_program *fcode _U_,
+                           char *errmsg _U_, size_t errmsg_len _U_)
+{
+    return FALSE;
+}
+
+gboolean
+tpacket_capture_start(tpacket_capture_t *cap _U_, tpacket_capture_ready_func ready_func _U_,
+                      void *user_data _U_, char *errmsg _U_, size_t errmsg_len _U_)
+{
+    return FALSE;
+}
+
+const struct pcap_pkthdr *
+tpacket_capture_peek(tpacket_capture_t *cap _U_, guint i _U_, const u_char **pd _U_)
+{
+    return NULL;
+}
+
+void
+tpacket_capture_next(tpacket_capture_t *cap _U_, guint i _U_)
+{
+}
+
+const char *
+tpacket_capture_geterr(tpacket_capture_t *cap _U_)
+{
+    return NULL;
+}
+
+gboolean
+tpacket_capture_stats(tpacket_capture_t *cap _U_, guint64 *received _U_, guint64 *dropped _U_)
+{
+    return FALSE;
+}
+
+void
+tpacket_capture_stop(tpacket_capture_t *cap _U_)
+{
+}
+
+void
+tpacket_capture_close(tpacket_capture_t *cap _U_)
+{
+}
+
+#endif /* __linux__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,108 @@
+/** @file
+ *
+ * Definitions for capturing on a Linux interface through a fanout group
+ * of packet sockets with memory-mapped TPACKET_V3 rings
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __CAPTURE_TPACKET_H__
+#define __CAPTURE_TPACKET_H__
+
+#include <glib.h>
+
+#include "wspcap.h"
+
+/*
+ * Dumpcap can capture on a Linux interface without libpcap, through
+ * several AF_PACKET sockets in a PACKET_FANOUT group, so that the kernel
+ * spreads the interface's packets, by flow, over several rings that are
+ * filled in parallel.
+ *
+ * Each socket has a TPACKET_V3 ring of blocks in memory shared with
+ * the kernel, and a thread that waits for the kernel to hand over the
+ * next block.  The packets in a block are given to the writer where
+ * they are, and the block is only handed back to the kernel once the
+ * writer is done with all of them, so packets aren't copied on their
+ * way to the capture file.
+ */
+
+/* The most sockets older kernels allow in a fanout group */
+#define TPACKET_CAPTURE_MAX_SOCKETS     256
+
+typedef struct tpacket_capture tpacket_capture_t;
+
+/* Called by a socket's thread when it has handed the writer packets. */
+typedef void (*tpacket_capture_ready_func)(void *user_data);
+
+/* Whether ifname is a network interface, rather than e.g. a pipe. */
+gboolean tpacket_capture_is_interface(const char *ifname);
+
+/*
+ * Open num_sockets packet sockets on ifname, each with a ring of
+ * buffer_size MiB, capturing at most snaplen bytes of each packet;
+ * timeout is the longest time, in milliseconds, a block that isn't full
+ * is kept from the writer.  No packets are captured until
+ * tpacket_capture_start() is called.
+ *
+ * On failure, returns NULL and puts an errno value in *err and a
+ * message in errmsg.
+ */
+tpacket_capture_t *tpacket_capture_open(const char *ifname, guint num_sockets,
+                                        int snaplen, gboolean promisc,
+                                        int buffer_size, int timeout,
+                                        int *err, char *errmsg, size_t errmsg_len);
+int tpacket_capture_linktype(const tpacket_capture_t *cap);
+int tpacket_capture_snaplen(const tpacket_capture_t *cap);
+guint tpacket_capture_num_sockets(const tpacket_capture_t *cap);
+
+/* Have the kernel run fcode, compiled for our link type and snaplen,
+   on the packets for each socket. */
+gboolean tpacket_capture_set_filter(tpacket_capture_t *cap,
+                                    const struct bpf_program *fcode,
+                                    char *errmsg, size_t errmsg_len);
+
+/* Join the sockets to the fanout group and start their threads. */
+gboolean tpacket_capture_start(tpacket_capture_t *cap,
+                               tpacket_capture_ready_func ready_func,
+                               void *user_data,
+                               char *errmsg, size_t errmsg_len);
+
+/*
+ * Called by the writer: get the next packet captured on a socket, or
+ * NULL if there's none yet.  The packet stays where it is until
+ * tpacket_capture_next() is called for that socket.
+ */
+const struct pcap_pkthdr *tpacket_capture_peek(tpacket_capture_t *cap, guint sock,
+                                               const u_char **pd);
+void tpacket_capture_next(tpacket_capture_t *cap, guint sock);
+
+/* The error that stopped a socket's thread, if any, else NULL. */
+const char *tpacket_capture_geterr(tpacket_capture_t *cap);
+
+/* The kernel's counts of packets received and dropped on all the sockets. */
+gboolean tpacket_capture_stats(tpacket_capture_t *cap, guint64 *received,
+                               guint64 *dropped);
+
+/* Stop the threads; packets already handed to the writer can still be read. */
+void tpacket_capture_stop(tpacket_capture_t *cap);
+void tpacket_capture_close(tpacket_capture_t *cap);
+
+#endif /* capture_tpacket.h */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
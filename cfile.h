@@ -61,6 +61,7 @@ struct packet_provider_data {
   frame_data  *prev_cap;
   frame_data_sequence *frames;         /* Sequence of frames, if we're keeping that information */
   GTree       *frames_modified_blocks; /* BST with modified blocks for frames (key = frame_data) */
+  GTree       *frames_shift_offsets;   /* BST with time shift offsets for frames (key = frame_data) */
 };
 
 typedef struct _capture_file {
@@ -134,6 +135,9 @@ const char *cap_file_provider_get_interface_name(struct packet_provider_data *pr
 const char *cap_file_provider_get_interface_description(struct packet_provider_data *prov, guint32 interface_id);
 wtap_block_t cap_file_provider_get_modified_block(struct packet_provider_data *prov, const frame_data *fd);
 void cap_file_provider_set_modified_block(struct packet_provider_data *prov, frame_data *fd, const wtap_block_t new_block);
+const nstime_t *cap_file_provider_get_shift_offset(struct packet_provider_data *prov, const frame_data *fd);
+void cap_file_provider_set_shift_offset(struct packet_provider_data *prov, frame_data *fd, const nstime_t *offset);
+gboolean cap_file_provider_seek_read(const struct packet_provider_data *prov, gint64 seek_off, wtap_rec *rec, Buffer *buf, int *err, gchar **err_info);
 
 #ifdef __cplusplus
 }
@@ -45,6 +45,7 @@
 #endif
 
 #include "ringbuffer.h"
+#include "capture_tpacket.h"
 
 #include "capture/capture_ifinfo.h"
 #include "capture/capture-pcap-util.h"
@@ -77,6 +78,7 @@
 #include "wsutil/time_util.h"
 #include "wsutil/please_report_bug.h"
 #include "wsutil/glib-compat.h"
+#include "wsutil/live_feed.h"
 #include <wsutil/ws_assert.h>
 
 #include "capture/ws80211_utils.h"
@@ -108,12 +110,26 @@ FILE *debug_log;   /* for logging debug messages to  */
                    /*  is defined                    */
 #endif
 
-static GAsyncQueue *pcap_queue;
-static gint64 pcap_queue_bytes;
-static gint64 pcap_queue_packets;
 static gint64 pcap_queue_byte_limit = 0;
 static gint64 pcap_queue_packet_limit = 0;
 
+/*
+ * Used by the main thread to wait for packets from the capture threads,
+ * when their queues are empty; capture threads only take the mutex
+ * to wake it up if pcap_queue_writer_waiting is set.
+ */
+static GMutex pcap_queue_mutex;
+static GCond pcap_queue_cond;
+static gint pcap_queue_writer_waiting;
+
+/* If non-zero, capture on each interface through this many fanout sockets rather than with libpcap */
+static guint fanout_sockets = 0;
+
+/* Size, in KiB, of the batches packets are written to the capture file in; 0 means one at a time */
+#define DEFAULT_WRITE_BATCH_SIZE 256
+#define MAX_WRITE_BATCH_SIZE     (64*1024)
+static guint write_batch_size = DEFAULT_WRITE_BATCH_SIZE;
+
 static gboolean capture_child = FALSE; /* FALSE: standalone call, TRUE: this is an Wireshark capture child */
 static const char *report_capture_filename = NULL; /* capture child file name */
 #ifdef _WIN32
@@ -192,6 +208,9 @@ typedef struct _capture_src {
     gboolean                     pcap_err;
     guint                        interface_id;
     GThread                     *tid;
+    struct _pcap_queue_ring     *queue;                  /**< Packets captured by tid, waiting to be written */
+    tpacket_capture_t           *tpacket;                /**< Fanout sockets we're capturing on, if any; pcap_h is then a dead handle */
+    guint                        tpacket_next;           /**< The socket with the next packet to write */
     int                          snaplen;
     int                          linktype;
     gboolean                     ts_nsec;                /**< TRUE if we're using nanosecond precision. */
@@ -257,7 +276,8 @@ typedef struct _loop_data {
     FILE     *pdh;
     int       save_file_fd;
     char     *io_buffer;           /**< Our IO buffer if we increase the size from the standard size */
-    guint64   bytes_written;       /**< Bytes written for the current file. */
+    pcapio_batch *batch;           /**< Packets waiting to be written to pdh, if we write them in batches */
+    guint64   bytes_written;       /**< Bytes written for the current file, including those in batch. */
     /* autostop conditions */
     int       packets_written;     /**< Packets written for the current file. */
     int       file_count;
@@ -268,14 +288,48 @@ typedef struct _loop_data {
 } loop_data;
 
 typedef struct _pcap_queue_element {
-    capture_src        *pcap_src;
     union {
         struct pcap_pkthdr  phdr;
         pcapng_block_header_t  bh;
     } u;
     u_char             *pd;
+    guint               pd_size;    /* allocated size of pd */
+    guint               pd_kept;    /* size of pd counted in the ring's kept_bytes, set by the main thread */
 } pcap_queue_element;
 
+/*
+ * When we capture in threads, each capture thread hands its packets to
+ * the main thread, which writes them, through a ring of elements that
+ * only that capture thread adds to and only the main thread takes from,
+ * so neither needs a lock.  An element's buffer is usually kept when the
+ * element is taken, and reused for later packets, so once the ring has
+ * been filled as far as it gets, queueing a packet doesn't allocate
+ * any memory; see pcap_queue_release() for when it isn't.
+ *
+ * head and tail count the elements added and taken, wrapping around;
+ * the element for packet N is elements[N & (size - 1)].
+ */
+typedef struct _pcap_queue_ring {
+    pcap_queue_element *elements;
+    guint               size;           /* number of elements, a power of 2 */
+    gint                head;           /* set by the capture thread */
+    gint                tail;           /* set by the main thread */
+    gint                bytes_in;       /* bytes queued so far, set by the capture thread */
+    gint                bytes_out;      /* bytes taken so far, set by the main thread */
+    gint                high_watermark; /* most elements queued at once, set by the capture thread */
+    guint64             kept_bytes;     /* bytes in buffers of taken elements, set by the main thread */
+} pcap_queue_ring;
+
+/*
+ * A ring has room for PCAP_QUEUE_RING_SIZE packets, or, if -N is given,
+ * for -N packets rounded up to a power of 2, up to PCAP_QUEUE_RING_MAX_SIZE.
+ */
+#define PCAP_QUEUE_RING_SIZE     65536
+#define PCAP_QUEUE_RING_MAX_SIZE (1U << 24)
+#define PCAP_QUEUE_KEEP_PD_SIZE  (16 * 1024)        /* largest element buffer kept for reuse */
+#define PCAP_QUEUE_KEEP_BYTES    (16 * 1024 * 1024) /* element buffer bytes kept per interface, unless -C is more */
+#define PCAP_QUEUE_WRITE_BATCH   64      /* packets written per pass through the capture loop */
+
 /*
  * This needs to be static, so that the SIGINT handler can clear the "go"
  * flag and for saved_shb_idb_lock.
@@ -327,6 +381,10 @@ dumpcap_log_writer(const char *domain, enum ws_log_level level,
 /* capture related options */
 static capture_options global_capture_opts;
 static GPtrArray *capture_comments = NULL;
+
+/* Where we also put what we write, for our capture parent to read */
+static char *live_feed_name = NULL;
+static live_feed_t *live_feed = NULL;
 static gboolean quiet = FALSE;
 static gboolean use_threads = FALSE;
 static guint64 start_time;
@@ -337,6 +395,7 @@ static void capture_loop_queue_packet_cb(u_char *pcap_src_p, const struct pcap_p
                                          const u_char *pd);
 static void capture_loop_write_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t *bh, u_char *pd);
 static void capture_loop_queue_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t *bh, u_char *pd);
+static void capture_loop_write_to_live_feed(const guint8 *data, size_t data_length, void *user_data);
 static void capture_loop_get_errmsg(char *errmsg, size_t errmsglen,
                                     char *secondary_errmsg,
                                     size_t secondary_errmsglen,
@@ -347,6 +406,7 @@ static void WS_NORETURN exit_main(int err);
 
 static void report_new_capture_file(const char *filename);
 static void report_packet_count(unsigned int packet_count);
+static void report_queued_packets(capture_options *capture_opts);
 static void report_packet_drops(guint32 received, guint32 pcap_drops, guint32 drops, guint32 flushed, guint32 ps_ifdrop, gchar *name);
 static void report_capture_error(const char *error_msg, const char *secondary_error_msg);
 static void report_cfilter_error(capture_options *capture_opts, guint i, const char *errmsg);
@@ -384,6 +444,10 @@ print_usage(FILE *output)
 #ifdef CAN_SET_CAPTURE_BUFFER_SIZE
     fprintf(output, "  -B <buffer size>, --buffer-size <buffer size>\n");
     fprintf(output, "                           size of kernel buffer in MiB (def: %dMiB)\n", DEFAULT_CAPTURE_BUFFER_SIZE);
+#endif
+#ifdef __linux__
+    fprintf(output, "  --fanout <count>         capture through <count> packet sockets and threads\n");
+    fprintf(output, "                           per interface, rather than with libpcap\n");
 #endif
     fprintf(output, "  -y <link type>, --linktype <link type>\n");
     fprintf(output, "                           link layer type (def: first appropriate)\n");
@@ -431,6 +495,8 @@ print_usage(FILE *output)
     fprintf(output, "                                           (can use 'stdout' or 'stderr')\n");
     fprintf(output, "  -n                       use pcapng format instead of pcap (default)\n");
     fprintf(output, "  -P                       use libpcap format instead of pcapng\n");
+    fprintf(output, "  --write-batch <size>     write packets in batches of about <size> KiB\n");
+    fprintf(output, "                           (def: %dKiB; 0 writes each one on its own)\n", DEFAULT_WRITE_BATCH_SIZE);
     fprintf(output, "  --capture-comment <comment>\n");
     fprintf(output, "                           add a capture comment to the output file\n");
     fprintf(output, "                           (only for pcapng)\n");
@@ -440,6 +506,8 @@ print_usage(FILE *output)
 
     fprintf(output, "Miscellaneous:\n");
     fprintf(output, "  -N <packet_limit>        maximum number of packets buffered within dumpcap\n");
+    fprintf(output, "                           (and at most 16777216 per interface, or 65536\n");
+    fprintf(output, "                           if only -C is given)\n");
     fprintf(output, "  -C <byte_limit>          maximum number of bytes used for buffering packets\n");
     fprintf(output, "                           within dumpcap\n");
     fprintf(output, "  -t                       use a separate thread per interface\n");
@@ -2756,6 +2824,106 @@ pcapng_pipe_dispatch(loop_data *ld, capture_src *pcap_src, char *errmsg, size_t
     return -1;
 }
 
+/*
+ * Open a pcap_t on an interface we capture on with fanout sockets, for
+ * the code that wants one, e.g. to compile the capture filter.
+ *
+ * The kernel takes VLAN tags out of the packets before running the
+ * filter on a packet socket, and keeps them in the packets' metadata.
+ * A filter compiled for a dead pcap_t would look for them in the packet
+ * data; one compiled for a pcap_t activated on the interface looks in
+ * the metadata, as libpcap's own packet socket needs it to.  We never
+ * read from the pcap_t, so have the kernel drop its packets.
+ */
+static pcap_t *
+capture_loop_open_tpacket_pcap(interface_options *interface_opts, int snaplen,
+                               char *errmsg, size_t errmsg_len)
+{
+    static struct bpf_insn drop_insns[] = {
+        BPF_STMT(BPF_RET|BPF_K, 0)
+    };
+    struct bpf_program drop_fcode = { G_N_ELEMENTS(drop_insns), drop_insns };
+    char open_err_str[PCAP_ERRBUF_SIZE];
+    pcap_t *pcap_h;
+
+#ifdef HAVE_PCAP_CREATE
+    pcap_h = pcap_create(interface_opts->name, open_err_str);
+    if (pcap_h != NULL) {
+        pcap_set_snaplen(pcap_h, snaplen);
+        pcap_set_timeout(pcap_h, CAP_READ_TIMEOUT);
+        if (pcap_activate(pcap_h) < 0) {
+            g_strlcpy(open_err_str, pcap_geterr(pcap_h), sizeof open_err_str);
+            pcap_close(pcap_h);
+            pcap_h = NULL;
+        }
+    }
+#else
+    pcap_h = pcap_open_live(interface_opts->name, snaplen, FALSE,
+                            CAP_READ_TIMEOUT, open_err_str);
+#endif
+    if (pcap_h == NULL) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "Couldn't open capture device \"%s\" to compile the capture filter (%s).",
+                   interface_opts->name, open_err_str);
+        return NULL;
+    }
+    if (pcap_datalink(pcap_h) != DLT_EN10MB) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "Only Ethernet can be captured with a fanout group on capture device \"%s\".",
+                   interface_opts->name);
+        pcap_close(pcap_h);
+        return NULL;
+    }
+    if (pcap_setfilter(pcap_h, &drop_fcode) < 0)
+        ws_debug("Couldn't stop packets being queued for \"%s\": %s",
+                 interface_opts->name, pcap_geterr(pcap_h));
+    return pcap_h;
+}
+
+/*
+ * Open an interface as a fanout group of packet sockets, with a pcap_t
+ * of its link-layer type and snapshot length that isn't read from.
+ */
+static gboolean
+capture_loop_open_tpacket(interface_options *interface_opts, capture_src *pcap_src,
+                          char *errmsg, size_t errmsg_len,
+                          char *secondary_errmsg, size_t secondary_errmsg_len)
+{
+    char open_err_str[PCAP_ERRBUF_SIZE];
+    int err;
+    int snaplen = interface_opts->has_snaplen ? interface_opts->snaplen : 256*1024;
+
+    if (interface_opts->linktype != -1 && interface_opts->linktype != DLT_EN10MB) {
+        g_snprintf(errmsg, (gulong) errmsg_len,
+                   "Only Ethernet can be captured with a fanout group on capture device \"%s\".",
+                   interface_opts->name);
+        *secondary_errmsg = '\0';
+        return FALSE;
+    }
+    pcap_src->tpacket = tpacket_capture_open(interface_opts->name, fanout_sockets,
+                                             snaplen, interface_opts->promisc_mode,
+                                             interface_opts->buffer_size,
+                                             CAP_READ_TIMEOUT, &err,
+                                             open_err_str, sizeof open_err_str);
+    if (pcap_src->tpacket == NULL) {
+        get_capture_device_open_failure_messages(
+            (err == EPERM || err == EACCES) ? CAP_DEVICE_OPEN_ERR_PERMISSIONS : CAP_DEVICE_OPEN_ERR_NOT_PERMISSIONS,
+            open_err_str, interface_opts->name,
+            errmsg, errmsg_len, secondary_errmsg, secondary_errmsg_len);
+        return FALSE;
+    }
+    pcap_src->linktype = tpacket_capture_linktype(pcap_src->tpacket);
+    pcap_src->pcap_h = capture_loop_open_tpacket_pcap(interface_opts,
+                                                      tpacket_capture_snaplen(pcap_src->tpacket),
+                                                      errmsg, errmsg_len);
+    if (pcap_src->pcap_h == NULL) {
+        *secondary_errmsg = '\0';
+        return FALSE;
+    }
+    pcap_src->ts_nsec = TRUE;
+    return TRUE;
+}
+
 /** Open the capture input sources; each one is either a pcap device,
  *  a capture pipe, or a capture socket.
  *  Returns TRUE if it succeeds, FALSE otherwise. */
@@ -2821,6 +2989,19 @@ capture_loop_open_input(capture_options *capture_opts, loop_data *ld,
         g_array_append_val(ld->pcaps, pcap_src);
 
         ws_debug("capture_loop_open_input : %s", interface_opts->name);
+        /*
+         * Pipes, FIFOs, stdin and extcap interfaces are opened as
+         * usual even with --fanout; only a network interface can be
+         * captured on with packet sockets.
+         */
+        if (fanout_sockets != 0 && tpacket_capture_is_interface(interface_opts->name)) {
+            if (!capture_loop_open_tpacket(interface_opts, pcap_src,
+                                           errmsg, errmsg_len,
+                                           secondary_errmsg, secondary_errmsg_len)) {
+                return FALSE;
+            }
+            continue;
+        }
         pcap_src->pcap_h = open_capture_device(capture_opts, interface_opts,
             CAP_READ_TIMEOUT, &open_status, &open_status_str);
 
@@ -3007,7 +3188,11 @@ static void capture_loop_close_input(loop_data *ld)
                 pcap_src->cap_pipe_info.pcapng.src_iface_to_global = NULL;
             }
         } else {
-            /* Capture device.  If open, close the pcap_t. */
+            /* Capture device.  If open, close the fanout sockets and the pcap_t. */
+            if (pcap_src->tpacket != NULL) {
+                tpacket_capture_close(pcap_src->tpacket);
+                pcap_src->tpacket = NULL;
+            }
             if (pcap_src->pcap_h != NULL) {
                 ws_debug("capture_loop_close_input: closing %p", (void *)pcap_src->pcap_h);
                 pcap_close(pcap_src->pcap_h);
@@ -3022,23 +3207,38 @@ static void capture_loop_close_input(loop_data *ld)
 
 /* init the capture filter */
 static initfilter_status_t
-capture_loop_init_filter(pcap_t *pcap_h, gboolean from_cap_pipe,
-                         const gchar * name, const gchar * cfilter)
+capture_loop_init_filter(capture_src *pcap_src, const gchar * name, const gchar * cfilter,
+                         char *errmsg, size_t errmsg_len)
 {
     struct bpf_program fcode;
+    char               tpacket_errmsg[PCAP_ERRBUF_SIZE];
 
     ws_debug("capture_loop_init_filter: %s", cfilter);
 
     /* capture filters only work on real interfaces */
-    if (cfilter && !from_cap_pipe) {
+    if (cfilter && !pcap_src->from_cap_pipe) {
         /* A capture filter was specified; set it up. */
-        if (!compile_capture_filter(name, pcap_h, &fcode, cfilter)) {
+        if (!compile_capture_filter(name, pcap_src->pcap_h, &fcode, cfilter)) {
             /* Treat this specially - our caller might try to compile this
                as a display filter and, if that succeeds, warn the user that
                the display and capture filter syntaxes are different. */
+            g_snprintf(errmsg, (gulong) errmsg_len, "%s", pcap_geterr(pcap_src->pcap_h));
             return INITFILTER_BAD_FILTER;
         }
-        if (pcap_setfilter(pcap_h, &fcode) < 0) {
+        if (pcap_src->tpacket != NULL) {
+            /* The kernel runs it on the packets for each of our sockets. */
+            if (!tpacket_capture_set_filter(pcap_src->tpacket, &fcode,
+                                            tpacket_errmsg, sizeof tpacket_errmsg)) {
+                g_snprintf(errmsg, (gulong) errmsg_len, "Can't install filter (%s).",
+                           tpacket_errmsg);
+#ifdef HAVE_PCAP_FREECODE
+                pcap_freecode(&fcode);
+#endif
+                return INITFILTER_OTHER_ERROR;
+            }
+        } else if (pcap_setfilter(pcap_src->pcap_h, &fcode) < 0) {
+            g_snprintf(errmsg, (gulong) errmsg_len, "Can't install filter (%s).",
+                       pcap_geterr(pcap_src->pcap_h));
 #ifdef HAVE_PCAP_FREECODE
             pcap_freecode(&fcode);
 #endif
@@ -3166,6 +3366,52 @@ capture_loop_init_pcapng_output(capture_options *capture_opts, loop_data *ld,
     return successful;
 }
 
+/*
+ * Write out the packets waiting in the batch, if we're writing them in
+ * batches; this has to be done before anything else is written to the
+ * capture file, and before it's flushed or switched.
+ * If this fails, set "ld->go" to FALSE, to stop the capture, and set
+ * "ld->err" to the error.
+ */
+static gboolean
+capture_loop_flush_batch(loop_data *ld)
+{
+    int err;
+
+    if (ld->batch == NULL || ld->pdh == NULL)
+        return TRUE;
+    if (!pcapio_batch_flush(ld->pdh, ld->batch, &err)) {
+        ld->go = FALSE;
+        ld->err = err;
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/*
+ * Attach to the live feed our capture parent asked us to put what we
+ * write into, if it asked for one.  This opens and maps it read-write,
+ * so it's done once we've opened the capture devices and given up any
+ * special privileges, not when we parse the command line.
+ */
+static void
+capture_loop_attach_live_feed(void)
+{
+    GError *feed_err = NULL;
+
+    if (live_feed_name == NULL || live_feed != NULL)
+        return;
+
+    live_feed = live_feed_attach(live_feed_name, &feed_err);
+    if (live_feed != NULL) {
+        pcapio_set_write_observer(capture_loop_write_to_live_feed, live_feed);
+    } else {
+        /* Our parent will just read everything from the file. */
+        ws_debug("Couldn't attach to the live feed: %s", feed_err->message);
+        g_error_free(feed_err);
+    }
+}
+
 /* set up to write to the already-opened capture output file/files */
 static gboolean
 capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *errmsg, int errmsg_len)
@@ -3174,6 +3420,8 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
 
     ws_debug("capture_loop_init_output");
 
+    capture_loop_attach_live_feed();
+
     if ((capture_opts->use_pcapng == FALSE) &&
         (capture_opts->ifaces->len > 1)) {
         g_snprintf(errmsg, errmsg_len,
@@ -3184,11 +3432,15 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
     /* Set up to write to the capture file. */
     if (capture_opts->multi_files_on) {
         ld->pdh = ringbuf_init_libpcap_fdopen(&err);
+        if (ld->pdh && live_feed != NULL)
+            live_feed_start_file(live_feed, fileno(ld->pdh));
     } else {
         ld->pdh = ws_fdopen(ld->save_file_fd, "wb");
         if (ld->pdh == NULL) {
             err = errno;
         } else {
+            if (live_feed != NULL)
+                live_feed_start_file(live_feed, ld->save_file_fd);
             size_t buffsize = IO_BUF_SIZE;
 #ifdef HAVE_STRUCT_STAT_ST_BLKSIZE
             ws_statb64 statb;
@@ -3225,6 +3477,8 @@ capture_loop_init_output(capture_options *capture_opts, loop_data *ld, char *err
             ld->pdh = NULL;
             g_free(ld->io_buffer);
             ld->io_buffer = NULL;
+        } else if (write_batch_size != 0) {
+            ld->batch = pcapio_batch_new((size_t)write_batch_size * 1024);
         }
     }
 
@@ -3259,6 +3513,10 @@ capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err
 
     ws_debug("capture_loop_close_output");
 
+    /* The last batch was written out when we stopped capturing. */
+    pcapio_batch_free(ld->batch);
+    ld->batch = NULL;
+
     if (capture_opts->multi_files_on) {
         return ringbuf_libpcap_dump_close(&capture_opts->save_file, err_close);
     } else {
@@ -3267,9 +3525,15 @@ capture_loop_close_output(capture_options *capture_opts, loop_data *ld, int *err
                 pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
                 if (!pcap_src->from_cap_pipe) {
                     guint64 isb_ifrecv, isb_ifdrop;
+                    guint64 kernel_received, kernel_dropped;
                     struct pcap_stat stats;
 
-                    if (pcap_stats(pcap_src->pcap_h, &stats) >= 0) {
+                    if (pcap_src->tpacket != NULL &&
+                        tpacket_capture_stats(pcap_src->tpacket, &kernel_received, &kernel_dropped)) {
+                        /* Packets the kernel had no room for in our sockets' rings */
+                        isb_ifrecv = pcap_src->received;
+                        isb_ifdrop = kernel_dropped + pcap_src->dropped + pcap_src->flushed;
+                    } else if (pcap_src->tpacket == NULL && pcap_stats(pcap_src->pcap_h, &stats) >= 0) {
                         isb_ifrecv = pcap_src->received;
                         isb_ifdrop = stats.ps_drop + pcap_src->dropped + pcap_src->flushed;
                    } else {
@@ -3729,11 +3993,17 @@ do_file_switch_or_stop(capture_options *capture_opts)
             return FALSE;
         }
 
+        /* Finish the current file */
+        if (!capture_loop_flush_batch(&global_ld))
+            return FALSE;
+
         /* Switch to the next ringbuffer file */
         if (ringbuf_switch_file(&global_ld.pdh, &capture_opts->save_file,
                                 &global_ld.save_file_fd, &global_ld.err)) {
 
             /* File switch succeeded: reset the conditions */
+            if (live_feed != NULL)
+                live_feed_start_file(live_feed, global_ld.save_file_fd);
             global_ld.bytes_written = 0;
             global_ld.packets_written = 0;
             if (capture_opts->use_pcapng) {
@@ -3798,44 +4068,282 @@ pcap_read_handler(void* arg)
     return (NULL);
 }
 
-/* Try to pop an item off the packet queue and if it exists, write it */
-static gboolean
-capture_loop_dequeue_packet(void) {
+static void
+pcap_queue_ring_init(capture_src *pcap_src)
+{
+    pcap_queue_ring *ring = g_new0(pcap_queue_ring, 1);
+    guint size = PCAP_QUEUE_RING_SIZE;
+
+    /*
+     * There's no point in having room for more packets than we'd queue,
+     * and we don't want the ring to drop packets that -N would let us
+     * queue.
+     */
+    if (pcap_queue_packet_limit != 0) {
+        size = 1;
+        while (size < pcap_queue_packet_limit && size < PCAP_QUEUE_RING_MAX_SIZE)
+            size *= 2;
+    }
+    ring->elements = g_new0(pcap_queue_element, size);
+    ring->size = size;
+    pcap_src->queue = ring;
+}
+
+static void
+pcap_queue_ring_free(capture_src *pcap_src)
+{
+    pcap_queue_ring *ring = pcap_src->queue;
+    guint i;
+
+    if (ring == NULL)
+        return;
+    ws_info("At most %u packets were queued for interface %u.",
+          (guint)ring->high_watermark, pcap_src->interface_id);
+    for (i = 0; i < ring->size; i++)
+        g_free(ring->elements[i].pd);
+    g_free(ring->elements);
+    g_free(ring);
+    pcap_src->queue = NULL;
+}
+
+/*
+ * Called by a capture thread to get the element for the next packet it
+ * queues, with room for len bytes of data; returns NULL if the packet
+ * has to be dropped, as the queue is full.
+ */
+static pcap_queue_element *
+pcap_queue_reserve(capture_src *pcap_src, guint len)
+{
+    pcap_queue_ring *ring = pcap_src->queue;
+    pcap_queue_element *element;
+    guint head = (guint)ring->head;     /* only we change it */
+
+    if (head - (guint)g_atomic_int_get(&ring->tail) >= ring->size)
+        return NULL;
+
+    if (pcap_queue_byte_limit != 0 || pcap_queue_packet_limit != 0) {
+        /* The limits are on what's queued for all interfaces. */
+        gint64 queued_bytes = 0;
+        gint64 queued_packets = 0;
+        guint i;
+
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_queue_ring *other = g_array_index(global_ld.pcaps, capture_src *, i)->queue;
+
+            if (other == NULL)
+                continue;   /* capturing with fanout sockets */
+            queued_bytes += (guint)g_atomic_int_get(&other->bytes_in) - (guint)g_atomic_int_get(&other->bytes_out);
+            queued_packets += (guint)g_atomic_int_get(&other->head) - (guint)g_atomic_int_get(&other->tail);
+        }
+        if (((pcap_queue_byte_limit != 0) && (queued_bytes >= pcap_queue_byte_limit)) ||
+            ((pcap_queue_packet_limit != 0) && (queued_packets >= pcap_queue_packet_limit)))
+            return NULL;
+    }
+
+    element = &ring->elements[head & (ring->size - 1)];
+    if (element->pd_size < len) {
+        g_free(element->pd);
+        element->pd = (u_char *)g_malloc(len);
+        element->pd_size = len;
+    }
+    return element;
+}
+
+/*
+ * Called by the main thread to hand an element whose packet it has
+ * written back to the capture thread.
+ *
+ * The element's buffer is kept for the next packet queued in it, unless
+ * it's bigger than most packets need, or the ring's taken elements are
+ * already keeping as much memory as -C lets us queue (or
+ * PCAP_QUEUE_KEEP_BYTES, if that's more); otherwise each element would
+ * keep the largest buffer it ever needed, and a large ring would keep a
+ * buffer for each element.
+ */
+static void
+pcap_queue_release(capture_src *pcap_src, pcap_queue_element *element, guint len)
+{
+    pcap_queue_ring *ring = pcap_src->queue;
+    guint64 keep_bytes = MAX(pcap_queue_byte_limit, PCAP_QUEUE_KEEP_BYTES);
+
+    /* The capture thread may have replaced the buffer since we counted it. */
+    ring->kept_bytes -= element->pd_kept;
+    if (element->pd_size > PCAP_QUEUE_KEEP_PD_SIZE ||
+        ring->kept_bytes + element->pd_size > keep_bytes) {
+        g_free(element->pd);
+        element->pd = NULL;
+        element->pd_size = 0;
+    }
+    element->pd_kept = element->pd_size;
+    ring->kept_bytes += element->pd_kept;
+
+    g_atomic_int_add(&ring->bytes_out, (gint)len);
+    g_atomic_int_inc(&ring->tail);
+}
+
+/* Called by a capture thread to wake up the main thread if it's waiting for packets. */
+static void
+pcap_queue_wake_writer(void *user_data _U_)
+{
+    if (g_atomic_int_get(&pcap_queue_writer_waiting)) {
+        g_mutex_lock(&pcap_queue_mutex);
+        g_cond_signal(&pcap_queue_cond);
+        g_mutex_unlock(&pcap_queue_mutex);
+    }
+}
+
+/*
+ * Called by a capture thread to make the element it got from
+ * pcap_queue_reserve(), now filled in, available to the main thread.
+ */
+static void
+pcap_queue_commit(capture_src *pcap_src, guint len)
+{
+    pcap_queue_ring *ring = pcap_src->queue;
+    guint queued;
+
+    g_atomic_int_add(&ring->bytes_in, (gint)len);
+    g_atomic_int_inc(&ring->head);
+
+    queued = (guint)ring->head - (guint)g_atomic_int_get(&ring->tail);
+    if (queued > (guint)ring->high_watermark)
+        g_atomic_int_set(&ring->high_watermark, (gint)queued);
+
+    pcap_queue_wake_writer(NULL);
+}
+
+/* The number of packets queued for an interface. */
+static guint
+pcap_queue_count(const capture_src *pcap_src)
+{
+    return (guint)g_atomic_int_get(&pcap_src->queue->head) - (guint)g_atomic_int_get(&pcap_src->queue->tail);
+}
+
+/*
+ * Find the interface with the earliest packet at the front of its
+ * queue, so that packets captured at about the same time on different
+ * interfaces are written in time order; returns NULL if all the queues
+ * are empty.  Blocks read from pcapng pipes don't necessarily have time
+ * stamps, so they're written as soon as possible.
+ *
+ * For an interface we capture on with fanout sockets, the front of each
+ * socket's ring is looked at, and the socket with the earliest packet
+ * is put in tpacket_next.
+ */
+static capture_src *
+pcap_queue_next_src(void)
+{
+    capture_src *best_src = NULL;
+    guint64 best_ts = 0;
+    guint i, sock;
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        capture_src *pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        pcap_queue_ring *ring = pcap_src->queue;
+        pcap_queue_element *element;
+        const struct pcap_pkthdr *phdr;
+        const u_char *pd;
+        guint64 ts;
+
+        if (pcap_src->tpacket != NULL) {
+            for (sock = 0; sock < tpacket_capture_num_sockets(pcap_src->tpacket); sock++) {
+                phdr = tpacket_capture_peek(pcap_src->tpacket, sock, &pd);
+                if (phdr == NULL)
+                    continue;
+                ts = (guint64)phdr->ts.tv_sec * 1000000000 + (guint64)phdr->ts.tv_usec;
+                if (best_src == NULL || ts < best_ts) {
+                    best_src = pcap_src;
+                    best_ts = ts;
+                    pcap_src->tpacket_next = sock;
+                }
+            }
+            continue;
+        }
+        if (pcap_queue_count(pcap_src) == 0)
+            continue;
+        if (pcap_src->from_pcapng)
+            return pcap_src;
+        element = &ring->elements[(guint)ring->tail & (ring->size - 1)];
+        ts = (guint64)element->u.phdr.ts.tv_sec * 1000000000 +
+             (guint64)element->u.phdr.ts.tv_usec * (pcap_src->ts_nsec ? 1 : 1000);
+        if (best_src == NULL || ts < best_ts) {
+            best_src = pcap_src;
+            best_ts = ts;
+        }
+    }
+    return best_src;
+}
+
+/*
+ * Write up to PCAP_QUEUE_WRITE_BATCH queued packets, waiting up to
+ * WRITER_THREAD_TIMEOUT for one if there are none; returns the number
+ * of packets written.
+ */
+static int
+capture_loop_dequeue_packets(void) {
+    capture_src *pcap_src;
+    pcap_queue_ring *ring;
     pcap_queue_element *queue_element;
+    const struct pcap_pkthdr *phdr;
+    const u_char *pd;
+    guint len;
+    int written;
 
-    g_async_queue_lock(pcap_queue);
-    queue_element = (pcap_queue_element *)g_async_queue_timeout_pop_unlocked(pcap_queue, WRITER_THREAD_TIMEOUT);
-    if (queue_element) {
-        if (queue_element->pcap_src->from_pcapng) {
-            pcap_queue_bytes -= queue_element->u.bh.block_total_length;
-        } else {
-            pcap_queue_bytes -= queue_element->u.phdr.caplen;
+    pcap_src = pcap_queue_next_src();
+    if (pcap_src == NULL) {
+        /*
+         * Tell the capture threads that we're waiting before we check
+         * again, so that a packet queued after that check wakes us up.
+         */
+        g_mutex_lock(&pcap_queue_mutex);
+        g_atomic_int_set(&pcap_queue_writer_waiting, 1);
+        pcap_src = pcap_queue_next_src();
+        if (pcap_src == NULL) {
+            g_cond_wait_until(&pcap_queue_cond, &pcap_queue_mutex,
+                              g_get_monotonic_time() + WRITER_THREAD_TIMEOUT);
+            pcap_src = pcap_queue_next_src();
         }
-        pcap_queue_packets -= 1;
+        g_atomic_int_set(&pcap_queue_writer_waiting, 0);
+        g_mutex_unlock(&pcap_queue_mutex);
     }
-    g_async_queue_unlock(pcap_queue);
-    if (queue_element) {
-        if (queue_element->pcap_src->from_pcapng) {
+
+    for (written = 0; pcap_src != NULL && written < PCAP_QUEUE_WRITE_BATCH; written++) {
+        if (pcap_src->tpacket != NULL) {
+            /* Write the packet from where the kernel put it, then move past it. */
+            phdr = tpacket_capture_peek(pcap_src->tpacket, pcap_src->tpacket_next, &pd);
+            pcap_src->received++;
+            capture_loop_write_packet_cb((u_char *) pcap_src, phdr, pd);
+            tpacket_capture_next(pcap_src->tpacket, pcap_src->tpacket_next);
+
+            pcap_src = pcap_queue_next_src();
+            continue;
+        }
+        ring = pcap_src->queue;
+        queue_element = &ring->elements[(guint)ring->tail & (ring->size - 1)];
+        if (pcap_src->from_pcapng) {
             ws_info("Dequeued a block of type 0x%08x of length %d captured on interface %d.",
                   queue_element->u.bh.block_type, queue_element->u.bh.block_total_length,
-                  queue_element->pcap_src->interface_id);
+                  pcap_src->interface_id);
 
-            capture_loop_write_pcapng_cb(queue_element->pcap_src,
+            len = queue_element->u.bh.block_total_length;
+            capture_loop_write_pcapng_cb(pcap_src,
                                         &queue_element->u.bh,
                                         queue_element->pd);
         } else {
             ws_info("Dequeued a packet of length %d captured on interface %d.",
-                queue_element->u.phdr.caplen, queue_element->pcap_src->interface_id);
+                queue_element->u.phdr.caplen, pcap_src->interface_id);
 
-            capture_loop_write_packet_cb((u_char *) queue_element->pcap_src,
+            len = queue_element->u.phdr.caplen;
+            capture_loop_write_packet_cb((u_char *) pcap_src,
                                         &queue_element->u.phdr,
                                         queue_element->pd);
         }
-        g_free(queue_element->pd);
-        g_free(queue_element);
-        return TRUE;
+
+        pcap_queue_release(pcap_src, queue_element, len);
+
+        pcap_src = pcap_queue_next_src();
     }
-    return FALSE;
+    return written;
 }
 
 /*
@@ -3910,6 +4418,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     global_ld.pdh                 = NULL;
     global_ld.save_file_fd        = -1;
     global_ld.io_buffer           = NULL;
+    global_ld.batch               = NULL;
     global_ld.file_count          = 0;
     global_ld.file_duration_timer = NULL;
     global_ld.next_interval_time  = 0;
@@ -3935,9 +4444,9 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
          * is NULL. This might be a bug in WPCap. Therefore we provide an empty
          * string.
          */
-        switch (capture_loop_init_filter(pcap_src->pcap_h, pcap_src->from_cap_pipe,
-                                         interface_opts->name,
-                                         interface_opts->cfilter?interface_opts->cfilter:"")) {
+        switch (capture_loop_init_filter(pcap_src, interface_opts->name,
+                                         interface_opts->cfilter?interface_opts->cfilter:"",
+                                         errmsg, sizeof(errmsg))) {
 
         case INITFILTER_NO_ERROR:
             break;
@@ -3945,15 +4454,22 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
         case INITFILTER_BAD_FILTER:
             cfilter_error = TRUE;
             error_index = i;
-            g_snprintf(errmsg, sizeof(errmsg), "%s", pcap_geterr(pcap_src->pcap_h));
             goto error;
 
         case INITFILTER_OTHER_ERROR:
-            g_snprintf(errmsg, sizeof(errmsg), "Can't install filter (%s).",
-                       pcap_geterr(pcap_src->pcap_h));
             g_snprintf(secondary_errmsg, sizeof(secondary_errmsg), "%s", please_report_bug());
             goto error;
         }
+
+        /* Now that the filter's on our sockets, start capturing on them. */
+        if (pcap_src->tpacket != NULL &&
+            !tpacket_capture_start(pcap_src->tpacket, pcap_queue_wake_writer, NULL,
+                                   secondary_errmsg, sizeof(secondary_errmsg))) {
+            g_snprintf(errmsg, sizeof(errmsg),
+                       "The capture session could not be initiated on capture device \"%s\".",
+                       interface_opts->name);
+            goto error;
+        }
     }
 
     /* If we're supposed to write to a capture file, open it for output
@@ -4020,25 +4536,23 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
     /* WOW, everything is prepared! */
     /* please fasten your seat belts, we will enter now the actual capture loop */
     if (use_threads) {
-        pcap_queue = g_async_queue_new();
-        pcap_queue_bytes = 0;
-        pcap_queue_packets = 0;
+        /* Fanout sockets have their own threads and rings, already started. */
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+            if (pcap_src->tpacket == NULL)
+                pcap_queue_ring_init(pcap_src);
+        }
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
             /* XXX - Add an interface name here? */
-            pcap_src->tid = g_thread_new("Capture read", pcap_read_handler, pcap_src);
+            if (pcap_src->tpacket == NULL)
+                pcap_src->tid = g_thread_new("Capture read", pcap_read_handler, pcap_src);
         }
     }
     while (global_ld.go) {
         /* dispatch incoming packets */
         if (use_threads) {
-            gboolean dequeued = capture_loop_dequeue_packet();
-
-            if (dequeued) {
-                inpkts = 1;
-            } else {
-                inpkts = 0;
-            }
+            inpkts = capture_loop_dequeue_packets();
         } else {
             pcap_src = g_array_index(global_ld.pcaps, capture_src *, 0);
             inpkts = capture_loop_dispatch(&global_ld, errmsg,
@@ -4049,6 +4563,11 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             gboolean open_interfaces = FALSE;
             for (i = 0; i < global_ld.pcaps->len; i++) {
                 pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+                if (pcap_src->tpacket != NULL && tpacket_capture_geterr(pcap_src->tpacket) != NULL) {
+                    /* One of its sockets failed; we've written what they captured. */
+                    pcap_src->pcap_err = TRUE;
+                    global_ld.go = FALSE;
+                }
                 if (pcap_src->cap_pipe_err == PIPOK) {
                     /* True for both non-pipes and open pipes. */
                     open_interfaces = TRUE;
@@ -4076,6 +4595,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
 
         if (inpkts > 0) {
             if (capture_opts->output_to_pipe) {
+                capture_loop_flush_batch(&global_ld);
                 fflush(global_ld.pdh);
             }
         } /* inpkts */
@@ -4106,6 +4626,7 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             /* Let the parent process know. */
             if (global_ld.inpkts_to_sync_pipe) {
                 /* do sync here */
+                capture_loop_flush_batch(&global_ld);
                 fflush(global_ld.pdh);
 
                 /* Send our parent a message saying we've written out
@@ -4115,6 +4636,8 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
 
                 global_ld.inpkts_to_sync_pipe = 0;
             }
+            if (!quiet)
+                report_queued_packets(capture_opts);
 
             /* check capture duration condition */
             if (autostop_duration_timer != NULL && g_timer_elapsed(autostop_duration_timer, NULL) >= capture_opts->autostop_duration) {
@@ -4145,18 +4668,29 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
         for (i = 0; i < global_ld.pcaps->len; i++) {
             pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
             ws_info("Waiting for thread of interface %u...", pcap_src->interface_id);
-            g_thread_join(pcap_src->tid);
+            if (pcap_src->tpacket != NULL)
+                tpacket_capture_stop(pcap_src->tpacket);
+            else
+                g_thread_join(pcap_src->tid);
             ws_info("Thread of interface %u terminated.", pcap_src->interface_id);
         }
         while (1) {
-            gboolean dequeued = capture_loop_dequeue_packet();
-            if (!dequeued) {
+            int dequeued = capture_loop_dequeue_packets();
+            if (dequeued == 0) {
                 break;
             }
             if (capture_opts->output_to_pipe) {
+                capture_loop_flush_batch(&global_ld);
                 fflush(global_ld.pdh);
             }
         }
+        /* The parent gets the final high-water marks. */
+        if (!quiet)
+            report_queued_packets(capture_opts);
+        for (i = 0; i < global_ld.pcaps->len; i++) {
+            pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+            pcap_queue_ring_free(pcap_src);
+        }
     }
 
 
@@ -4203,7 +4737,10 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             char *secondary_msg;
 
             interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
-            cap_err_str = pcap_geterr(pcap_src->pcap_h);
+            if (pcap_src->tpacket != NULL)
+                cap_err_str = (char *)tpacket_capture_geterr(pcap_src->tpacket);
+            else
+                cap_err_str = pcap_geterr(pcap_src->pcap_h);
             if (strcmp(cap_err_str, "The interface went down") == 0 ||
                 strcmp(cap_err_str, "recvfrom: Network is down") == 0) {
                 primary_msg = g_strdup_printf("The network adapter \"%s\" "
@@ -4279,6 +4816,9 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
             break;
         }
     }
+    /* write out the packets still waiting in a batch */
+    capture_loop_flush_batch(&global_ld);
+
     /* did we have an output error while capturing? */
     if (global_ld.err == 0) {
         write_ok = TRUE;
@@ -4332,7 +4872,23 @@ capture_loop_start(capture_options *capture_opts, gboolean *stats_known, struct
         pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
         interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
         received = pcap_src->received;
-        if (pcap_src->pcap_h != NULL) {
+        if (pcap_src->tpacket != NULL) {
+            guint64 kernel_received, kernel_dropped;
+
+            /* Get the kernel's counts for our sockets. */
+            if (tpacket_capture_stats(pcap_src->tpacket, &kernel_received, &kernel_dropped)) {
+                *stats_known = TRUE;
+                stats->ps_recv = (u_int)kernel_received;
+                stats->ps_drop = (u_int)kernel_dropped;
+                stats->ps_ifdrop = 0;
+                pcap_dropped += stats->ps_drop;
+            } else {
+                g_snprintf(errmsg, sizeof(errmsg),
+                           "Can't get packet-drop statistics: %s",
+                           g_strerror(errno));
+                report_capture_error(errmsg, please_report_bug());
+            }
+        } else if (pcap_src->pcap_h != NULL) {
             ws_assert(!pcap_src->from_cap_pipe);
             /* Get the capture statistics, so we know how many packets were dropped. */
             if (pcap_stats(pcap_src->pcap_h, stats) >= 0) {
@@ -4474,6 +5030,7 @@ capture_loop_wrote_one_packet(capture_src *pcap_src) {
 
     /* check -c NUM / -a packets:NUM */
     if (global_capture_opts.has_autostop_packets && global_ld.packets_captured >= global_capture_opts.autostop_packets) {
+        capture_loop_flush_batch(&global_ld);
         fflush(global_ld.pdh);
         global_ld.go = FALSE;
         return;
@@ -4493,6 +5050,13 @@ capture_loop_wrote_one_packet(capture_src *pcap_src) {
     }
 }
 
+/* something was written to the capture file, pass it on to our parent */
+static void
+capture_loop_write_to_live_feed(const guint8 *data, size_t data_length, void *user_data)
+{
+    live_feed_write((live_feed_t *)user_data, data, data_length);
+}
+
 /* one pcapng block was captured, process it */
 static void
 capture_loop_write_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t *bh, u_char *pd)
@@ -4530,9 +5094,14 @@ capture_loop_write_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t
     if (global_ld.pdh) {
         gboolean successful;
 
-        /* We're supposed to write the packet to a file; do so.
+        /* We're supposed to write the packet to a file; do so, after
+           any packets batched before it.
            If this fails, set "ld->go" to FALSE, to stop the capture, and set
            "ld->err" to the error. */
+        if (!capture_loop_flush_batch(&global_ld)) {
+            pcap_src->dropped++;
+            return;
+        }
         successful = pcapng_write_block(global_ld.pdh,
                                        pd,
                                        bh->block_total_length,
@@ -4586,7 +5155,17 @@ capture_loop_write_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
         /* We're supposed to write the packet to a file; do so.
            If this fails, set "ld->go" to FALSE, to stop the capture, and set
            "ld->err" to the error. */
-        if (global_capture_opts.use_pcapng) {
+        if (global_capture_opts.use_pcapng && global_ld.batch != NULL) {
+            successful = pcapng_batch_enhanced_packet_block(global_ld.pdh,
+                                                            global_ld.batch,
+                                                            NULL,
+                                                            phdr->ts.tv_sec, (gint32)phdr->ts.tv_usec,
+                                                            phdr->caplen, phdr->len,
+                                                            pcap_src->interface_id,
+                                                            ts_mul,
+                                                            pd, 0,
+                                                            &global_ld.bytes_written, &err);
+        } else if (global_capture_opts.use_pcapng) {
             successful = pcapng_write_enhanced_packet_block(global_ld.pdh,
                                                             NULL,
                                                             phdr->ts.tv_sec, (gint32)phdr->ts.tv_usec,
@@ -4595,6 +5174,13 @@ capture_loop_write_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
                                                             ts_mul,
                                                             pd, 0,
                                                             &global_ld.bytes_written, &err);
+        } else if (global_ld.batch != NULL) {
+            successful = libpcap_batch_packet(global_ld.pdh,
+                                              global_ld.batch,
+                                              phdr->ts.tv_sec, (gint32)phdr->ts.tv_usec,
+                                              phdr->caplen, phdr->len,
+                                              pd,
+                                              &global_ld.bytes_written, &err);
         } else {
             successful = libpcap_write_packet(global_ld.pdh,
                                               phdr->ts.tv_sec, (gint32)phdr->ts.tv_usec,
@@ -4623,7 +5209,6 @@ capture_loop_queue_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
 {
     capture_src        *pcap_src = (capture_src *) (void *) pcap_src_p;
     pcap_queue_element *queue_element;
-    gboolean            limit_reached;
 
     /* We may be called multiple times from pcap_dispatch(); if we've set
        the "stop capturing" flag, ignore this packet, as we're not
@@ -4633,46 +5218,22 @@ capture_loop_queue_packet_cb(u_char *pcap_src_p, const struct pcap_pkthdr *phdr,
         return;
     }
 
-    queue_element = g_new(pcap_queue_element, 1);
+    queue_element = pcap_queue_reserve(pcap_src, phdr->caplen);
     if (queue_element == NULL) {
-       pcap_src->dropped++;
-       return;
-    }
-    queue_element->pcap_src = pcap_src;
-    queue_element->u.phdr = *phdr;
-    queue_element->pd = (u_char *)g_malloc(phdr->caplen);
-    if (queue_element->pd == NULL) {
         pcap_src->dropped++;
-        g_free(queue_element);
-        return;
-    }
-    memcpy(queue_element->pd, pd, phdr->caplen);
-    g_async_queue_lock(pcap_queue);
-    if (((pcap_queue_byte_limit == 0) || (pcap_queue_bytes < pcap_queue_byte_limit)) &&
-        ((pcap_queue_packet_limit == 0) || (pcap_queue_packets < pcap_queue_packet_limit))) {
-        limit_reached = FALSE;
-        g_async_queue_push_unlocked(pcap_queue, queue_element);
-        pcap_queue_bytes += phdr->caplen;
-        pcap_queue_packets += 1;
-    } else {
-        limit_reached = TRUE;
-    }
-    g_async_queue_unlock(pcap_queue);
-    if (limit_reached) {
-        pcap_src->dropped++;
-        g_free(queue_element->pd);
-        g_free(queue_element);
         ws_info("Dropped a packet of length %d captured on interface %u.",
               phdr->caplen, pcap_src->interface_id);
-    } else {
-        pcap_src->received++;
-        ws_info("Queued a packet of length %d captured on interface %u.",
-              phdr->caplen, pcap_src->interface_id);
+        return;
     }
-    /* I don't want to hold the mutex over the debug output. So the
-       output may be wrong */
-    ws_info("Queue size is now %" G_GINT64_MODIFIER "d bytes (%" G_GINT64_MODIFIER "d packets)",
-          pcap_queue_bytes, pcap_queue_packets);
+    queue_element->u.phdr = *phdr;
+    memcpy(queue_element->pd, pd, phdr->caplen);
+    pcap_queue_commit(pcap_src, phdr->caplen);
+
+    pcap_src->received++;
+    ws_info("Queued a packet of length %d captured on interface %u.",
+          phdr->caplen, pcap_src->interface_id);
+    ws_info("Queue for interface %u now has %u packets",
+          pcap_src->interface_id, pcap_queue_count(pcap_src));
 }
 
 /* one pcapng block was captured, queue it */
@@ -4680,7 +5241,6 @@ static void
 capture_loop_queue_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t *bh, u_char *pd)
 {
     pcap_queue_element *queue_element;
-    gboolean            limit_reached;
 
     /* We may be called multiple times from pcap_dispatch(); if we've set
        the "stop capturing" flag, ignore this packet, as we're not
@@ -4690,46 +5250,22 @@ capture_loop_queue_pcapng_cb(capture_src *pcap_src, const pcapng_block_header_t
         return;
     }
 
-    queue_element = g_new(pcap_queue_element, 1);
+    queue_element = pcap_queue_reserve(pcap_src, bh->block_total_length);
     if (queue_element == NULL) {
-       pcap_src->dropped++;
-       return;
-    }
-    queue_element->pcap_src = pcap_src;
-    queue_element->u.bh = *bh;
-    queue_element->pd = (u_char *)g_malloc(bh->block_total_length);
-    if (queue_element->pd == NULL) {
         pcap_src->dropped++;
-        g_free(queue_element);
-        return;
-    }
-    memcpy(queue_element->pd, pd, bh->block_total_length);
-    g_async_queue_lock(pcap_queue);
-    if (((pcap_queue_byte_limit == 0) || (pcap_queue_bytes < pcap_queue_byte_limit)) &&
-        ((pcap_queue_packet_limit == 0) || (pcap_queue_packets < pcap_queue_packet_limit))) {
-        limit_reached = FALSE;
-        g_async_queue_push_unlocked(pcap_queue, queue_element);
-        pcap_queue_bytes += bh->block_total_length;
-        pcap_queue_packets += 1;
-    } else {
-        limit_reached = TRUE;
-    }
-    g_async_queue_unlock(pcap_queue);
-    if (limit_reached) {
-        pcap_src->dropped++;
-        g_free(queue_element->pd);
-        g_free(queue_element);
         ws_info("Dropped a packet of length %d captured on interface %u.",
               bh->block_total_length, pcap_src->interface_id);
-    } else {
-        pcap_src->received++;
-        ws_info("Queued a block of type 0x%08x of length %d captured on interface %u.",
-              bh->block_type, bh->block_total_length, pcap_src->interface_id);
+        return;
     }
-    /* I don't want to hold the mutex over the debug output. So the
-       output may be wrong */
-    ws_info("Queue size is now %" G_GINT64_MODIFIER "d bytes (%" G_GINT64_MODIFIER "d packets)",
-          pcap_queue_bytes, pcap_queue_packets);
+    queue_element->u.bh = *bh;
+    memcpy(queue_element->pd, pd, bh->block_total_length);
+    pcap_queue_commit(pcap_src, bh->block_total_length);
+
+    pcap_src->received++;
+    ws_info("Queued a block of type 0x%08x of length %d captured on interface %u.",
+          bh->block_type, bh->block_total_length, pcap_src->interface_id);
+    ws_info("Queue for interface %u now has %u packets",
+          pcap_src->interface_id, pcap_queue_count(pcap_src));
 }
 
 static int
@@ -4810,6 +5346,9 @@ get_dumpcap_runtime_info(GString *str)
 #define LONGOPT_IFNAME             LONGOPT_BASE_APPLICATION+1
 #define LONGOPT_IFDESCR            LONGOPT_BASE_APPLICATION+2
 #define LONGOPT_CAPTURE_COMMENT    LONGOPT_BASE_APPLICATION+3
+#define LONGOPT_LIVE_FEED          LONGOPT_BASE_APPLICATION+4
+#define LONGOPT_FANOUT             LONGOPT_BASE_APPLICATION+5
+#define LONGOPT_WRITE_BATCH        LONGOPT_BASE_APPLICATION+6
 
 /* And now our feature presentation... [ fade to music ] */
 int
@@ -4824,6 +5363,9 @@ main(int argc, char *argv[])
         {"ifname", ws_required_argument, NULL, LONGOPT_IFNAME},
         {"ifdescr", ws_required_argument, NULL, LONGOPT_IFDESCR},
         {"capture-comment", ws_required_argument, NULL, LONGOPT_CAPTURE_COMMENT},
+        {"live-feed", ws_required_argument, NULL, LONGOPT_LIVE_FEED},
+        {"fanout", ws_required_argument, NULL, LONGOPT_FANOUT},
+        {"write-batch", ws_required_argument, NULL, LONGOPT_WRITE_BATCH},
         {0, 0, 0, 0 }
     };
 
@@ -5184,6 +5726,36 @@ main(int argc, char *argv[])
             }
             g_ptr_array_add(capture_comments, g_strdup(ws_optarg));
             break;
+        case LONGOPT_LIVE_FEED:        /* live feed for the capture parent (hidden feature) */
+            /*
+             * Don't attach to it until we've given up any special
+             * privileges; see capture_loop_attach_live_feed().
+             */
+            g_free(live_feed_name);
+            live_feed_name = g_strdup(ws_optarg);
+            break;
+        case LONGOPT_FANOUT:           /* capture through a fanout group of packet sockets */
+            fanout_sockets = get_positive_int(ws_optarg, "number of fanout sockets");
+            if (fanout_sockets > TPACKET_CAPTURE_MAX_SOCKETS) {
+                cmdarg_err("The number of fanout sockets must be at most %u.",
+                           TPACKET_CAPTURE_MAX_SOCKETS);
+                arg_error = TRUE;
+            }
+#ifndef __linux__
+            cmdarg_err("Capturing with a fanout group is only supported on Linux.");
+            arg_error = TRUE;
+#endif
+            /* Each socket has its own capture thread. */
+            use_threads = TRUE;
+            break;
+        case LONGOPT_WRITE_BATCH:      /* size of the batches packets are written in */
+            write_batch_size = get_natural_int(ws_optarg, "write batch size");
+            if (write_batch_size > MAX_WRITE_BATCH_SIZE) {
+                cmdarg_err("The write batch size must be at most %u KiB.",
+                           MAX_WRITE_BATCH_SIZE);
+                arg_error = TRUE;
+            }
+            break;
         case 'Z':
             capture_child = TRUE;
 #ifdef _WIN32
@@ -5633,6 +6205,33 @@ report_packet_count(unsigned int packet_count)
     }
 }
 
+/*
+ * Tell our parent how many packets are waiting to be written for each
+ * interface whose packets we queue, and the most there have been.
+ */
+static void
+report_queued_packets(capture_options *capture_opts)
+{
+    char tmp[SP_MAX_MSG_LEN];
+    guint i;
+
+    if (!capture_child)
+        return;
+
+    for (i = 0; i < global_ld.pcaps->len; i++) {
+        capture_src *pcap_src = g_array_index(global_ld.pcaps, capture_src *, i);
+        interface_options *interface_opts = &g_array_index(capture_opts->ifaces, interface_options, i);
+
+        if (pcap_src->queue == NULL)
+            continue;
+        g_snprintf(tmp, sizeof(tmp), "%u:%u:%s", pcap_queue_count(pcap_src),
+                   (guint)g_atomic_int_get(&pcap_src->queue->high_watermark),
+                   interface_opts->display_name);
+        ws_debug("Queued: %s", tmp);
+        pipe_write_block(2, SP_QUEUED, tmp);
+    }
+}
+
 static void
 report_new_capture_file(const char *filename)
 {
@@ -103,6 +103,9 @@ typedef struct _fd_hash_t {
     guint8     digest[16];
     guint32    len;
     nstime_t   frame_time;
+    gboolean   used;      /* entry holds a frame, and is in fd_hash_index */
+    int        newer;     /* next newer entry with the same digest and length, or -1 */
+    int        older;     /* next older entry with the same digest and length, or -1 */
 } fd_hash_t;
 
 #define DEFAULT_DUP_DEPTH       5   /* Used with -d */
@@ -112,6 +115,14 @@ static fd_hash_t fd_hash[MAX_DUP_DEPTH];
 static int       dup_window    = DEFAULT_DUP_DEPTH;
 static int       cur_dup_entry = 0;
 
+/*
+ * The newest entry in fd_hash[] for each digest and length; the other
+ * entries with the same digest and length are chained from it, newest
+ * first, so finding a duplicate doesn't mean looking at every entry in
+ * the window.
+ */
+static GHashTable *fd_hash_index = NULL;
+
 static guint32   ignored_bytes  = 0;  /* Used with -I */
 
 #define ONE_BILLION 1000000000
@@ -582,15 +593,77 @@ remove_vlan_info(const wtap_packet_header *phdr, guint8* fd, guint32* len) {
     }
 }
 
+static guint
+fd_hash_hash(gconstpointer key)
+{
+    const fd_hash_t *entry = (const fd_hash_t *)key;
+
+    /* The digest is already well mixed. */
+    return pntoh32(entry->digest) ^ entry->len;
+}
+
+static gboolean
+fd_hash_equal(gconstpointer a, gconstpointer b)
+{
+    const fd_hash_t *entry_a = (const fd_hash_t *)a;
+    const fd_hash_t *entry_b = (const fd_hash_t *)b;
+
+    return entry_a->len == entry_b->len
+        && memcmp(entry_a->digest, entry_b->digest, 16) == 0;
+}
+
+/*
+ * Replace the oldest entry in the window with one for a new frame, and
+ * return the index of the newest other entry with the same digest and
+ * length, or -1 if there isn't one.
+ */
+static int
+add_dup_entry(const guint8 *fd, guint32 len, guint32 offset)
+{
+    fd_hash_t *entry, *newest;
+
+    cur_dup_entry++;
+    if (cur_dup_entry >= dup_window)
+        cur_dup_entry = 0;
+    entry = &fd_hash[cur_dup_entry];
+
+    /*
+     * The entry we're replacing is the oldest one in the window, so
+     * it's the last one in its chain; unlink it.
+     */
+    if (entry->used) {
+        if (entry->newer != -1)
+            fd_hash[entry->newer].older = -1;
+        else
+            g_hash_table_remove(fd_hash_index, entry);
+    }
+
+    /* Calculate our digest */
+    gcry_md_hash_buffer(GCRY_MD_MD5, entry->digest, &fd[offset], len - offset);
+
+    entry->len = len;
+    entry->used = TRUE;
+    entry->newer = -1;
+
+    /* Make it the newest entry with its digest and length. */
+    newest = (fd_hash_t *)g_hash_table_lookup(fd_hash_index, entry);
+    if (newest != NULL) {
+        newest->newer = cur_dup_entry;
+        entry->older = (int)(newest - fd_hash);
+    } else {
+        entry->older = -1;
+    }
+    g_hash_table_replace(fd_hash_index, entry, entry);
+
+    return entry->older;
+}
+
 static gboolean
 is_duplicate(guint8* fd, guint32 len) {
-    int i;
     const struct ieee80211_radiotap_header* tap_header;
 
     /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
     guint32 offset = ignored_bytes;
-    guint32 new_len;
-    guint8 *new_fd;
 
     if (len <= ignored_bytes) {
         offset = 0;
@@ -604,30 +677,8 @@ is_duplicate(guint8* fd, guint32 len) {
             offset = 0;
     }
 
-    new_fd  = &fd[offset];
-    new_len = len - (offset);
-
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
-    /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
-
-    /* Look for duplicates */
-    for (i = 0; i < dup_window; i++) {
-        if (i == cur_dup_entry)
-            continue;
-
-        if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-            && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return TRUE;
-        }
-    }
-
-    return FALSE;
+    /* Is any other frame in the window the same? */
+    return add_dup_entry(fd, len, offset) != -1;
 }
 
 static gboolean
@@ -636,33 +687,21 @@ is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
 
     /*Hint to ignore some bytes at the start of the frame for the digest calculation(-I option) */
     guint32 offset = ignored_bytes;
-    guint32 new_len;
-    guint8 *new_fd;
 
     if (len <= ignored_bytes) {
         offset = 0;
     }
 
-    new_fd  = &fd[offset];
-    new_len = len - (offset);
+    i = add_dup_entry(fd, len, offset);
 
-    cur_dup_entry++;
-    if (cur_dup_entry >= dup_window)
-        cur_dup_entry = 0;
-
-    /* Calculate our digest */
-    gcry_md_hash_buffer(GCRY_MD_MD5, fd_hash[cur_dup_entry].digest, new_fd, new_len);
-
-    fd_hash[cur_dup_entry].len = len;
     fd_hash[cur_dup_entry].frame_time.secs = current->secs;
     fd_hash[cur_dup_entry].frame_time.nsecs = current->nsecs;
 
     /*
      * Look for relative time related duplicates.
-     * This is hopefully a reasonably efficient mechanism for
-     * finding duplicates by rel time in the fd_hash[] cache.
-     * We check starting from the most recently added hash
-     * entries and work backwards towards older packets.
+     * We check the cached frames with the same digest and length,
+     * starting from the most recently added one and working
+     * backwards towards older packets.
      * This approach allows the dup test to be terminated
      * when the relative time of a cached entry is found to
      * be beyond the dup time window.
@@ -671,36 +710,11 @@ is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
      * "well-formed" in the sense that the packet timestamps are
      * in strict chronologically increasing order (which is NOT
      * always the case!!).
-     *
-     * The fd_hash[] table was deliberately created large (1,000,000).
-     * Looking for time related duplicates in large trace files with
-     * non-fractional dup time window values can potentially take
-     * a long time to complete.
      */
-
-    for (i = cur_dup_entry - 1;; i--) {
+    for (; i != -1; i = fd_hash[i].older) {
         nstime_t delta;
         int cmp;
 
-        if (i < 0)
-            i = dup_window - 1;
-
-        if (i == cur_dup_entry) {
-            /*
-             * We've decremented back to where we started.
-             * Check no more!
-             */
-            break;
-        }
-
-        if (nstime_is_unset(&(fd_hash[i].frame_time))) {
-            /*
-             * We've decremented to an unused fd_hash[] entry.
-             * Check no more!
-             */
-            break;
-        }
-
         nstime_delta(&delta, current, &fd_hash[i].frame_time);
 
         if (delta.secs < 0 || delta.nsecs < 0) {
@@ -734,10 +748,8 @@ is_duplicate_rel_time(guint8* fd, guint32 len, const nstime_t *current) {
              * Check no more!
              */
             break;
-        } else if (fd_hash[i].len == fd_hash[cur_dup_entry].len
-                   && memcmp(fd_hash[i].digest, fd_hash[cur_dup_entry].digest, 16) == 0) {
-            return TRUE;
         }
+        return TRUE;
     }
 
     return FALSE;
@@ -1741,7 +1753,11 @@ main(int argc, char *argv[])
             memset(&fd_hash[i].digest, 0, 16);
             fd_hash[i].len = 0;
             nstime_set_unset(&fd_hash[i].frame_time);
+            fd_hash[i].used = FALSE;
+            fd_hash[i].newer = -1;
+            fd_hash[i].older = -1;
         }
+        fd_hash_index = g_hash_table_new(fd_hash_hash, fd_hash_equal);
     }
 
     /* Set up an array of all IDBs seen */
@@ -2220,10 +2236,19 @@ main(int argc, char *argv[])
                     (const char*)g_tree_lookup(frames_user_comments, GUINT_TO_POINTER(read_count));
                 /* XXX: What about comment changed to no comment? */
                 if (comment != NULL) {
+                    /*
+                     * The reader might not have supplied a block, e.g.
+                     * for a pcapng packet without options; create one
+                     * for the comment, to be freed with read_rec.
+                     */
+                    if (rec->block == NULL) {
+                        read_rec.block = wtap_block_create(WTAP_BLOCK_PACKET);
+                    }
                     /* Copy and change rather than modify returned rec */
                     temp_rec = *rec;
+                    temp_rec.block = read_rec.block;
                     /* The comment is not modified by dumper, cast away. */
-                    wtap_block_add_string_option(rec->block, OPT_COMMENT, (char *)comment, strlen((char *)comment));
+                    wtap_block_add_string_option(temp_rec.block, OPT_COMMENT, (char *)comment, strlen((char *)comment));
                     temp_rec.block_was_modified = TRUE;
                     rec = &temp_rec;
                 } else {
@@ -2320,6 +2345,8 @@ clean_exit:
         }
         g_array_free(idbs_seen, TRUE);
     }
+    if (fd_hash_index != NULL)
+        g_hash_table_destroy(fd_hash_index);
     g_free(params.idb_inf);
     wtap_dump_params_cleanup(&params);
     if (wth != NULL)
@@ -49,11 +49,67 @@ static GSList *color_filter_valid_list   = NULL;
 /* Color Filters can en-/disabled. */
 static gboolean filters_enabled = TRUE;
 
+/* The enabled filters of color_filter_list compiled into a single program,
+ * which returns the index in color_filter_program_rules of the first one
+ * that matches; built on demand after color_filter_list changes. */
+static dfilter_t *color_filter_program = NULL;
+static GPtrArray *color_filter_program_rules = NULL;
+static gboolean   color_filter_program_valid = FALSE;
+
 /* Remember if there are temporary coloring filters set to
  * add sensitivity to the "Reset Coloring 1-10" menu item
  */
 static gboolean tmp_colors_set = FALSE;
 
+/* Forget the combined program; called whenever color_filter_list changes */
+static void
+color_filters_invalidate_program(void)
+{
+    dfilter_free(color_filter_program);
+    color_filter_program = NULL;
+    if (color_filter_program_rules) {
+        g_ptr_array_free(color_filter_program_rules, TRUE);
+        color_filter_program_rules = NULL;
+    }
+    color_filter_program_valid = FALSE;
+}
+
+/* Compile the enabled filters into one program, so that fields used by
+ * several filters are read from the tree only once per packet. If that
+ * fails, color_filters_colorize_packet() falls back to applying the
+ * filters one at a time. */
+static void
+color_filters_compile_program(void)
+{
+    GSList         *curr;
+    color_filter_t *colorf;
+    GPtrArray      *texts;
+    gchar          *local_err_msg = NULL;
+
+    color_filters_invalidate_program();
+
+    texts = g_ptr_array_new();
+    color_filter_program_rules = g_ptr_array_new();
+    for (curr = color_filter_list; curr != NULL; curr = g_slist_next(curr)) {
+        colorf = (color_filter_t *)curr->data;
+        if (!colorf->disabled && colorf->c_colorfilter != NULL) {
+            g_ptr_array_add(texts, colorf->filter_text);
+            g_ptr_array_add(color_filter_program_rules, colorf);
+        }
+    }
+
+    if (!dfilter_compile_list((const gchar **)texts->pdata, texts->len,
+                              &color_filter_program, &local_err_msg)) {
+        ws_warning("Could not combine color filters: %s", local_err_msg);
+        g_free(local_err_msg);
+        g_ptr_array_free(color_filter_program_rules, TRUE);
+        color_filter_program_rules = NULL;
+    }
+    g_ptr_array_free(texts, TRUE);
+
+    color_filter_program_valid = TRUE;
+}
+
 /* Create a new filter */
 color_filter_t *
 color_filter_new(const gchar *name,          /* The name of the filter to create */
@@ -190,6 +246,7 @@ color_filters_set_tmp(guint8 filt_nr, const gchar *filter, gboolean disabled, gc
                 colorf->filter_text = g_strdup(tmpfilter);
                 colorf->c_colorfilter = compiled_filter;
                 colorf->disabled = ((i!=filt_nr) ? TRUE : disabled);
+                color_filters_invalidate_program();
                 /* Remember that there are now temporary coloring filters set */
                 if( filter )
                     tmp_colors_set = TRUE;
@@ -349,6 +406,7 @@ gboolean
 color_filters_init(gchar** err_msg, color_filter_add_cb_func add_cb)
 {
     /* delete all currently existing filters */
+    color_filters_invalidate_program();
     color_filter_list_delete(&color_filter_list);
 
     /* now try to construct the filters list */
@@ -362,6 +420,7 @@ color_filters_reload(gchar** err_msg, color_filter_add_cb_func add_cb)
      * we must keep them until the dissection no longer needs them */
     color_filter_deleted_list = g_slist_concat(color_filter_deleted_list, color_filter_list);
     color_filter_list = NULL;
+    color_filters_invalidate_program();
 
     /* now try to construct the filters list */
     return color_filters_get(err_msg, add_cb);
@@ -370,6 +429,8 @@ color_filters_reload(gchar** err_msg, color_filter_add_cb_func add_cb)
 void
 color_filters_cleanup(void)
 {
+    /* forget the combined program; it is compiled again when next needed */
+    color_filters_invalidate_program();
     /* delete the previously deleted filters */
     color_filter_list_delete(&color_filter_deleted_list);
 }
@@ -456,6 +517,7 @@ color_filters_apply(GSList *tmp_cfl, GSList *edit_cfl, gchar** err_msg)
      * we must keep them until the dissection no longer needs them */
     color_filter_deleted_list = g_slist_concat(color_filter_deleted_list, color_filter_list);
     color_filter_list = NULL;
+    color_filters_invalidate_program();
 
     /* clone all list entries from tmp/edit to normal list */
     color_filter_valid_list = NULL;
@@ -509,8 +571,15 @@ prime_edt(gpointer data, gpointer user_data)
 void
 color_filters_prime_edt(epan_dissect_t *edt)
 {
-    if (color_filters_used())
-        g_slist_foreach(color_filter_list, prime_edt, edt);
+    if (color_filters_used()) {
+        if (!color_filter_program_valid)
+            color_filters_compile_program();
+
+        if (color_filter_program != NULL)
+            epan_dissect_prime_with_dfilter(edt, color_filter_program);
+        else
+            g_slist_foreach(color_filter_list, prime_edt, edt);
+    }
 }
 
 /* * Return the color_t for later use */
@@ -519,9 +588,21 @@ color_filters_colorize_packet(epan_dissect_t *edt)
 {
     GSList         *curr;
     color_filter_t *colorf;
+    int             match;
 
     /* If we have color filters, "search" for the matching one. */
     if ((edt->tree != NULL) && (color_filters_used())) {
+        if (!color_filter_program_valid)
+            color_filters_compile_program();
+
+        /* Evaluate all of the filters in one pass. */
+        if (color_filter_program != NULL) {
+            match = dfilter_apply_first_edt(color_filter_program, edt);
+            if (match < 0)
+                return NULL;
+            return (color_filter_t *)g_ptr_array_index(color_filter_program_rules, match);
+        }
+
         curr = color_filter_list;
 
         while(curr != NULL) {
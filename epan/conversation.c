@@ -65,6 +65,41 @@ static wmem_map_t *conversation_hashtable_no_addr2_or_port2 = NULL;
 
 static guint32 new_index;
 
+/*
+ * Bumped whenever a conversation is added to or removed from one of the
+ * hash tables, so that a remembered lookup result can be checked cheaply.
+ */
+static guint conversation_generation;
+
+/*
+ * The most recent find_conversation() call and its result.
+ *
+ * Dissectors commonly look up the same conversation several times while
+ * dissecting one packet (for example, TCP and then the protocol on top
+ * of it, or find_or_create_conversation() followed by
+ * find_conversation_pinfo()); remembering the last lookup lets the
+ * repeats skip hashing the addresses and probing up to four hash tables.
+ *
+ * Only addresses short enough to copy into the fixed buffers are
+ * remembered.
+ */
+#define FIND_MEMO_ADDR_MAX 16
+
+static struct {
+	gboolean valid;
+	guint generation;
+	guint32 frame_num;
+	address addr_a;
+	address addr_b;
+	guint8 addr_a_data[FIND_MEMO_ADDR_MAX];
+	guint8 addr_b_data[FIND_MEMO_ADDR_MAX];
+	endpoint_type etype;
+	guint32 port_a;
+	guint32 port_b;
+	guint options;
+	conversation_t *conversation;
+} find_memo;
+
 /*
  * Placeholder for address-less conversations.
  */
@@ -470,6 +505,8 @@ conversation_init(void)
 	    wmem_map_new_autoreset(wmem_epan_scope(), wmem_file_scope(), conversation_hash_no_addr2_or_port2,
 	      conversation_match_no_addr2_or_port2);
 
+	conversation_generation++;
+	find_memo.valid = FALSE;
 }
 
 /**
@@ -481,6 +518,13 @@ void conversation_epan_reset(void)
 	 * Start the conversation indices over at 0.
 	 */
 	new_index = 0;
+
+	/*
+	 * The hash tables are emptied when the file scope is left, so
+	 * anything remembered from the previous file is gone.
+	 */
+	conversation_generation++;
+	find_memo.valid = FALSE;
 }
 
 /*
@@ -494,6 +538,7 @@ conversation_insert_into_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 {
 	conversation_t *chain_head, *chain_tail, *cur, *prev;
 
+	conversation_generation++;
 	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
 
 	if (NULL==chain_head) {
@@ -550,6 +595,7 @@ conversation_remove_from_hashtable(wmem_map_t *hashtable, conversation_t *conv)
 {
 	conversation_t *chain_head, *cur, *prev;
 
+	conversation_generation++;
 	chain_head = (conversation_t *)wmem_map_lookup(hashtable, conv->key_ptr);
 
 	if (conv == chain_head) {
@@ -825,7 +871,7 @@ conversation_set_addr2(conversation_t *conv, const address *addr)
 	if (conv->options & NO_PORT2) {
 		conversation_remove_from_hashtable(conversation_hashtable_no_addr2_or_port2, conv);
 	} else {
-		conversation_remove_from_hashtable(conversation_hashtable_no_port2, conv);
+		conversation_remove_from_hashtable(conversation_hashtable_no_addr2, conv);
 	}
 	conv->options &= ~NO_ADDR2;
 	copy_address_wmem(wmem_file_scope(), &conv->key_ptr->addr2, addr);
@@ -893,6 +939,61 @@ conversation_lookup_hashtable(wmem_map_t *hashtable, const guint32 frame_num, co
 }
 
 
+/*
+ * Check whether a find_conversation() call has the same arguments as the
+ * remembered one, and nothing has been added to or removed from the hash
+ * tables since.
+ */
+static inline gboolean
+find_memo_matches(const guint32 frame_num, const address *addr_a, const address *addr_b,
+    const endpoint_type etype, const guint32 port_a, const guint32 port_b, const guint options)
+{
+	return find_memo.valid &&
+	    find_memo.generation == conversation_generation &&
+	    find_memo.frame_num == frame_num &&
+	    find_memo.port_a == port_a &&
+	    find_memo.port_b == port_b &&
+	    find_memo.etype == etype &&
+	    find_memo.options == options &&
+	    addr_b != NULL &&
+	    addresses_equal(&find_memo.addr_a, addr_a) &&
+	    addresses_equal(&find_memo.addr_b, addr_b);
+}
+
+static void
+find_memo_store(const guint32 frame_num, const address *addr_a, const address *addr_b,
+    const endpoint_type etype, const guint32 port_a, const guint32 port_b, const guint options,
+    conversation_t *conversation)
+{
+	if (addr_b == NULL ||
+	    addr_a->len < 0 || addr_a->len > FIND_MEMO_ADDR_MAX ||
+	    addr_b->len < 0 || addr_b->len > FIND_MEMO_ADDR_MAX) {
+		find_memo.valid = FALSE;
+		return;
+	}
+
+	if (addr_a->len > 0)
+		memcpy(find_memo.addr_a_data, addr_a->data, addr_a->len);
+	set_address(&find_memo.addr_a, addr_a->type, addr_a->len, find_memo.addr_a_data);
+	if (addr_b->len > 0)
+		memcpy(find_memo.addr_b_data, addr_b->data, addr_b->len);
+	set_address(&find_memo.addr_b, addr_b->type, addr_b->len, find_memo.addr_b_data);
+	find_memo.frame_num = frame_num;
+	find_memo.etype = etype;
+	find_memo.port_a = port_a;
+	find_memo.port_b = port_b;
+	find_memo.options = options;
+	find_memo.conversation = conversation;
+	/*
+	 * The lookup may itself have moved a conversation between tables
+	 * (filling in a wildcarded address or port); the result is still
+	 * what the same lookup would return now.
+	 */
+	find_memo.generation = conversation_generation;
+	find_memo.valid = TRUE;
+}
+
+
 /*
  * Given two address/port pairs for a packet, search for a conversation
  * containing packets between those address/port pairs.  Returns NULL if
@@ -935,6 +1036,9 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 {
 	conversation_t *conversation;
 
+	if (find_memo_matches(frame_num, addr_a, addr_b, etype, port_a, port_b, options))
+		return find_memo.conversation;
+
 	DINSTR(gchar *addr_a_str = address_to_str(NULL, addr_a));
 	DINSTR(gchar *addr_b_str = address_to_str(NULL, addr_b));
 	/*
@@ -1283,6 +1387,7 @@ find_conversation(const guint32 frame_num, const address *addr_a, const address
 	conversation = NULL;
 
 end:
+	find_memo_store(frame_num, addr_a, addr_b, etype, port_a, port_b, options, conversation);
 	DINSTR(wmem_free(NULL, addr_a_str));
 	DINSTR(wmem_free(NULL, addr_b_str));
 	return conversation;
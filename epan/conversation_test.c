@@ -0,0 +1,168 @@
+/* conversation_test.c
+ * Conversation lookup tests
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+#undef G_DISABLE_ASSERT
+
+#include <glib.h>
+
+#include <epan/epan.h>
+#include <epan/address.h>
+#include <epan/conversation.h>
+
+/*
+ * find_conversation() remembers its last lookup.  These tests repeat a
+ * lookup after the conversations it could match have changed, and check
+ * that the answer reflects the change.
+ */
+
+static const struct packet_provider_funcs test_provider_funcs = {
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+static const guint8 addr_a_data[] = { 192, 168, 0, 1 };
+static const guint8 addr_b_data[] = { 192, 168, 0, 2 };
+static address addr_a;
+static address addr_b;
+
+static void
+test_conversation_find(void)
+{
+    epan_t *session = epan_new(NULL, &test_provider_funcs);
+    conversation_t *conv;
+
+    conv = conversation_new(1, &addr_a, &addr_b, ENDPOINT_TCP, 1000, 2000, 0);
+    g_assert_nonnull(conv);
+
+    g_assert_true(find_conversation(2, &addr_a, &addr_b, ENDPOINT_TCP, 1000, 2000, 0) == conv);
+    g_assert_true(find_conversation(2, &addr_a, &addr_b, ENDPOINT_TCP, 1000, 2000, 0) == conv);
+    g_assert_true(find_conversation(2, &addr_b, &addr_a, ENDPOINT_TCP, 2000, 1000, 0) == conv);
+    g_assert_null(find_conversation(2, &addr_a, &addr_b, ENDPOINT_TCP, 1000, 2001, 0));
+    g_assert_null(find_conversation(2, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0));
+    /* Not set up yet. */
+    g_assert_null(find_conversation(0, &addr_a, &addr_b, ENDPOINT_TCP, 1000, 2000, 0));
+
+    epan_free(session);
+}
+
+static void
+test_conversation_created(void)
+{
+    epan_t *session = epan_new(NULL, &test_provider_funcs);
+    conversation_t *conv;
+
+    g_assert_null(find_conversation(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0));
+    conv = conversation_new(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0);
+    g_assert_true(find_conversation(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0) == conv);
+
+    epan_free(session);
+}
+
+static void
+test_conversation_replaced(void)
+{
+    epan_t *session = epan_new(NULL, &test_provider_funcs);
+    conversation_t *first, *second;
+
+    first = conversation_new(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0);
+    g_assert_true(find_conversation(5, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0) == first);
+
+    /* A new conversation with the same addresses and ports starts at frame 5. */
+    second = conversation_new(5, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0);
+    g_assert_true(second != first);
+    g_assert_true(find_conversation(5, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0) == second);
+    g_assert_true(find_conversation(4, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0) == first);
+
+    epan_free(session);
+}
+
+static void
+test_conversation_changed(void)
+{
+    epan_t *session = epan_new(NULL, &test_provider_funcs);
+    conversation_t *conv;
+
+    /* Any port on addr_b. */
+    conv = conversation_new(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 0, NO_PORT2);
+    g_assert_true(find_conversation(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 3000, 0) == conv);
+
+    /* Pin it to port 2000; port 3000 no longer matches. */
+    conversation_set_port2(conv, 2000);
+    g_assert_null(find_conversation(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 3000, 0));
+    g_assert_true(find_conversation(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 2000, 0) == conv);
+
+    /* Any address on port 4000. */
+    conv = conversation_new(1, &addr_a, NULL, ENDPOINT_UDP, 1000, 4000, NO_ADDR2);
+    g_assert_true(find_conversation(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 4000, 0) == conv);
+
+    /* Pin it to addr_a; addr_b no longer matches. */
+    conversation_set_addr2(conv, &addr_a);
+    g_assert_null(find_conversation(1, &addr_a, &addr_b, ENDPOINT_UDP, 1000, 4000, 0));
+    g_assert_true(find_conversation(1, &addr_a, &addr_a, ENDPOINT_UDP, 1000, 4000, 0) == conv);
+
+    epan_free(session);
+}
+
+static void
+test_conversation_new_file(void)
+{
+    epan_t *session = epan_new(NULL, &test_provider_funcs);
+    conversation_t *conv;
+
+    conv = conversation_new(1, &addr_a, &addr_b, ENDPOINT_TCP, 1000, 2000, 0);
+    g_assert_true(find_conversation(1, &addr_a, &addr_b, ENDPOINT_TCP, 1000, 2000, 0) == conv);
+    epan_free(session);
+
+    /* The conversations from the previous file are gone. */
+    session = epan_new(NULL, &test_provider_funcs);
+    g_assert_null(find_conversation(1, &addr_a, &addr_b, ENDPOINT_TCP, 1000, 2000, 0));
+    epan_free(session);
+}
+
+int
+main(int argc, char **argv)
+{
+    int result;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/conversation/find", test_conversation_find);
+    g_test_add_func("/conversation/created", test_conversation_created);
+    g_test_add_func("/conversation/replaced", test_conversation_replaced);
+    g_test_add_func("/conversation/changed", test_conversation_changed);
+    g_test_add_func("/conversation/new_file", test_conversation_new_file);
+
+    set_address(&addr_a, AT_IPv4, sizeof addr_a_data, addr_a_data);
+    set_address(&addr_b, AT_IPv4, sizeof addr_b_data, addr_b_data);
+
+    if (!epan_init(NULL, NULL, FALSE))
+        return 1;
+    result = g_test_run();
+    epan_cleanup();
+
+    return result;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -27,6 +27,7 @@ struct epan_dfilter {
 	gboolean	*owns_memory;
 	int		*interesting_fields;
 	int		num_interesting_fields;
+	int		matched_index;	/* set by IF_TRUE_RETURN */
 	GPtrArray	*deprecated;
 };
 
@@ -308,57 +308,33 @@ add_deprecated_token(dfwork_t *dfw, const char *token)
 	g_ptr_array_add(deprecated, g_strdup(token));
 }
 
-gboolean
-dfilter_compile_real(const gchar *text, dfilter_t **dfp,
-			gchar **error_ret, const char *caller)
+/*
+ * Expands macros in, scans, parses and semantically checks the text of a
+ * filter, leaving its syntax tree in dfw->st_root (NULL for an empty
+ * filter). On failure dfw->error_message is set.
+ */
+static gboolean
+dfw_compile_syntax_tree(dfwork_t *dfw, const gchar *text)
 {
 	gchar		*expanded_text;
 	int		token;
-	dfilter_t	*dfilter;
-	dfwork_t	*dfw;
 	df_scanner_state_t state;
 	yyscan_t	scanner;
 	YY_BUFFER_STATE in_buffer;
 	gboolean failure = FALSE;
 	unsigned token_count = 0;
 
-	ws_assert(dfp);
-	*dfp = NULL;
-
-	if (text == NULL) {
-		ws_log(WS_LOG_DOMAIN, LOG_LEVEL_DEBUG,
-			"%s() called from %s() with null filter",
-			__func__, caller);
-		if (error_ret != NULL) {
-			/* XXX This BUG happens often. Some callers are ignoring these errors. */
-			*error_ret = g_strdup("BUG: NULL text pointer passed to dfilter_compile");
-		}
-		return FALSE;
-	}
-	else if (*text == '\0') {
-		/* An empty filter is considered a valid input. */
-		ws_log(WS_LOG_DOMAIN, LOG_LEVEL_DEBUG,
-			"%s() called from %s() with empty filter",
-			__func__, caller);
-	}
-	else {
-		ws_log(WS_LOG_DOMAIN, LOG_LEVEL_DEBUG,
-			"%s() called from %s(), compiling filter: %s",
-			__func__, caller, text);
-	}
-
-	dfw = dfwork_new();
-
 	expanded_text = dfilter_macro_apply(text, &dfw->error_message);
 	if (expanded_text == NULL) {
-		goto FAILURE;
+		return FALSE;
 	}
 
 	ws_noisy("Expanded text: %s", expanded_text);
 
 	if (df_lex_init(&scanner) != 0) {
 		dfw->error_message = g_strdup_printf("Can't initialize scanner: %s", g_strerror(errno));
-		goto FAILURE;
+		wmem_free(NULL, expanded_text);
+		return FALSE;
 	}
 
 	in_buffer = df__scan_string(expanded_text, scanner);
@@ -424,49 +400,121 @@ dfilter_compile_real(const gchar *text, dfilter_t **dfp,
 		g_string_free(state.quoted_string, TRUE);
 	df__delete_buffer(in_buffer, scanner);
 	df_lex_destroy(scanner);
+	wmem_free(NULL, expanded_text);
 
 	if (failure)
-		goto FAILURE;
+		return FALSE;
 
-	/* Success, but was it an empty filter? If so, discard
-	 * it and set *dfp to NULL */
-	if (dfw->st_root == NULL) {
-		*dfp = NULL;
-	}
-	else {
+	if (dfw->st_root != NULL) {
 		log_syntax_tree(LOG_LEVEL_NOISY, dfw->st_root, "Syntax tree before semantic check");
 
 		/* Check semantics and do necessary type conversion*/
 		if (!dfw_semcheck(dfw)) {
-			goto FAILURE;
+			return FALSE;
 		}
 
 		log_syntax_tree(LOG_LEVEL_NOISY, dfw->st_root, "Syntax tree after successful semantic check");
+	}
+	return TRUE;
+}
+
+/* Tucks away the bytecode generated in dfw in a new dfilter_t. */
+static dfilter_t *
+dfilter_new_from_dfw(dfwork_t *dfw)
+{
+	dfilter_t	*dfilter;
+
+	dfilter = dfilter_new(dfw->deprecated);
+	dfilter->insns = dfw->insns;
+	dfilter->consts = dfw->consts;
+	dfw->insns = NULL;
+	dfw->consts = NULL;
+	dfilter->interesting_fields = dfw_interesting_fields(dfw,
+		&dfilter->num_interesting_fields);
+
+	/* Initialize run-time space */
+	dfilter->num_registers = dfw->first_constant;
+	dfilter->max_registers = dfw->next_register;
+	dfilter->registers = g_new0(GList*, dfilter->max_registers);
+	dfilter->attempted_load = g_new0(gboolean, dfilter->max_registers);
+	dfilter->owns_memory = g_new0(gboolean, dfilter->max_registers);
+
+	/* Initialize constants */
+	dfvm_init_const(dfilter);
+
+	return dfilter;
+}
+
+static void
+dfw_report_failure(dfwork_t *dfw, const gchar *text, gchar **error_ret)
+{
+	if (dfw->error_message == NULL) {
+		/* We require an error message. */
+		ws_critical("Unknown error compiling filter: %s", text);
+	}
+	else {
+		ws_debug("Compiling filter failed with error: %s.", dfw->error_message);
+		if (error_ret != NULL) {
+			*error_ret = dfw->error_message;
+		}
+		else {
+			g_free(dfw->error_message);
+		}
+		dfw->error_message = NULL;
+	}
+}
+
+gboolean
+dfilter_compile_real(const gchar *text, dfilter_t **dfp,
+			gchar **error_ret, const char *caller)
+{
+	dfwork_t	*dfw;
+
+	ws_assert(dfp);
+	*dfp = NULL;
 
+	if (text == NULL) {
+		ws_log(WS_LOG_DOMAIN, LOG_LEVEL_DEBUG,
+			"%s() called from %s() with null filter",
+			__func__, caller);
+		if (error_ret != NULL) {
+			/* XXX This BUG happens often. Some callers are ignoring these errors. */
+			*error_ret = g_strdup("BUG: NULL text pointer passed to dfilter_compile");
+		}
+		return FALSE;
+	}
+	else if (*text == '\0') {
+		/* An empty filter is considered a valid input. */
+		ws_log(WS_LOG_DOMAIN, LOG_LEVEL_DEBUG,
+			"%s() called from %s() with empty filter",
+			__func__, caller);
+	}
+	else {
+		ws_log(WS_LOG_DOMAIN, LOG_LEVEL_DEBUG,
+			"%s() called from %s(), compiling filter: %s",
+			__func__, caller, text);
+	}
+
+	dfw = dfwork_new();
+
+	if (!dfw_compile_syntax_tree(dfw, text)) {
+		dfw_report_failure(dfw, text, error_ret);
+		global_dfw = NULL;
+		dfwork_free(dfw);
+		return FALSE;
+	}
+
+	/* Success, but was it an empty filter? If so, discard
+	 * it and set *dfp to NULL */
+	if (dfw->st_root == NULL) {
+		*dfp = NULL;
+	}
+	else {
 		/* Create bytecode */
 		dfw_gencode(dfw);
 
-		/* Tuck away the bytecode in the dfilter_t */
-		dfilter = dfilter_new(dfw->deprecated);
-		dfilter->insns = dfw->insns;
-		dfilter->consts = dfw->consts;
-		dfw->insns = NULL;
-		dfw->consts = NULL;
-		dfilter->interesting_fields = dfw_interesting_fields(dfw,
-			&dfilter->num_interesting_fields);
-
-		/* Initialize run-time space */
-		dfilter->num_registers = dfw->first_constant;
-		dfilter->max_registers = dfw->next_register;
-		dfilter->registers = g_new0(GList*, dfilter->max_registers);
-		dfilter->attempted_load = g_new0(gboolean, dfilter->max_registers);
-		dfilter->owns_memory = g_new0(gboolean, dfilter->max_registers);
-
-		/* Initialize constants */
-		dfvm_init_const(dfilter);
-
 		/* And give it to the user. */
-		*dfp = dfilter;
+		*dfp = dfilter_new_from_dfw(dfw);
 	}
 	/* SUCCESS */
 	global_dfw = NULL;
@@ -475,30 +523,67 @@ dfilter_compile_real(const gchar *text, dfilter_t **dfp,
 		ws_log(WS_LOG_DOMAIN, LOG_LEVEL_INFO, "Compiled display filter: %s", text);
 	else
 		ws_debug("Compiled empty filter (successfully).");
-	wmem_free(NULL, expanded_text);
 	return TRUE;
+}
 
-FAILURE:
-	ws_assert(dfw);
-	if (dfw->error_message == NULL) {
-		/* We require an error message. */
-		ws_critical("Unknown error compiling filter: %s", text);
+static void
+free_syntax_trees(GPtrArray *roots)
+{
+	guint		i;
+
+	for (i = 0; i < roots->len; i++) {
+		if (g_ptr_array_index(roots, i))
+			stnode_free((stnode_t *)g_ptr_array_index(roots, i));
 	}
-	else {
-		ws_debug("Compiling filter failed with error: %s.", dfw->error_message);
-		if (error_ret != NULL) {
-			*error_ret = dfw->error_message;
+	g_ptr_array_free(roots, TRUE);
+}
+
+gboolean
+dfilter_compile_list(const gchar **texts, guint count, dfilter_t **dfp,
+			gchar **error_ret)
+{
+	dfwork_t	*dfw;
+	dfwork_t	*text_dfw;
+	GPtrArray	*roots;
+	guint		i;
+
+	ws_assert(dfp);
+	*dfp = NULL;
+
+	roots = g_ptr_array_sized_new(count);
+	dfw = dfwork_new();
+
+	for (i = 0; i < count; i++) {
+		/* Empty filters never match; keep their slots so that the
+		 * indexes of the other filters stay the same. */
+		if (texts[i] == NULL || *texts[i] == '\0') {
+			g_ptr_array_add(roots, NULL);
+			continue;
 		}
-		else {
-			g_free(dfw->error_message);
+
+		text_dfw = dfwork_new();
+		if (!dfw_compile_syntax_tree(text_dfw, texts[i])) {
+			dfw_report_failure(text_dfw, texts[i], error_ret);
+			global_dfw = NULL;
+			dfwork_free(text_dfw);
+			dfwork_free(dfw);
+			free_syntax_trees(roots);
+			return FALSE;
 		}
+		g_ptr_array_add(roots, text_dfw->st_root);
+		text_dfw->st_root = NULL;
+		global_dfw = NULL;
+		dfwork_free(text_dfw);
 	}
 
-	global_dfw = NULL;
+	/* Create bytecode for all of the filters in one program */
+	dfw_gencode_list(dfw, roots);
+	*dfp = dfilter_new_from_dfw(dfw);
+
 	dfwork_free(dfw);
-	wmem_free(NULL, expanded_text);
-	*dfp = NULL;
-	return FALSE;
+	free_syntax_trees(roots);
+	ws_debug("Compiled a list of %u display filters.", count);
+	return TRUE;
 }
 
 
@@ -514,6 +599,15 @@ dfilter_apply_edt(dfilter_t *df, epan_dissect_t* edt)
 	return dfvm_apply(df, edt->tree);
 }
 
+int
+dfilter_apply_first_edt(dfilter_t *df, epan_dissect_t* edt)
+{
+	/* Only IF_TRUE_RETURN sets this. */
+	df->matched_index = -1;
+	dfvm_apply(df, edt->tree);
+	return df->matched_index;
+}
+
 
 void
 dfilter_prime_proto_tree(const dfilter_t *df, proto_tree *tree)
@@ -54,6 +54,21 @@ dfilter_compile_real(const gchar *text, dfilter_t **dfp,
 #define dfilter_compile(text, dfp, err_msg) \
 	dfilter_compile_real(text, dfp, err_msg, __func__)
 
+/* Compiles a list of filter strings into a single dfilter_t, to be
+ * applied with dfilter_apply_first_edt().  The filters share field
+ * loads, so a field used by several of them is read from the tree
+ * only once per packet.  Empty (or NULL) filters never match.
+ *
+ * On failure, *err_msg is set as for dfilter_compile() and the
+ * dfilter* is set to NULL.
+ *
+ * Returns TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC
+gboolean
+dfilter_compile_list(const gchar **texts, guint count, dfilter_t **dfp,
+			gchar **err_msg);
+
 /* Frees all memory used by dfilter, and frees
  * the dfilter itself. */
 WS_DLL_PUBLIC
@@ -65,6 +80,13 @@ WS_DLL_PUBLIC
 gboolean
 dfilter_apply_edt(dfilter_t *df, struct epan_dissect *edt);
 
+/* Apply a dfilter compiled with dfilter_compile_list(); returns the
+ * index of the first filter in the list that matches, or -1 if none
+ * does. */
+WS_DLL_PUBLIC
+int
+dfilter_apply_first_edt(dfilter_t *df, struct epan_dissect *edt);
+
 /* Apply compiled dfilter */
 gboolean
 dfilter_apply(dfilter_t *df, proto_tree *tree);
@@ -77,6 +77,25 @@ dfvm_value_new(dfvm_value_type_t type)
 }
 
 
+static const char *
+relation_name(dfvm_opcode_t op)
+{
+	switch (op) {
+		case ANY_EQ:		return "==";
+		case ALL_NE:		return "!=";
+		case ANY_NE:		return "~=";
+		case ANY_GT:		return ">";
+		case ANY_GE:		return ">=";
+		case ANY_LT:		return "<";
+		case ANY_LE:		return "<=";
+		case ANY_BITWISE_AND:	return "&";
+		case ANY_CONTAINS:	return "contains";
+		default:
+			ws_assert_not_reached();
+	}
+	return "?";
+}
+
 void
 dfvm_dump(FILE *f, dfilter_t *df)
 {
@@ -130,6 +149,9 @@ dfvm_dump(FILE *f, dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case TREE_CMP:
+			case TREE_UINT_CMP:
+			case IF_TRUE_RETURN:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
@@ -280,6 +302,23 @@ dfvm_dump(FILE *f, dfilter_t *df)
 					arg3->value.numeric);
 				break;
 
+			case TREE_CMP:
+				value_str = fvalue_to_string_repr(NULL, arg2->value.fvalue,
+					FTREPR_DFILTER, BASE_NONE);
+				fprintf(f, "%05d TREE_CMP\t%s %s %s <%s>\n",
+					id, arg1->value.hfinfo->abbrev,
+					relation_name((dfvm_opcode_t)arg3->value.numeric),
+					value_str, fvalue_type_name(arg2->value.fvalue));
+				wmem_free(NULL, value_str);
+				break;
+
+			case TREE_UINT_CMP:
+				fprintf(f, "%05d TREE_UINT_CMP\t%s %s %u\n",
+					id, arg1->value.hfinfo->abbrev,
+					relation_name((dfvm_opcode_t)arg3->value.numeric),
+					arg2->value.numeric);
+				break;
+
 			case NOT:
 				fprintf(f, "%05d NOT\n", id);
 				break;
@@ -293,6 +332,11 @@ dfvm_dump(FILE *f, dfilter_t *df)
 						id, arg1->value.numeric);
 				break;
 
+			case IF_TRUE_RETURN:
+				fprintf(f, "%05d IF-TRUE-RETURN\t#%u\n",
+						id, arg1->value.numeric);
+				break;
+
 			case IF_FALSE_GOTO:
 				fprintf(f, "%05d IF-FALSE-GOTO\t%u\n",
 						id, arg1->value.numeric);
@@ -500,6 +544,117 @@ any_in_range(dfilter_t *df, int reg1, int reg2, int reg3)
 }
 
 
+/* Returns the comparison function used by a relation opcode, and whether
+ * any or all of the field values must satisfy it. */
+static DFVMMatchFunc
+relation_match_func(dfvm_opcode_t op, enum match_how *how)
+{
+	*how = MATCH_ANY;
+	switch (op) {
+		case ANY_EQ:		return fvalue_eq;
+		case ALL_NE:		*how = MATCH_ALL; return fvalue_ne;
+		case ANY_NE:		return fvalue_ne;
+		case ANY_GT:		return fvalue_gt;
+		case ANY_GE:		return fvalue_ge;
+		case ANY_LT:		return fvalue_lt;
+		case ANY_LE:		return fvalue_le;
+		case ANY_BITWISE_AND:	return fvalue_bitwise_and;
+		case ANY_CONTAINS:	return fvalue_contains;
+		default:
+			ws_assert_not_reached();
+	}
+	return NULL;
+}
+
+/* Compares the values of a field in the tree directly against a constant,
+ * without building a register list for them first. Like a relation on a
+ * failed READ_TREE, a field that isn't in the tree never matches. */
+static gboolean
+tree_cmp(proto_tree *tree, header_field_info *hfinfo, dfvm_opcode_t op,
+		const fvalue_t *fv)
+{
+	GPtrArray	*finfos;
+	field_info	*finfo;
+	guint		i;
+	enum match_how	how;
+	DFVMMatchFunc	match_func;
+	gboolean	found_something = FALSE;
+	gboolean	have_match;
+
+	match_func = relation_match_func(op, &how);
+
+	for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
+		if (finfos == NULL)
+			continue;
+
+		for (i = 0; i < finfos->len; i++) {
+			finfo = (field_info *)g_ptr_array_index(finfos, i);
+			found_something = TRUE;
+			have_match = match_func(&finfo->value, fv);
+			if (how == MATCH_ALL && !have_match) {
+				return FALSE;
+			}
+			else if (how == MATCH_ANY && have_match) {
+				return TRUE;
+			}
+		}
+	}
+	return found_something && how == MATCH_ALL;
+}
+
+static inline gboolean
+uint_match(dfvm_opcode_t op, guint32 a, guint32 b)
+{
+	switch (op) {
+		case ANY_EQ:		return a == b;
+		case ALL_NE:
+		case ANY_NE:		return a != b;
+		case ANY_GT:		return a > b;
+		case ANY_GE:		return a >= b;
+		case ANY_LT:		return a < b;
+		case ANY_LE:		return a <= b;
+		case ANY_BITWISE_AND:	return (a & b) != 0;
+		default:
+			ws_assert_not_reached();
+	}
+	return FALSE;
+}
+
+/* Same as tree_cmp(), for fields whose values are all 32-bit unsigned
+ * integers, which are compared inline rather than through the ftype. */
+static gboolean
+tree_uint_cmp(proto_tree *tree, header_field_info *hfinfo, dfvm_opcode_t op,
+		guint32 value)
+{
+	GPtrArray	*finfos;
+	field_info	*finfo;
+	guint		i;
+	gboolean	want_all = (op == ALL_NE);
+	gboolean	found_something = FALSE;
+	gboolean	have_match;
+
+	for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+		finfos = proto_get_finfo_ptr_array(tree, hfinfo->id);
+		if (finfos == NULL)
+			continue;
+
+		for (i = 0; i < finfos->len; i++) {
+			finfo = (field_info *)g_ptr_array_index(finfos, i);
+			found_something = TRUE;
+			have_match = uint_match(op,
+					fvalue_get_uinteger(&finfo->value), value);
+			if (want_all && !have_match) {
+				return FALSE;
+			}
+			else if (!want_all && have_match) {
+				return TRUE;
+			}
+		}
+	}
+	return found_something && want_all;
+}
+
 static void
 free_owned_register(gpointer data, gpointer user_data _U_)
 {
@@ -680,6 +835,20 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 						arg3->value.numeric);
 				break;
 
+			case TREE_CMP:
+				arg3 = insn->arg3;
+				accum = tree_cmp(tree, arg1->value.hfinfo,
+						(dfvm_opcode_t)arg3->value.numeric,
+						arg2->value.fvalue);
+				break;
+
+			case TREE_UINT_CMP:
+				arg3 = insn->arg3;
+				accum = tree_uint_cmp(tree, arg1->value.hfinfo,
+						(dfvm_opcode_t)arg3->value.numeric,
+						arg2->value.numeric);
+				break;
+
 			case NOT:
 				accum = !accum;
 				break;
@@ -695,6 +864,14 @@ dfvm_apply(dfilter_t *df, proto_tree *tree)
 				}
 				break;
 
+			case IF_TRUE_RETURN:
+				if (accum) {
+					df->matched_index = arg1->value.numeric;
+					free_register_overhead(df);
+					return TRUE;
+				}
+				break;
+
 			case IF_FALSE_GOTO:
 				if (!accum) {
 					id = arg1->value.numeric;
@@ -768,6 +945,9 @@ dfvm_init_const(dfilter_t *df)
 			case ANY_CONTAINS:
 			case ANY_MATCHES:
 			case ANY_IN_RANGE:
+			case TREE_CMP:
+			case TREE_UINT_CMP:
+			case IF_TRUE_RETURN:
 			case NOT:
 			case RETURN:
 			case IF_TRUE_GOTO:
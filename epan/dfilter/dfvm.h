@@ -66,7 +66,10 @@ typedef enum {
 	ANY_MATCHES,
 	MK_RANGE,
 	CALL_FUNCTION,
-	ANY_IN_RANGE
+	ANY_IN_RANGE,
+	TREE_CMP,
+	TREE_UINT_CMP,
+	IF_TRUE_RETURN
 
 } dfvm_opcode_t;
 
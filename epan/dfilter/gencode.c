@@ -274,12 +274,97 @@ gen_relation_regs(dfwork_t *dfw, dfvm_opcode_t op, int reg1, int reg2)
 	dfw_append_insn(dfw, insn);
 }
 
+/* Rewinds to the first field of this name and records all the fields
+ * of the name as interesting. */
+static header_field_info *
+dfw_add_interesting_field(dfwork_t *dfw, header_field_info *hfinfo)
+{
+	header_field_info	*first;
+
+	while (hfinfo->same_name_prev_id != -1) {
+		hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
+	}
+	first = hfinfo;
+
+	while (hfinfo) {
+		g_hash_table_insert(dfw->interesting_fields,
+			GINT_TO_POINTER(hfinfo->id),
+			GUINT_TO_POINTER(TRUE));
+		hfinfo = hfinfo->same_name_next;
+	}
+	return first;
+}
+
+/* Returns TRUE if every field with this name holds a 32-bit unsigned
+ * integer. */
+static gboolean
+all_fields_uint32(header_field_info *hfinfo)
+{
+	for (; hfinfo; hfinfo = hfinfo->same_name_next) {
+		if (!IS_FT_UINT32(hfinfo->type))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+/*
+ * Field-versus-constant relations are the most common shape of test and
+ * don't need the field values in a register: emit a single TREE_CMP (or,
+ * for 32-bit unsigned integers, TREE_UINT_CMP) instruction that compares
+ * the values in the tree directly, instead of READ_TREE, IF_FALSE_GOTO and
+ * the relation itself.
+ */
+static gboolean
+gen_relation_tree(dfwork_t *dfw, dfvm_opcode_t op, stnode_t *st_arg1, stnode_t *st_arg2)
+{
+	dfvm_insn_t	*insn;
+	dfvm_value_t	*val1, *val2, *val3;
+	header_field_info	*hfinfo;
+	fvalue_t	*fv;
+
+	if (stnode_type_id(st_arg1) != STTYPE_FIELD ||
+			stnode_type_id(st_arg2) != STTYPE_FVALUE)
+		return FALSE;
+
+	hfinfo = dfw_add_interesting_field(dfw,
+			(header_field_info *)stnode_data(st_arg1));
+	fv = (fvalue_t *)stnode_steal_data(st_arg2);
+
+	val1 = dfvm_value_new(HFINFO);
+	val1->value.hfinfo = hfinfo;
+
+	if (op != ANY_CONTAINS && all_fields_uint32(hfinfo) &&
+			IS_FT_UINT32(fvalue_type_ftenum(fv))) {
+		insn = dfvm_insn_new(TREE_UINT_CMP);
+		val2 = dfvm_value_new(INTEGER);
+		val2->value.numeric = fvalue_get_uinteger(fv);
+		fvalue_free(fv);
+	}
+	else {
+		insn = dfvm_insn_new(TREE_CMP);
+		val2 = dfvm_value_new(FVALUE);
+		val2->value.fvalue = fv;
+	}
+
+	val3 = dfvm_value_new(INTEGER);
+	val3->value.numeric = op;
+
+	insn->arg1 = val1;
+	insn->arg2 = val2;
+	insn->arg3 = val3;
+	dfw_append_insn(dfw, insn);
+	return TRUE;
+}
+
 static void
 gen_relation(dfwork_t *dfw, dfvm_opcode_t op, stnode_t *st_arg1, stnode_t *st_arg2)
 {
 	dfvm_value_t	*jmp1 = NULL, *jmp2 = NULL;
 	int		reg1 = -1, reg2 = -1;
 
+	if (op != ANY_MATCHES && gen_relation_tree(dfw, op, st_arg1, st_arg2))
+		return;
+
 	/* Create code for the LHS and RHS of the relation */
 	reg1 = gen_entity(dfw, st_arg1, &jmp1);
 	reg2 = gen_entity(dfw, st_arg2, &jmp2);
@@ -458,23 +543,12 @@ gen_test(dfwork_t *dfw, stnode_t *st_node)
 			val1 = dfvm_value_new(HFINFO);
 			hfinfo = (header_field_info*)stnode_data(st_arg1);
 
-			/* Rewind to find the first field of this name. */
-			while (hfinfo->same_name_prev_id != -1) {
-				hfinfo = proto_registrar_get_nth(hfinfo->same_name_prev_id);
-			}
-			val1->value.hfinfo = hfinfo;
+			/* Rewind to find the first field of this name, and
+			 * record the FIELD_IDs in hash of interesting fields. */
+			val1->value.hfinfo = dfw_add_interesting_field(dfw, hfinfo);
 			insn = dfvm_insn_new(CHECK_EXISTS);
 			insn->arg1 = val1;
 			dfw_append_insn(dfw, insn);
-
-			/* Record the FIELD_ID in hash of interesting fields. */
-			while (hfinfo) {
-				g_hash_table_insert(dfw->interesting_fields,
-					GINT_TO_POINTER(hfinfo->id),
-					GUINT_TO_POINTER(TRUE));
-				hfinfo = hfinfo->same_name_next;
-			}
-
 			break;
 
 		case TEST_OP_NOT:
@@ -570,18 +644,22 @@ gencode(dfwork_t *dfw, stnode_t *st_node)
 }
 
 
-void
-dfw_gencode(dfwork_t *dfw)
+static void
+gencode_begin(dfwork_t *dfw)
 {
-	int		id, id1, length;
-	dfvm_insn_t	*insn, *insn1, *prev;
-	dfvm_value_t	*arg1;
-
 	dfw->insns = g_ptr_array_new();
 	dfw->consts = g_ptr_array_new();
 	dfw->loaded_fields = g_hash_table_new(g_direct_hash, g_direct_equal);
 	dfw->interesting_fields = g_hash_table_new(g_direct_hash, g_direct_equal);
-	gencode(dfw, dfw->st_root);
+}
+
+static void
+gencode_end(dfwork_t *dfw)
+{
+	int		id, id1, length;
+	dfvm_insn_t	*insn, *insn1, *prev;
+	dfvm_value_t	*arg1;
+
 	dfw_append_insn(dfw, dfvm_insn_new(RETURN));
 
 	/* fixup goto */
@@ -657,6 +735,43 @@ dfw_gencode(dfwork_t *dfw)
 
 }
 
+void
+dfw_gencode(dfwork_t *dfw)
+{
+	gencode_begin(dfw);
+	gencode(dfw, dfw->st_root);
+	gencode_end(dfw);
+}
+
+/* Generate one program for a list of syntax trees, which returns TRUE
+ * with the index of the first tree that matches. The trees share the
+ * registers into which fields are loaded, so each field is read from
+ * the tree at most once per run. NULL entries are skipped. */
+void
+dfw_gencode_list(dfwork_t *dfw, GPtrArray *roots)
+{
+	dfvm_insn_t	*insn;
+	dfvm_value_t	*val1;
+	stnode_t	*root;
+	guint		i;
+
+	gencode_begin(dfw);
+	for (i = 0; i < roots->len; i++) {
+		root = (stnode_t *)g_ptr_array_index(roots, i);
+		if (root == NULL)
+			continue;
+
+		gencode(dfw, root);
+
+		insn = dfvm_insn_new(IF_TRUE_RETURN);
+		val1 = dfvm_value_new(INTEGER);
+		val1->value.numeric = i;
+		insn->arg1 = val1;
+		dfw_append_insn(dfw, insn);
+	}
+	gencode_end(dfw);
+}
+
 
 
 typedef struct {
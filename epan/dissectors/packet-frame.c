@@ -354,6 +354,8 @@ dissect_frame(tvbuff_t *tvb, packet_info *pinfo, proto_tree *parent_tree, void*
 	const gchar *cap_plurality, *frame_plurality;
 	frame_data_t *fr_data = (frame_data_t*)data;
 	const color_filter_t *color_filter;
+	const nstime_t *shift_offset;
+	static const nstime_t zero_shift_offset = NSTIME_INIT_ZERO;
 	dissector_handle_t dissector_handle;
 	fr_foreach_t fr_user_data;
 	struct nflx_tcpinfo tcpinfo;
@@ -738,8 +740,11 @@ dissect_frame(tvbuff_t *tvb, packet_info *pinfo, proto_tree *parent_tree, void*
 								  " the valid range is 0-1000000000",
 								  (long) pinfo->abs_ts.nsecs);
 			}
+			shift_offset = epan_get_shift_offset(pinfo->epan, pinfo->fd);
+			if (shift_offset == NULL)
+				shift_offset = &zero_shift_offset;
 			item = proto_tree_add_time(fh_tree, hf_frame_shift_offset, tvb,
-					    0, 0, &(pinfo->fd->shift_offset));
+					    0, 0, shift_offset);
 			proto_item_set_generated(item);
 
 			if (generate_epoch_time) {
@@ -85,10 +85,10 @@ typedef struct _frame_data {
   unsigned int ignored          : 1; /**< 1 = ignore this frame, 0 = normal */
   unsigned int has_ts           : 1; /**< 1 = has time stamp, 0 = no time stamp */
   unsigned int has_modified_block : 1; /** 1 = block for this packet has been modified */
+  unsigned int has_shift_offset : 1; /**< 1 = packet time has been shifted; the offset is kept by the packet provider */
   unsigned int need_colorize    : 1; /**< 1 = need to (re-)calculate packet color */
   unsigned int tsprec           : 4; /**< Time stamp precision -2^tsprec gives up to femtoseconds */
   nstime_t     abs_ts;       /**< Absolute timestamp */
-  nstime_t     shift_offset; /**< How much the abs_tm of the frame is shifted */
   guint32      frame_ref_num; /**< Previous reference frame (0 if this is one) */
   guint32      prev_dis_num; /**< Previous displayed frame (0 if first one) */
 } frame_data;
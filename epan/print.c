@@ -81,6 +81,7 @@ struct _output_fields {
     GPtrArray   **field_values;
     gchar         quote;
     gboolean      includes_col_fields;
+    GArray       *field_hfids;
 };
 
 static gchar *get_field_hex_value(GSList *src_list, field_info *fi);
@@ -2138,6 +2139,10 @@ void output_fields_free(output_fields_t* fields)
         g_ptr_array_free(fields->fields, TRUE);
     }
 
+    if (NULL != fields->field_hfids) {
+        g_array_free(fields->field_hfids, TRUE);
+    }
+
     g_free(fields);
 }
 
@@ -2326,6 +2331,54 @@ gboolean output_fields_has_cols(output_fields_t* fields)
     return fields->includes_col_fields;
 }
 
+/* Get the hfids of all fields (of any of the same name) to be printed. */
+static GArray *
+output_fields_get_hfids(output_fields_t* fields)
+{
+    gsize i;
+    header_field_info *hfinfo;
+
+    if (NULL == fields->field_hfids) {
+        fields->field_hfids = g_array_new(FALSE, FALSE, sizeof(int));
+        for (i = 0; fields->fields != NULL && i < fields->fields->len; i++) {
+            const gchar *field = (const gchar *)g_ptr_array_index(fields->fields, i);
+
+            for (hfinfo = proto_registrar_get_byname(field); hfinfo != NULL;
+                 hfinfo = hfinfo->same_name_next) {
+                g_array_append_val(fields->field_hfids, hfinfo->id);
+            }
+        }
+    }
+    return fields->field_hfids;
+}
+
+gboolean output_fields_need_labels(output_fields_t* fields)
+{
+    GArray *hfids;
+    guint i;
+
+    ws_assert(fields);
+
+    /*
+     * Protocols are printed with their label; everything else is
+     * printed from the field's value, which is there even if the
+     * protocol tree isn't visible.
+     */
+    hfids = output_fields_get_hfids(fields);
+    for (i = 0; i < hfids->len; i++) {
+        if (proto_registrar_get_ftype(g_array_index(hfids, int, i)) == FT_PROTOCOL)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+void output_fields_prime_edt(output_fields_t* fields, epan_dissect_t *edt)
+{
+    ws_assert(fields);
+
+    epan_dissect_prime_with_hfid_array(edt, output_fields_get_hfids(fields));
+}
+
 void write_fields_preamble(output_fields_t* fields, FILE *fh)
 {
     gsize i;
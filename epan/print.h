@@ -70,6 +70,12 @@ WS_DLL_PUBLIC gsize output_fields_num_fields(output_fields_t* info);
 WS_DLL_PUBLIC gboolean output_fields_set_option(output_fields_t* info, gchar* option);
 WS_DLL_PUBLIC void output_fields_list_options(FILE *fh);
 WS_DLL_PUBLIC gboolean output_fields_has_cols(output_fields_t* info);
+/** TRUE if any of the fields is printed using its label, so the protocol
+ * tree must be visible; otherwise, the values of the fields can be got
+ * from an invisible tree primed with output_fields_prime_edt(). */
+WS_DLL_PUBLIC gboolean output_fields_need_labels(output_fields_t* info);
+/** Prime an epan_dissect_t's proto_tree with the fields to be printed. */
+WS_DLL_PUBLIC void output_fields_prime_edt(output_fields_t* info, epan_dissect_t *edt);
 
 /*
  * Higher-level packet-printing code.
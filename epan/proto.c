@@ -412,6 +412,20 @@ typedef struct _gpa_hfinfo_t {
 
 static gpa_hfinfo_t gpa_hfinfo;
 
+/*
+ * Each field that has been primed (i.e., that a filter or tap is
+ * interested in) gets a small slot number, so that a protocol tree can
+ * keep the field_info's for it in a dense array indexed by slot, which
+ * it reuses from one dissection to the next, rather than in a hash
+ * table of GPtrArray's created and freed for every packet.
+ *
+ * interesting_slot_of_hfid[hfid] is the slot number plus one, or 0 if
+ * the field has never been primed.
+ */
+static guint *interesting_slot_of_hfid;
+static guint  interesting_slot_of_hfid_len;
+static guint  num_interesting_slots;
+
 /* Hash table of abbreviations and IDs */
 static GHashTable *gpa_name_map = NULL;
 static header_field_info *same_name_hfinfo;
@@ -660,6 +674,11 @@ proto_cleanup_base(void)
 		gpa_hfinfo.hfi           = NULL;
 	}
 
+	g_free(interesting_slot_of_hfid);
+	interesting_slot_of_hfid     = NULL;
+	interesting_slot_of_hfid_len = 0;
+	num_interesting_slots        = 0;
+
 	if (deregistered_fields) {
 		g_ptr_array_free(deregistered_fields, TRUE);
 		deregistered_fields = NULL;
@@ -763,28 +782,37 @@ proto_tree_children_foreach(proto_tree *tree, proto_tree_foreach_func func,
 	}
 }
 
+/* Empty the slots filled by the last dissection, keeping their storage. */
 static void
-free_GPtrArray_value(gpointer key, gpointer value, gpointer user_data _U_)
+tree_data_clear_interesting_fields(tree_data_t *tree_data)
 {
-	GPtrArray         *ptrs = (GPtrArray *)value;
-	gint               hfid = GPOINTER_TO_UINT(key);
+	GPtrArray         *ptrs;
 	header_field_info *hfinfo;
+	guint              i;
 
-	PROTO_REGISTRAR_GET_NTH(hfid, hfinfo);
-	if (hfinfo->ref_type != HF_REF_TYPE_NONE) {
-		/* when a field is referenced by a filter this also
-		   affects the refcount for the parent protocol so we need
-		   to adjust the refcount for the parent as well
-		*/
-		if (hfinfo->parent != -1) {
-			header_field_info *parent_hfinfo;
-			PROTO_REGISTRAR_GET_NTH(hfinfo->parent, parent_hfinfo);
-			parent_hfinfo->ref_type = HF_REF_TYPE_NONE;
+	if (tree_data->interesting_used == NULL)
+		return;
+
+	for (i = 0; i < tree_data->interesting_used->len; i++) {
+		ptrs = tree_data->interesting_fields[g_array_index(tree_data->interesting_used, guint, i)];
+
+		hfinfo = ((field_info *)g_ptr_array_index(ptrs, 0))->hfinfo;
+		if (hfinfo->ref_type != HF_REF_TYPE_NONE) {
+			/* when a field is referenced by a filter this also
+			   affects the refcount for the parent protocol so we need
+			   to adjust the refcount for the parent as well
+			*/
+			if (hfinfo->parent != -1) {
+				header_field_info *parent_hfinfo;
+				PROTO_REGISTRAR_GET_NTH(hfinfo->parent, parent_hfinfo);
+				parent_hfinfo->ref_type = HF_REF_TYPE_NONE;
+			}
+			hfinfo->ref_type = HF_REF_TYPE_NONE;
 		}
-		hfinfo->ref_type = HF_REF_TYPE_NONE;
-	}
 
-	g_ptr_array_free(ptrs, TRUE);
+		g_ptr_array_set_size(ptrs, 0);
+	}
+	g_array_set_size(tree_data->interesting_used, 0);
 }
 
 static void
@@ -805,14 +833,7 @@ proto_tree_reset(proto_tree *tree)
 	proto_tree_children_foreach(tree, proto_tree_free_node, NULL);
 
 	/* free tree data */
-	if (tree_data->interesting_hfids) {
-		/* Free all the GPtrArray's in the interesting_hfids hash. */
-		g_hash_table_foreach(tree_data->interesting_hfids,
-			free_GPtrArray_value, NULL);
-
-		/* And then remove all values. */
-		g_hash_table_remove_all(tree_data->interesting_hfids);
-	}
+	tree_data_clear_interesting_fields(tree_data);
 
 	/* Reset track of the number of children */
 	tree_data->count = 0;
@@ -829,14 +850,18 @@ proto_tree_free(proto_tree *tree)
 	proto_tree_children_foreach(tree, proto_tree_free_node, NULL);
 
 	/* free tree data */
-	if (tree_data->interesting_hfids) {
-		/* Free all the GPtrArray's in the interesting_hfids hash. */
-		g_hash_table_foreach(tree_data->interesting_hfids,
-			free_GPtrArray_value, NULL);
+	tree_data_clear_interesting_fields(tree_data);
+	if (tree_data->interesting_fields) {
+		guint i;
 
-		/* And then destroy the hash. */
-		g_hash_table_destroy(tree_data->interesting_hfids);
+		for (i = 0; i < tree_data->interesting_fields_len; i++) {
+			if (tree_data->interesting_fields[i])
+				g_ptr_array_free(tree_data->interesting_fields[i], TRUE);
+		}
+		g_free(tree_data->interesting_fields);
 	}
+	if (tree_data->interesting_used)
+		g_array_free(tree_data->interesting_used, TRUE);
 
 	g_slice_free(tree_data_t, tree_data);
 
@@ -2474,24 +2499,35 @@ tree_data_add_maybe_interesting_field(tree_data_t *tree_data, field_info *fi)
 	const header_field_info *hfinfo = fi->hfinfo;
 
 	if (hfinfo->ref_type == HF_REF_TYPE_DIRECT) {
-		GPtrArray *ptrs = NULL;
-
-		if (tree_data->interesting_hfids == NULL) {
-			/* Initialize the hash because we now know that it is needed */
-			tree_data->interesting_hfids =
-				g_hash_table_new(g_direct_hash, NULL /* g_direct_equal */);
-		} else if (g_hash_table_size(tree_data->interesting_hfids)) {
-			ptrs = (GPtrArray *)g_hash_table_lookup(tree_data->interesting_hfids,
-					   GINT_TO_POINTER(hfinfo->id));
+		GPtrArray *ptrs;
+		guint slot;
+
+		/* Fields are only referenced directly once they're primed,
+		 * which gives them a slot. */
+		DISSECTOR_ASSERT((guint)hfinfo->id < interesting_slot_of_hfid_len &&
+				 interesting_slot_of_hfid[hfinfo->id] != 0);
+		slot = interesting_slot_of_hfid[hfinfo->id] - 1;
+
+		if (slot >= tree_data->interesting_fields_len) {
+			/* Make room for all the slots handed out so far */
+			tree_data->interesting_fields = g_renew(GPtrArray *,
+				tree_data->interesting_fields, num_interesting_slots);
+			memset(&tree_data->interesting_fields[tree_data->interesting_fields_len], 0,
+				(num_interesting_slots - tree_data->interesting_fields_len) * sizeof (GPtrArray *));
+			tree_data->interesting_fields_len = num_interesting_slots;
 		}
+		if (tree_data->interesting_used == NULL)
+			tree_data->interesting_used = g_array_new(FALSE, FALSE, sizeof (guint));
 
+		ptrs = tree_data->interesting_fields[slot];
 		if (!ptrs) {
-			/* First element triggers the creation of pointer array */
+			/* First element ever triggers the creation of pointer array */
 			ptrs = g_ptr_array_new();
-			g_hash_table_insert(tree_data->interesting_hfids,
-					    GINT_TO_POINTER(hfinfo->id), ptrs);
+			tree_data->interesting_fields[slot] = ptrs;
 		}
 
+		if (ptrs->len == 0)
+			g_array_append_val(tree_data->interesting_used, slot);
 		g_ptr_array_add(ptrs, fi);
 	}
 }
@@ -7157,8 +7193,10 @@ proto_tree_create_root(packet_info *pinfo)
 	/* Make sure we can access pinfo everywhere */
 	pnode->tree_data->pinfo = pinfo;
 
-	/* Don't initialize the tree_data_t. Wait until we know we need it */
-	pnode->tree_data->interesting_hfids = NULL;
+	/* Don't allocate the interesting fields. Wait until we know we need them */
+	pnode->tree_data->interesting_fields = NULL;
+	pnode->tree_data->interesting_fields_len = 0;
+	pnode->tree_data->interesting_used = NULL;
 
 	/* Set the default to FALSE so it's easier to
 	 * find errors; if we expect to see the protocol tree
@@ -7188,6 +7226,18 @@ proto_tree_prime_with_hfid(proto_tree *tree _U_, const gint hfid)
 	   also increase the refcount for the parent, i.e the protocol.
 	*/
 	hfinfo->ref_type = HF_REF_TYPE_DIRECT;
+
+	/* Give the field a slot, if it doesn't have one yet. */
+	if ((guint)hfid >= interesting_slot_of_hfid_len) {
+		guint new_len = MAX((guint)hfid + 1, gpa_hfinfo.len);
+
+		interesting_slot_of_hfid = g_renew(guint, interesting_slot_of_hfid, new_len);
+		memset(&interesting_slot_of_hfid[interesting_slot_of_hfid_len], 0,
+			(new_len - interesting_slot_of_hfid_len) * sizeof (guint));
+		interesting_slot_of_hfid_len = new_len;
+	}
+	if (interesting_slot_of_hfid[hfid] == 0)
+		interesting_slot_of_hfid[hfid] = ++num_interesting_slots;
 	/* only increase the refcount if there is a parent.
 	   if this is a protocol and not a field then parent will be -1
 	   and there is no parent to add any refcounting for.
@@ -10383,27 +10433,41 @@ proto_check_for_protocol_or_field(const proto_tree* tree, const int id)
 GPtrArray *
 proto_get_finfo_ptr_array(const proto_tree *tree, const int id)
 {
+	tree_data_t *tree_data;
+	GPtrArray   *ptrs;
+	guint        slot;
+
 	if (!tree)
 		return NULL;
 
-	if (PTREE_DATA(tree)->interesting_hfids != NULL)
-		return (GPtrArray *)g_hash_table_lookup(PTREE_DATA(tree)->interesting_hfids,
-					   GINT_TO_POINTER(id));
-	else
+	if ((guint)id >= interesting_slot_of_hfid_len ||
+	    interesting_slot_of_hfid[id] == 0)
+		return NULL;
+	slot = interesting_slot_of_hfid[id] - 1;
+
+	tree_data = PTREE_DATA(tree);
+	if (slot >= tree_data->interesting_fields_len)
+		return NULL;
+
+	/* The arrays are kept from one dissection to the next; an empty
+	 * one means the field isn't in this tree. */
+	ptrs = tree_data->interesting_fields[slot];
+	if (ptrs == NULL || ptrs->len == 0)
 		return NULL;
+	return ptrs;
 }
 
 gboolean
 proto_tracking_interesting_fields(const proto_tree *tree)
 {
-	GHashTable *interesting_hfids;
+	GArray *interesting_used;
 
 	if (!tree)
 		return FALSE;
 
-	interesting_hfids = PTREE_DATA(tree)->interesting_hfids;
+	interesting_used = PTREE_DATA(tree)->interesting_used;
 
-	return (interesting_hfids != NULL) && g_hash_table_size(interesting_hfids);
+	return (interesting_used != NULL) && interesting_used->len;
 }
 
 /* Helper struct for proto_find_info() and	proto_all_finfos() */
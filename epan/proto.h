@@ -854,7 +854,9 @@ typedef struct
 /** One of these exists for the entire protocol tree. Each proto_node
  * in the protocol tree points to the same copy. */
 typedef struct {
-    GHashTable          *interesting_hfids;
+    GPtrArray          **interesting_fields;     /**< field_info's of each primed field, by slot */
+    guint                interesting_fields_len; /**< number of slots in interesting_fields */
+    GArray              *interesting_used;       /**< slots with fields in this tree */
     gboolean             visible;
     gboolean             fake_protocols;
     guint                count;
@@ -969,6 +969,126 @@ MERGE_FRAG(fragment_head *fd_head, fragment_item *fd)
 	fd_i->next = fd;
 }
 
+/*
+ * The reassembled data is a composite tvbuff made of the fragments' own
+ * data, rather than a copy of it; the composite takes over the
+ * fragments' tvbuffs and frees them when it is freed.
+ *
+ * Start building the reassembled data for a reassembly of "size" bytes.
+ * If an earlier, partial reassembly is being extended, its data is the
+ * start of the new data; its members are taken over rather than copied
+ * again, *dfpos is set past them, and TRUE is returned.  The fragments
+ * that made up that reassembly refer to it with FD_SUBSET_TVB tvbuffs,
+ * and the caller must not add their data again.
+ */
+static gboolean
+fragment_data_start(fragment_head *fd_head, const guint32 size,
+		    tvbuff_t **data_tvb, guint32 *dfpos)
+{
+	tvbuff_t *old_tvb_data = fd_head->tvb_data;
+	fragment_item *fd_i;
+
+	*data_tvb = tvb_new_composite_owner();
+	*dfpos = 0;
+	if (!old_tvb_data || !tvb_composite_is_owner(old_tvb_data) ||
+	    tvb_captured_length(old_tvb_data) > size)
+		return FALSE;
+
+	for (fd_i = fd_head->next; fd_i; fd_i = fd_i->next) {
+		if (fd_i->flags & FD_SUBSET_TVB) {
+			tvb_composite_take_members(*data_tvb, old_tvb_data);
+			*dfpos = tvb_captured_length(old_tvb_data);
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Add "len" bytes of a fragment's data, starting at "offset" within
+ * it, to the reassembled data.
+ *
+ * The fragment's own data is handed over to the reassembled data, and
+ * the fragment is marked with FD_SUBSET_TVB so that it isn't freed along
+ * with the fragments.  Data that already has FD_SUBSET_TVB set refers to
+ * an earlier reassembly that is about to be freed, so it is copied.
+ */
+static void
+fragment_data_append(tvbuff_t *data_tvb, fragment_item *fd_i,
+		     const guint32 offset, const guint32 len)
+{
+	tvbuff_t *member;
+
+	if (len == 0)
+		return;
+
+	if (fd_i->flags & FD_SUBSET_TVB) {
+		member = tvb_clone_offset_len(fd_i->tvb_data, offset, len);
+		tvb_composite_append_owned(data_tvb, member, member);
+	} else {
+		if (offset == 0 && len == tvb_captured_length(fd_i->tvb_data))
+			member = fd_i->tvb_data;
+		else
+			member = tvb_new_subset_length(fd_i->tvb_data, offset, len);
+		tvb_composite_append_owned(data_tvb, member, fd_i->tvb_data);
+		fd_i->flags |= FD_SUBSET_TVB;
+	}
+}
+
+/*
+ * Finish building the reassembled data.  Anything short of "size"
+ * bytes (which only happens when the reassembly has errors) is filled
+ * with zeroes.
+ */
+static tvbuff_t *
+fragment_data_finish(tvbuff_t *data_tvb, const guint32 dfpos, const guint32 size)
+{
+	if (size == 0) {
+		/* A composite can't be empty. */
+		tvb_free(data_tvb);
+		return tvb_new_real_data(NULL, 0, 0);
+	}
+
+	if (dfpos < size) {
+		guint8 *zeroes = (guint8 *)g_malloc0(size - dfpos);
+		tvbuff_t *member = tvb_new_real_data(zeroes, size - dfpos, size - dfpos);
+
+		tvb_set_free_cb(member, g_free);
+		tvb_composite_append_owned(data_tvb, member, member);
+	}
+	tvb_composite_finalize(data_tvb);
+	return data_tvb;
+}
+
+/*
+ * A fragment whose start overlaps data before it in the reassembly, and
+ * how many of its bytes to compare with that data.
+ */
+typedef struct {
+	fragment_item *fd;
+	guint32 cmp_len;
+} fragment_overlap_check;
+
+/*
+ * Check whether the reassembled data at the given offset differs from
+ * the start of a fragment's data.
+ */
+static gboolean
+fragment_data_conflicts(tvbuff_t *data_tvb, const guint32 offset,
+			fragment_item *fd_i, const guint32 cmp_len)
+{
+	guint8 *buf;
+	gboolean conflict;
+
+	/* Copy rather than tvb_get_ptr(), which would flatten the
+	 * whole composite if the range spans more than one member. */
+	buf = (guint8 *)g_malloc(cmp_len);
+	tvb_memcpy(data_tvb, buf, offset, cmp_len);
+	conflict = memcmp(buf, tvb_get_ptr(fd_i->tvb_data, 0, cmp_len), cmp_len) != 0;
+	g_free(buf);
+	return conflict;
+}
+
 /*
  * This function adds a new fragment to the fragment hash table.
  * If this is the first fragment seen for this datagram, a new entry
@@ -998,8 +1118,11 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	fragment_item *fd;
 	fragment_item *fd_i;
 	guint32 max, dfpos, fraglen, overlap;
-	tvbuff_t *old_tvb_data;
-	guint8 *data;
+	tvbuff_t *old_tvb_data, *data_tvb;
+	gboolean extended;
+	GArray *overlaps;
+	fragment_overlap_check check;
+	guint i;
 
 	/* create new fd describing this fragment */
 	fd = g_slice_new(fragment_item);
@@ -1191,12 +1314,11 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 	 */
 	/* store old data just in case */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(fd_head->datalen);
-	fd_head->tvb_data = tvb_new_real_data(data, fd_head->datalen, fd_head->datalen);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
+	extended = fragment_data_start(fd_head, fd_head->datalen, &data_tvb, &dfpos);
+	overlaps = g_array_new(FALSE, FALSE, sizeof(fragment_overlap_check));
 
 	/* add all data fragments */
-	for (dfpos=0,fd_i=fd_head;fd_i;fd_i=fd_i->next) {
+	for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
 		if (fd_i->len) {
 			/*
 			 * The loop above that calculates max also
@@ -1213,10 +1335,15 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 			 *
 			 * Note that the "overlap" compare must only be
 			 * done for fragments with (offset+len) <= fd_head->datalen
-			 * and thus within the newly g_malloc'd buffer.
+			 * and thus within the reassembled data.
 			 */
 
-			if (fd_i->offset >= fd_head->datalen) {
+			if (extended && (fd_i->flags & FD_SUBSET_TVB)) {
+				/*
+				 * Part of the earlier reassembly we're
+				 * extending; its data is already there.
+				 */
+			} else if (fd_i->offset >= fd_head->datalen) {
 				/*
 				 * Fragment starts after the end
 				 * of the reassembled packet.
@@ -1269,17 +1396,14 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 				 * has checked for gaps. */
 				if (overlap) {
 					/* duplicate/retransmission/overlap */
-					guint32 cmp_len = MIN(fd_i->len,overlap);
-
 					fd_i->flags    |= FD_OVERLAP;
 					fd_head->flags |= FD_OVERLAP;
-					if ( memcmp(data + fd_i->offset,
-							tvb_get_ptr(fd_i->tvb_data, 0, cmp_len),
-							cmp_len)
-							 ) {
-						fd_i->flags    |= FD_OVERLAPCONFLICT;
-						fd_head->flags |= FD_OVERLAPCONFLICT;
-					}
+					/* The overlapping bytes are compared
+					 * once the reassembled data is
+					 * complete. */
+					check.fd = fd_i;
+					check.cmp_len = MIN(fd_i->len, overlap);
+					g_array_append_val(overlaps, check);
 				}
 				/* XXX: As in the fragment_add_seq funcs
 				 * like fragment_defragment_and_free() the
@@ -1301,13 +1425,30 @@ fragment_add_work(fragment_head *fd_head, tvbuff_t *tvb, const int offset,
 				 * out rather than mixed with the new ones?
 				 */
 				if (fd_i->offset + fraglen > dfpos) {
-					memcpy(data+dfpos,
-						tvb_get_ptr(fd_i->tvb_data, overlap, fraglen-overlap),
-						fraglen-overlap);
+					fragment_data_append(data_tvb, fd_i,
+						overlap, fraglen-overlap);
 					dfpos = fd_i->offset + fraglen;
 				}
 			}
+		}
+	}
+
+	fd_head->tvb_data = fragment_data_finish(data_tvb, dfpos, fd_head->datalen);
+
+	for (i = 0; i < overlaps->len; i++) {
+		check = g_array_index(overlaps, fragment_overlap_check, i);
+		if (fragment_data_conflicts(fd_head->tvb_data, check.fd->offset,
+		    check.fd, check.cmp_len)) {
+			check.fd->flags |= FD_OVERLAPCONFLICT;
+			fd_head->flags  |= FD_OVERLAPCONFLICT;
+		}
+	}
+	g_array_free(overlaps, TRUE);
 
+	/* free all fragments; the data of those that were added to the
+	 * reassembled data now belongs to it */
+	for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
+		if (fd_i->len) {
 			if (fd_i->flags & FD_SUBSET_TVB)
 				fd_i->flags &= ~FD_SUBSET_TVB;
 			else if (fd_i->tvb_data)
@@ -1628,7 +1769,8 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 	fragment_item *last_fd = NULL;
 	guint32  dfpos = 0, size = 0;
 	tvbuff_t *old_tvb_data = NULL;
-	guint8 *data;
+	tvbuff_t *data_tvb;
+	gboolean extended;
 
 	for(fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
 		if(!last_fd || last_fd->offset!=fd_i->offset){
@@ -1639,10 +1781,7 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 
 	/* store old data in case the fd_i->data pointers refer to it */
 	old_tvb_data=fd_head->tvb_data;
-	data = (guint8 *) g_malloc(size);
-	fd_head->tvb_data = tvb_new_real_data(data, size, size);
-	tvb_set_free_cb(fd_head->tvb_data, g_free);
-	fd_head->len = size;		/* record size for caller	*/
+	extended = fragment_data_start(fd_head, size, &data_tvb, &dfpos);
 
 	/* add all data fragments */
 	last_fd=NULL;
@@ -1650,8 +1789,10 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 		if (fd_i->len) {
 			if(!last_fd || last_fd->offset != fd_i->offset) {
 				/* First fragment or in-sequence fragment */
-				memcpy(data+dfpos, tvb_get_ptr(fd_i->tvb_data, 0, fd_i->len), fd_i->len);
-				dfpos += fd_i->len;
+				if (!extended || !(fd_i->flags & FD_SUBSET_TVB)) {
+					fragment_data_append(data_tvb, fd_i, 0, fd_i->len);
+					dfpos += fd_i->len;
+				}
 			} else {
 				/* duplicate/retransmission/overlap */
 				fd_i->flags    |= FD_OVERLAP;
@@ -1666,7 +1807,12 @@ fragment_defragment_and_free (fragment_head *fd_head, const packet_info *pinfo)
 		last_fd=fd_i;
 	}
 
-	/* we have defragmented the pdu, now free all fragments*/
+	fd_head->tvb_data = fragment_data_finish(data_tvb, dfpos, size);
+	fd_head->len = size;		/* record size for caller	*/
+
+	/* we have defragmented the pdu, now free all fragments; the data
+	 * of those that were added to the reassembled data now belongs
+	 * to it */
 	for (fd_i=fd_head->next;fd_i;fd_i=fd_i->next) {
 		if (fd_i->flags & FD_SUBSET_TVB)
 			fd_i->flags &= ~FD_SUBSET_TVB;
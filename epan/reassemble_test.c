@@ -1918,6 +1918,70 @@ test_fragment_add_partial_reassembly(void)
     ASSERT(!tvb_memeql(fd_head->tvb_data,190,data,40));
 }
 
+/* Test case for fragment_add when the reassembled data is made
+ * contiguous, which frees the fragments it was made of, and the
+ * reassembly is then extended.
+ *
+ *    seq_off   frame  tvb_off   len   (initial) more_frags
+ *    -------   -----  -------   ---   --------------------
+ *        0       1       10      50   true
+ *       50       2        5      60   false
+ *      110       3        0      40   false
+ */
+static void
+test_fragment_add_flattened_reassembly(void)
+{
+    fragment_head *fd_head;
+    const guint8 *ptr;
+
+    printf("Starting test test_fragment_add_flattened_reassembly\n");
+
+    pinfo.num = 1;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 10, &pinfo, 12, NULL,
+                         0, 50, TRUE);
+    ASSERT_EQ_POINTER(NULL,fd_head);
+
+    pinfo.num = 2;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 5, &pinfo, 12, NULL,
+                         50, 60, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(110,fd_head->datalen);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET,fd_head->flags);
+
+    /* a range spanning both fragments makes the data contiguous */
+    ptr = tvb_get_ptr(fd_head->tvb_data, 40, 20);
+    ASSERT(!memcmp(ptr, data+50, 10));
+    ASSERT(!memcmp(ptr+10, data+5, 10));
+
+    /* the data is still all there without the fragments */
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+5,60));
+    ASSERT_EQ(0x0a,tvb_get_guint8(fd_head->tvb_data,0));
+    ASSERT_EQ(-1,tvb_find_guint8(fd_head->tvb_data,0,-1,0xff));
+
+    /* now extend the reassembly */
+    fragment_set_partial_reassembly(&test_reassembly_table, &pinfo, 12, NULL);
+
+    pinfo.num = 3;
+    fd_head=fragment_add(&test_reassembly_table, tvb, 0, &pinfo, 12, NULL,
+                         110, 40, FALSE);
+    ASSERT_NE_POINTER(NULL,fd_head);
+    ASSERT_EQ(3,fd_head->frame);
+    ASSERT_EQ(150,fd_head->datalen);
+    ASSERT_EQ(3,fd_head->reassembled_in);
+    ASSERT_EQ(FD_DEFRAGMENTED|FD_DATALEN_SET,fd_head->flags);
+
+    /* test the actual reassembly */
+    ASSERT(!tvb_memeql(fd_head->tvb_data,0,data+10,50));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,50,data+5,60));
+    ASSERT(!tvb_memeql(fd_head->tvb_data,110,data,40));
+
+    /* and make that contiguous as well */
+    ptr = tvb_get_ptr(fd_head->tvb_data, 100, 20);
+    ASSERT(!memcmp(ptr, data+55, 10));
+    ASSERT(!memcmp(ptr+10, data, 10));
+}
+
 /* XXX: Is the proper behavior here really throwing an exception instead
  * of setting FD_OVERLAP?
  */
@@ -3301,6 +3365,7 @@ main(int argc _U_, char **argv _U_)
 #endif
         test_simple_fragment_add,              /* frag table only   */
         test_fragment_add_partial_reassembly,
+        test_fragment_add_flattened_reassembly,
         test_fragment_add_duplicate_first,
         test_fragment_add_duplicate_middle,
         test_fragment_add_duplicate_last,
@@ -91,10 +91,33 @@ typedef struct _tap_listener_t {
 	tap_packet_cb packet;
 	tap_draw_cb draw;
 	tap_finish_cb finish;
+	/* listener whose filter result we use, as it has the same filter */
+	struct _tap_listener_t *filter_owner;
+	guint filter_pass;	/* tap_push_count when filter_passed was set */
+	gboolean filter_passed;
 } tap_listener_t;
 
 static tap_listener_t *tap_listener_queue=NULL;
 
+/*
+ * The listeners, grouped by the tap they listen to, in the same order
+ * as in tap_listener_queue; the listeners for tap N are
+ * tap_dispatch_table[tap_dispatch_start[N]] up to, but not including,
+ * tap_dispatch_table[tap_dispatch_start[N+1]].
+ *
+ * This, and the listeners' filter_owner, is rebuilt when the listeners,
+ * their filters, or the taps change, so that tap_push_tapped_queue()
+ * only looks at the listeners for each queued packet's tap, and
+ * evaluates each distinct filter at most once per packet.
+ */
+static tap_listener_t **tap_dispatch_table=NULL;
+static guint *tap_dispatch_start=NULL;
+static int tap_dispatch_num_taps=0;
+static gboolean tap_dispatch_stale=TRUE;
+
+/* Incremented for each packet whose queue we push. */
+static guint tap_push_count=0;
+
 static GSList *tap_plugins = NULL;
 
 #ifdef HAVE_PLUGINS
@@ -201,6 +224,7 @@ register_tap(const char *name)
 	} else {
 		tdl->next=td;
 	}
+	tap_dispatch_stale=TRUE;
 	return i;
 }
 
@@ -297,6 +321,55 @@ tap_queue_init(epan_dissect_t *edt)
 	tap_build_interesting (edt);
 }
 
+/* Rebuild tap_dispatch_table and the listeners' filter_owner. */
+static void
+tap_build_dispatch_table(void)
+{
+	tap_listener_t *tl, *tl2;
+	tap_dissector_t *td;
+	guint num_listeners=0;
+	int num_taps=0;
+	int tap_id;
+	guint n;
+
+	for(td=tap_dissector_list;td;td=td->next){
+		num_taps++;
+	}
+
+	g_free(tap_dispatch_table);
+	g_free(tap_dispatch_start);
+	for(tl=tap_listener_queue;tl;tl=tl->next){
+		num_listeners++;
+
+		/* Does an earlier listener have the same filter? */
+		tl->filter_owner=tl;
+		if(tl->code){
+			for(tl2=tap_listener_queue;tl2!=tl;tl2=tl2->next){
+				if(tl2->code && !strcmp(tl2->fstring, tl->fstring)){
+					tl->filter_owner=tl2;
+					break;
+				}
+			}
+		}
+		tl->filter_pass=tap_push_count;
+	}
+
+	tap_dispatch_table=g_new(tap_listener_t *, num_listeners ? num_listeners : 1);
+	tap_dispatch_start=g_new(guint, num_taps + 2);
+	n=0;
+	for(tap_id=0;tap_id<=num_taps;tap_id++){
+		tap_dispatch_start[tap_id]=n;
+		for(tl=tap_listener_queue;tl;tl=tl->next){
+			if(tl->tap_id==tap_id){
+				tap_dispatch_table[n++]=tl;
+			}
+		}
+	}
+	tap_dispatch_start[num_taps + 1]=n;
+	tap_dispatch_num_taps=num_taps;
+	tap_dispatch_stale=FALSE;
+}
+
 /* this function is called after a packet has been fully dissected to push the tapped
    data to all extensions that has callbacks registered.
 */
@@ -304,8 +377,8 @@ void
 tap_push_tapped_queue(epan_dissect_t *edt)
 {
 	tap_packet_t *tp;
-	tap_listener_t *tl;
-	guint i;
+	tap_listener_t *tl, *owner;
+	guint i, j;
 
 	/* nothing to do, just return */
 	if(!tapping_is_active){
@@ -319,62 +392,81 @@ tap_push_tapped_queue(epan_dissect_t *edt)
 		return;
 	}
 
+	if(tap_dispatch_stale){
+		tap_build_dispatch_table();
+	}
+
+	/* No filter has been evaluated for this packet yet. */
+	tap_push_count++;
+
 	/* loop over all tap listeners and call the listener callback
 	   for all packets that match the filter. */
 	for(i=0;i<tap_packet_index;i++){
-		for(tl=tap_listener_queue;tl;tl=tl->next){
-			tp=&tap_packet_array[i];
+		tp=&tap_packet_array[i];
+		if(tp->tap_id<=0 || tp->tap_id>tap_dispatch_num_taps){
+			continue;
+		}
+		for(j=tap_dispatch_start[tp->tap_id];j<tap_dispatch_start[tp->tap_id+1];j++){
+			tl=tap_dispatch_table[j];
 			/* Don't tap the packet if it's an "error packet"
 			 * unless the listener has requested that we do so.
 			 */
-			if (!(tp->flags & TAP_PACKET_IS_ERROR_PACKET) || (tl->flags & TL_REQUIRES_ERROR_PACKETS))
-			{
-				if(tp->tap_id==tl->tap_id){
-					if(!tl->packet){
-						/* There isn't a per-packet
-						 * routine for this tap.
-						 */
-						continue;
-					}
-					if(tl->failed){
-						/* A previous call failed,
-						 * meaning "stop running this
-						 * tap", so don't call the
-						 * packet routine.
-						 */
-						continue;
-					}
-
-					/* If we have a filter, see if the
-					 * packet passes.
-					 */
-					if(tl->code){
-						if (!dfilter_apply_edt(tl->code, edt)){
-							/* The packet didn't
-							 * pass the filter. */
-							continue;
-						}
-					}
-
-					/* So call the per-packet routine. */
-					tap_packet_status status;
-
-					status = tl->packet(tl->tapdata, tp->pinfo, edt, tp->tap_specific_data);
-
-					switch (status) {
-
-					case TAP_PACKET_DONT_REDRAW:
-						break;
-
-					case TAP_PACKET_REDRAW:
-						tl->needs_redraw=TRUE;
-						break;
-
-					case TAP_PACKET_FAILED:
-						tl->failed=TRUE;
-						break;
-					}
+			if ((tp->flags & TAP_PACKET_IS_ERROR_PACKET) && !(tl->flags & TL_REQUIRES_ERROR_PACKETS)){
+				continue;
+			}
+			if(!tl->packet){
+				/* There isn't a per-packet
+				 * routine for this tap.
+				 */
+				continue;
+			}
+			if(tl->failed){
+				/* A previous call failed,
+				 * meaning "stop running this
+				 * tap", so don't call the
+				 * packet routine.
+				 */
+				continue;
+			}
+
+			/* If we have a filter, see if the
+			 * packet passes.  The result only
+			 * depends on the packet, so evaluate
+			 * each distinct filter at most once
+			 * per packet, however many listeners
+			 * have it and however many times their
+			 * tap was queued.
+			 */
+			if(tl->code){
+				owner=tl->filter_owner;
+				if(owner->filter_pass!=tap_push_count){
+					owner->filter_passed=dfilter_apply_edt(owner->code, edt);
+					owner->filter_pass=tap_push_count;
 				}
+				if (!owner->filter_passed){
+					/* The packet didn't
+					 * pass the filter. */
+					continue;
+				}
+			}
+
+			/* So call the per-packet routine. */
+			tap_packet_status status;
+
+			status = tl->packet(tl->tapdata, tp->pinfo, edt, tp->tap_specific_data);
+
+			switch (status) {
+
+			case TAP_PACKET_DONT_REDRAW:
+				break;
+
+			case TAP_PACKET_REDRAW:
+				tl->needs_redraw=TRUE;
+				break;
+
+			case TAP_PACKET_FAILED:
+				tl->failed=TRUE;
+				break;
 			}
 		}
 	}
@@ -573,6 +665,7 @@ register_tap_listener(const char *tapname, void *tapdata, const char *fstring,
 	tl->next=tap_listener_queue;
 
 	tap_listener_queue=tl;
+	tap_dispatch_stale=TRUE;
 
 	return NULL;
 }
@@ -609,6 +702,7 @@ set_tap_dfilter(void *tapdata, const char *fstring)
 			tl->code=NULL;
 		}
 		tl->needs_redraw=TRUE;
+		tap_dispatch_stale=TRUE;
 		g_free(tl->fstring);
 		if(fstring){
 			if(!dfilter_compile(fstring, &code, &err_msg)){
@@ -655,6 +749,7 @@ tap_listeners_dfilter_recompile(void)
 		}
 		tl->code=code;
 	}
+	tap_dispatch_stale=TRUE;
 }
 
 /* this function removes a tap listener
@@ -685,6 +780,7 @@ remove_tap_listener(void *tapdata)
 			return;
 		}
 	}
+	tap_dispatch_stale=TRUE;
 	free_tap_listener(tl);
 }
 
@@ -770,6 +866,13 @@ void tap_cleanup(void)
 	}
 	tap_listener_queue = NULL;
 
+	g_free(tap_dispatch_table);
+	tap_dispatch_table = NULL;
+	g_free(tap_dispatch_start);
+	tap_dispatch_start = NULL;
+	tap_dispatch_num_taps = 0;
+	tap_dispatch_stale = TRUE;
+
 	while(head_dl){
 		elem_dl = head_dl;
 		head_dl = head_dl->next;
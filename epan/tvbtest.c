@@ -605,6 +605,61 @@ run_tests(void)
 	tvb_free_chain(tvb_parent);  /* should free all tvb's and associated data */
 }
 
+#define OWNER_MEMBERS		32
+#define OWNER_MEMBER_LENGTH	8
+
+/* Composites that own their members, as used by reassembly. */
+static void
+run_owner_composite_tests(void)
+{
+	int		i;
+	guint8		*expected;
+	guint8		*member_data;
+	tvbuff_t	*member;
+	tvbuff_t	*tvb_first;
+	tvbuff_t	*tvb_all;
+
+	expected = (guint8 *)g_malloc(OWNER_MEMBERS * OWNER_MEMBER_LENGTH);
+	for (i = 0; i < OWNER_MEMBERS * OWNER_MEMBER_LENGTH; i++)
+		expected[i] = (guint8)i;
+
+	/* The first half of the members. */
+	printf("Making Owner Composite 0\n");
+	tvb_first = tvb_new_composite_owner();
+	for (i = 0; i < OWNER_MEMBERS / 2; i++) {
+		member_data = (guint8 *)g_malloc(OWNER_MEMBER_LENGTH);
+		memcpy(member_data, &expected[i * OWNER_MEMBER_LENGTH], OWNER_MEMBER_LENGTH);
+		member = tvb_new_real_data(member_data, OWNER_MEMBER_LENGTH, OWNER_MEMBER_LENGTH);
+		tvb_set_free_cb(member, g_free);
+		tvb_composite_append_owned(tvb_first, member, member);
+	}
+	tvb_composite_finalize(tvb_first);
+	test(tvb_first, "Owner Composite 0", expected,
+	    OWNER_MEMBERS / 2 * OWNER_MEMBER_LENGTH, OWNER_MEMBERS / 2 * OWNER_MEMBER_LENGTH);
+
+	/* Take those over, add the second half, and free the first
+	 * composite; the members must stay alive. */
+	printf("Making Owner Composite 1\n");
+	tvb_all = tvb_new_composite_owner();
+	tvb_composite_take_members(tvb_all, tvb_first);
+	for (i = OWNER_MEMBERS / 2; i < OWNER_MEMBERS; i++) {
+		member_data = (guint8 *)g_malloc(OWNER_MEMBER_LENGTH);
+		memcpy(member_data, &expected[i * OWNER_MEMBER_LENGTH], OWNER_MEMBER_LENGTH);
+		member = tvb_new_real_data(member_data, OWNER_MEMBER_LENGTH, OWNER_MEMBER_LENGTH);
+		tvb_set_free_cb(member, g_free);
+		/* Use part of the member only. */
+		tvb_composite_append_owned(tvb_all,
+		    tvb_new_subset_length(member, 0, OWNER_MEMBER_LENGTH), member);
+	}
+	tvb_composite_finalize(tvb_all);
+	tvb_free(tvb_first);
+	test(tvb_all, "Owner Composite 1", expected,
+	    OWNER_MEMBERS * OWNER_MEMBER_LENGTH, OWNER_MEMBERS * OWNER_MEMBER_LENGTH);
+
+	tvb_free(tvb_all);	/* should free all members */
+	g_free(expected);
+}
+
 /* Note: valgrind can be used to check for tvbuff memory leaks */
 int
 main(void)
@@ -615,6 +670,7 @@ main(void)
 
 	except_init();
 	run_tests();
+	run_owner_composite_tests();
 	except_deinit();
 	exit(failed?1:0);
 }
@@ -214,6 +214,28 @@ WS_DLL_PUBLIC tvbuff_t *tvb_new_composite(void);
  * occur, data access can finally happen after this finalization. */
 WS_DLL_PUBLIC void tvb_composite_finalize(tvbuff_t *tvb);
 
+/** Create an empty composite tvbuff that frees the tvbuffs handed to it
+ * with tvb_composite_append_owned() when it is freed.  Its members need
+ * not be part of the same chain, and it is not added to any member's
+ * chain; the caller frees it with tvb_free().  Used by reassembly. */
+extern tvbuff_t *tvb_new_composite_owner(void);
+
+/** TRUE if tvb was created with tvb_new_composite_owner(). */
+extern gboolean tvb_composite_is_owner(const tvbuff_t *tvb);
+
+/** Append member to a composite created with tvb_new_composite_owner().
+ * If owned is not NULL, it (and its chain) is freed along with the
+ * composite; member is usually owned itself, or a subset of it. */
+extern void tvb_composite_append_owned(tvbuff_t *tvb, tvbuff_t *member,
+    tvbuff_t *owned);
+
+/** Append all members of the finalized composite src, created with
+ * tvb_new_composite_owner(), to tvb and take over the tvbuffs src
+ * owns, so that src can be freed without freeing its members.
+ * An owning composite frees its members once it has been made
+ * contiguous; if src has, its contiguous data is taken over instead. */
+extern void tvb_composite_take_members(tvbuff_t *tvb, tvbuff_t *src);
+
 
 /* Get amount of captured data in the buffer (which is *NOT* necessarily the
  * length of the packet). You probably want tvb_reported_length instead. */
@@ -14,16 +14,28 @@
 #include "tvbuff.h"
 #include "tvbuff-int.h"
 #include "proto.h"	/* XXX - only used for DISSECTOR_ASSERT, probably a new header file? */
+#include "wmem_scopes.h"
 
 typedef struct {
-	GSList		*tvbs;
-
-	/* Used for quick testing to see if this
-	 * is the tvbuff that a COMPOSITE is
-	 * interested in. */
+	/* Members, in order, while the composite is being built. */
+	GQueue		tvbs;
+
+	/* Set up by tvb_composite_finalize(): the members in an array,
+	 * and the offsets at which each of them starts and ends, so
+	 * that the member holding an offset can be found with a binary
+	 * search. */
+	tvbuff_t	**members;
+	guint		num_members;
 	guint		*start_offsets;
 	guint		*end_offsets;
 
+	/* TRUE for composites created with tvb_new_composite_owner(). */
+	gboolean	owner;
+	/* tvbuffs (with their chains) to free along with this composite. */
+	GSList		*owned;
+	/* TRUE if real_data has been handed to another composite by
+	 * tvb_composite_take_members(). */
+	gboolean	real_data_taken;
 } tvb_comp_t;
 
 struct tvb_composite {
@@ -32,17 +44,70 @@ struct tvb_composite {
 	tvb_comp_t	composite;
 };
 
+static void
+composite_free_owned(GSList *owned)
+{
+	GSList *slist;
+
+	for (slist = owned; slist != NULL; slist = slist->next)
+		tvb_free_chain((tvbuff_t *)slist->data);
+	g_slist_free(owned);
+}
+
+static gboolean
+composite_free_owned_cb(wmem_allocator_t *allocator _U_, wmem_cb_event_t event _U_, void *user_data)
+{
+	composite_free_owned((GSList *)user_data);
+
+	/* Once is enough. */
+	return FALSE;
+}
+
 static void
 composite_free(tvbuff_t *tvb)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	tvb_comp_t *composite = &composite_tvb->composite;
 
-	g_slist_free(composite->tvbs);
+	g_queue_clear(&composite->tvbs);
+
+	g_free(composite->members);
+	g_free(composite->start_offsets);
+	g_free(composite->end_offsets);
+	if (!composite->real_data_taken)
+		g_free((gpointer)tvb->real_data);
+
+	composite_free_owned(composite->owned);
+}
+
+/*
+ * Once an owning composite has been made contiguous, real_data holds
+ * all of its data, so there's no need to keep a second copy in the
+ * members.  Pointers into the members that were handed out while
+ * dissecting the current packet may still be in use, so if we're
+ * dissecting one, the members are freed when it's done.
+ */
+static void
+composite_release_members(tvb_comp_t *composite)
+{
+	GSList *owned = composite->owned;
+
+	if (!composite->owner || owned == NULL)
+		return;
 
+	g_free(composite->members);
 	g_free(composite->start_offsets);
 	g_free(composite->end_offsets);
-	g_free((gpointer)tvb->real_data);
+	composite->members	 = NULL;
+	composite->num_members	 = 0;
+	composite->start_offsets = NULL;
+	composite->end_offsets	 = NULL;
+	composite->owned	 = NULL;
+
+	if (wmem_in_packet_scope())
+		wmem_register_callback(wmem_packet_scope(), composite_free_owned_cb, owned);
+	else
+		composite_free_owned(owned);
 }
 
 static guint
@@ -51,37 +116,50 @@ composite_offset(const tvbuff_t *tvb _U_, const guint counter)
 	return counter;
 }
 
+/*
+ * Find the member that holds abs_offset; returns num_members if
+ * abs_offset is at (or past) the end of the composite.
+ */
+static guint
+composite_find_member(const tvb_comp_t *composite, const guint abs_offset)
+{
+	guint lo = 0, hi = composite->num_members;
+
+	/* Find the first member whose end offset is >= abs_offset. */
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (composite->end_offsets[mid] < abs_offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
 static const guint8*
 composite_get_ptr(tvbuff_t *tvb, guint abs_offset, guint abs_length)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
-	tvbuff_t   *member_tvb = NULL;
+	tvbuff_t   *member_tvb;
 	guint	    member_offset;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
 	/* Maybe the range specified by offset/length
 	 * is contiguous inside one of the member tvbuffs */
 	composite = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	i = composite_find_member(composite, abs_offset);
 
 	/* special case */
-	if (!member_tvb) {
+	if (i == composite->num_members) {
 		DISSECTOR_ASSERT(abs_offset == tvb->length && abs_length == 0);
 		return "";
 	}
 
+	member_tvb = composite->members[i];
 	member_offset = abs_offset - composite->start_offsets[i];
 
 	if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
@@ -96,6 +174,7 @@ composite_get_ptr(tvbuff_t *tvb, guint abs_offset, guint abs_length)
 		void *real_data = g_malloc(tvb->length);
 		tvb_memcpy(tvb, real_data, 0, tvb->length);
 		tvb->real_data = (const guint8 *)real_data;
+		composite_release_members(composite);
 		return tvb->real_data + abs_offset;
 	}
 
@@ -108,63 +187,80 @@ composite_memcpy(tvbuff_t *tvb, void* _target, guint abs_offset, guint abs_lengt
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	guint8 *target = (guint8 *) _target;
 
-	guint	    i, num_members;
+	guint	    i;
 	tvb_comp_t *composite;
-	tvbuff_t   *member_tvb = NULL;
+	tvbuff_t   *member_tvb;
 	guint	    member_offset, member_length;
-	GSList	   *slist;
 
 	/* DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops); */
 
-	/* Maybe the range specified by offset/length
-	 * is contiguous inside one of the member tvbuffs */
-	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
-
-	for (i = 0; i < num_members; i++) {
-		if (abs_offset <= composite->end_offsets[i]) {
-			slist = g_slist_nth(composite->tvbs, i);
-			member_tvb = (tvbuff_t *)slist->data;
-			break;
-		}
-	}
+	composite = &composite_tvb->composite;
+	i = composite_find_member(composite, abs_offset);
 
 	/* special case */
-	if (!member_tvb) {
+	if (i == composite->num_members) {
 		DISSECTOR_ASSERT(abs_offset == tvb->length && abs_length == 0);
 		return target;
 	}
 
+	/*
+	 * Copy the part of the range that's in this member, then carry
+	 * on with the following members until we have copied all data.
+	 */
 	member_offset = abs_offset - composite->start_offsets[i];
-
-	if (tvb_bytes_exist(member_tvb, member_offset, abs_length)) {
-		DISSECTOR_ASSERT(!tvb->real_data);
-		return tvb_memcpy(member_tvb, target, member_offset, abs_length);
-	}
-	else {
-		/* The requested data is non-contiguous inside
-		 * the member tvb. We have to memcpy() the part that's in the member tvb,
-		 * then iterate across the other member tvb's, copying their portions
-		 * until we have copied all data.
-		 */
+	while (abs_length > 0) {
+		DISSECTOR_ASSERT(i < composite->num_members);
+		member_tvb = composite->members[i];
 		member_length = tvb_captured_length_remaining(member_tvb, member_offset);
 
-		/* composite_memcpy() can't handle a member_length of zero. */
+		/* Members are never empty; see tvb_composite_append(). */
 		DISSECTOR_ASSERT(member_length > 0);
 
+		if (member_length > abs_length)
+			member_length = abs_length;
 		tvb_memcpy(member_tvb, target, member_offset, member_length);
-		abs_offset	+= member_length;
+		target		+= member_length;
 		abs_length	-= member_length;
+		member_offset	 = 0;
+		i++;
+	}
 
-		/* Recurse */
-		if (abs_length > 0) {
-			composite_memcpy(tvb, target + member_length, abs_offset, abs_length);
-		}
+	return _target;
+}
 
-		return target;
+static gint
+composite_find_guint8(tvbuff_t *tvb, guint abs_offset, guint limit, guint8 needle)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+	tvb_comp_t *composite = &composite_tvb->composite;
+	guint	    i;
+	guint	    member_offset, member_length;
+	gint	    result;
+
+	/*
+	 * Search the members one after the other, rather than making
+	 * the whole composite contiguous just to search it.
+	 */
+	i = composite_find_member(composite, abs_offset);
+	if (i == composite->num_members)
+		return -1;
+
+	member_offset = abs_offset - composite->start_offsets[i];
+	while (limit > 0 && i < composite->num_members) {
+		member_length = tvb_captured_length_remaining(composite->members[i], member_offset);
+		if (member_length > limit)
+			member_length = limit;
+
+		result = tvb_find_guint8(composite->members[i], member_offset, member_length, needle);
+		if (result != -1)
+			return composite->start_offsets[i] + result;
+
+		limit	     -= member_length;
+		member_offset = 0;
+		i++;
 	}
 
-	DISSECTOR_ASSERT_NOT_REACHED();
+	return -1;
 }
 
 static const struct tvb_ops tvb_composite_ops = {
@@ -174,7 +270,7 @@ static const struct tvb_ops tvb_composite_ops = {
 	composite_offset,     /* offset */
 	composite_get_ptr,    /* get_ptr */
 	composite_memcpy,     /* memcpy */
-	NULL,                 /* find_guint8 XXX */
+	composite_find_guint8, /* find_guint8 */
 	NULL,                 /* pbrk_guint8 XXX */
 	NULL,                 /* clone */
 };
@@ -198,13 +294,45 @@ tvb_new_composite(void)
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
 	tvb_comp_t *composite = &composite_tvb->composite;
 
-	composite->tvbs		 = NULL;
+	g_queue_init(&composite->tvbs);
+	composite->members	 = NULL;
+	composite->num_members	 = 0;
 	composite->start_offsets = NULL;
 	composite->end_offsets	 = NULL;
+	composite->owner	 = FALSE;
+	composite->owned	 = NULL;
+	composite->real_data_taken = FALSE;
+
+	return tvb;
+}
+
+/*
+ * Owning composite tvb
+ *
+ * A composite TVB that frees the TVBs handed to it with
+ * tvb_composite_append_owned() when it is itself freed, so its members
+ * need not share a chain.  It is not added to the chain of any member;
+ * whoever creates it frees it with tvb_free().
+ */
+tvbuff_t *
+tvb_new_composite_owner(void)
+{
+	tvbuff_t *tvb = tvb_new_composite();
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+
+	composite_tvb->composite.owner = TRUE;
 
 	return tvb;
 }
 
+gboolean
+tvb_composite_is_owner(const tvbuff_t *tvb)
+{
+	const struct tvb_composite *composite_tvb = (const struct tvb_composite *) tvb;
+
+	return tvb->ops == &tvb_composite_ops && composite_tvb->composite.owner;
+}
+
 void
 tvb_composite_append(tvbuff_t *tvb, tvbuff_t *member)
 {
@@ -219,12 +347,12 @@ tvb_composite_append(tvbuff_t *tvb, tvbuff_t *member)
 	 */
 	DISSECTOR_ASSERT(member->length);
 
-	composite       = &composite_tvb->composite;
-	composite->tvbs = g_slist_append(composite->tvbs, member);
+	composite = &composite_tvb->composite;
+	g_queue_push_tail(&composite->tvbs, member);
 
 	/* Attach the composite TVB to the first TVB only. */
-	if (!composite->tvbs->next) {
-		tvb_add_to_chain((tvbuff_t *)composite->tvbs->data, tvb);
+	if (!composite->owner && composite->tvbs.length == 1) {
+		tvb_add_to_chain((tvbuff_t *)composite->tvbs.head->data, tvb);
 	}
 }
 
@@ -242,24 +370,68 @@ tvb_composite_prepend(tvbuff_t *tvb, tvbuff_t *member)
 	 */
 	DISSECTOR_ASSERT(member->length);
 
-	composite       = &composite_tvb->composite;
-	composite->tvbs = g_slist_prepend(composite->tvbs, member);
+	composite = &composite_tvb->composite;
+	g_queue_push_head(&composite->tvbs, member);
 
 	/* Attach the composite TVB to the first TVB only. */
-	if (!composite->tvbs->next) {
-		tvb_add_to_chain((tvbuff_t *)composite->tvbs->data, tvb);
+	if (!composite->owner && composite->tvbs.length == 1) {
+		tvb_add_to_chain((tvbuff_t *)composite->tvbs.head->data, tvb);
+	}
+}
+
+void
+tvb_composite_append_owned(tvbuff_t *tvb, tvbuff_t *member, tvbuff_t *owned)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+
+	DISSECTOR_ASSERT(tvb && tvb_composite_is_owner(tvb));
+
+	tvb_composite_append(tvb, member);
+	if (owned)
+		composite_tvb->composite.owned = g_slist_prepend(composite_tvb->composite.owned, owned);
+}
+
+void
+tvb_composite_take_members(tvbuff_t *tvb, tvbuff_t *src)
+{
+	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
+	struct tvb_composite *src_composite_tvb = (struct tvb_composite *) src;
+	tvb_comp_t *src_composite;
+	tvbuff_t *member;
+	guint i;
+
+	DISSECTOR_ASSERT(tvb && tvb_composite_is_owner(tvb));
+	DISSECTOR_ASSERT(src && tvb_composite_is_owner(src) && src->initialized);
+
+	src_composite = &src_composite_tvb->composite;
+	if (src_composite->num_members == 0) {
+		/* src has released its members (see composite_release_members());
+		 * take its contiguous copy of them instead. */
+		DISSECTOR_ASSERT(src->real_data && !src_composite->real_data_taken);
+		member = tvb_new_real_data(src->real_data, src->length, src->reported_length);
+		tvb_set_free_cb(member, g_free);
+		tvb_composite_append_owned(tvb, member, member);
+		src_composite->real_data_taken = TRUE;
+		return;
 	}
+	for (i = 0; i < src_composite->num_members; i++)
+		tvb_composite_append(tvb, src_composite->members[i]);
+
+	/* src keeps its member array, so it stays usable until it's freed. */
+	composite_tvb->composite.owned = g_slist_concat(src_composite->owned,
+	    composite_tvb->composite.owned);
+	src_composite->owned = NULL;
 }
 
 void
 tvb_composite_finalize(tvbuff_t *tvb)
 {
 	struct tvb_composite *composite_tvb = (struct tvb_composite *) tvb;
-	GSList	   *slist;
+	GList	   *list;
 	guint	    num_members;
 	tvbuff_t   *member_tvb;
 	tvb_comp_t *composite;
-	int	    i = 0;
+	guint	    i = 0;
 
 	DISSECTOR_ASSERT(tvb && !tvb->initialized);
 	DISSECTOR_ASSERT(tvb->ops == &tvb_composite_ops);
@@ -268,7 +440,7 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	DISSECTOR_ASSERT(tvb->contained_length == 0);
 
 	composite   = &composite_tvb->composite;
-	num_members = g_slist_length(composite->tvbs);
+	num_members = composite->tvbs.length;
 
 	/* Dissectors should not create composite TVBs if they're not going to
 	 * put at least one TVB in them.
@@ -276,12 +448,15 @@ tvb_composite_finalize(tvbuff_t *tvb)
 	 */
 	DISSECTOR_ASSERT(num_members);
 
+	composite->members = g_new(tvbuff_t *, num_members);
+	composite->num_members = num_members;
 	composite->start_offsets = g_new(guint, num_members);
 	composite->end_offsets = g_new(guint, num_members);
 
-	for (slist = composite->tvbs; slist != NULL; slist = slist->next) {
-		DISSECTOR_ASSERT((guint) i < num_members);
-		member_tvb = (tvbuff_t *)slist->data;
+	for (list = composite->tvbs.head; list != NULL; list = list->next) {
+		DISSECTOR_ASSERT(i < num_members);
+		member_tvb = (tvbuff_t *)list->data;
+		composite->members[i] = member_tvb;
 		composite->start_offsets[i] = tvb->length;
 		tvb->length += member_tvb->length;
 		tvb->reported_length += member_tvb->reported_length;
@@ -290,6 +465,9 @@ tvb_composite_finalize(tvbuff_t *tvb)
 		i++;
 	}
 
+	/* The array is all we need from now on. */
+	g_queue_clear(&composite->tvbs);
+
 	tvb->initialized = TRUE;
 	tvb->ds_tvb = tvb;
 }
@@ -50,6 +50,13 @@ wmem_packet_scope(void)
     return packet_scope;
 }
 
+/* Is a packet being dissected? Safe to call before the scopes are set up. */
+gboolean
+wmem_in_packet_scope(void)
+{
+    return packet_scope != NULL && wmem_in_scope(packet_scope);
+}
+
 void
 wmem_enter_packet_scope(void)
 {
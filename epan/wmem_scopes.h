@@ -30,6 +30,10 @@ WS_DLL_PUBLIC
 wmem_allocator_t *
 wmem_packet_scope(void);
 
+WS_DLL_PUBLIC
+gboolean
+wmem_in_packet_scope(void);
+
 WS_DLL_LOCAL
 void
 wmem_enter_packet_scope(void);
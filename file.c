@@ -251,7 +251,8 @@ ws_epan_new(capture_file *cf)
     ws_get_frame_ts,
     cap_file_provider_get_interface_name,
     cap_file_provider_get_interface_description,
-    cap_file_provider_get_modified_block
+    cap_file_provider_get_modified_block,
+    cap_file_provider_get_shift_offset
   };
 
   return epan_new(&cf->provider, &funcs);
@@ -410,6 +411,10 @@ cf_close(capture_file *cf)
     g_tree_destroy(cf->provider.frames_modified_blocks);
     cf->provider.frames_modified_blocks = NULL;
   }
+  if (cf->provider.frames_shift_offsets) {
+    g_tree_destroy(cf->provider.frames_shift_offsets);
+    cf->provider.frames_shift_offsets = NULL;
+  }
   cf_unselect_packet(cf);   /* nothing to select */
   cf->first_displayed = 0;
   cf->last_displayed = 0;
@@ -1171,6 +1176,7 @@ void cf_set_rfcode(capture_file *cf, dfilter_t *rfcode)
 
 static void
 add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
+    const struct packet_provider_data *prov,
     epan_dissect_t *edt, dfilter_t *dfcode, column_info *cinfo,
     wtap_rec *rec, Buffer *buf, gboolean add_to_packet_list)
 {
@@ -1199,7 +1205,7 @@ add_packet_to_packet_list(frame_data *fdata, capture_file *cf,
 
   /* Dissect the frame. */
   epan_dissect_run_with_taps(edt, cf->cd_t, rec,
-                             frame_tvbuff_new_buffer(&cf->provider, fdata, buf),
+                             frame_tvbuff_new_buffer(prov, fdata, buf),
                              fdata, cinfo);
 
   /* If we don't have a display filter, set "passed_dfilter" to 1. */
@@ -1294,7 +1300,7 @@ read_record(capture_file *cf, wtap_rec *rec, Buffer *buf, dfilter_t *dfcode,
     /* When a redissection is in progress (or queued), do not process packets.
      * This will be done once all (new) packets have been scanned. */
     if (!cf->redissecting && cf->redissection_queued == RESCAN_NONE) {
-      add_packet_to_packet_list(fdata, cf, edt, dfcode, cinfo, rec, buf, TRUE);
+      add_packet_to_packet_list(fdata, cf, &cf->provider, edt, dfcode, cinfo, rec, buf, TRUE);
     }
   }
 
@@ -1364,7 +1370,7 @@ merge_callback(merge_event event, int num _U_,
             gint64 file_pos = 0;
             /* Get the sum of the seek positions in all of the files. */
             for (i = 0; i < in_file_count; i++)
-              file_pos += wtap_read_so_far(in_files[i].wth);
+              file_pos += in_files[i].read_so_far;
 
             progbar_val = (gfloat) file_pos / (gfloat) cb_data->f_len;
             if (progbar_val > 1.0f) {
@@ -1574,6 +1580,17 @@ cf_redissect_packets(capture_file *cf)
   }
 }
 
+/*
+ * Random access reads go through the provider, which serializes them,
+ * as a rescan may be reading records ahead in a separate thread.
+ */
+static gboolean
+seek_read_record(capture_file *cf, const frame_data *fdata,
+                 wtap_rec *rec, Buffer *buf, int *err, gchar **err_info)
+{
+  return cap_file_provider_seek_read(&cf->provider, fdata->file_off, rec, buf, err, err_info);
+}
+
 gboolean
 cf_read_record(capture_file *cf, const frame_data *fdata,
                  wtap_rec *rec, Buffer *buf)
@@ -1581,7 +1598,7 @@ cf_read_record(capture_file *cf, const frame_data *fdata,
   int    err;
   gchar *err_info;
 
-  if (!wtap_seek_read(cf->provider.wth, fdata->file_off, rec, buf, &err, &err_info)) {
+  if (!seek_read_record(cf, fdata, rec, buf, &err, &err_info)) {
     cfile_read_failure_alert_box(cf->filename, err, err_info);
     return FALSE;
   }
@@ -1595,7 +1612,7 @@ cf_read_record_no_alert(capture_file *cf, const frame_data *fdata,
   int    err;
   gchar *err_info;
 
-  if (!wtap_seek_read(cf->provider.wth, fdata->file_off, rec, buf, &err, &err_info)) {
+  if (!seek_read_record(cf, fdata, rec, buf, &err, &err_info)) {
     g_free(err_info);
     return FALSE;
   }
@@ -1608,6 +1625,139 @@ cf_read_current_record(capture_file *cf)
   return cf_read_record(cf, cf->current_frame, &cf->rec, &cf->buf);
 }
 
+/*
+ * Rescan read-ahead.
+ *
+ * When rescanning a file that's been read completely, the records are
+ * read (and, for compressed files, decompressed) by a separate thread,
+ * which fills a fixed set of slots in frame number order, while the
+ * main thread dissects, filters and adds them to the packet list in
+ * that order.  The dissection itself stays on the main thread, as
+ * libwireshark isn't thread-safe, and it depends on the state left by
+ * the frames before it anyway.
+ */
+#define RESCAN_READ_AHEAD_RECORDS 256
+
+typedef struct {
+  guint32     framenum;   /* 0 marks the end of the records */
+  gboolean    read_ok;
+  int         err;
+  gchar      *err_info;
+  wtap_rec    rec;
+  Buffer      buf;
+} rescan_slot_t;
+
+typedef struct {
+  capture_file  *cf;
+  guint32        frames_count;
+  GAsyncQueue   *free_slots;    /* slots the reader may fill */
+  GAsyncQueue   *filled_slots;  /* slots waiting to be dissected */
+  gint           stop;          /* set by the main thread to stop reading */
+  rescan_slot_t  slots[RESCAN_READ_AHEAD_RECORDS + 1];
+  GThread       *reader;
+} rescan_read_ahead_t;
+
+static gpointer
+rescan_read_ahead_thread(gpointer data)
+{
+  rescan_read_ahead_t *ra = (rescan_read_ahead_t *)data;
+  rescan_slot_t       *slot;
+  guint32              framenum;
+
+  for (framenum = 1; framenum <= ra->frames_count; framenum++) {
+    slot = (rescan_slot_t *)g_async_queue_pop(ra->free_slots);
+    if (g_atomic_int_get(&ra->stop)) {
+      g_async_queue_push(ra->free_slots, slot);
+      break;
+    }
+    slot->framenum = framenum;
+    slot->err = 0;
+    slot->err_info = NULL;
+    slot->read_ok = seek_read_record(ra->cf,
+                                     frame_data_sequence_find(ra->cf->provider.frames, framenum),
+                                     &slot->rec, &slot->buf, &slot->err,
+                                     &slot->err_info);
+    g_async_queue_push(ra->filled_slots, slot);
+    if (!slot->read_ok)
+      break;
+  }
+
+  /* Tell the main thread that there are no more records. */
+  slot = (rescan_slot_t *)g_async_queue_pop(ra->free_slots);
+  slot->framenum = 0;
+  g_async_queue_push(ra->filled_slots, slot);
+  return NULL;
+}
+
+static rescan_read_ahead_t *
+rescan_read_ahead_start(capture_file *cf, guint32 frames_count)
+{
+  rescan_read_ahead_t *ra = g_new(rescan_read_ahead_t, 1);
+  guint                i;
+
+  ra->cf = cf;
+  ra->frames_count = frames_count;
+  ra->free_slots = g_async_queue_new();
+  ra->filled_slots = g_async_queue_new();
+  ra->stop = 0;
+  /* One more slot than we read ahead, for the end-of-records marker. */
+  for (i = 0; i <= RESCAN_READ_AHEAD_RECORDS; i++) {
+    wtap_rec_init(&ra->slots[i].rec);
+    ws_buffer_init(&ra->slots[i].buf, 1514);
+    g_async_queue_push(ra->free_slots, &ra->slots[i]);
+  }
+  ra->reader = g_thread_new("rescan read-ahead", rescan_read_ahead_thread, ra);
+  return ra;
+}
+
+/*
+ * Get the next record; the reader reads them in frame number order, so
+ * it's the one for the frame after the one we got last.  Returns NULL if
+ * there are no more records.
+ */
+static rescan_slot_t *
+rescan_read_ahead_next(rescan_read_ahead_t *ra)
+{
+  rescan_slot_t *slot = (rescan_slot_t *)g_async_queue_pop(ra->filled_slots);
+
+  if (slot->framenum == 0) {
+    g_async_queue_push(ra->free_slots, slot);
+    return NULL;
+  }
+  return slot;
+}
+
+static void
+rescan_read_ahead_release(rescan_read_ahead_t *ra, rescan_slot_t *slot)
+{
+  wtap_rec_reset(&slot->rec);
+  g_async_queue_push(ra->free_slots, slot);
+}
+
+static void
+rescan_read_ahead_finish(rescan_read_ahead_t *ra)
+{
+  rescan_slot_t *slot;
+  guint          i;
+
+  /* Stop the reader, and throw away whatever it has already read. */
+  g_atomic_int_set(&ra->stop, 1);
+  while ((slot = rescan_read_ahead_next(ra)) != NULL) {
+    if (!slot->read_ok)
+      g_free(slot->err_info);
+    rescan_read_ahead_release(ra, slot);
+  }
+  g_thread_join(ra->reader);
+
+  for (i = 0; i <= RESCAN_READ_AHEAD_RECORDS; i++) {
+    ws_buffer_free(&ra->slots[i].buf);
+    wtap_rec_cleanup(&ra->slots[i].rec);
+  }
+  g_async_queue_unref(ra->free_slots);
+  g_async_queue_unref(ra->filled_slots);
+  g_free(ra);
+}
+
 /* Rescan the list of packets, reconstructing the CList.
 
    "action" describes why we're doing this; it's used in the progress
@@ -1646,6 +1796,10 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
   gboolean    compiled _U_;
   guint32     frames_count;
   gboolean    queued_rescan_type = RESCAN_NONE;
+  rescan_read_ahead_t *ra = NULL;
+  rescan_slot_t *slot;
+  wtap_rec   *recp;
+  Buffer     *bufp;
 
   /* Rescan in progress, clear pending actions. */
   cf->redissection_queued = RESCAN_NONE;
@@ -1786,6 +1940,15 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     wtap_set_cb_new_secrets(cf->provider.wth, secrets_wtap_callback);
   }
 
+  /*
+   * If we've read the whole file, no more frames will show up while
+   * we're rescanning, so read the records ahead in a separate thread.
+   * (If we're still reading a file that's being captured to, the
+   * sequential reads share state with random access ones.)
+   */
+  if (cf->state == FILE_READ_DONE && frames_count != 0)
+    ra = rescan_read_ahead_start(cf, frames_count);
+
   for (framenum = 1; framenum <= frames_count; framenum++) {
     fdata = frame_data_sequence_find(cf->provider.frames, framenum);
 
@@ -1858,8 +2021,26 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
     /* Frame dependencies from the previous dissection/filtering are no longer valid. */
     fdata->dependent_of_displayed = 0;
 
-    if (!cf_read_record(cf, fdata, &rec, &buf))
-      break; /* error reading the frame */
+    if (ra != NULL) {
+      slot = rescan_read_ahead_next(ra);
+      if (slot == NULL)
+        break;
+      ws_assert(slot->framenum == framenum);
+      if (!slot->read_ok) {
+        /* error reading the frame */
+        cfile_read_failure_alert_box(cf->filename, slot->err, slot->err_info);
+        rescan_read_ahead_release(ra, slot);
+        break;
+      }
+      recp = &slot->rec;
+      bufp = &slot->buf;
+    } else {
+      slot = NULL;
+      if (!cf_read_record(cf, fdata, &rec, &buf))
+        break; /* error reading the frame */
+      recp = &rec;
+      bufp = &buf;
+    }
 
     /* If the previous frame is displayed, and we haven't yet seen the
        selected frame, remember that frame - it's the closest one we've
@@ -1869,8 +2050,8 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
       preceding_frame = prev_frame;
     }
 
-    add_packet_to_packet_list(fdata, cf, &edt, dfcode,
-                                    cinfo, &rec, &buf,
+    add_packet_to_packet_list(fdata, cf, &cf->provider, &edt, dfcode,
+                                    cinfo, recp, bufp,
                                     add_to_packet_list);
 
     /* If this frame is displayed, and this is the first frame we've
@@ -1891,9 +2072,14 @@ rescan_packets(capture_file *cf, const char *action, const char *action_item, gb
        on the next pass through the loop. */
     prev_frame_num = fdata->num;
     prev_frame = fdata;
-    wtap_rec_reset(&rec);
+    if (slot != NULL)
+      rescan_read_ahead_release(ra, slot);
+    else
+      wtap_rec_reset(&rec);
   }
 
+  if (ra != NULL)
+    rescan_read_ahead_finish(ra);
   epan_dissect_cleanup(&edt);
   wtap_rec_cleanup(&rec);
   ws_buffer_free(&buf);
@@ -4016,8 +4202,15 @@ cf_get_packet_block(capture_file *cf, const frame_data *fd)
     if (!cf_read_record(cf, fd, &rec, &buf))
       { /* XXX, what we can do here? */ }
 
-    /* rec.block is owned by the record, steal it before it is gone. */
-    block = wtap_block_ref(rec.block);
+    /*
+     * rec.block is owned by the record, steal it before it is gone.
+     * Some readers, e.g. pcapng for packets without options, don't
+     * supply a block; give the caller an empty one to modify.
+     */
+    if (rec.block != NULL)
+      block = wtap_block_ref(rec.block);
+    else
+      block = wtap_block_create(WTAP_BLOCK_PACKET);
 
     wtap_rec_cleanup(&rec);
     ws_buffer_free(&buf);
@@ -91,3 +91,58 @@ cap_file_provider_set_modified_block(struct packet_provider_data *prov, frame_da
 
   fd->has_modified_block = TRUE;
 }
+
+const nstime_t *
+cap_file_provider_get_shift_offset(struct packet_provider_data *prov, const frame_data *fd)
+{
+  if (fd->has_shift_offset && prov->frames_shift_offsets)
+    return (const nstime_t *)g_tree_lookup(prov->frames_shift_offsets, fd);
+
+  return NULL;
+}
+
+/*
+ * Held around random access reads, as a rescan reads records ahead in
+ * a separate thread while the main thread may be reading records for,
+ * e.g., the packet details, or the data of a frame tvbuff; they all
+ * share the file's random access handle.
+ */
+static GMutex seek_read_mutex;
+
+gboolean
+cap_file_provider_seek_read(const struct packet_provider_data *prov, gint64 seek_off,
+                            wtap_rec *rec, Buffer *buf, int *err, gchar **err_info)
+{
+  gboolean ret;
+
+  g_mutex_lock(&seek_read_mutex);
+  ret = wtap_seek_read(prov->wth, seek_off, rec, buf, err, err_info);
+  g_mutex_unlock(&seek_read_mutex);
+  return ret;
+}
+
+/*
+ * Time shifts are rare, so rather than have an nstime_t in every
+ * frame_data, keep the nonzero ones here.
+ */
+void
+cap_file_provider_set_shift_offset(struct packet_provider_data *prov, frame_data *fd, const nstime_t *offset)
+{
+  nstime_t *new_offset;
+
+  if (offset->secs == 0 && offset->nsecs == 0) {
+    if (fd->has_shift_offset)
+      g_tree_remove(prov->frames_shift_offsets, fd);
+    fd->has_shift_offset = FALSE;
+    return;
+  }
+
+  if (!prov->frames_shift_offsets)
+    prov->frames_shift_offsets = g_tree_new_full(frame_cmp, NULL, NULL, g_free);
+
+  new_offset = g_new(nstime_t, 1);
+  *new_offset = *offset;
+  g_tree_replace(prov->frames_shift_offsets, fd, new_offset);
+
+  fd->has_shift_offset = TRUE;
+}
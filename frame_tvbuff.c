@@ -41,7 +41,7 @@ frame_read(struct tvb_frame *frame_tvb, wtap_rec *rec, Buffer *buf)
 	/* XXX, what if phdr->caplen isn't equal to
 	 * frame_tvb->tvb.length + frame_tvb->offset?
 	 */
-	if (!wtap_seek_read(frame_tvb->prov->wth, frame_tvb->file_off, rec, buf, &err, &err_info)) {
+	if (!cap_file_provider_seek_read(frame_tvb->prov, frame_tvb->file_off, rec, buf, &err, &err_info)) {
 		/* XXX - report error! */
 		switch (err) {
 			case WTAP_ERR_BAD_FILE:
@@ -19,6 +19,7 @@
 
 #include <wiretap/wtap.h>
 
+#include <ui/clopts_common.h>
 #include <ui/cmdarg_err.h>
 #include <ui/exit_codes.h>
 #include <wsutil/filesystem.h>
@@ -49,6 +50,10 @@ print_usage(FILE *output)
     fprintf(output, "\n");
     fprintf(output, "Options:\n");
     fprintf(output, "  -n        don't write to output file if the input file is ordered.\n");
+    fprintf(output, "  -m <max frames>\n");
+    fprintf(output, "            keep at most <max frames> frames in memory, and read and\n");
+    fprintf(output, "            write the files sequentially; frames that are further out\n");
+    fprintf(output, "            of order are sorted using temporary files.\n");
     fprintf(output, "  -h        display this help and exit.\n");
     fprintf(output, "  -v        print version information and exit.\n");
 }
@@ -131,6 +136,534 @@ frames_compare(gconstpointer a, gconstpointer b)
     return nstime_cmp(time1, time2);
 }
 
+/**************************************************/
+/* Streaming reorder (-m)                         */
+
+/*
+ * Frames are passed through a min-heap of at most max_frames frames,
+ * ordered by timestamp, which puts frames that are only slightly out of
+ * order back in order.  A frame that is older than one that has already
+ * been written can't be put in order that way, so it starts a new run,
+ * and the heap keeps it (and any others for the new run) until the
+ * current run is done ("replacement selection").  Runs are usually much
+ * longer than max_frames.
+ *
+ * A first pass over the file works out how many runs there are, using
+ * only the timestamps.  If there's just one, the second pass writes the
+ * frames straight to the output file; otherwise, it writes each run to a
+ * temporary file, and the runs are merged into the output file.  Only
+ * max_frames frames are held in memory, and all reading and writing is
+ * sequential.
+ */
+
+/* Maximum number of runs to merge at once. */
+#define MAX_MERGE_RUNS 64
+
+typedef struct {
+    guint        run;
+    nstime_t     frame_time;
+    guint        num;
+} ReorderKey_t;
+
+typedef struct {
+    ReorderKey_t *keys;         /* key of the frame in each slot */
+    wtap_rec     *recs;         /* frame in each slot, or NULL in the first pass */
+    Buffer       *bufs;
+    guint        *heap;         /* slots in the heap, as a min-heap on their keys */
+    guint         count;        /* number of slots in the heap */
+    guint         max_frames;   /* number of slots */
+    guint         cur_run;      /* run of the last frame taken from the heap */
+    gboolean      have_last;    /* a frame has been taken from the heap */
+    nstime_t      last_time;    /* time of the last frame taken from the heap */
+} ReorderWindow_t;
+
+static gboolean
+reorder_key_before(const ReorderKey_t *key1, const ReorderKey_t *key2)
+{
+    int cmp;
+
+    if (key1->run != key2->run)
+        return key1->run < key2->run;
+    cmp = nstime_cmp(&key1->frame_time, &key2->frame_time);
+    if (cmp != 0)
+        return cmp < 0;
+    /* Keep frames with the same timestamp in their original order. */
+    return key1->num < key2->num;
+}
+
+/*
+ * When merging runs, frames are ordered by timestamp, and frames with the
+ * same timestamp by run, as frames in a later run came later in the file.
+ */
+static gboolean
+reorder_merge_key_before(const ReorderKey_t *key1, const ReorderKey_t *key2)
+{
+    int cmp;
+
+    cmp = nstime_cmp(&key1->frame_time, &key2->frame_time);
+    if (cmp != 0)
+        return cmp < 0;
+    if (key1->run != key2->run)
+        return key1->run < key2->run;
+    return key1->num < key2->num;
+}
+
+static void
+reorder_window_init(ReorderWindow_t *win, guint max_frames, gboolean with_frames)
+{
+    guint i;
+
+    win->keys = g_new(ReorderKey_t, max_frames);
+    win->heap = g_new(guint, max_frames);
+    if (with_frames) {
+        win->recs = g_new(wtap_rec, max_frames);
+        win->bufs = g_new(Buffer, max_frames);
+        for (i = 0; i < max_frames; i++) {
+            wtap_rec_init(&win->recs[i]);
+            ws_buffer_init(&win->bufs[i], 1514);
+        }
+    } else {
+        win->recs = NULL;
+        win->bufs = NULL;
+    }
+    win->count = 0;
+    win->max_frames = max_frames;
+    win->cur_run = 0;
+    win->have_last = FALSE;
+    nstime_set_unset(&win->last_time);
+}
+
+static void
+reorder_window_cleanup(ReorderWindow_t *win)
+{
+    guint i;
+
+    if (win->recs != NULL) {
+        for (i = 0; i < win->max_frames; i++) {
+            wtap_rec_cleanup(&win->recs[i]);
+            ws_buffer_free(&win->bufs[i]);
+        }
+        g_free(win->recs);
+        g_free(win->bufs);
+    }
+    g_free(win->keys);
+    g_free(win->heap);
+}
+
+/* Add the frame in a slot, whose key has been filled in, to the heap. */
+static void
+reorder_window_push(ReorderWindow_t *win, guint slot)
+{
+    guint i = win->count++;
+
+    /* Frames older than the last one we've taken go in the next run. */
+    if (win->have_last &&
+        nstime_cmp(&win->keys[slot].frame_time, &win->last_time) < 0)
+        win->keys[slot].run = win->cur_run + 1;
+    else
+        win->keys[slot].run = win->cur_run;
+
+    while (i > 0) {
+        guint parent = (i - 1) / 2;
+
+        if (!reorder_key_before(&win->keys[slot], &win->keys[win->heap[parent]]))
+            break;
+        win->heap[i] = win->heap[parent];
+        i = parent;
+    }
+    win->heap[i] = slot;
+}
+
+/*
+ * Take the first frame from the heap, and return its slot; the frame
+ * stays in the slot until the slot is reused.  Sets *new_run if the
+ * frame is the first one of a run other than the first run.
+ */
+static guint
+reorder_window_pop(ReorderWindow_t *win, gboolean *new_run)
+{
+    guint top = win->heap[0];
+    guint slot = win->heap[--win->count];
+    guint i = 0;
+
+    for (;;) {
+        guint child = 2 * i + 1;
+
+        if (child >= win->count)
+            break;
+        if (child + 1 < win->count &&
+            reorder_key_before(&win->keys[win->heap[child + 1]], &win->keys[win->heap[child]]))
+            child++;
+        if (!reorder_key_before(&win->keys[win->heap[child]], &win->keys[slot]))
+            break;
+        win->heap[i] = win->heap[child];
+        i = child;
+    }
+    if (win->count > 0)
+        win->heap[i] = slot;
+
+    *new_run = win->have_last && win->keys[top].run != win->cur_run;
+    win->cur_run = win->keys[top].run;
+    win->last_time = win->keys[top].frame_time;
+    win->have_last = TRUE;
+    return top;
+}
+
+/*
+ * Get a free slot for the next frame; if all slots are in use, the first
+ * frame in the heap is taken from it, and *popped is set to TRUE.
+ */
+static guint
+reorder_window_free_slot(ReorderWindow_t *win, guint frames_seen,
+                         gboolean *popped, gboolean *new_run)
+{
+    if (frames_seen < win->max_frames) {
+        *popped = FALSE;
+        *new_run = FALSE;
+        return frames_seen;
+    }
+    *popped = TRUE;
+    return reorder_window_pop(win, new_run);
+}
+
+static void
+reorder_set_key_time(ReorderKey_t *key, const wtap_rec *rec, guint num)
+{
+    key->num = num;
+    if (rec->presence_flags & WTAP_HAS_TS) {
+        key->frame_time = rec->ts;
+    } else {
+        nstime_set_unset(&key->frame_time);
+    }
+}
+
+/*
+ * First pass: count the frames, the frames that are out of order, and
+ * the runs that the second pass will produce.
+ */
+static guint
+reorder_count_runs(const char *infile, guint max_frames,
+                   guint *frame_count, guint *wrong_order_count)
+{
+    ReorderWindow_t win;
+    wtap *wth;
+    wtap_rec rec;
+    Buffer buf;
+    int err;
+    gchar *err_info;
+    gint64 data_offset;
+    guint num = 0;
+    guint runs = 0;
+    guint slot;
+    gboolean popped, new_run;
+    nstime_t prev_time;
+
+    wth = wtap_open_offline(infile, WTAP_TYPE_AUTO, &err, &err_info, FALSE);
+    if (wth == NULL) {
+        cfile_open_failure_message(infile, err, err_info);
+        exit(OPEN_ERROR);
+    }
+
+    nstime_set_unset(&prev_time);
+    reorder_window_init(&win, max_frames, FALSE);
+    wtap_rec_init(&rec);
+    ws_buffer_init(&buf, 1514);
+    *wrong_order_count = 0;
+    while (wtap_read(wth, &rec, &buf, &err, &err_info, &data_offset)) {
+        slot = reorder_window_free_slot(&win, num, &popped, &new_run);
+        if (popped && (runs == 0 || new_run))
+            runs++;
+        num++;
+        reorder_set_key_time(&win.keys[slot], &rec, num);
+        if (num > 1 && nstime_cmp(&win.keys[slot].frame_time, &prev_time) < 0)
+            (*wrong_order_count)++;
+        prev_time = win.keys[slot].frame_time;
+        reorder_window_push(&win, slot);
+        wtap_rec_reset(&rec);
+    }
+    if (err != 0) {
+      /* Print a message noting that the read failed somewhere along the line. */
+      cfile_read_failure_message(infile, err, err_info);
+    }
+    while (win.count > 0) {
+        reorder_window_pop(&win, &new_run);
+        if (runs == 0 || new_run)
+            runs++;
+    }
+    wtap_rec_cleanup(&rec);
+    ws_buffer_free(&buf);
+    reorder_window_cleanup(&win);
+    wtap_close(wth);
+
+    *frame_count = num;
+    return runs;
+}
+
+/*
+ * Open a temporary file for a run, in the same format, and with the same
+ * interfaces, as the input file.
+ */
+static wtap_dumper *
+reorder_open_run(wtap *wth, const wtap_dump_params *params, GPtrArray *run_names)
+{
+    wtap_dumper *run_pdh;
+    char *run_name = NULL;
+    int err;
+    gchar *err_info;
+
+    run_pdh = wtap_dump_open_tempfile(&run_name, "reordercap",
+                                      wtap_file_type_subtype(wth),
+                                      WTAP_UNCOMPRESSED, params, &err, &err_info);
+    if (run_pdh == NULL) {
+        cfile_dump_open_failure_message(run_name ? run_name : "temporary file",
+                                        err, err_info, wtap_file_type_subtype(wth));
+        exit(OUTPUT_FILE_ERROR);
+    }
+    g_ptr_array_add(run_names, run_name);
+    return run_pdh;
+}
+
+static void
+reorder_close_run(wtap_dumper *run_pdh, const char *run_name)
+{
+    int err;
+    gchar *err_info;
+
+    if (!wtap_dump_close(run_pdh, &err, &err_info)) {
+        cfile_close_failure_message(run_name, err, err_info);
+        exit(OUTPUT_FILE_ERROR);
+    }
+}
+
+typedef struct {
+    wtap        *wth;
+    wtap_rec     rec;
+    Buffer       buf;
+    ReorderKey_t key;    /* run is the index of the run */
+} ReorderRun_t;
+
+static gboolean
+reorder_run_read(ReorderRun_t *run, const char *run_name)
+{
+    int err;
+    gchar *err_info;
+    gint64 data_offset;
+
+    wtap_rec_reset(&run->rec);
+    if (wtap_read(run->wth, &run->rec, &run->buf, &err, &err_info, &data_offset)) {
+        reorder_set_key_time(&run->key, &run->rec, run->key.num + 1);
+        return TRUE;
+    }
+    if (err != 0) {
+        cfile_read_failure_message(run_name, err, err_info);
+        exit(1);
+    }
+    return FALSE;
+}
+
+/*
+ * Merge the runs with the given names to pdh; each run is in timestamp
+ * order, and a frame in an earlier run goes before a frame with the same
+ * timestamp in a later run.
+ */
+static void
+reorder_merge_runs(char **run_names, guint run_count, wtap_dumper *pdh,
+                   const char *infile, const char *outfile)
+{
+    ReorderRun_t *runs = g_new(ReorderRun_t, run_count);
+    guint *heap = g_new(guint, run_count);
+    guint count = 0;
+    guint num = 0;
+    guint i, run, parent, child, last;
+    int err;
+    gchar *err_info;
+
+    for (run = 0; run < run_count; run++) {
+        runs[run].wth = wtap_open_offline(run_names[run], WTAP_TYPE_AUTO,
+                                          &err, &err_info, FALSE);
+        if (runs[run].wth == NULL) {
+            cfile_open_failure_message(run_names[run], err, err_info);
+            exit(OPEN_ERROR);
+        }
+        wtap_rec_init(&runs[run].rec);
+        ws_buffer_init(&runs[run].buf, 1514);
+        runs[run].key.run = run;
+        runs[run].key.num = 0;
+        if (!reorder_run_read(&runs[run], run_names[run]))
+            continue;
+
+        /* Add it to the heap. */
+        for (i = count++; i > 0; i = parent) {
+            parent = (i - 1) / 2;
+            if (!reorder_merge_key_before(&runs[run].key, &runs[heap[parent]].key))
+                break;
+            heap[i] = heap[parent];
+        }
+        heap[i] = run;
+    }
+
+    while (count > 0) {
+        run = heap[0];
+        num++;
+        if (!wtap_dump(pdh, &runs[run].rec, ws_buffer_start_ptr(&runs[run].buf),
+                       &err, &err_info)) {
+            cfile_write_failure_message(infile, outfile, err, err_info, num,
+                                        wtap_file_type_subtype(runs[run].wth));
+            exit(1);
+        }
+
+        /* Replace it with the run's next frame, or drop the run. */
+        if (reorder_run_read(&runs[run], run_names[run])) {
+            last = run;
+        } else {
+            last = heap[--count];
+        }
+        for (i = 0; count > 0; i = child) {
+            child = 2 * i + 1;
+            if (child >= count)
+                break;
+            if (child + 1 < count &&
+                reorder_merge_key_before(&runs[heap[child + 1]].key, &runs[heap[child]].key))
+                child++;
+            if (!reorder_merge_key_before(&runs[heap[child]].key, &runs[last].key))
+                break;
+            heap[i] = heap[child];
+        }
+        if (count > 0)
+            heap[i] = last;
+    }
+
+    for (run = 0; run < run_count; run++) {
+        wtap_rec_cleanup(&runs[run].rec);
+        ws_buffer_free(&runs[run].buf);
+        wtap_close(runs[run].wth);
+    }
+    g_free(heap);
+    g_free(runs);
+}
+
+typedef struct {
+    wtap                *wth;
+    wtap_dumper         *pdh;         /* output file, or current run's file */
+    wtap_dump_params     run_params;
+    GPtrArray           *run_names;   /* names of the runs' files, or NULL if there's one run */
+    const char          *infile;
+    const char          *outfile;
+} ReorderOutput_t;
+
+/* Write the frame taken from the heap to the output file or its run. */
+static void
+reorder_write_frame(ReorderOutput_t *out, ReorderWindow_t *win, guint slot,
+                    gboolean new_run)
+{
+    int err;
+    gchar *err_info;
+
+    if (new_run && out->run_names != NULL) {
+        reorder_close_run(out->pdh, (const char *)g_ptr_array_index(out->run_names,
+                                                                    out->run_names->len - 1));
+        out->pdh = reorder_open_run(out->wth, &out->run_params, out->run_names);
+    }
+    if (!wtap_dump(out->pdh, &win->recs[slot], ws_buffer_start_ptr(&win->bufs[slot]),
+                   &err, &err_info)) {
+        cfile_write_failure_message(out->infile, out->outfile, err, err_info,
+                                    win->keys[slot].num,
+                                    wtap_file_type_subtype(out->wth));
+        exit(1);
+    }
+    wtap_rec_reset(&win->recs[slot]);
+}
+
+/*
+ * Second pass: read the frames from wth, and write them, in order, to
+ * pdh, via temporary files if there's more than one run.
+ */
+static void
+reorder_stream(wtap *wth, wtap_dumper *pdh, guint max_frames, guint run_count,
+               const char *infile, const char *outfile)
+{
+    ReorderWindow_t win;
+    ReorderOutput_t out;
+    GPtrArray *run_names;
+    int err;
+    gchar *err_info;
+    gint64 data_offset;
+    guint num = 0;
+    guint slot, i;
+    gboolean popped, new_run;
+
+    out.wth = wth;
+    out.pdh = pdh;
+    out.run_names = NULL;
+    out.infile = infile;
+    out.outfile = outfile;
+    if (run_count > 1) {
+        out.run_names = g_ptr_array_new_with_free_func(g_free);
+        wtap_dump_params_init(&out.run_params, wth);
+        out.pdh = reorder_open_run(wth, &out.run_params, out.run_names);
+    }
+
+    reorder_window_init(&win, max_frames, TRUE);
+    for (;;) {
+        /* Get a slot, writing out the first frame in the heap if need be. */
+        slot = reorder_window_free_slot(&win, num, &popped, &new_run);
+        if (popped)
+            reorder_write_frame(&out, &win, slot, new_run);
+
+        if (!wtap_read(wth, &win.recs[slot], &win.bufs[slot], &err, &err_info,
+                       &data_offset)) {
+            if (err != 0) {
+                /* Print a message noting that the read failed somewhere along the line. */
+                cfile_read_failure_message(infile, err, err_info);
+            }
+            break;
+        }
+        num++;
+        reorder_set_key_time(&win.keys[slot], &win.recs[slot], num);
+        reorder_window_push(&win, slot);
+    }
+
+    /* Write out what's left in the heap. */
+    while (win.count > 0) {
+        slot = reorder_window_pop(&win, &new_run);
+        reorder_write_frame(&out, &win, slot, new_run);
+    }
+    reorder_window_cleanup(&win);
+
+    if (out.run_names == NULL)
+        return;
+
+    run_names = out.run_names;
+    reorder_close_run(out.pdh, (const char *)g_ptr_array_index(run_names, run_names->len - 1));
+
+    /* Merge the runs, MAX_MERGE_RUNS at a time, until few enough are left. */
+    while (run_names->len > MAX_MERGE_RUNS) {
+        GPtrArray *merged_names = g_ptr_array_new_with_free_func(g_free);
+
+        for (i = 0; i < run_names->len; i += MAX_MERGE_RUNS) {
+            guint group = MIN(MAX_MERGE_RUNS, run_names->len - i);
+
+            out.pdh = reorder_open_run(wth, &out.run_params, merged_names);
+            reorder_merge_runs((char **)&run_names->pdata[i], group, out.pdh,
+                               infile, outfile);
+            reorder_close_run(out.pdh, (const char *)g_ptr_array_index(merged_names, merged_names->len - 1));
+        }
+        for (i = 0; i < run_names->len; i++)
+            ws_unlink((const char *)g_ptr_array_index(run_names, i));
+        g_ptr_array_free(run_names, TRUE);
+        run_names = merged_names;
+    }
+    reorder_merge_runs((char **)run_names->pdata, run_names->len, pdh,
+                       infile, outfile);
+
+    for (i = 0; i < run_names->len; i++)
+        ws_unlink((const char *)g_ptr_array_index(run_names, i));
+    g_ptr_array_free(run_names, TRUE);
+    g_free(out.run_params.idb_inf);
+    out.run_params.idb_inf = NULL;
+    wtap_dump_params_cleanup(&out.run_params);
+}
+
 /*
  * General errors and warnings are reported with an console message
  * in reordercap.
@@ -181,6 +714,8 @@ main(int argc, char *argv[])
     gint64 data_offset;
     guint wrong_order_count = 0;
     gboolean write_output_regardless = TRUE;
+    guint max_frames = 0;
+    guint frame_count, run_count;
     guint i;
     wtap_dump_params params;
     int                          ret = EXIT_SUCCESS;
@@ -231,8 +766,11 @@ main(int argc, char *argv[])
     wtap_init(TRUE);
 
     /* Process the options first */
-    while ((opt = ws_getopt_long(argc, argv, "hnv", long_options, NULL)) != -1) {
+    while ((opt = ws_getopt_long(argc, argv, "hm:nv", long_options, NULL)) != -1) {
         switch (opt) {
+            case 'm':
+                max_frames = get_nonzero_guint32(ws_optarg, "maximum number of frames in memory");
+                break;
             case 'n':
                 write_output_regardless = FALSE;
                 break;
@@ -294,6 +832,19 @@ main(int argc, char *argv[])
         goto clean_exit;
     }
 
+    if (max_frames != 0) {
+        /* Sort with bounded memory, reading and writing sequentially. */
+        run_count = reorder_count_runs(infile, max_frames, &frame_count,
+                                       &wrong_order_count);
+        printf("%u frames, %u out of order\n", frame_count, wrong_order_count);
+        if (write_output_regardless || (wrong_order_count > 0)) {
+            reorder_stream(wth, pdh, max_frames, run_count, infile, outfile);
+        } else {
+            printf("Not writing output file because input file is already in order.\n");
+        }
+        goto close_outfile;
+    }
+
     /* Allocate the array of frame pointers. */
     frames = g_ptr_array_new();
 
@@ -356,6 +907,7 @@ main(int argc, char *argv[])
     /* Free the whole array */
     g_ptr_array_free(frames, TRUE);
 
+close_outfile:
     /* Close outfile */
     if (!wtap_dump_close(pdh, &err, &err_info)) {
         cfile_close_failure_message(outfile, err, err_info);
@@ -49,6 +49,8 @@
 
 #ifdef _WIN32
 #include <wsutil/win32-utils.h>
+#else
+#include <sys/select.h>
 #endif
 
 #include "ringbuffer.h"
@@ -58,12 +60,64 @@
 #include <zlib.h>
 #endif
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#if LZ4_VERSION_NUMBER >= 10703
+#define USE_LZ4
+#include <lz4frame.h>
+#endif
+#endif
+
 /* Ringbuffer file structure */
 typedef struct _rb_file {
   gchar         *name;
 } rb_file;
 
-#define MAX_FILENAME_QUEUE  100
+/* How the ringbuffer files are compressed */
+typedef enum {
+  RB_COMPRESS_NONE,
+  RB_COMPRESS_GZIP,
+  RB_COMPRESS_ZSTD,
+  RB_COMPRESS_LZ4
+} rb_compress_type;
+
+/* File name extensions, indexed by rb_compress_type */
+static const char *compress_extensions[] = { "", ".gz", ".zst", ".lz4" };
+
+#define RB_COMPRESS_BUF_SIZE          65536
+#define RB_COMPRESS_MAX_PENDING       2         /* files being compressed at once */
+#define RB_COMPRESS_MAX_ZSTD_WORKERS  4         /* zstd threads per file */
+#define RB_COMPRESS_MIN_ZSTD_JOB_SIZE (512 * 1024) /* zstd's smallest job */
+#define RB_COMPRESS_ZSTD_LEVEL        3         /* zstd's default */
+#define RB_COMPRESS_FLUSH_INTERVAL    G_USEC_PER_SEC
+#define RB_COMPRESS_FRAME_SIZE        (4 * 1024 * 1024) /* uncompressed bytes per zstd or lz4 frame */
+#ifdef _WIN32
+#define RB_COMPRESS_POLL_INTERVAL     (10 * 1000)  /* usecs between checks of the pipe */
+#endif
+
+/* State of the compression of one ringbuffer file */
+typedef struct _rb_compressor {
+  rb_compress_type type;
+  int           in_fd;               /**< read end of the pipe the capture is written to */
+  int           out_fd;              /**< the ringbuffer file */
+  guint8       *out_buf;             /**< compressed data to be written to out_fd */
+  size_t        out_size;
+  size_t        frame_len;           /**< uncompressed bytes in the current zstd or lz4 frame */
+#ifdef HAVE_ZLIB
+  gzFile        gz;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_CStream *zcs;
+#endif
+#ifdef USE_LZ4
+  LZ4F_cctx    *lz4_cctx;
+  LZ4F_preferences_t lz4_prefs;
+#endif
+} rb_compressor;
 
 /** Ringbuffer data structure */
 typedef struct _ringbuf_data {
@@ -80,125 +134,543 @@ typedef struct _ringbuf_data {
   char         *io_buffer;              /**< The IO buffer used to write to the file */
   gboolean      group_read_access;   /**< TRUE if files need to be opened with group read access */
   FILE         *name_h;              /**< write names of completed files to this handle */
-  gchar        *compress_type;       /**< compress type */
+  rb_compress_type compress;         /**< how to compress the files */
 
-  GMutex        mutex;               /**< mutex for oldnames */
-  gchar        *oldnames[MAX_FILENAME_QUEUE];       /**< filename list of pending to be deleted */
+  GMutex        mutex;               /**< mutex for the fields below */
+  GCond         compress_cond;       /**< signalled when a file has been compressed */
+  guint         compress_pending;    /**< number of files being compressed */
+  int           compress_err;        /**< first error compressing a file, or 0 */
 } ringbuf_data;
 
 static ringbuf_data rb_data;
 
 /*
- * delete pending uncompressed pcap files.
+ * Write all of a buffer to a file descriptor.
+ * Returns 0 on success, an errno value on failure.
  */
-static void CleanupOldCap(gchar* name)
+static int
+ringbuf_write_all(int fd, const guint8 *buf, size_t len)
 {
-  ws_statb64 statb;
-  size_t i;
+  ssize_t nwritten;
+
+  while (len != 0) {
+    nwritten = ws_write(fd, buf, (unsigned int)MIN(len, RB_COMPRESS_BUF_SIZE));
+    if (nwritten < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    buf += nwritten;
+    len -= (size_t)nwritten;
+  }
+  return 0;
+}
 
-  g_mutex_lock(&rb_data.mutex);
+/*
+ * Set up to compress a file.
+ * Returns 0 on success, an errno value on failure.
+ */
+static int
+ringbuf_compress_begin(rb_compressor *comp)
+{
+  switch (comp->type) {
 
-  /* Delete pending delete file */
-  for (i = 0; i < sizeof(rb_data.oldnames) / sizeof(rb_data.oldnames[0]); i++) {
-    if (rb_data.oldnames[i] != NULL) {
-      ws_unlink(rb_data.oldnames[i]);
-      if (ws_stat64(rb_data.oldnames[i], &statb) != 0) {
-        g_free(rb_data.oldnames[i]);
-        rb_data.oldnames[i] = NULL;
-      }
+#ifdef HAVE_ZLIB
+  case RB_COMPRESS_GZIP:
+    /* gzclose() closes out_fd */
+    comp->gz = gzdopen(comp->out_fd, "wb");
+    if (comp->gz == NULL)
+      return errno != 0 ? errno : ENOMEM;
+    comp->out_fd = -1;
+    return 0;
+#endif
+
+#ifdef HAVE_ZSTD
+  case RB_COMPRESS_ZSTD:
+  {
+#if ZSTD_VERSION_NUMBER >= 10400
+    int workers = (int)MIN(g_get_num_processors(), RB_COMPRESS_MAX_ZSTD_WORKERS);
+#endif
+
+    comp->zcs = ZSTD_createCStream();
+    if (comp->zcs == NULL)
+      return ENOMEM;
+    if (ZSTD_isError(ZSTD_initCStream(comp->zcs, RB_COMPRESS_ZSTD_LEVEL)))
+      return EINVAL;
+#if ZSTD_VERSION_NUMBER >= 10400
+    /*
+     * Have zstd compress in worker threads of its own as well, if it
+     * was built with multithreading support; if not, this fails, and
+     * we compress in this thread.
+     *
+     * zstd gives each worker a job of several times the window size,
+     * more than a whole frame at our level, so split each frame into a
+     * job per worker, or the workers would take turns.
+     */
+    if (!ZSTD_isError(ZSTD_CCtx_setParameter(comp->zcs, ZSTD_c_nbWorkers, workers)))
+      ZSTD_CCtx_setParameter(comp->zcs, ZSTD_c_jobSize,
+                             MAX(RB_COMPRESS_FRAME_SIZE / workers, RB_COMPRESS_MIN_ZSTD_JOB_SIZE));
+#endif
+    comp->out_size = ZSTD_CStreamOutSize();
+    comp->out_buf = (guint8 *)g_malloc(comp->out_size);
+    return 0;
+  }
+#endif
+
+#ifdef USE_LZ4
+  case RB_COMPRESS_LZ4:
+  {
+    size_t ret;
+
+    if (LZ4F_isError(LZ4F_createCompressionContext(&comp->lz4_cctx, LZ4F_VERSION)))
+      return ENOMEM;
+    memset(&comp->lz4_prefs, 0, sizeof comp->lz4_prefs);
+    comp->out_size = LZ4F_compressBound(RB_COMPRESS_BUF_SIZE, &comp->lz4_prefs);
+    comp->out_buf = (guint8 *)g_malloc(comp->out_size);
+    ret = LZ4F_compressBegin(comp->lz4_cctx, comp->out_buf, comp->out_size, &comp->lz4_prefs);
+    if (LZ4F_isError(ret))
+      return EINVAL;
+    return ringbuf_write_all(comp->out_fd, comp->out_buf, ret);
+  }
+#endif
+
+  default:
+    return EINVAL;
+  }
+}
+
+/*
+ * Finish the current zstd or lz4 frame.
+ * Returns 0 on success, an errno value on failure.
+ */
+static int
+ringbuf_compress_end_frame(rb_compressor *comp)
+{
+  switch (comp->type) {
+
+#ifdef HAVE_ZSTD
+  case RB_COMPRESS_ZSTD:
+  {
+    ZSTD_outBuffer output;
+    size_t ret;
+    int err;
+
+    do {
+      output.dst = comp->out_buf;
+      output.size = comp->out_size;
+      output.pos = 0;
+      ret = ZSTD_endStream(comp->zcs, &output);
+      if (ZSTD_isError(ret))
+        return EINVAL;
+      err = ringbuf_write_all(comp->out_fd, comp->out_buf, output.pos);
+      if (err != 0)
+        return err;
+    } while (ret != 0);
+    return 0;
+  }
+#endif
+
+#ifdef USE_LZ4
+  case RB_COMPRESS_LZ4:
+  {
+    size_t ret = LZ4F_compressEnd(comp->lz4_cctx, comp->out_buf, comp->out_size, NULL);
+
+    if (LZ4F_isError(ret))
+      return EINVAL;
+    return ringbuf_write_all(comp->out_fd, comp->out_buf, ret);
+  }
+#endif
+
+  default:
+    return 0;
+  }
+}
+
+/*
+ * End the current zstd or lz4 frame and start another one.  Frames are
+ * decompressed independently of each other, so a reader can start at the
+ * beginning of any of them; when reading the file, wiretap records where
+ * each one starts, and seeking into a file made of frames of a few MB
+ * then costs at most a few MB of decompression.
+ * Returns 0 on success, an errno value on failure.
+ */
+static int
+ringbuf_compress_new_frame(rb_compressor *comp)
+{
+  int err;
+
+  err = ringbuf_compress_end_frame(comp);
+  if (err != 0)
+    return err;
+  comp->frame_len = 0;
+
+  switch (comp->type) {
+
+#ifdef USE_LZ4
+  case RB_COMPRESS_LZ4:
+  {
+    size_t ret = LZ4F_compressBegin(comp->lz4_cctx, comp->out_buf, comp->out_size, &comp->lz4_prefs);
+
+    if (LZ4F_isError(ret))
+      return EINVAL;
+    return ringbuf_write_all(comp->out_fd, comp->out_buf, ret);
+  }
+#endif
+
+  default:
+    /* ZSTD_compressStream() starts a new zstd frame by itself. */
+    return 0;
+  }
+}
+
+/*
+ * Compress data; if flush is TRUE, also write out everything compressed
+ * so far, so that a reader of the file can get all of the data written
+ * so far.
+ * Returns 0 on success, an errno value on failure.
+ */
+static int
+ringbuf_compress_data(rb_compressor *comp, const guint8 *data, size_t len,
+                      gboolean flush)
+{
+  int err;
+
+  if ((comp->type == RB_COMPRESS_ZSTD || comp->type == RB_COMPRESS_LZ4) && len != 0) {
+    if (comp->frame_len >= RB_COMPRESS_FRAME_SIZE) {
+      err = ringbuf_compress_new_frame(comp);
+      if (err != 0)
+        return err;
     }
+    comp->frame_len += len;
   }
 
-  if (name) {
-    /* push the current file to pending list if it failed to delete */
-    if (ws_stat64(name, &statb) == 0) {
-      for (i = 0; i < sizeof(rb_data.oldnames) / sizeof(rb_data.oldnames[0]); i++) {
-        if (rb_data.oldnames[i] == NULL) {
-          rb_data.oldnames[i] = g_strdup(name);
-          break;
-        }
-      }
+  switch (comp->type) {
+
+#ifdef HAVE_ZLIB
+  case RB_COMPRESS_GZIP:
+    if (len != 0 && gzwrite(comp->gz, data, (unsigned int)len) <= 0)
+      return errno != 0 ? errno : EIO;
+    if (flush && gzflush(comp->gz, Z_SYNC_FLUSH) != Z_OK)
+      return errno != 0 ? errno : EIO;
+    return 0;
+#endif
+
+#ifdef HAVE_ZSTD
+  case RB_COMPRESS_ZSTD:
+  {
+    ZSTD_inBuffer input = { data, len, 0 };
+    ZSTD_outBuffer output;
+    size_t ret;
+
+    do {
+      output.dst = comp->out_buf;
+      output.size = comp->out_size;
+      output.pos = 0;
+      if (input.pos < input.size)
+        ret = ZSTD_compressStream(comp->zcs, &output, &input);
+      else if (flush)
+        ret = ZSTD_flushStream(comp->zcs, &output);
+      else
+        break;
+      if (ZSTD_isError(ret))
+        return EINVAL;
+      err = ringbuf_write_all(comp->out_fd, comp->out_buf, output.pos);
+      if (err != 0)
+        return err;
+    } while (input.pos < input.size || ret != 0);
+    return 0;
+  }
+#endif
+
+#ifdef USE_LZ4
+  case RB_COMPRESS_LZ4:
+  {
+    size_t ret;
+
+    if (len != 0) {
+      ret = LZ4F_compressUpdate(comp->lz4_cctx, comp->out_buf, comp->out_size,
+                                data, len, NULL);
+      if (LZ4F_isError(ret))
+        return EINVAL;
+      err = ringbuf_write_all(comp->out_fd, comp->out_buf, ret);
+      if (err != 0)
+        return err;
     }
+    if (!flush)
+      return 0;
+    ret = LZ4F_flush(comp->lz4_cctx, comp->out_buf, comp->out_size, NULL);
+    if (LZ4F_isError(ret))
+      return EINVAL;
+    return ringbuf_write_all(comp->out_fd, comp->out_buf, ret);
   }
+#endif
 
-  g_mutex_unlock(&rb_data.mutex);
+  default:
+    return EINVAL;
+  }
 }
 
 /*
- * compress capture file
+ * Finish compressing a file, if we haven't had an error, and free
+ * everything used to compress it.
+ * Returns 0 on success, an errno value on failure.
  */
-static int ringbuf_exec_compress(gchar* name)
+static int
+ringbuf_compress_end(rb_compressor *comp, int err)
 {
-  guint8  *buffer = NULL;
-  gchar* outgz = NULL;
-  int  fd = -1;
-  ssize_t nread;
-  gboolean delete_org_file = TRUE;
-  gzFile fi = NULL;
+  switch (comp->type) {
 
-  fd = ws_open(name, O_RDONLY | O_BINARY, 0000);
-  if (fd < 0) {
-    return -1;
+#ifdef HAVE_ZLIB
+  case RB_COMPRESS_GZIP:
+    if (comp->gz != NULL) {
+      if (gzclose(comp->gz) != Z_OK && err == 0)
+        err = errno != 0 ? errno : EIO;
+      comp->gz = NULL;
+    }
+    break;
+#endif
+
+#ifdef HAVE_ZSTD
+  case RB_COMPRESS_ZSTD:
+    if (comp->zcs != NULL) {
+      if (err == 0)
+        err = ringbuf_compress_end_frame(comp);
+      ZSTD_freeCStream(comp->zcs);
+      comp->zcs = NULL;
+    }
+    break;
+#endif
+
+#ifdef USE_LZ4
+  case RB_COMPRESS_LZ4:
+    if (comp->lz4_cctx != NULL) {
+      if (err == 0)
+        err = ringbuf_compress_end_frame(comp);
+      LZ4F_freeCompressionContext(comp->lz4_cctx);
+      comp->lz4_cctx = NULL;
+    }
+    break;
+#endif
+
+  default:
+    break;
   }
 
-  outgz = g_strdup_printf("%s.gz", name);
-  fi = gzopen(outgz, "wb");
-  g_free(outgz);
-  if (fi == NULL) {
-    ws_close(fd);
-    return -1;
+  g_free(comp->out_buf);
+  comp->out_buf = NULL;
+  if (comp->out_fd != -1) {
+    if (ws_close(comp->out_fd) == -1 && err == 0)
+      err = errno;
+    comp->out_fd = -1;
   }
+  return err;
+}
 
-#define FS_READ_SIZE 65536
-  buffer = (guint8*)g_malloc(FS_READ_SIZE);
-  if (buffer == NULL) {
-    ws_close(fd);
-    gzclose(fi);
-    return -1;
+/*
+ * Wait up to timeout microseconds for something to read from the pipe
+ * the capture is written to.
+ * Returns TRUE if there's something to read, or the pipe has been closed
+ * or has failed, so that a read won't block; FALSE if we timed out.
+ */
+static gboolean
+ringbuf_compress_wait(int fd, gint64 timeout)
+{
+#ifdef _WIN32
+  /* select() only works on sockets on Windows, so poll the pipe. */
+  HANDLE  pipe_h = (HANDLE)_get_osfhandle(fd);
+  DWORD   bytes_avail;
+  gint64  deadline = g_get_monotonic_time() + timeout;
+
+  for (;;) {
+    if (!PeekNamedPipe(pipe_h, NULL, 0, NULL, &bytes_avail, NULL) ||
+        bytes_avail != 0)
+      return TRUE;
+    if (g_get_monotonic_time() >= deadline)
+      return FALSE;
+    g_usleep(RB_COMPRESS_POLL_INTERVAL);
   }
+#else
+  fd_set  rfds;
+  struct timeval tv;
+  int     ret;
+
+  do {
+    FD_ZERO(&rfds);
+    FD_SET(fd, &rfds);
+    tv.tv_sec = (time_t)(timeout / G_USEC_PER_SEC);
+    tv.tv_usec = (suseconds_t)(timeout % G_USEC_PER_SEC);
+    ret = select(fd + 1, &rfds, NULL, NULL, &tv);
+  } while (ret == -1 && errno == EINTR);
+  return ret != 0;
+#endif
+}
 
-  while ((nread = ws_read(fd, buffer, FS_READ_SIZE)) > 0) {
-    int n = gzwrite(fi, buffer, (unsigned int)nread);
-    if (n <= 0) {
-      /* mark compression as failed */
-      delete_org_file = FALSE;
+/*
+ * Thread to compress what's written to a ringbuffer file as it's
+ * written; it reads it from the pipe the capture is written to and
+ * writes the compressed data to the file, until the capture is
+ * written to the next file and the pipe is closed.
+ *
+ * Whatever has been compressed is flushed to the file at least once
+ * every RB_COMPRESS_FLUSH_INTERVAL, including when no more packets
+ * arrive, so that a program reading the file as it's written sees all
+ * of the packets written to it; it's not flushed more often than that,
+ * as that would make the compression much worse.
+ */
+static gpointer
+ringbuf_compress_thread(gpointer arg)
+{
+  rb_compressor *comp = (rb_compressor *)arg;
+  guint8  *buffer;
+  ssize_t nread;
+  gint64  last_flush;
+  gint64  now;
+  gboolean unflushed = FALSE;
+  int     err;
+
+  buffer = (guint8 *)g_malloc(RB_COMPRESS_BUF_SIZE);
+  err = ringbuf_compress_begin(comp);
+  last_flush = g_get_monotonic_time();
+  for (;;) {
+    /*
+     * If there's compressed data that hasn't been flushed yet, don't
+     * block reading past the time it should be flushed.
+     */
+    if (unflushed && err == 0) {
+      now = g_get_monotonic_time();
+      if (!ringbuf_compress_wait(comp->in_fd,
+                                 MAX(last_flush + RB_COMPRESS_FLUSH_INTERVAL - now, 0))) {
+        err = ringbuf_compress_data(comp, NULL, 0, TRUE);
+        last_flush = g_get_monotonic_time();
+        unflushed = FALSE;
+        continue;
+      }
+    }
+    nread = ws_read(comp->in_fd, buffer, RB_COMPRESS_BUF_SIZE);
+    if (nread == 0)
+      break;
+    if (nread < 0) {
+      if (errno == EINTR)
+        continue;
+      if (err == 0)
+        err = errno;
       break;
     }
+    /*
+     * If we've had an error, keep reading, so that the capture isn't
+     * stalled, until we can report it at the next file switch.
+     */
+    if (err != 0)
+      continue;
+
+    /*
+     * If packets keep arriving, we never time out waiting for them;
+     * flush when it's time to, once we've caught up with the capture
+     * (we got less than we asked for).
+     */
+    now = g_get_monotonic_time();
+    if (nread < RB_COMPRESS_BUF_SIZE && now - last_flush >= RB_COMPRESS_FLUSH_INTERVAL) {
+      err = ringbuf_compress_data(comp, buffer, (size_t)nread, TRUE);
+      last_flush = now;
+      unflushed = FALSE;
+    } else {
+      err = ringbuf_compress_data(comp, buffer, (size_t)nread, FALSE);
+      unflushed = TRUE;
+    }
   }
-  if (nread < 0) {
-    /* mark compression as failed */
-    delete_org_file = FALSE;
-  }
-  ws_close(fd);
-  gzclose(fi);
+  err = ringbuf_compress_end(comp, err);
+  ws_close(comp->in_fd);
   g_free(buffer);
+  g_free(comp);
+
+  g_mutex_lock(&rb_data.mutex);
+  if (err != 0 && rb_data.compress_err == 0)
+    rb_data.compress_err = err;
+  rb_data.compress_pending--;
+  g_cond_signal(&rb_data.compress_cond);
+  g_mutex_unlock(&rb_data.mutex);
+  return NULL;
+}
+
+/*
+ * Start compressing what's written to a ringbuffer file, opened on
+ * out_fd, in a separate thread.
+ * Returns the file descriptor the capture should be written to, or -1
+ * on failure; out_fd is closed in any case.
+ */
+static int
+ringbuf_start_compress_file(int out_fd, int *err)
+{
+  rb_compressor *comp;
+  int      fds[2];
+
+  /*
+   * Don't have more than RB_COMPRESS_MAX_PENDING files being compressed
+   * at once; if we're switching files faster than we can compress
+   * them, wait for one of them to be finished.
+   */
+  g_mutex_lock(&rb_data.mutex);
+  while (rb_data.compress_pending >= RB_COMPRESS_MAX_PENDING)
+    g_cond_wait(&rb_data.compress_cond, &rb_data.mutex);
+  g_mutex_unlock(&rb_data.mutex);
 
-  /* delete the original file only if compression succeeds */
-  if (delete_org_file) {
-    ws_unlink(name);
-    CleanupOldCap(name);
+#ifdef _WIN32
+  if (_pipe(fds, RB_COMPRESS_BUF_SIZE, O_BINARY) == -1) {
+#else
+  if (pipe(fds) == -1) {
+#endif
+    if (err != NULL)
+      *err = errno;
+    ws_close(out_fd);
+    return -1;
   }
-  g_free(name);
-  return 0;
+
+  comp = g_new0(rb_compressor, 1);
+  comp->type = rb_data.compress;
+  comp->in_fd = fds[0];
+  comp->out_fd = out_fd;
+
+  g_mutex_lock(&rb_data.mutex);
+  rb_data.compress_pending++;
+  g_mutex_unlock(&rb_data.mutex);
+  g_thread_unref(g_thread_new("Ringbuffer compression", ringbuf_compress_thread, comp));
+
+  return fds[1];
 }
 
 /*
- * thread to compress capture file
+ * Wait for all the files being compressed to be finished.
+ * Returns 0 if they were all compressed successfully, otherwise
+ * the first error we got compressing one of them.
  */
-static void* exec_compress_thread(void* arg)
+static int
+ringbuf_wait_compress_files(void)
 {
-  ringbuf_exec_compress((gchar*)arg);
-  return NULL;
+  int err;
+
+  g_mutex_lock(&rb_data.mutex);
+  while (rb_data.compress_pending != 0)
+    g_cond_wait(&rb_data.compress_cond, &rb_data.mutex);
+  err = rb_data.compress_err;
+  rb_data.compress_err = 0;
+  g_mutex_unlock(&rb_data.mutex);
+  return err;
 }
 
 /*
- * start a thread to compress capture file
+ * Get, and clear, the first error we got compressing a file, if any,
+ * without waiting for the ones still being compressed.
  */
-static int ringbuf_start_compress_file(rb_file* rfile)
+static int
+ringbuf_get_compress_error(void)
 {
-  gchar* name = g_strdup(rfile->name);
-  g_thread_new("exec_compress", &exec_compress_thread, name);
-  return 0;
+  int err;
+
+  g_mutex_lock(&rb_data.mutex);
+  err = rb_data.compress_err;
+  rb_data.compress_err = 0;
+  g_mutex_unlock(&rb_data.mutex);
+  return err;
 }
 
 /*
@@ -210,15 +682,13 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
   char    timestr[14+1];
   time_t  current_time;
   struct tm *tm;
+  int     fd;
 
   if (rfile->name != NULL) {
     if (rb_data.unlimited == FALSE) {
       /* remove old file (if any, so ignore error) */
       ws_unlink(rfile->name);
     }
-    else if (rb_data.compress_type != NULL && strcmp(rb_data.compress_type, "gzip") == 0) {
-      ringbuf_start_compress_file(rfile);
-    }
     g_free(rfile->name);
   }
 
@@ -245,12 +715,24 @@ static int ringbuf_open_file(rb_file *rfile, int *err)
     return -1;
   }
 
-  rb_data.fd = ws_open(rfile->name, O_RDWR|O_BINARY|O_TRUNC|O_CREAT,
+  if (rb_data.compress != RB_COMPRESS_NONE) {
+    gchar *name = rfile->name;
+
+    rfile->name = g_strconcat(name, compress_extensions[rb_data.compress], NULL);
+    g_free(name);
+  }
+
+  fd = ws_open(rfile->name, O_RDWR|O_BINARY|O_TRUNC|O_CREAT,
                             rb_data.group_read_access ? 0640 : 0600);
 
-  if (rb_data.fd == -1 && err != NULL) {
-    *err = errno;
+  if (fd == -1) {
+    if (err != NULL)
+      *err = errno;
+  } else if (rb_data.compress != RB_COMPRESS_NONE) {
+    /* The capture is written to a pipe to the thread compressing it. */
+    fd = ringbuf_start_compress_file(fd, err);
   }
+  rb_data.fd = fd;
 
   return rb_data.fd;
 }
@@ -277,8 +759,25 @@ ringbuf_init(const char *capfile_name, guint num_files, gboolean group_read_acce
   rb_data.io_buffer = NULL;
   rb_data.group_read_access = group_read_access;
   rb_data.name_h = NULL;
-  rb_data.compress_type = compress_type;
+  rb_data.compress = RB_COMPRESS_NONE;
+  if (compress_type != NULL) {
+#ifdef HAVE_ZLIB
+    if (strcmp(compress_type, "gzip") == 0)
+      rb_data.compress = RB_COMPRESS_GZIP;
+#endif
+#ifdef HAVE_ZSTD
+    if (strcmp(compress_type, "zstd") == 0)
+      rb_data.compress = RB_COMPRESS_ZSTD;
+#endif
+#ifdef USE_LZ4
+    if (strcmp(compress_type, "lz4") == 0)
+      rb_data.compress = RB_COMPRESS_LZ4;
+#endif
+  }
   g_mutex_init(&rb_data.mutex);
+  g_cond_init(&rb_data.compress_cond);
+  rb_data.compress_pending = 0;
+  rb_data.compress_err = 0;
 
   /* just to be sure ... */
   if (num_files <= RINGBUFFER_MAX_NUM_FILES) {
@@ -429,6 +928,7 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
 {
   int     next_file_index;
   rb_file *next_rfile = NULL;
+  int     compress_err;
 
   /* close current file */
 
@@ -447,6 +947,17 @@ ringbuf_switch_file(FILE **pdh, gchar **save_file, int *save_file_fd, int *err)
   rb_data.pdh = NULL;
   rb_data.fd  = -1;
 
+  /* report any error compressing a previous file */
+  compress_err = ringbuf_get_compress_error();
+  if (compress_err != 0) {
+    if (err != NULL) {
+      *err = compress_err;
+    }
+    g_free(rb_data.io_buffer);
+    rb_data.io_buffer = NULL;
+    return FALSE;
+  }
+
   if (rb_data.name_h != NULL) {
     fprintf(rb_data.name_h, "%s\n", ringbuf_current_filename());
     fflush(rb_data.name_h);
@@ -481,6 +992,7 @@ gboolean
 ringbuf_libpcap_dump_close(gchar **save_file, int *err)
 {
   gboolean  ret_val = TRUE;
+  int       compress_err;
 
   /* close current file, if it's open */
   if (rb_data.pdh != NULL) {
@@ -498,6 +1010,15 @@ ringbuf_libpcap_dump_close(gchar **save_file, int *err)
 
   }
 
+  /* wait for the files being compressed, including this one */
+  compress_err = ringbuf_wait_compress_files();
+  if (compress_err != 0 && ret_val) {
+    if (err != NULL) {
+      *err = compress_err;
+    }
+    ret_val = FALSE;
+  }
+
   if (rb_data.name_h != NULL) {
     fprintf(rb_data.name_h, "%s\n", ringbuf_current_filename());
     fflush(rb_data.name_h);
@@ -539,7 +1060,7 @@ ringbuf_free(void)
     rb_data.fsuffix = NULL;
   }
 
-  CleanupOldCap(NULL);
+  ringbuf_wait_compress_files();
 }
 
 /*
@@ -564,6 +1085,9 @@ ringbuf_error_cleanup(void)
     rb_data.fd = -1;
   }
 
+  /* the files can't be removed until we're done compressing them */
+  ringbuf_wait_compress_files();
+
   if (rb_data.files != NULL) {
     for (i=0; i < rb_data.num_files; i++) {
       if (rb_data.files[i].name != NULL) {
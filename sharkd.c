@@ -497,6 +497,51 @@ sharkd_load_cap_file(void)
   return load_cap_file(&cfile, 0, 0);
 }
 
+int
+sharkd_preload_cap_file(const char *fname)
+{
+  int err = 0;
+
+  fprintf(stderr, "load: filename=%s\n", fname);
+
+  if (sharkd_cf_open(fname, WTAP_TYPE_AUTO, FALSE, &err) != CF_OK)
+    return -1;
+
+  TRY
+  {
+    err = sharkd_load_cap_file();
+  }
+  CATCH(OutOfMemoryError)
+  {
+    fprintf(stderr, "load: OutOfMemoryError\n");
+    err = ENOMEM;
+  }
+  ENDTRY;
+
+  return err;
+}
+
+/*
+ * A forked session process shares the random-access file descriptor of
+ * a preloaded capture file, and thus its file offset, with the daemon
+ * and all the other sessions; give it one of its own.
+ */
+int
+sharkd_reopen_cap_file(void)
+{
+  int err;
+
+  if (cfile.provider.wth == NULL)
+    return 0;
+
+  wtap_fdclose(cfile.provider.wth);
+  if (!wtap_fdreopen(cfile.provider.wth, cfile.filename, &err)) {
+    cfile_open_failure_message(cfile.filename, err, NULL);
+    return err;
+  }
+  return 0;
+}
+
 frame_data *
 sharkd_get_frame(guint32 framenum)
 {
@@ -625,8 +670,14 @@ sharkd_retap(void)
   return 0;
 }
 
+/*
+ * Find the frames matching a display filter.  If frames isn't NULL, only
+ * the frames in it are checked; the others are taken not to match.
+ * On success, *result is set to the set of matching frames, or to NULL
+ * if the filter is empty, so that every frame matches.
+ */
 int
-sharkd_filter(const char *dftext, guint8 **result)
+sharkd_filter(const char *dftext, const sharkd_bitset_t *frames, sharkd_bitset_t **result)
 {
   dfilter_t  *dfcode = NULL;
 
@@ -637,8 +688,7 @@ sharkd_filter(const char *dftext, guint8 **result)
   int err;
   char *err_info = NULL;
 
-  guint8 *result_bits;
-  guint8  passed_bits;
+  sharkd_bitset_t *result_bits;
 
   epan_dissect_t edt;
 
@@ -659,16 +709,15 @@ sharkd_filter(const char *dftext, guint8 **result)
   ws_buffer_init(&buf, 1514);
   epan_dissect_init(&edt, cfile.epan, TRUE, FALSE);
 
-  passed_bits = 0;
-  result_bits = (guint8 *) g_malloc(2 + (frames_count / 8));
+  result_bits = sharkd_bitset_new(frames_count);
 
   for (framenum = 1; framenum <= frames_count; framenum++) {
-    frame_data *fdata = sharkd_get_frame(framenum);
+    frame_data *fdata;
 
-    if ((framenum & 7) == 0) {
-      result_bits[(framenum / 8) - 1] = passed_bits;
-      passed_bits = 0;
-    }
+    if (frames && !sharkd_bitset_contains(frames, framenum))
+      continue;
+
+    fdata = sharkd_get_frame(framenum);
 
     if (!wtap_seek_read(cfile.provider.wth, fdata->file_off, &rec, &buf, &err, &err_info))
       break;
@@ -684,7 +733,7 @@ sharkd_filter(const char *dftext, guint8 **result)
                      fdata, NULL);
 
     if (dfilter_apply_edt(dfcode, &edt)) {
-      passed_bits |= (1 << (framenum % 8));
+      sharkd_bitset_add(result_bits, framenum);
       prev_dis_num = framenum;
     }
 
@@ -694,10 +743,6 @@ sharkd_filter(const char *dftext, guint8 **result)
     epan_dissect_reset(&edt);
   }
 
-  if ((framenum & 7) == 0)
-      framenum--;
-  result_bits[framenum / 8] = passed_bits;
-
   wtap_rec_cleanup(&rec);
   ws_buffer_free(&buf);
   epan_dissect_cleanup(&edt);
@@ -706,7 +751,7 @@ sharkd_filter(const char *dftext, guint8 **result)
 
   *result = result_bits;
 
-  return framenum;
+  return 0;
 }
 
 /*
@@ -743,8 +788,15 @@ sharkd_get_packet_block(const frame_data *fd)
     if (!wtap_seek_read(cfile.provider.wth, fd->file_off, &rec, &buf, &err, &err_info))
       { /* XXX, what we can do here? */ }
 
-    /* rec.block is owned by the record, steal it before it is gone. */
-    block = wtap_block_ref(rec.block);
+    /*
+     * rec.block is owned by the record, steal it before it is gone.
+     * Some readers, e.g. pcapng for packets without options, don't
+     * supply a block; give the caller an empty one to modify.
+     */
+    if (rec.block != NULL)
+      block = wtap_block_ref(rec.block);
+    else
+      block = wtap_block_create(WTAP_BLOCK_PACKET);
 
     wtap_rec_cleanup(&rec);
     ws_buffer_free(&buf);
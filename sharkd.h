@@ -26,13 +26,17 @@
 #define SHARKD_MODE_GOLD_CONSOLE       3
 #define SHARKD_MODE_GOLD_DAEMON        4
 
+typedef struct sharkd_bitset sharkd_bitset_t;
+
 typedef void (*sharkd_dissect_func_t)(epan_dissect_t *edt, proto_tree *tree, struct epan_column_info *cinfo, const GSList *data_src, void *data);
 
 /* sharkd.c */
 cf_status_t sharkd_cf_open(const char *fname, unsigned int type, gboolean is_tempfile, int *err);
 int sharkd_load_cap_file(void);
+int sharkd_preload_cap_file(const char *fname);
+int sharkd_reopen_cap_file(void);
 int sharkd_retap(void);
-int sharkd_filter(const char *dftext, guint8 **result);
+int sharkd_filter(const char *dftext, const sharkd_bitset_t *frames, sharkd_bitset_t **result);
 frame_data *sharkd_get_frame(guint32 framenum);
 enum dissect_request_status {
   DISSECT_REQUEST_SUCCESS,
@@ -50,6 +54,19 @@ wtap_block_t sharkd_get_packet_block(const frame_data *fd);
 int sharkd_set_modified_block(frame_data *fd, wtap_block_t new_block);
 const char *sharkd_version(void);
 
+/* sharkd_bitset.c */
+sharkd_bitset_t *sharkd_bitset_new(guint32 max);
+sharkd_bitset_t *sharkd_bitset_new_full(guint32 max);
+sharkd_bitset_t *sharkd_bitset_copy(const sharkd_bitset_t *bs);
+void sharkd_bitset_free(sharkd_bitset_t *bs);
+void sharkd_bitset_add(sharkd_bitset_t *bs, guint32 n);
+gboolean sharkd_bitset_contains(const sharkd_bitset_t *bs, guint32 n);
+guint32 sharkd_bitset_count(const sharkd_bitset_t *bs);
+gsize sharkd_bitset_size(const sharkd_bitset_t *bs);
+sharkd_bitset_t *sharkd_bitset_and(const sharkd_bitset_t *a, const sharkd_bitset_t *b);
+sharkd_bitset_t *sharkd_bitset_or(const sharkd_bitset_t *a, const sharkd_bitset_t *b);
+sharkd_bitset_t *sharkd_bitset_not(const sharkd_bitset_t *a);
+
 /* sharkd_daemon.c */
 int sharkd_init(int argc, char **argv);
 int sharkd_loop(int argc _U_, char* argv[] _U_);
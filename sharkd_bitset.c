@@ -0,0 +1,529 @@
+/* sharkd_bitset.c
+ *
+ * Compressed sets of frame numbers for sharkd's filter cache.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <wsutil/bits_count_ones.h>
+
+#include "sharkd.h"
+
+/*
+ * The frame numbers are split into chunks of 65536 frames, by their
+ * upper 16 bits, and each chunk is stored the way that takes the least
+ * memory for the number of frames it holds (as "roaring" bitmaps do):
+ *
+ *  - not at all, if it holds no frames;
+ *  - as a sorted array of the lower 16 bits of its frame numbers, if
+ *    it holds up to CHUNK_ARRAY_MAX frames;
+ *  - as a bitmap of 65536 bits otherwise;
+ *  - not at all, if it holds all 65536 frames.
+ *
+ * A filter matching few frames, or nearly all of them, then takes far
+ * less than the bit per frame of a plain bitmap.
+ */
+#define CHUNK_BITS      16
+#define CHUNK_FRAMES    (1U << CHUNK_BITS)
+#define CHUNK_MASK      (CHUNK_FRAMES - 1)
+#define CHUNK_WORDS     (CHUNK_FRAMES / 64)
+#define CHUNK_ARRAY_MAX (CHUNK_FRAMES / 16)   /* the size of a bitmap */
+
+enum chunk_type {
+	CHUNK_EMPTY = 0,
+	CHUNK_ARRAY,
+	CHUNK_BITMAP,
+	CHUNK_FULL
+};
+
+struct bitset_chunk
+{
+	enum chunk_type type;
+	guint32 card;        /* number of frames in the chunk */
+	guint32 alloc;       /* allocated entries of array */
+	union {
+		guint16 *array;
+		guint64 *bitmap;
+	} u;
+};
+
+struct sharkd_bitset
+{
+	guint32 max;
+	guint32 nchunks;
+	struct bitset_chunk *chunks;
+};
+
+static void
+chunk_clear(struct bitset_chunk *c)
+{
+	if (c->type == CHUNK_ARRAY)
+		g_free(c->u.array);
+	else if (c->type == CHUNK_BITMAP)
+		g_free(c->u.bitmap);
+	memset(c, 0, sizeof(*c));
+}
+
+static gboolean
+chunk_contains(const struct bitset_chunk *c, guint16 low)
+{
+	switch (c->type)
+	{
+		case CHUNK_ARRAY:
+		{
+			guint32 lo = 0, hi = c->card;
+
+			while (lo < hi)
+			{
+				guint32 mid = lo + (hi - lo) / 2;
+
+				if (c->u.array[mid] == low)
+					return TRUE;
+				if (c->u.array[mid] < low)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			return FALSE;
+		}
+
+		case CHUNK_BITMAP:
+			return (c->u.bitmap[low / 64] >> (low % 64)) & 1;
+
+		case CHUNK_FULL:
+			return TRUE;
+
+		default:
+			return FALSE;
+	}
+}
+
+/* Expand a chunk of any type into a bitmap of CHUNK_WORDS words. */
+static void
+chunk_get_bitmap(const struct bitset_chunk *c, guint64 *words)
+{
+	guint32 i;
+
+	switch (c->type)
+	{
+		case CHUNK_ARRAY:
+			memset(words, 0, CHUNK_WORDS * sizeof(guint64));
+			for (i = 0; i < c->card; i++)
+				words[c->u.array[i] / 64] |= G_GUINT64_CONSTANT(1) << (c->u.array[i] % 64);
+			break;
+
+		case CHUNK_BITMAP:
+			memcpy(words, c->u.bitmap, CHUNK_WORDS * sizeof(guint64));
+			break;
+
+		case CHUNK_FULL:
+			memset(words, 0xff, CHUNK_WORDS * sizeof(guint64));
+			break;
+
+		default:
+			memset(words, 0, CHUNK_WORDS * sizeof(guint64));
+			break;
+	}
+}
+
+/* Set an (empty) chunk from a bitmap, in whatever form suits it best. */
+static void
+chunk_set_bitmap(struct bitset_chunk *c, const guint64 *words)
+{
+	guint32 card = 0;
+	guint32 i;
+
+	for (i = 0; i < CHUNK_WORDS; i++)
+		card += ws_count_ones(words[i]);
+
+	c->card = card;
+	if (card == 0)
+	{
+		c->type = CHUNK_EMPTY;
+	}
+	else if (card == CHUNK_FRAMES)
+	{
+		c->type = CHUNK_FULL;
+	}
+	else if (card <= CHUNK_ARRAY_MAX)
+	{
+		guint32 n = 0;
+
+		c->type = CHUNK_ARRAY;
+		c->alloc = card;
+		c->u.array = g_new(guint16, card);
+		for (i = 0; i < CHUNK_WORDS; i++)
+		{
+			guint32 bit;
+
+			if (words[i] == 0)
+				continue;
+			for (bit = 0; bit < 64; bit++)
+			{
+				if ((words[i] >> bit) & 1)
+					c->u.array[n++] = (guint16) (i * 64 + bit);
+			}
+		}
+	}
+	else
+	{
+		c->type = CHUNK_BITMAP;
+		c->u.bitmap = (guint64 *) g_memdup2(words, CHUNK_WORDS * sizeof(guint64));
+	}
+}
+
+static void
+chunk_copy(struct bitset_chunk *dst, const struct bitset_chunk *src)
+{
+	*dst = *src;
+	if (src->type == CHUNK_ARRAY)
+	{
+		dst->alloc = src->card;
+		dst->u.array = (guint16 *) g_memdup2(src->u.array, src->card * sizeof(guint16));
+	}
+	else if (src->type == CHUNK_BITMAP)
+	{
+		dst->u.bitmap = (guint64 *) g_memdup2(src->u.bitmap, CHUNK_WORDS * sizeof(guint64));
+	}
+}
+
+static void
+chunk_add(struct bitset_chunk *c, guint16 low)
+{
+	if (chunk_contains(c, low))
+		return;
+
+	switch (c->type)
+	{
+		case CHUNK_EMPTY:
+			c->type = CHUNK_ARRAY;
+			c->alloc = 4;
+			c->u.array = g_new(guint16, c->alloc);
+			c->u.array[0] = low;
+			c->card = 1;
+			break;
+
+		case CHUNK_ARRAY:
+			if (c->card == CHUNK_ARRAY_MAX)
+			{
+				guint64 *words = g_new(guint64, CHUNK_WORDS);
+
+				chunk_get_bitmap(c, words);
+				g_free(c->u.array);
+				c->type = CHUNK_BITMAP;
+				c->u.bitmap = words;
+				c->u.bitmap[low / 64] |= G_GUINT64_CONSTANT(1) << (low % 64);
+				c->card++;
+				break;
+			}
+			if (c->card == c->alloc)
+			{
+				c->alloc = MIN(c->alloc * 2, CHUNK_ARRAY_MAX);
+				c->u.array = g_renew(guint16, c->u.array, c->alloc);
+			}
+			/* Frames are usually added in order, so this is usually an append. */
+			{
+				guint32 i = c->card;
+
+				while (i > 0 && c->u.array[i - 1] > low)
+				{
+					c->u.array[i] = c->u.array[i - 1];
+					i--;
+				}
+				c->u.array[i] = low;
+				c->card++;
+			}
+			break;
+
+		case CHUNK_BITMAP:
+			c->u.bitmap[low / 64] |= G_GUINT64_CONSTANT(1) << (low % 64);
+			if (++c->card == CHUNK_FRAMES)
+			{
+				g_free(c->u.bitmap);
+				c->type = CHUNK_FULL;
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+static sharkd_bitset_t *
+bitset_alloc(guint32 max)
+{
+	sharkd_bitset_t *bs = g_new(sharkd_bitset_t, 1);
+
+	bs->max = max;
+	bs->nchunks = (max >> CHUNK_BITS) + 1;
+	bs->chunks = g_new0(struct bitset_chunk, bs->nchunks);
+	return bs;
+}
+
+sharkd_bitset_t *
+sharkd_bitset_new(guint32 max)
+{
+	return bitset_alloc(max);
+}
+
+sharkd_bitset_t *
+sharkd_bitset_new_full(guint32 max)
+{
+	sharkd_bitset_t *none = bitset_alloc(max);
+	sharkd_bitset_t *bs = sharkd_bitset_not(none);
+
+	sharkd_bitset_free(none);
+	return bs;
+}
+
+sharkd_bitset_t *
+sharkd_bitset_copy(const sharkd_bitset_t *bs)
+{
+	sharkd_bitset_t *res = bitset_alloc(bs->max);
+	guint32 i;
+
+	for (i = 0; i < bs->nchunks; i++)
+		chunk_copy(&res->chunks[i], &bs->chunks[i]);
+	return res;
+}
+
+void
+sharkd_bitset_free(sharkd_bitset_t *bs)
+{
+	guint32 i;
+
+	if (!bs)
+		return;
+
+	for (i = 0; i < bs->nchunks; i++)
+		chunk_clear(&bs->chunks[i]);
+	g_free(bs->chunks);
+	g_free(bs);
+}
+
+void
+sharkd_bitset_add(sharkd_bitset_t *bs, guint32 n)
+{
+	if (n == 0 || n > bs->max)
+		return;
+
+	chunk_add(&bs->chunks[n >> CHUNK_BITS], (guint16) (n & CHUNK_MASK));
+}
+
+gboolean
+sharkd_bitset_contains(const sharkd_bitset_t *bs, guint32 n)
+{
+	if (n > bs->max)
+		return FALSE;
+
+	return chunk_contains(&bs->chunks[n >> CHUNK_BITS], (guint16) (n & CHUNK_MASK));
+}
+
+guint32
+sharkd_bitset_count(const sharkd_bitset_t *bs)
+{
+	guint32 count = 0;
+	guint32 i;
+
+	for (i = 0; i < bs->nchunks; i++)
+		count += bs->chunks[i].card;
+	return count;
+}
+
+gsize
+sharkd_bitset_size(const sharkd_bitset_t *bs)
+{
+	gsize size = sizeof(*bs) + bs->nchunks * sizeof(struct bitset_chunk);
+	guint32 i;
+
+	for (i = 0; i < bs->nchunks; i++)
+	{
+		if (bs->chunks[i].type == CHUNK_ARRAY)
+			size += bs->chunks[i].alloc * sizeof(guint16);
+		else if (bs->chunks[i].type == CHUNK_BITMAP)
+			size += CHUNK_WORDS * sizeof(guint64);
+	}
+	return size;
+}
+
+sharkd_bitset_t *
+sharkd_bitset_and(const sharkd_bitset_t *a, const sharkd_bitset_t *b)
+{
+	sharkd_bitset_t *res = bitset_alloc(MIN(a->max, b->max));
+	guint64 *words = NULL;
+	guint32 i;
+
+	for (i = 0; i < res->nchunks; i++)
+	{
+		const struct bitset_chunk *ca = &a->chunks[i];
+		const struct bitset_chunk *cb = &b->chunks[i];
+		struct bitset_chunk *cr = &res->chunks[i];
+
+		if (ca->type == CHUNK_EMPTY || cb->type == CHUNK_EMPTY)
+			continue;
+
+		if (ca->type == CHUNK_FULL)
+		{
+			chunk_copy(cr, cb);
+		}
+		else if (cb->type == CHUNK_FULL)
+		{
+			chunk_copy(cr, ca);
+		}
+		else if (ca->type == CHUNK_ARRAY || cb->type == CHUNK_ARRAY)
+		{
+			/* The result is no bigger than the (smaller) array. */
+			const struct bitset_chunk *arr = (ca->type == CHUNK_ARRAY) ? ca : cb;
+			const struct bitset_chunk *oth = (arr == ca) ? cb : ca;
+			guint32 j;
+
+			if (oth->type == CHUNK_ARRAY && oth->card < arr->card)
+			{
+				const struct bitset_chunk *tmp = arr;
+
+				arr = oth;
+				oth = tmp;
+			}
+
+			cr->type = CHUNK_ARRAY;
+			cr->alloc = arr->card;
+			cr->u.array = g_new(guint16, arr->card);
+			for (j = 0; j < arr->card; j++)
+			{
+				if (chunk_contains(oth, arr->u.array[j]))
+					cr->u.array[cr->card++] = arr->u.array[j];
+			}
+			if (cr->card == 0)
+				chunk_clear(cr);
+		}
+		else
+		{
+			guint32 j;
+
+			if (!words)
+				words = g_new(guint64, CHUNK_WORDS);
+			for (j = 0; j < CHUNK_WORDS; j++)
+				words[j] = ca->u.bitmap[j] & cb->u.bitmap[j];
+			chunk_set_bitmap(cr, words);
+		}
+	}
+
+	g_free(words);
+	return res;
+}
+
+sharkd_bitset_t *
+sharkd_bitset_or(const sharkd_bitset_t *a, const sharkd_bitset_t *b)
+{
+	sharkd_bitset_t *res = bitset_alloc(MAX(a->max, b->max));
+	guint64 *words = NULL, *other = NULL;
+	guint32 i;
+
+	for (i = 0; i < res->nchunks; i++)
+	{
+		const struct bitset_chunk *ca = (i < a->nchunks) ? &a->chunks[i] : NULL;
+		const struct bitset_chunk *cb = (i < b->nchunks) ? &b->chunks[i] : NULL;
+		struct bitset_chunk *cr = &res->chunks[i];
+		guint32 j;
+
+		if (!ca || ca->type == CHUNK_EMPTY)
+		{
+			if (cb)
+				chunk_copy(cr, cb);
+			continue;
+		}
+		if (!cb || cb->type == CHUNK_EMPTY)
+		{
+			chunk_copy(cr, ca);
+			continue;
+		}
+		if (ca->type == CHUNK_FULL || cb->type == CHUNK_FULL)
+		{
+			cr->type = CHUNK_FULL;
+			cr->card = CHUNK_FRAMES;
+			continue;
+		}
+
+		if (!words)
+		{
+			words = g_new(guint64, CHUNK_WORDS);
+			other = g_new(guint64, CHUNK_WORDS);
+		}
+		chunk_get_bitmap(ca, words);
+		chunk_get_bitmap(cb, other);
+		for (j = 0; j < CHUNK_WORDS; j++)
+			words[j] |= other[j];
+		chunk_set_bitmap(cr, words);
+	}
+
+	g_free(words);
+	g_free(other);
+	return res;
+}
+
+sharkd_bitset_t *
+sharkd_bitset_not(const sharkd_bitset_t *a)
+{
+	sharkd_bitset_t *res = bitset_alloc(a->max);
+	guint64 *words = g_new(guint64, CHUNK_WORDS);
+	guint32 i;
+
+	for (i = 0; i < res->nchunks; i++)
+	{
+		const struct bitset_chunk *ca = &a->chunks[i];
+		/* The range of frames in this chunk: there's no frame 0, and none after max. */
+		guint32 first = (i == 0) ? 1 : 0;
+		guint32 last = (i == res->nchunks - 1) ? (a->max & CHUNK_MASK) : CHUNK_MASK;
+		guint32 j;
+
+		if (first == 0 && last == CHUNK_MASK)
+		{
+			if (ca->type == CHUNK_EMPTY)
+			{
+				res->chunks[i].type = CHUNK_FULL;
+				res->chunks[i].card = CHUNK_FRAMES;
+				continue;
+			}
+			if (ca->type == CHUNK_FULL)
+				continue;
+		}
+
+		chunk_get_bitmap(ca, words);
+		for (j = 0; j < CHUNK_WORDS; j++)
+			words[j] = ~words[j];
+		/* Clear the bits outside of the range. */
+		for (j = 0; j < first; j++)
+			words[j / 64] &= ~(G_GUINT64_CONSTANT(1) << (j % 64));
+		for (j = last + 1; j < CHUNK_FRAMES && j % 64 != 0; j++)
+			words[j / 64] &= ~(G_GUINT64_CONSTANT(1) << (j % 64));
+		for (; j < CHUNK_FRAMES; j += 64)
+			words[j / 64] = 0;
+		chunk_set_bitmap(&res->chunks[i], words);
+	}
+
+	g_free(words);
+	return res;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 8
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * End:
+ *
+ * vi: set shiftwidth=8 tabstop=8 noexpandtab:
+ * :indentSize=8:tabSize=8:noTabs=false:
+ */
@@ -52,6 +52,7 @@
 
 static int mode = 0;
 static socket_handle_t _server_fd = INVALID_SOCKET;
+static char *read_file_name = NULL;
 
 static socket_handle_t
 socket_init(char *path)
@@ -179,6 +180,9 @@ print_usage(FILE* output)
 	fprintf(output, "Gold (gold_options):\n");
 	fprintf(output, "  -a <socket>, --api <socket>\n");
 	fprintf(output, "                           listen on this socket\n");
+	fprintf(output, "  -r <infile>, --read-file <infile>\n");
+	fprintf(output, "                           load this capture file once at startup, and share\n");
+	fprintf(output, "                           it with every session\n");
 	fprintf(output, "  -h, --help               show this help information\n");
 	fprintf(output, "  -v, --version            show version information\n");
 	fprintf(output, "  -C <config profile>, --config-profile <config profile>\n");
@@ -188,6 +192,7 @@ print_usage(FILE* output)
 	fprintf(output, "  Examples:\n");
 	fprintf(output, "    sharkd -C myprofile\n");
 	fprintf(output, "    sharkd -a tcp:127.0.0.1:4446 -C myprofile\n");
+	fprintf(output, "    sharkd -a unix:/tmp/sharkd.sock -r big.pcapng\n");
 
 	fprintf(output, "\n");
 	fprintf(output, "See the sharkd page of the Wireshark wiki for full details.\n");
@@ -217,7 +222,7 @@ sharkd_init(int argc, char **argv)
 	 * platform-dependent.
 	 */
 
-#define OPTSTRING "+" "a:hmvC:"
+#define OPTSTRING "+" "a:hmr:vC:"
 
 	static const char    optstring[] = OPTSTRING;
 
@@ -225,6 +230,7 @@ sharkd_init(int argc, char **argv)
 	static const struct ws_option long_options[] = {
 	  {"api", ws_required_argument, NULL, 'a'},
 	  {"help", ws_no_argument, NULL, 'h'},
+	  {"read-file", ws_required_argument, NULL, 'r'},
 	  {"version", ws_no_argument, NULL, 'v'},
 	  {"config-profile", ws_required_argument, NULL, 'C'},
 	  {0, 0, 0, 0 }
@@ -321,6 +327,11 @@ sharkd_init(int argc, char **argv)
 				mode = SHARKD_MODE_GOLD_CONSOLE;
 				break;
 
+			case 'r':        /* Read capture file */
+				g_free(read_file_name);
+				read_file_name = g_strdup(ws_optarg);
+				break;
+
 			case 'v':         /* Show version and exit */
 				show_version();
 				exit(0);
@@ -362,6 +373,33 @@ sharkd_loop(int argc _U_, char* argv[] _U_)
 sharkd_loop(int argc _U_, char* argv[])
 #endif
 {
+	/*
+	 * Load the capture file given with -r before any session starts.
+	 *
+	 * The daemon does it before accepting connections, so that every
+	 * session process forked afterwards shares the frame data, and the
+	 * state built by the first pass (conversations, reassembled PDUs,
+	 * ...), copy-on-write, rather than reading and dissecting the whole
+	 * file once per connection.  Whatever a session changes (comments,
+	 * another loaded file, ...) stays private to it.
+	 *
+	 * The dissection engine is not thread-safe, so sessions can't be
+	 * threads sharing one process; forking after the load is as close
+	 * as we can get.
+	 *
+	 * On Windows the session processes are spawned rather than forked,
+	 * and are passed -r, so each of them loads the file itself.
+	 */
+#ifdef _WIN32
+	if (read_file_name != NULL && (mode == SHARKD_MODE_CLASSIC_CONSOLE || mode == SHARKD_MODE_GOLD_CONSOLE))
+#else
+	if (read_file_name != NULL)
+#endif
+	{
+		if (sharkd_preload_cap_file(read_file_name) != 0)
+			return -1;
+	}
+
 	if (mode == SHARKD_MODE_CLASSIC_CONSOLE || mode == SHARKD_MODE_GOLD_CONSOLE)
 	{
 		return sharkd_session_main(mode);
@@ -397,6 +435,10 @@ sharkd_loop(int argc _U_, char* argv[])
 			dup2(fd, 1);
 			close(fd);
 
+			/* don't share the file offset of the preloaded file with other sessions */
+			if (sharkd_reopen_cap_file() != 0)
+				exit(1);
+
 			exit(sharkd_session_main(mode));
 		}
 
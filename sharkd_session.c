@@ -75,12 +75,26 @@
 
 #include "sharkd.h"
 
+/*
+ * The results of the filters used so far, by filter string.  The least
+ * recently used ones are dropped once they take more than
+ * SHARKD_FILTER_CACHE_MAX_SIZE bytes, and a filter made up of cached
+ * ones (e.g. a previous filter refined with "&& ...") is worked out
+ * from them without dissecting every frame again.
+ */
+#define SHARKD_FILTER_CACHE_MAX_SIZE (256 * 1024 * 1024)
+
 struct sharkd_filter_item
 {
-	guint8 *filtered; /* can be NULL if all frames are matching for given filter. */
+	char *filter;               /* key in filter_table */
+	sharkd_bitset_t *filtered;
+	gsize size;
+	GList lru_link;
 };
 
 static GHashTable *filter_table = NULL;
+static GQueue filter_lru = G_QUEUE_INIT; /* most recently used first */
+static gsize filter_cache_size;
 
 static int mode;
 static guint32 rpcid;
@@ -705,32 +719,453 @@ sharkd_session_filter_free(gpointer data)
 {
 	struct sharkd_filter_item *l = (struct sharkd_filter_item *) data;
 
-	g_free(l->filtered);
+	sharkd_bitset_free(l->filtered);
 	g_free(l);
 }
 
-static const struct sharkd_filter_item *
-sharkd_session_filter_data(const char *filter)
+static void
+sharkd_session_filter_cache_clear(void)
+{
+	g_hash_table_remove_all(filter_table);
+	/* The links are part of the items, which are gone. */
+	g_queue_init(&filter_lru);
+	filter_cache_size = 0;
+}
+
+static sharkd_bitset_t *
+sharkd_session_filter_cache_lookup(const char *filter)
 {
 	struct sharkd_filter_item *l;
 
 	l = (struct sharkd_filter_item *) g_hash_table_lookup(filter_table, filter);
 	if (!l)
+		return NULL;
+
+	/* Move it to the front of the LRU list. */
+	g_queue_unlink(&filter_lru, &l->lru_link);
+	g_queue_push_head_link(&filter_lru, &l->lru_link);
+
+	return l->filtered;
+}
+
+static sharkd_bitset_t *
+sharkd_session_filter_cache_insert(const char *filter, sharkd_bitset_t *filtered)
+{
+	struct sharkd_filter_item *l;
+
+	l = g_new0(struct sharkd_filter_item, 1);
+	l->filtered = filtered;
+	l->size = sharkd_bitset_size(filtered);
+	l->lru_link.data = l;
+	l->filter = g_strdup(filter);
+
+	g_hash_table_insert(filter_table, l->filter, l);
+	g_queue_push_head_link(&filter_lru, &l->lru_link);
+	filter_cache_size += l->size;
+
+	return filtered;
+}
+
+/*
+ * Drop the least recently used filter results until the cache is within
+ * its budget again.  The most recently used one is always kept, as the
+ * caller is about to use it.
+ */
+static void
+sharkd_session_filter_cache_trim(void)
+{
+	while (filter_cache_size > SHARKD_FILTER_CACHE_MAX_SIZE && filter_lru.length > 1)
+	{
+		GList *link = g_queue_pop_tail_link(&filter_lru);
+		struct sharkd_filter_item *l = (struct sharkd_filter_item *) link->data;
+
+		filter_cache_size -= l->size;
+		g_hash_table_remove(filter_table, l->filter);
+	}
+}
+
+static gboolean
+sharkd_session_filter_is_word_char(char c)
+{
+	return g_ascii_isalnum(c) || c == '_' || c == '.' || c == '-' || c == ':';
+}
+
+/*
+ * Dissect the frames in candidates (or all of them, if it's NULL) to find
+ * those matching filter.  Returns NULL if the filter is invalid.
+ */
+static sharkd_bitset_t *
+sharkd_session_filter_scan(const char *filter, const sharkd_bitset_t *candidates)
+{
+	sharkd_bitset_t *filtered = NULL;
+
+	if (sharkd_filter(filter, candidates, &filtered) == -1)
+		return NULL;
+
+	/* An empty filter matches every frame. */
+	if (!filtered)
+		filtered = candidates ? sharkd_bitset_copy(candidates) : sharkd_bitset_new_full(cfile.count);
+
+	return filtered;
+}
+
+/*
+ * Check filter against every frame, and cache the result.
+ */
+static sharkd_bitset_t *
+sharkd_session_filter_scan_all(const char *filter)
+{
+	sharkd_bitset_t *filtered = sharkd_session_filter_scan(filter, NULL);
+
+	if (!filtered)
+		return NULL;
+	return sharkd_session_filter_cache_insert(filter, filtered);
+}
+
+/*
+ * Split a filter at its top-level "&&"/"and" or "||"/"or" operators.
+ *
+ * Returns '&' or '|' if the filter is two or more terms joined by the same
+ * operator, with the terms added to terms, or 0 if it has no top-level
+ * operator, or mixes them.  (The display filter grammar gives "||" a
+ * higher precedence than "&&", which is easy to get wrong; a filter mixing
+ * them is just treated as a whole.)
+ */
+static char
+sharkd_session_filter_split(const char *filter, GPtrArray *terms)
+{
+	const char *term = filter;
+	const char *p = filter;
+	char op = 0;
+	int depth = 0;
+
+	while (*p)
+	{
+		char this_op = 0;
+		size_t op_len = 0;
+
+		if (*p == '"' || *p == '\'')
+		{
+			char quote = *p++;
+
+			while (*p && *p != quote)
+			{
+				if (*p == '\\' && p[1])
+					p++;
+				p++;
+			}
+			if (*p)
+				p++;
+			continue;
+		}
+
+		if (*p == '(' || *p == '[' || *p == '{')
+			depth++;
+		else if (*p == ')' || *p == ']' || *p == '}')
+			depth--;
+		else if (depth == 0)
+		{
+			if (p[0] == '&' && p[1] == '&')
+			{
+				this_op = '&';
+				op_len = 2;
+			}
+			else if (p[0] == '|' && p[1] == '|')
+			{
+				this_op = '|';
+				op_len = 2;
+			}
+			else if ((p == filter || !sharkd_session_filter_is_word_char(p[-1])))
+			{
+				if (!strncmp(p, "and", 3) && !sharkd_session_filter_is_word_char(p[3]))
+				{
+					this_op = '&';
+					op_len = 3;
+				}
+				else if (!strncmp(p, "or", 2) && !sharkd_session_filter_is_word_char(p[2]))
+				{
+					this_op = '|';
+					op_len = 2;
+				}
+			}
+		}
+
+		if (this_op)
+		{
+			if (op && op != this_op)
+				break;
+			op = this_op;
+			g_ptr_array_add(terms, g_strstrip(g_strndup(term, p - term)));
+			p += op_len;
+			term = p;
+			continue;
+		}
+		p++;
+	}
+
+	if (!op || *p || depth != 0)
+	{
+		g_ptr_array_set_size(terms, 0);
+		return 0;
+	}
+
+	g_ptr_array_add(terms, g_strstrip(g_strdup(term)));
+	return op;
+}
+
+/* Return the inside of filter if it's all in one pair of parentheses, NULL otherwise. */
+static char *
+sharkd_session_filter_unparenthesize(const char *filter)
+{
+	size_t len = strlen(filter);
+	char *inner;
+	int depth = 0;
+	const char *p;
+
+	if (len < 2 || filter[0] != '(' || filter[len - 1] != ')')
+		return NULL;
+
+	/* Check that the first parenthesis is the one closed at the end. */
+	inner = g_strndup(filter + 1, len - 2);
+	for (p = inner; *p; p++)
+	{
+		if (*p == '"' || *p == '\'')
+		{
+			char quote = *p;
+
+			while (p[1] && p[1] != quote)
+			{
+				if (p[1] == '\\' && p[2])
+					p++;
+				p++;
+			}
+			if (!p[1])
+				break;
+			p++;
+		}
+		else if (*p == '(')
+			depth++;
+		else if (*p == ')' && --depth < 0)
+			break;
+	}
+	if (*p || depth != 0)
 	{
-		guint8 *filtered = NULL;
+		g_free(inner);
+		return NULL;
+	}
+
+	return g_strstrip(inner);
+}
+
+/*
+ * If a filter with no top-level "&&" or "||" is "(x)", or the negation of
+ * a field name or of "(x)", return x, and set *negate in the latter case;
+ * otherwise return NULL.  ("!a == 1" isn't split, as which of "!(a == 1)"
+ * and "(!a) == 1" it means is up to the grammar.)
+ */
+static char *
+sharkd_session_filter_unwrap(const char *filter, gboolean *negate)
+{
+	const char *operand = NULL;
+	char *inner;
+
+	*negate = FALSE;
 
-		int ret = sharkd_filter(filter, &filtered);
+	if (filter[0] == '!' && filter[1] != '=')
+		operand = filter + 1;
+	else if (!strncmp(filter, "not", 3) && !sharkd_session_filter_is_word_char(filter[3]))
+		operand = filter + 3;
 
-		if (ret == -1)
+	if (!operand)
+		return sharkd_session_filter_unparenthesize(filter);
+
+	inner = g_strstrip(g_strdup(operand));
+	if (inner[0] != '(')
+	{
+		const char *p;
+
+		for (p = inner; *p; p++)
+		{
+			if (!sharkd_session_filter_is_word_char(*p))
+				break;
+		}
+		if (*p || p == inner)
+		{
+			g_free(inner);
 			return NULL;
+		}
+	}
+	else
+	{
+		char *parenthesized = sharkd_session_filter_unparenthesize(inner);
 
-		l = g_new(struct sharkd_filter_item, 1);
-		l->filtered = filtered;
+		if (!parenthesized)
+		{
+			g_free(inner);
+			return NULL;
+		}
+		g_free(parenthesized);
+	}
+
+	*negate = TRUE;
+	return inner;
+}
+
+/*
+ * Find the frames matching filter, which has already been checked to be
+ * valid, using the cached results for any of its subexpressions.
+ *
+ * If may_scan is FALSE, NULL is returned if that isn't enough, i.e. if
+ * frames would have to be dissected; otherwise, only the subexpressions
+ * that aren't cached are checked against the frames, and if some of the
+ * terms of an "&&" ("||") are cached, only the frames matching (not
+ * matching) those are.
+ *
+ * The result is owned by the cache.
+ */
+static sharkd_bitset_t *
+sharkd_session_filter_eval(const char *filter, gboolean may_scan)
+{
+	sharkd_bitset_t *filtered;
+	sharkd_bitset_t *known = NULL;
+	sharkd_bitset_t *candidates;
+	sharkd_bitset_t *matched;
+	GPtrArray *terms;
+	GString *residual;
+	gboolean negate;
+	char *inner;
+	char op;
+	guint i;
 
-		g_hash_table_insert(filter_table, g_strdup(filter), l);
+	filtered = sharkd_session_filter_cache_lookup(filter);
+	if (filtered)
+		return filtered;
+
+	terms = g_ptr_array_new_with_free_func(g_free);
+	op = sharkd_session_filter_split(filter, terms);
+	if (!op)
+	{
+		g_ptr_array_free(terms, TRUE);
+
+		inner = sharkd_session_filter_unwrap(filter, &negate);
+		if (inner)
+		{
+			sharkd_bitset_t *inner_filtered = sharkd_session_filter_eval(inner, may_scan && !negate);
+
+			g_free(inner);
+			if (!negate)
+				return inner_filtered;
+			if (inner_filtered)
+				return sharkd_session_filter_cache_insert(filter, sharkd_bitset_not(inner_filtered));
+		}
+		return may_scan ? sharkd_session_filter_scan_all(filter) : NULL;
 	}
 
-	return l;
+	residual = g_string_new(NULL);
+	for (i = 0; i < terms->len; i++)
+	{
+		const char *term = (const char *) g_ptr_array_index(terms, i);
+		sharkd_bitset_t *term_filtered = sharkd_session_filter_eval(term, FALSE);
+
+		if (!term_filtered)
+		{
+			if (residual->len)
+				g_string_append(residual, op == '&' ? " && " : " || ");
+			g_string_append_printf(residual, "(%s)", term);
+		}
+		else if (!known)
+		{
+			known = sharkd_bitset_copy(term_filtered);
+		}
+		else
+		{
+			sharkd_bitset_t *combined = op == '&' ? sharkd_bitset_and(known, term_filtered) : sharkd_bitset_or(known, term_filtered);
+
+			sharkd_bitset_free(known);
+			known = combined;
+		}
+	}
+	g_ptr_array_free(terms, TRUE);
+
+	if (!residual->len)
+	{
+		g_string_free(residual, TRUE);
+		return sharkd_session_filter_cache_insert(filter, known);
+	}
+
+	if (!known || !may_scan)
+	{
+		/* Nothing to go on, just check the filter as a whole. */
+		g_string_free(residual, TRUE);
+		sharkd_bitset_free(known);
+		return may_scan ? sharkd_session_filter_scan_all(filter) : NULL;
+	}
+
+	if (op == '&')
+	{
+		/* Only the frames matching the known terms can match. */
+		filtered = sharkd_session_filter_scan(residual->str, known);
+	}
+	else
+	{
+		/* The frames matching the known terms match anyway. */
+		candidates = sharkd_bitset_not(known);
+		matched = sharkd_session_filter_scan(residual->str, candidates);
+		if (matched)
+		{
+			filtered = sharkd_bitset_or(known, matched);
+			sharkd_bitset_free(matched);
+		}
+		sharkd_bitset_free(candidates);
+	}
+	g_string_free(residual, TRUE);
+	sharkd_bitset_free(known);
+
+	if (!filtered)
+		return sharkd_session_filter_scan_all(filter);
+	return sharkd_session_filter_cache_insert(filter, filtered);
+}
+
+static const sharkd_bitset_t *
+sharkd_session_filter_data(const char *filter)
+{
+	sharkd_bitset_t *filtered;
+	dfilter_t *dfcode = NULL;
+	char *key;
+
+	key = g_strstrip(g_strdup(filter));
+
+	filtered = sharkd_session_filter_cache_lookup(key);
+	if (!filtered)
+	{
+		if (!dfilter_compile(key, &dfcode, NULL))
+		{
+			g_free(key);
+			return NULL;
+		}
+
+		if (!dfcode)
+			filtered = sharkd_session_filter_cache_insert(key, sharkd_bitset_new_full(cfile.count));
+		else if (strstr(key, "_displayed"))
+		{
+			/*
+			 * Whether a frame matches depends on which frames before it
+			 * matched (e.g. frame.time_delta_displayed), so this filter
+			 * can't be split up, or checked against only some frames.
+			 */
+			filtered = sharkd_session_filter_scan_all(key);
+		}
+		else
+		{
+			filtered = sharkd_session_filter_eval(key, TRUE);
+		}
+
+		dfilter_free(dfcode);
+		sharkd_session_filter_cache_trim();
+	}
+
+	g_free(key);
+	return filtered;
 }
 
 static gboolean
@@ -1065,6 +1500,9 @@ sharkd_session_process_load(const char *buf, const jsmntok_t *tokens, int count)
 
 	fprintf(stderr, "load: filename=%s\n", tok_file);
 
+	/* The cached filter results are for the frames of the previous file. */
+	sharkd_session_filter_cache_clear();
+
 	if (sharkd_cf_open(tok_file, WTAP_TYPE_AUTO, FALSE, &err) != CF_OK)
 	{
 		sharkd_json_error(
@@ -1402,7 +1840,7 @@ sharkd_session_process_frames(const char *buf, const jsmntok_t *tokens, int coun
 	const char *tok_limit  = json_find_attr(buf, tokens, count, "limit");
 	const char *tok_refs   = json_find_attr(buf, tokens, count, "refs");
 
-	const guint8 *filter_data = NULL;
+	const sharkd_bitset_t *filter_data = NULL;
 
 	guint32 next_ref_frame = G_MAXUINT32;
 	guint32 skip;
@@ -1429,10 +1867,8 @@ sharkd_session_process_frames(const char *buf, const jsmntok_t *tokens, int coun
 
 	if (tok_filter)
 	{
-		const struct sharkd_filter_item *filter_item;
-
-		filter_item = sharkd_session_filter_data(tok_filter);
-		if (!filter_item)
+		filter_data = sharkd_session_filter_data(tok_filter);
+		if (!filter_data)
 		{
 			sharkd_json_error(
 				rpcid, -13002, NULL,
@@ -1440,8 +1876,6 @@ sharkd_session_process_frames(const char *buf, const jsmntok_t *tokens, int coun
 			);
 			return;
 		}
-
-		filter_data = filter_item->filtered;
 	}
 
 	skip = 0;
@@ -1476,7 +1910,7 @@ sharkd_session_process_frames(const char *buf, const jsmntok_t *tokens, int coun
 		int err;
 		gchar *err_info;
 
-		if (filter_data && !(filter_data[framenum / 8] & (1 << (framenum % 8))))
+		if (filter_data && !sharkd_bitset_contains(filter_data, framenum))
 			continue;
 
 		if (skip)
@@ -3816,7 +4250,7 @@ sharkd_session_process_intervals(char *buf, const jsmntok_t *tokens, int count)
 	const char *tok_interval = json_find_attr(buf, tokens, count, "interval");
 	const char *tok_filter = json_find_attr(buf, tokens, count, "filter");
 
-	const guint8 *filter_data = NULL;
+	const sharkd_bitset_t *filter_data = NULL;
 
 	struct
 	{
@@ -3836,10 +4270,8 @@ sharkd_session_process_intervals(char *buf, const jsmntok_t *tokens, int count)
 
 	if (tok_filter)
 	{
-		const struct sharkd_filter_item *filter_item;
-
-		filter_item = sharkd_session_filter_data(tok_filter);
-		if (!filter_item)
+		filter_data = sharkd_session_filter_data(tok_filter);
+		if (!filter_data)
 		{
 			sharkd_json_error(
 				rpcid, -7001, NULL,
@@ -3847,7 +4279,6 @@ sharkd_session_process_intervals(char *buf, const jsmntok_t *tokens, int count)
 			);
 			return;
 		}
-		filter_data = filter_item->filtered;
 	}
 
 	st_total.frames = 0;
@@ -3869,7 +4300,7 @@ sharkd_session_process_intervals(char *buf, const jsmntok_t *tokens, int count)
 		gint64 msec_rel;
 		gint64 new_idx;
 
-		if (filter_data && !(filter_data[framenum / 8] & (1 << (framenum % 8))))
+		if (filter_data && !sharkd_bitset_contains(filter_data, framenum))
 			continue;
 
 		fdata = sharkd_get_frame(framenum);
@@ -5080,6 +5511,7 @@ sharkd_session_main(int mode_setting)
 		sharkd_session_process(buf, tokens, ret);
 	}
 
+	sharkd_session_filter_cache_clear();
 	g_hash_table_destroy(filter_table);
 	g_free(tokens);
 
@@ -116,6 +116,11 @@ def cmd_rawshark(program):
     return program('rawshark')
 
 
+@fixtures.fixture(scope='session')
+def cmd_reordercap(program):
+    return program('reordercap')
+
+
 @fixtures.fixture(scope='session')
 def cmd_tshark(program):
     return program('tshark')
@@ -184,6 +189,9 @@ def features(cmd_tshark, make_env):
         have_gnutls='with GnuTLS' in tshark_v,
         have_pkcs11='and PKCS #11 support' in tshark_v,
         have_brotli='with brotli' in tshark_v,
+        have_zlib='with zlib' in tshark_v,
+        have_zstd='with Zstandard' in tshark_v,
+        have_lz4='with LZ4' in tshark_v,
         have_plugins='binary plugins supported' in tshark_v,
     )
 
@@ -0,0 +1,34 @@
+-- change_file_size.lua
+-- Change the size of the capture file being read once a given frame has
+-- been dissected, as if another process had truncated it or appended to it.
+--
+-- Arguments: the capture file, the frame number, and either "truncate" or
+-- "append" followed by a file holding the data to append.
+
+local arg = {...}
+local capture_file = arg[1]
+local frame = tonumber(arg[2])
+local action = arg[3]
+local append_file = arg[4]
+
+local tap = Listener.new()
+
+function tap.packet(pinfo)
+    if pinfo.number ~= frame then
+        return
+    end
+
+    if action == "truncate" then
+        local f = assert(io.open(capture_file, "wb"))
+        f:close()
+    elseif action == "append" then
+        local src = assert(io.open(append_file, "rb"))
+        local data = src:read("*all")
+        src:close()
+        local f = assert(io.open(capture_file, "ab"))
+        f:write(data)
+        f:close()
+    else
+        error("unknown action " .. tostring(action))
+    end
+end
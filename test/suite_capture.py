@@ -13,6 +13,7 @@ import glob
 import hashlib
 import os
 import socket
+import struct
 import subprocess
 import subprocesstest
 import sys
@@ -306,6 +307,57 @@ def check_dumpcap_ringbuffer_stdin(cmd_dumpcap):
     return check_dumpcap_ringbuffer_stdin_real
 
 
+@fixtures.fixture
+def check_dumpcap_ringbuffer_compressed(cmd_dumpcap, features):
+    if sys.platform == 'win32':
+        fixtures.skip('Test requires OS fifo support.')
+    # File name extension, first bytes of the file, and whether we have it
+    compress_types = {
+        'gzip': ('.gz', b'\x1f\x8b', features.have_zlib),
+        'zstd': ('.zst', b'\x28\xb5\x2f\xfd', features.have_zstd),
+        'lz4': ('.lz4', b'\x04\x22\x4d\x18', features.have_lz4),
+    }
+    def check_dumpcap_ringbuffer_compressed_real(self, compress_type, packets):
+        # Similar to check_capture_fifo and check_dumpcap_ringbuffer_stdin.
+        extension, magic, have_type = compress_types[compress_type]
+        if not have_type:
+            fixtures.skip('Requires {} support.'.format(compress_type))
+        rb_unique = 'dhcp_rb_' + uuid.uuid4().hex[:6] # Random ID
+        testout_file = '{}.{}.pcapng'.format(self.id(), rb_unique)
+        testout_glob = '{}.{}_*.pcapng{}'.format(self.id(), rb_unique, extension)
+        fifo_file = self.filename_from_id('testout.fifo')
+        try:
+            # If a previous test left its fifo laying around, e.g. from a failure, remove it.
+            os.unlink(fifo_file)
+        except Exception:
+            pass
+        os.mkfifo(fifo_file)
+        cat100_dhcp_cmd = subprocesstest.cat_dhcp_command('cat100')
+        fifo_proc = self.startProcess(
+            ('{0} > {1}'.format(cat100_dhcp_cmd, fifo_file)),
+            shell=True)
+        capture_proc = self.assertRun(capture_command(cmd_dumpcap,
+            '-i', fifo_file,
+            '-w', testout_file,
+            '-a', 'files:2',
+            '-b', 'packets:{}'.format(packets),
+            '--compress-type', compress_type,
+        ))
+        fifo_proc.kill()
+
+        rb_files = glob.glob(testout_glob)
+        for rbf in rb_files:
+            self.cleanup_files.append(rbf)
+
+        self.assertEqual(len(rb_files), 2)
+
+        for rbf in rb_files:
+            with open(rbf, 'rb') as f:
+                self.assertEqual(f.read(len(magic)), magic)
+            self.checkPacketCount(packets, cap_file=rbf)
+    return check_dumpcap_ringbuffer_compressed_real
+
+
 @fixtures.fixture
 def check_dumpcap_pcapng_sections(cmd_dumpcap, cmd_tshark, capture_file):
     if sys.platform == 'win32':
@@ -472,6 +524,58 @@ def check_dumpcap_pcapng_sections(cmd_dumpcap, cmd_tshark, capture_file):
     return check_dumpcap_pcapng_sections_real
 
 
+@fixtures.fixture
+def check_dumpcap_live_feed(cmd_dumpcap):
+    if sys.platform == 'win32':
+        fixtures.skip('Live feeds require mmap().')
+    def check_dumpcap_live_feed_real(self, feed_size):
+        # Similar to check_dumpcap_autostop_stdin.  The feed's header is
+        # a magic number, the data size, a sequence number, padding, and
+        # the device and inode numbers, length and generation of the
+        # file being written, in native byte order; the data starts at
+        # offset 64.
+        testout_file = self.filename_from_id(testout_pcapng)
+        feed_file = self.filename_from_id('testout.feed')
+        header_fmt = '=IIiIQQQQ'
+        with open(feed_file, 'wb') as f:
+            f.write(struct.pack(header_fmt, 0x57534c46, feed_size, 0, 0, 0, 0, 0, 0))
+            f.write(b'\0' * (64 - struct.calcsize(header_fmt) + feed_size))
+        cat100_dhcp_cmd = subprocesstest.cat_dhcp_command('cat100')
+
+        cmd_ = '"{}"'.format(cmd_dumpcap)
+        capture_cmd = ' '.join((cmd_,
+            '-i', '-',
+            '-w', testout_file,
+            '--live-feed', feed_file,
+            '-a', 'packets:97',
+        ))
+        pipe_proc = self.assertRun(cat100_dhcp_cmd + ' | ' + capture_cmd, shell=True)
+        self.checkPacketCount(97)
+
+        with open(feed_file, 'rb') as f:
+            feed = f.read()
+        with open(testout_file, 'rb') as f:
+            capture = f.read()
+        magic, size, seq, _, file_dev, file_ino, head, generation = \
+            struct.unpack_from(header_fmt, feed)
+        self.assertEqual(magic, 0x57534c46)
+        self.assertEqual(size, feed_size)
+        self.assertEqual(seq % 2, 0)
+        statb = os.stat(testout_file)
+        self.assertEqual(file_dev, statb.st_dev)
+        self.assertEqual(file_ino, statb.st_ino)
+        self.assertEqual(head, len(capture))
+        self.assertEqual(generation, 1)
+
+        # The feed holds the last feed_size bytes written, in a ring.
+        data = feed[64:]
+        kept = min(head, feed_size)
+        for offset in range(head - kept, head):
+            if data[offset % feed_size] != capture[offset]:
+                self.fail('Live feed differs from the capture file at offset {}'.format(offset))
+    return check_dumpcap_live_feed_real
+
+
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
 class case_wireshark_capture(subprocesstest.SubprocessTestCase):
@@ -548,6 +652,18 @@ class case_dumpcap_capture(subprocesstest.SubprocessTestCase):
         '''Capture truncated packets using Dumpcap'''
         check_capture_snapshot_len(self, cmd=cmd_dumpcap)
 
+    def test_dumpcap_capture_10_packets_fanout(self, cmd_dumpcap, check_capture_10_packets):
+        '''Capture 10 packets from the network to a file using Dumpcap with a fanout group'''
+        if not sys.platform.startswith('linux'):
+            fixtures.skip('Fanout capture is only supported on Linux')
+        check_capture_10_packets(self, cmd=(cmd_dumpcap, '--fanout', '2'))
+
+    def test_dumpcap_capture_from_fifo_fanout(self, cmd_dumpcap, check_capture_fifo):
+        '''Capture from a fifo using Dumpcap with a fanout group, which only applies to network interfaces'''
+        if not sys.platform.startswith('linux'):
+            fixtures.skip('Fanout capture is only supported on Linux')
+        check_capture_fifo(self, cmd=(cmd_dumpcap, '--fanout', '2'))
+
 
 @fixtures.mark_usefixtures('base_env')
 @fixtures.uses_fixtures
@@ -574,6 +690,30 @@ class case_dumpcap_ringbuffer(subprocesstest.SubprocessTestCase):
         '''Capture from stdin using Dumpcap and write multiple files until we reach a packet limit'''
         check_dumpcap_ringbuffer_stdin(self, packets=47) # Last prime before 50. Arbitrary.
 
+    def test_dumpcap_ringbuffer_gzip(self, check_dumpcap_ringbuffer_compressed):
+        '''Capture from a fifo using Dumpcap and write multiple gzip-compressed files'''
+        check_dumpcap_ringbuffer_compressed(self, 'gzip', packets=47)
+
+    def test_dumpcap_ringbuffer_zstd(self, check_dumpcap_ringbuffer_compressed):
+        '''Capture from a fifo using Dumpcap and write multiple zstd-compressed files'''
+        check_dumpcap_ringbuffer_compressed(self, 'zstd', packets=47)
+
+    def test_dumpcap_ringbuffer_lz4(self, check_dumpcap_ringbuffer_compressed):
+        '''Capture from a fifo using Dumpcap and write multiple lz4-compressed files'''
+        check_dumpcap_ringbuffer_compressed(self, 'lz4', packets=47)
+
+
+@fixtures.mark_usefixtures('base_env')
+@fixtures.uses_fixtures
+class case_dumpcap_live_feed(subprocesstest.SubprocessTestCase):
+    def test_dumpcap_live_feed(self, check_dumpcap_live_feed):
+        '''Capture from stdin using Dumpcap, sharing what's written in a live feed'''
+        check_dumpcap_live_feed(self, feed_size=1024 * 1024)
+
+    def test_dumpcap_live_feed_wrap(self, check_dumpcap_live_feed):
+        '''Capture from stdin using Dumpcap, sharing what's written in a live feed smaller than the file'''
+        check_dumpcap_live_feed(self, feed_size=4096)
+
 
 @fixtures.mark_usefixtures('base_env')
 @fixtures.uses_fixtures
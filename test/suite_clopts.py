@@ -288,6 +288,43 @@ class case_tshark_z_expert(subprocesstest.SubprocessTestCase):
         self.assertFalse(self.grepOutput('Chats'))
 
 
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_tshark_z_multiple(subprocesstest.SubprocessTestCase):
+    # Several listeners on the same taps and with the same filters as each
+    # other; each must see the same packets as it does on its own.
+    stats = (
+        'conv,ip,icmp',
+        'endpoints,ip,icmp',
+        'conv,ip,dns',
+        'conv,ip,tcp',
+        'conv,udp',
+        'endpoints,udp,dns',
+        'expert,icmp',
+    )
+
+    def check_tshark_z_multiple(self, cmd_tshark, capture_file, stats):
+        separate = []
+        for stat in stats:
+            proc = self.assertRun((cmd_tshark, '-q', '-z', stat,
+                '-r', capture_file('dns+icmp.pcapng.gz')))
+            separate.append(proc.stdout_str.strip())
+        z_args = []
+        for stat in stats:
+            z_args += ['-z', stat]
+        proc = self.assertRun([cmd_tshark, '-q'] + z_args
+            + ['-r', capture_file('dns+icmp.pcapng.gz')])
+        combined = proc.stdout_str
+        for stat, output in zip(stats, separate):
+            self.assertIn(output, combined, 'Output of -z {} differs'.format(stat))
+
+    def test_tshark_z_multiple(self, cmd_tshark, capture_file):
+        self.check_tshark_z_multiple(cmd_tshark, capture_file, self.stats)
+
+    def test_tshark_z_multiple_reversed(self, cmd_tshark, capture_file):
+        self.check_tshark_z_multiple(cmd_tshark, capture_file, tuple(reversed(self.stats)))
+
+
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
 class case_tshark_extcap(subprocesstest.SubprocessTestCase):
@@ -0,0 +1,100 @@
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import os.path
+import subprocess
+import unittest
+import fixtures
+from suite_dfilter.dfiltertest import *
+
+# Coloring rules are compiled into a single program that returns the first
+# rule that matches, with dfilter_compile_list() and dfilter_apply_first_edt().
+# Check that the rule it picks for each packet is the first one whose filter,
+# applied on its own, matches the packet.
+
+# (name, filter, disabled)
+coloring_rules = (
+    ('Echo reply', 'icmp.type == 0', False),
+    ('Disabled ICMP', 'icmp', True),
+    ('DNS response', 'dns.flags.response == 1 && udp.srcport == 53', False),
+    ('Long IP', 'ip.len > 80', False),
+    ('Short UDP', 'ip.len <= 80 && udp', False),
+    ('ICMP or UDP', 'icmp || udp', False),
+    ('Never', 'ip.len > 80 && ip.len <= 80', False),
+)
+
+
+@fixtures.fixture
+def frames_matching(cmd_tshark, capture_file, base_env, request):
+    def frames_matching_real(dfilter):
+        '''Frame numbers of the packets that match dfilter.'''
+        output = subprocess.check_output((cmd_tshark,
+                                          '-n',
+                                          '-r', capture_file(request.instance.trace_file),
+                                          '-Y', dfilter,
+                                          '-Tfields', '-e', 'frame.number'),
+                                         universal_newlines=True,
+                                         env=base_env)
+        return set(int(line) for line in output.splitlines())
+    return frames_matching_real
+
+
+@fixtures.fixture
+def checkColoringRules(cmd_tshark, capture_file, conf_path, base_env, frames_matching, request):
+    def checkColoringRules_real(rules):
+        '''Color the trace file with rules, and check that each packet gets
+        the first enabled rule that matches it on its own.'''
+        with open(os.path.join(conf_path, 'colorfilters'), 'w') as f:
+            for name, dfilter, disabled in rules:
+                f.write('{}@{}@{}@[65535,65535,65535][0,0,0]\n'.format(
+                    '!' if disabled else '', name, dfilter))
+        output = subprocess.check_output((cmd_tshark,
+                                          '-n', '--color',
+                                          '-r', capture_file(request.instance.trace_file),
+                                          '-Tfields',
+                                          '-e', 'frame.number',
+                                          '-e', 'frame.coloring_rule.name'),
+                                         universal_newlines=True,
+                                         env=base_env)
+        colored = {}
+        for line in output.splitlines():
+            number, _, name = line.partition('\t')
+            colored[int(number)] = name
+        assert colored, 'No packets read'
+
+        matches = [(name, frames_matching(dfilter)) for name, dfilter, disabled in rules if not disabled]
+        for number, name in colored.items():
+            expected = next((rule_name for rule_name, frames in matches if number in frames), '')
+            assert name == expected, \
+                'Frame %d: expected coloring rule %r, got %r' % (number, expected, name)
+        return colored
+    return checkColoringRules_real
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_first_match(unittest.TestCase):
+    trace_file = "dns+icmp.pcapng.gz"
+
+    def test_first_match_1(self, checkColoringRules, frames_matching):
+        colored = checkColoringRules(coloring_rules)
+        # Several rules matched, earlier rules took packets that the
+        # catch-all rule matches too, and a disabled rule that matches
+        # some packets was skipped.
+        names = set(colored.values())
+        assert len(names) > 1, names
+        catch_all = [number for number, name in colored.items() if name == 'ICMP or UDP']
+        assert len(catch_all) < len(frames_matching('icmp || udp'))
+        assert frames_matching('icmp')
+        assert 'Disabled ICMP' not in names
+        assert 'Never' not in names
+
+    def test_first_match_reversed(self, checkColoringRules):
+        checkColoringRules(tuple(reversed(coloring_rules)))
+
+    def test_first_match_one_rule(self, checkColoringRules):
+        checkColoringRules((('ICMP or UDP', 'icmp || udp', False),))
+
+    def test_first_match_all_disabled(self, checkColoringRules):
+        colored = checkColoringRules((('Disabled ICMP', 'icmp', True),))
+        assert set(colored.values()) == {''}
@@ -0,0 +1,138 @@
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+
+import subprocess
+import unittest
+import fixtures
+from suite_dfilter.dfiltertest import *
+
+# A field compared against a constant is compiled into a single TREE_CMP
+# instruction, or TREE_UINT_CMP if every field with the name is a 32-bit
+# unsigned integer, that looks at the values in the tree directly.  Check
+# that those give the same results as the general code, including for
+# fields that appear more than once in a packet, negated tests, and
+# ranges built from two comparisons.
+#
+# dhcp.pcap has two DHCP exchanges; frames 1 and 3 are 314 bytes long,
+# from 0.0.0.0 port 68 to 255.255.255.255 port 67, and frames 2 and 4
+# are 342 bytes long, from 192.168.0.1 port 67 to 192.168.0.10 port 68.
+
+
+@fixtures.fixture
+def checkDFilterCode(cmd_dftest, base_env):
+    def checkDFilterCode_real(dfilter, instruction):
+        """Compile a display filter and expect its code to use instruction."""
+        output = subprocess.check_output((cmd_dftest, dfilter),
+                                         universal_newlines=True,
+                                         env=base_env)
+        assert ' {}\t'.format(instruction) in output, \
+            'Expected %s in the code for %r:\n%s' % (instruction, dfilter, output)
+    return checkDFilterCode_real
+
+
+@fixtures.uses_fixtures
+class case_tree_cmp(unittest.TestCase):
+    trace_file = "dhcp.pcap"
+
+    def test_uint32_code(self, checkDFilterCode):
+        checkDFilterCode("frame.len == 314", "TREE_UINT_CMP")
+
+    def test_uint32_eq(self, checkDFilterCount):
+        checkDFilterCount("frame.len == 314", 2)
+
+    def test_uint32_eq_none(self, checkDFilterCount):
+        checkDFilterCount("frame.len == 0", 0)
+
+    def test_uint32_ne(self, checkDFilterCount):
+        checkDFilterCount("frame.len != 314", 2)
+
+    def test_uint32_gt(self, checkDFilterCount):
+        checkDFilterCount("frame.len > 314", 2)
+
+    def test_uint32_ge(self, checkDFilterCount):
+        checkDFilterCount("frame.len >= 314", 4)
+
+    def test_uint32_lt(self, checkDFilterCount):
+        checkDFilterCount("frame.len < 342", 2)
+
+    def test_uint32_le(self, checkDFilterCount):
+        checkDFilterCount("frame.len <= 341", 2)
+
+    def test_uint32_bitwise_and(self, checkDFilterCount):
+        # 342 has bit 2 set, 314 doesn't.
+        checkDFilterCount("frame.len & 4", 2)
+
+    def test_uint32_hex(self, checkDFilterCount):
+        checkDFilterCount("dhcp.id == 0x3d1e", 2)
+
+    def test_uint32_not(self, checkDFilterCount):
+        checkDFilterCount("!(frame.len == 314)", 2)
+
+    def test_uint32_not_none(self, checkDFilterCount):
+        checkDFilterCount("!(frame.len > 400)", 4)
+
+    def test_uint32_range(self, checkDFilterCount):
+        checkDFilterCount("frame.len >= 314 && frame.len <= 342", 4)
+
+    def test_uint32_range_empty(self, checkDFilterCount):
+        checkDFilterCount("frame.len > 314 && frame.len < 342", 0)
+
+    def test_uint32_outside_range(self, checkDFilterCount):
+        checkDFilterCount("frame.len < 320 || frame.len > 340", 4)
+
+    def test_uint32_not_range(self, checkDFilterCount):
+        checkDFilterCount("!(frame.len > 300 && frame.len < 320)", 2)
+
+    def test_uint16_code(self, checkDFilterCode):
+        checkDFilterCode("ip.len == 300", "TREE_CMP")
+
+    def test_uint16_eq(self, checkDFilterCount):
+        checkDFilterCount("ip.len == 300", 2)
+
+    def test_uint16_gt(self, checkDFilterCount):
+        checkDFilterCount("ip.len > 300", 2)
+
+    def test_uint8_range(self, checkDFilterCount):
+        checkDFilterCount("ip.ttl >= 128 && ip.ttl < 250", 2)
+
+    def test_two_fields(self, checkDFilterCount):
+        checkDFilterCount("ip.len == 300 && udp.length == 280", 2)
+
+    def test_any_eq(self, checkDFilterCount):
+        # udp.port is both the source and the destination port.
+        checkDFilterCount("udp.port == 67", 4)
+
+    def test_any_ne(self, checkDFilterCount):
+        # Each packet has a port that isn't 67.
+        checkDFilterCount("udp.port != 67", 4)
+
+    def test_any_not(self, checkDFilterCount):
+        checkDFilterCount("!(udp.port == 68)", 0)
+
+    def test_one_of_fields(self, checkDFilterCount):
+        checkDFilterCount("udp.srcport == 67", 2)
+
+    def test_ipv4_eq(self, checkDFilterCount):
+        checkDFilterCount("ip.addr == 192.168.0.10", 2)
+
+    def test_ipv4_ne(self, checkDFilterCount):
+        # The destination of frames 1 and 3 isn't 0.0.0.0.
+        checkDFilterCount("ip.addr != 0.0.0.0", 4)
+
+    def test_ipv4_not(self, checkDFilterCount):
+        checkDFilterCount("!(ip.addr == 0.0.0.0)", 2)
+
+    def test_ipv4_subnet(self, checkDFilterCount):
+        checkDFilterCount("ip.src == 192.168.0.0/24", 2)
+
+    def test_ether_eq(self, checkDFilterCount):
+        checkDFilterCount("eth.dst == ff:ff:ff:ff:ff:ff", 2)
+
+    def test_ether_contains(self, checkDFilterCount):
+        checkDFilterCount("eth.src contains fc:42", 2)
+
+    def test_absent(self, checkDFilterCount):
+        checkDFilterCount("tcp.port == 80", 0)
+
+    def test_absent_not(self, checkDFilterCount):
+        checkDFilterCount("!(tcp.port == 80)", 4)
@@ -235,6 +235,31 @@ class case_fileformat_pcapng_dsb(subprocesstest.SubprocessTestCase):
         ))
 
 
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_fileformat_pcapng_comments(subprocesstest.SubprocessTestCase):
+    def test_pcapng_comment_no_options(self, cmd_editcap, cmd_tshark, capture_file):
+        '''Add a comment to pcapng packets that have no options.'''
+        # The packets in dhcp.pcapng have no options, so the reader
+        # doesn't supply a block for them.
+        outfile = self.filename_from_id('dhcp-comments.pcapng')
+        self.assertRun((cmd_editcap,
+            '-a', '2:Second packet',
+            '-a', '4:Fourth packet',
+            capture_file('dhcp.pcapng'), outfile
+        ))
+        proc = self.assertRun((cmd_tshark,
+            '-r', outfile,
+            '-Tfields', '-e', 'frame.number', '-e', 'frame.comment',
+        ))
+        self.assertEqual(proc.stdout_str.splitlines(), [
+            '1\t',
+            '2\tSecond packet',
+            '3\t',
+            '4\tFourth packet',
+        ])
+
+
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
 class case_fileformat_mime(subprocesstest.SubprocessTestCase):
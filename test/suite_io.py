@@ -10,6 +10,8 @@
 
 import io
 import os.path
+import shutil
+import struct
 import subprocesstest
 import sys
 import unittest
@@ -69,6 +71,332 @@ class case_tshark_io(subprocesstest.SubprocessTestCase):
         '''Read direct and write direct using TShark'''
         check_io_4_packets(self, capture_file, cmd=cmd_tshark)
 
+    def test_tshark_io_two_pass_read_ahead(self, cmd_tshark, capture_file):
+        '''Two-pass read-ahead output matches plain two-pass output'''
+        plain_proc = self.assertRun((cmd_tshark,
+            '-r', capture_file('http.pcap'), '-2', '-V',
+        ))
+        read_ahead_proc = self.assertRun((cmd_tshark,
+            '-r', capture_file('http.pcap'), '-2', '-V', '--read-ahead', '4',
+        ))
+        self.assertEqual(plain_proc.stdout_str, read_ahead_proc.stdout_str)
+
+    def run_frame_index(self, cmd_tshark, index_capture, run):
+        '''Copy index_capture with a two-pass frame index run, and return
+        the time stamps of the packets written.'''
+        testout_file = self.filename_from_id('frame-index-{}.pcap'.format(run))
+        self.assertRun((cmd_tshark,
+            '-r', index_capture, '-2', '--frame-index',
+            '-F', 'pcap', '-w', testout_file,
+        ))
+        return read_pcap_times(testout_file)
+
+    def set_frame_index_count(self, index_capture, count):
+        # The entry count is at offset 32 of the header.
+        with open(index_capture + '.frameidx', 'r+b') as f:
+            f.seek(32)
+            f.write(struct.pack('<I', count))
+
+    def test_tshark_io_two_pass_frame_index(self, cmd_tshark, capture_file):
+        '''The frame index is created, reused, and read by the first pass'''
+        index_capture = self.filename_from_id('frame-index.pcap')
+        shutil.copy(capture_file('dhcp.pcap'), index_capture)
+        created = self.run_frame_index(cmd_tshark, index_capture, 'create')
+        self.assertEqual(len(created), 4)
+        index_stat = os.stat(index_capture + '.frameidx')
+        self.assertEqual(self.run_frame_index(cmd_tshark, index_capture, 'use'), created)
+        # It wasn't rebuilt, which would have renamed a new file into place.
+        reused_stat = os.stat(index_capture + '.frameidx')
+        self.assertEqual(reused_stat.st_ino, index_stat.st_ino)
+        self.assertEqual(reused_stat.st_mtime_ns, index_stat.st_mtime_ns)
+        # The first pass takes the frame list from the index, so an index
+        # listing only the first frame gives only one packet.
+        self.set_frame_index_count(index_capture, 1)
+        self.assertEqual(len(self.run_frame_index(cmd_tshark, index_capture, 'one')), 1)
+
+    def test_tshark_io_two_pass_frame_index_stale_mtime(self, cmd_tshark, capture_file):
+        '''A frame index is rebuilt if its capture's modification time changes'''
+        index_capture = self.filename_from_id('frame-index.pcap')
+        shutil.copy(capture_file('dhcp.pcap'), index_capture)
+        self.run_frame_index(cmd_tshark, index_capture, 'create')
+        self.set_frame_index_count(index_capture, 1)
+        capture_stat = os.stat(index_capture)
+        os.utime(index_capture, ns=(capture_stat.st_atime_ns, capture_stat.st_mtime_ns + 1000000000))
+        self.assertEqual(len(self.run_frame_index(cmd_tshark, index_capture, 'stale')), 4)
+        # The rebuilt index is used.
+        self.assertEqual(len(self.run_frame_index(cmd_tshark, index_capture, 'use')), 4)
+        self.set_frame_index_count(index_capture, 1)
+        self.assertEqual(len(self.run_frame_index(cmd_tshark, index_capture, 'one')), 1)
+
+    def test_tshark_io_two_pass_frame_index_stale_size(self, cmd_tshark, capture_file):
+        '''A frame index is rebuilt if its capture's size changes'''
+        index_capture = self.filename_from_id('frame-index.pcap')
+        shutil.copy(capture_file('dhcp.pcap'), index_capture)
+        self.run_frame_index(cmd_tshark, index_capture, 'create')
+        # Append a second copy of the packets, but keep the old
+        # modification time; the index's entries are still valid ones.
+        capture_stat = os.stat(index_capture)
+        write_dhcp_copies(capture_file, index_capture, 2)
+        os.utime(index_capture, ns=(capture_stat.st_atime_ns, capture_stat.st_mtime_ns))
+        self.assertEqual(len(self.run_frame_index(cmd_tshark, index_capture, 'stale')), 8)
+
+    def test_tshark_io_two_pass_frame_index_damaged(self, cmd_tshark, capture_file):
+        '''A frame index with out of range entries is ignored'''
+        index_capture = self.filename_from_id('frame-index.pcap')
+        shutil.copy(capture_file('http.pcap'), index_capture)
+        testout_file = self.filename_from_id('frame-index-create.pcap')
+        self.assertRun((cmd_tshark,
+            '-r', index_capture, '-2', '--frame-index',
+            '-F', 'pcap', '-w', testout_file,
+        ))
+        with open(testout_file, 'rb') as f:
+            expected = f.read()
+        # Give the first entry (which follows the 40-byte header) a huge
+        # captured length and a time stamp precision frame_data can't hold.
+        with open(index_capture + '.frameidx', 'r+b') as f:
+            f.seek(40 + 20)
+            f.write(b'\xff\xff\xff\x7f')
+            f.seek(40 + 31)
+            f.write(b'\xff')
+        testout_file = self.filename_from_id('frame-index-damaged.pcap')
+        self.assertRun((cmd_tshark,
+            '-r', index_capture, '-2', '--frame-index',
+            '-F', 'pcap', '-w', testout_file,
+        ))
+        with open(testout_file, 'rb') as f:
+            self.assertEqual(f.read(), expected)
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_compressed_random_access(subprocesstest.SubprocessTestCase):
+    # The multi-frame captures hold a 300-frame pcap file compressed as a
+    # series of 4 KiB zstd or lz4 frames; multi-frame-skippable.pcap.zst
+    # adds a zstd skippable frame after the third frame and at the end.
+    # Its frames are in six blocks whose time stamps are in reverse order,
+    # so reordercap reads them back to front.
+    def check_random_access(self, cmd_tshark, cmd_editcap, cmd_reordercap, capture_file, name):
+        compressed_file = capture_file(name)
+        # Sequential reads.
+        one_pass_proc = self.assertRun((cmd_tshark, '-r', compressed_file, '-x'))
+        uncompressed_file = self.filename_from_id('uncompressed.pcap')
+        self.assertRun((cmd_editcap, '-F', 'pcap', compressed_file, uncompressed_file))
+        # Random access.
+        two_pass_proc = self.assertRun((cmd_tshark, '-r', compressed_file, '-2', '-x'))
+        self.assertEqual(one_pass_proc.stdout_str, two_pass_proc.stdout_str)
+        outputs = []
+        for infile in (uncompressed_file, compressed_file):
+            testout_file = self.filename_from_id('reordered-{}.pcap'.format(len(outputs)))
+            self.assertRun((cmd_reordercap, infile, testout_file))
+            with open(testout_file, 'rb') as f:
+                outputs.append(f.read())
+        self.assertEqual(outputs[0], outputs[1])
+
+    def test_random_access_zstd(self, cmd_tshark, cmd_editcap, cmd_reordercap, capture_file, features):
+        '''Random access to a capture compressed as several zstd frames'''
+        if not features.have_zstd:
+            self.skipTest('Requires Zstandard.')
+        self.check_random_access(cmd_tshark, cmd_editcap, cmd_reordercap, capture_file,
+            'multi-frame.pcap.zst')
+
+    def test_random_access_zstd_skippable(self, cmd_tshark, cmd_editcap, cmd_reordercap, capture_file, features):
+        '''Random access to a capture compressed as zstd frames with skippable frames'''
+        if not features.have_zstd:
+            self.skipTest('Requires Zstandard.')
+        self.check_random_access(cmd_tshark, cmd_editcap, cmd_reordercap, capture_file,
+            'multi-frame-skippable.pcap.zst')
+
+    def test_random_access_lz4(self, cmd_tshark, cmd_editcap, cmd_reordercap, capture_file, features):
+        '''Random access to a capture compressed as several lz4 frames'''
+        if not features.have_lz4:
+            self.skipTest('Requires LZ4.')
+        self.check_random_access(cmd_tshark, cmd_editcap, cmd_reordercap, capture_file,
+            'multi-frame.pcap.lz4')
+
+
+def write_dhcp_copies(capture_file, out_file, copies):
+    '''Write a pcap file holding the records of dhcp.pcap copies times,
+    and return the bytes of its first record.'''
+    with open(capture_file('dhcp.pcap'), 'rb') as f:
+        dhcp = f.read()
+    records = dhcp[24:]
+    # dhcp.pcap is little-endian; the record length is at offset 8.
+    first_record = records[:16 + int.from_bytes(records[8:12], 'little')]
+    with open(out_file, 'wb') as f:
+        f.write(dhcp[:24])
+        for _ in range(copies):
+            f.write(records)
+    return first_record
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_mapped_read(subprocesstest.SubprocessTestCase):
+    # Uncompressed pcap and pcapng files are read through a memory mapping.
+    # The captures are a few MiB, so that the reader checks the size of
+    # the file several times while reading them.
+    copies = 2500
+    fields = ('-Tfields',
+        '-e', 'frame.number', '-e', 'frame.time_epoch', '-e', 'frame.len',
+        '-e', 'ip.checksum', '-e', 'udp.checksum', '-e', 'dhcp.id')
+
+    def make_captures(self, cmd_editcap, capture_file):
+        pcap_file = self.filename_from_id('mapped.pcap')
+        first_record = write_dhcp_copies(capture_file, pcap_file, self.copies)
+        pcapng_file = self.filename_from_id('mapped.pcapng')
+        self.assertRun((cmd_editcap, '-F', 'pcapng', pcap_file, pcapng_file))
+        return pcap_file, pcapng_file, first_record
+
+    def check_mapped_read(self, cmd_tshark, infile):
+        # A pipe can't be mapped, so it's read with read().
+        piped_proc = self.assertRun('{0} | "{1}" -r - {2}'.format(
+            subprocesstest.cat_cap_file_command(infile), cmd_tshark,
+            ' '.join(self.fields)), shell=True)
+        self.assertEqual(len(piped_proc.stdout_str.splitlines()), 4 * self.copies)
+        mapped_proc = self.assertRun((cmd_tshark, '-r', infile) + self.fields)
+        self.assertEqual(mapped_proc.stdout_str, piped_proc.stdout_str)
+        # Random access, which seeks within the mapping.
+        two_pass_proc = self.assertRun((cmd_tshark, '-r', infile, '-2') + self.fields)
+        self.assertEqual(two_pass_proc.stdout_str, piped_proc.stdout_str)
+
+    def change_file_size(self, cmd_tshark, dirs, features, infile, frame, *action):
+        '''Read infile, changing its size after dissecting frame; returns
+        the frame numbers read.'''
+        if not features.have_lua:
+            self.skipTest('Requires Lua scripting support.')
+        args = [cmd_tshark, '-r', infile,
+            '-X', 'lua_script:' + os.path.join(dirs.lua_dir, 'change_file_size.lua'),
+            '-X', 'lua_script1:' + infile,
+            '-X', 'lua_script1:{}'.format(frame)]
+        for arg in action:
+            args += ['-X', 'lua_script1:' + arg]
+        args += ['-Tfields', '-e', 'frame.number']
+        proc = self.assertRun(args)
+        return [int(line) for line in proc.stdout_str.splitlines()]
+
+    def test_mapped_read_pcap(self, cmd_tshark, cmd_editcap, capture_file):
+        '''Read a pcap file through a mapping'''
+        pcap_file, _, _ = self.make_captures(cmd_editcap, capture_file)
+        self.check_mapped_read(cmd_tshark, pcap_file)
+
+    def test_mapped_read_pcapng(self, cmd_tshark, cmd_editcap, capture_file):
+        '''Read a pcapng file through a mapping'''
+        _, pcapng_file, _ = self.make_captures(cmd_editcap, capture_file)
+        self.check_mapped_read(cmd_tshark, pcapng_file)
+
+    @unittest.skipIf(sys.platform == 'win32', 'Files are not mapped on Windows')
+    def test_mapped_read_truncated_pcap(self, cmd_tshark, cmd_editcap, capture_file, dirs, features):
+        '''Truncate a mapped pcap file while reading it'''
+        # Well past anything read into the buffer when opening the file,
+        # so that the next record is read from the mapping, which now
+        # faults; we then read the rest of the file with read(), and
+        # get an end of file.
+        pcap_file, _, _ = self.make_captures(cmd_editcap, capture_file)
+        frames = self.change_file_size(cmd_tshark, dirs, features, pcap_file, 6000, 'truncate')
+        self.assertEqual(frames, list(range(1, 6001)))
+
+    @unittest.skipIf(sys.platform == 'win32', 'Files are not mapped on Windows')
+    def test_mapped_read_truncated_pcapng(self, cmd_tshark, cmd_editcap, capture_file, dirs, features):
+        '''Truncate a mapped pcapng file while reading it'''
+        _, pcapng_file, _ = self.make_captures(cmd_editcap, capture_file)
+        frames = self.change_file_size(cmd_tshark, dirs, features, pcapng_file, 6000, 'truncate')
+        self.assertEqual(frames, list(range(1, 6001)))
+
+    def test_mapped_read_appended_pcap(self, cmd_tshark, cmd_editcap, capture_file, dirs, features):
+        '''Append a record to a mapped pcap file while reading it'''
+        pcap_file, _, first_record = self.make_captures(cmd_editcap, capture_file)
+        record_file = self.filename_from_id('record.bin')
+        with open(record_file, 'wb') as f:
+            f.write(first_record)
+        frames = self.change_file_size(cmd_tshark, dirs, features, pcap_file, 10, 'append', record_file)
+        self.assertEqual(frames, list(range(1, 4 * self.copies + 2)))
+
+
+def read_pcap_times(pcap_file):
+    '''Return the time stamps, in microseconds, of the records of a
+    little-endian pcap file.'''
+    with open(pcap_file, 'rb') as f:
+        data = f.read()
+    times = []
+    offset = 24
+    while offset < len(data):
+        secs, usecs, caplen = struct.unpack_from('<III', data, offset)
+        times.append(secs * 1000000 + usecs)
+        offset += 16 + caplen
+    return times
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_editcap_dedup(subprocesstest.SubprocessTestCase):
+    # The four packets of dhcp.pcap, A to D, repeated, with each frame's
+    # time in seconds.
+    frames = (
+        (0, 0.0),   # 1: A
+        (0, 0.5),   # 2: A, 0.5 s and 1 frame after 1
+        (1, 1.0),   # 3: B
+        (2, 2.0),   # 4: C
+        (3, 3.0),   # 5: D
+        (1, 4.0),   # 6: B, 3 s and 3 frames after 3
+        (2, 10.0),  # 7: C, 8 s and 3 frames after 4
+        (0, 11.0),  # 8: A, 10.5 s and 6 frames after 2
+        (3, 12.0),  # 9: D, 9 s and 4 frames after 5
+    )
+
+    def check_dedup(self, cmd_editcap, capture_file, args, kept):
+        with open(capture_file('dhcp.pcap'), 'rb') as f:
+            dhcp = f.read()
+        records = []
+        offset = 24
+        while offset < len(dhcp):
+            caplen = struct.unpack_from('<I', dhcp, offset + 8)[0]
+            records.append(dhcp[offset + 16:offset + 16 + caplen])
+            offset += 16 + caplen
+        in_file = self.filename_from_id('dups.pcap')
+        in_times = []
+        with open(in_file, 'wb') as f:
+            f.write(dhcp[:24])
+            for record, secs in self.frames:
+                ts = 1000000000 * 1000000 + int(secs * 1000000)
+                in_times.append(ts)
+                data = records[record]
+                f.write(struct.pack('<IIII', ts // 1000000, ts % 1000000, len(data), len(data)))
+                f.write(data)
+        out_file = self.filename_from_id('dedup.pcap')
+        self.assertRun((cmd_editcap,) + args + (in_file, out_file))
+        self.assertTrue(self.grepOutput('{} packets seen, {} packet{} skipped'.format(
+            len(self.frames), len(self.frames) - len(kept),
+            '' if len(self.frames) - len(kept) == 1 else 's')))
+        self.assertEqual(read_pcap_times(out_file), [in_times[i - 1] for i in kept])
+
+    def test_editcap_dedup_default_window(self, cmd_editcap, capture_file):
+        '''-d compares each frame with the 4 before it'''
+        self.check_dedup(cmd_editcap, capture_file, ('-d',), (1, 3, 4, 5, 8))
+
+    def test_editcap_dedup_window_0(self, cmd_editcap, capture_file):
+        '''-D 0 removes nothing'''
+        self.check_dedup(cmd_editcap, capture_file, ('-D', '0'), (1, 2, 3, 4, 5, 6, 7, 8, 9))
+
+    def test_editcap_dedup_window_2(self, cmd_editcap, capture_file):
+        '''-D 2 compares each frame with the one before it'''
+        self.check_dedup(cmd_editcap, capture_file, ('-D', '2'), (1, 3, 4, 5, 6, 7, 8, 9))
+
+    def test_editcap_dedup_window_large(self, cmd_editcap, capture_file):
+        '''-D with a window larger than the capture removes every repeat'''
+        self.check_dedup(cmd_editcap, capture_file, ('-D', '100000'), (1, 3, 4, 5))
+
+    def test_editcap_dedup_time_1(self, cmd_editcap, capture_file):
+        '''-w 1 removes frames repeated within a second'''
+        self.check_dedup(cmd_editcap, capture_file, ('-w', '1'), (1, 3, 4, 5, 6, 7, 8, 9))
+
+    def test_editcap_dedup_time_5(self, cmd_editcap, capture_file):
+        '''-w 5 removes frames repeated within 5 seconds'''
+        self.check_dedup(cmd_editcap, capture_file, ('-w', '5'), (1, 3, 4, 5, 7, 8, 9))
+
+    def test_editcap_dedup_time_10(self, cmd_editcap, capture_file):
+        '''-w 10 compares a frame with the newest identical one, even if it was removed'''
+        self.check_dedup(cmd_editcap, capture_file, ('-w', '10'), (1, 3, 4, 5, 8))
+
 
 @fixtures.mark_usefixtures('test_env')
 @fixtures.uses_fixtures
@@ -97,6 +97,26 @@ class case_mergecap_pcap(subprocesstest.SubprocessTestCase):
         ))
         check_mergecap(self, mergecap_proc, 'pcap', 'Ethernet', 8, 1, 8)
 
+    def test_mergecap_chronological_many_pcap(self, cmd_mergecap, cmd_tshark, capture_file):
+        '''Merge several pcap files chronologically'''
+        in_files = ('dhcp.pcap', 'http.pcap', 'dns_port.pcap', 'arp.pcap', 'dhcp-nanosecond.pcap')
+        testout_file = self.filename_from_id(testout_pcap)
+        self.assertRun((cmd_mergecap,
+            '-F', 'pcap',
+            '-w', testout_file,
+        ) + tuple(capture_file(f) for f in in_files))
+        tshark_proc = self.assertRun((cmd_tshark,
+            '-r', testout_file,
+            '-T', 'fields', '-e', 'frame.time_epoch',
+        ))
+        times = [float(t) for t in tshark_proc.stdout_str.split()]
+        in_count = 0
+        for in_file in in_files:
+            count_proc = self.assertRun((cmd_tshark, '-r', capture_file(in_file)))
+            in_count += len(count_proc.stdout_str.splitlines())
+        self.assertEqual(len(times), in_count)
+        self.assertEqual(times, sorted(times))
+
     def test_mergecap_basic_3_empty_pcap_pcap(self, cmd_mergecap, capture_file):
         '''Merge three pcap files to pcap, two empty'''
         # $MERGECAP -vF pcap -w testout.pcap "${CAPTURE_DIR}empty.pcap" "${CAPTURE_DIR}dhcp.pcap" "${CAPTURE_DIR}empty.pcap" > testout.txt 2>&1
@@ -93,3 +93,18 @@ class case_outputformats(subprocesstest.SubprocessTestCase):
         ''' Check that the option -j works with -Tek.'''
         check_outputformat("ek", extra_args=['-j', 'dhcp'], expected="dhcp-filter.ek",
             multiline=True)
+
+    def test_outputformat_fields_pruned_tree(self, cmd_tshark, capture_file):
+        '''Checks that -Tfields gives the same values with a pruned tree.'''
+        fields = ['-e', 'frame.number', '-e', 'ip.src', '-e', 'udp.srcport',
+                  '-e', 'dhcp.option.type', '-e', 'dhcp.hw.mac_addr']
+        # Asking for a protocol field needs its label, which makes TShark
+        # dissect with a full tree.
+        pruned_proc = self.assertRun([cmd_tshark, '-r', capture_file('dhcp.pcap'),
+                                      '-T', 'fields'] + fields)
+        full_proc = self.assertRun([cmd_tshark, '-r', capture_file('dhcp.pcap'),
+                                    '-T', 'fields'] + fields + ['-e', 'udp'])
+        pruned = pruned_proc.stdout_str.splitlines()
+        full = [line.rsplit('\t', 1)[0] for line in full_proc.stdout_str.splitlines()]
+        self.assertEqual(len(pruned), 4)
+        self.assertEqual(pruned, full)
@@ -0,0 +1,82 @@
+#
+# Wireshark tests
+#
+# SPDX-License-Identifier: GPL-2.0-or-later
+#
+'''Reordercap tests'''
+
+import struct
+import subprocesstest
+import fixtures
+
+testin_pcap = 'testin.pcap'
+testout_pcap = 'testout.pcap'
+
+
+def write_pcap(path, times):
+    '''Write a pcap file with one Ethernet frame per time stamp, each holding its frame number.'''
+    with open(path, 'wb') as pcap_fd:
+        pcap_fd.write(struct.pack('<IHHiIII', 0xa1b2c3d4, 2, 4, 0, 0, 65535, 1))
+        for num, (secs, usecs) in enumerate(times, 1):
+            data = struct.pack('>I', num) + bytes(56)
+            pcap_fd.write(struct.pack('<IIII', secs, usecs, len(data), len(data)))
+            pcap_fd.write(data)
+
+
+def read_pcap(path):
+    '''Return the time stamp and frame number of each frame in a pcap file written by write_pcap().'''
+    frames = []
+    with open(path, 'rb') as pcap_fd:
+        pcap_fd.read(24)
+        while True:
+            hdr = pcap_fd.read(16)
+            if not hdr:
+                break
+            secs, usecs, caplen, _ = struct.unpack('<IIII', hdr)
+            data = pcap_fd.read(caplen)
+            frames.append(((secs, usecs), struct.unpack('>I', data[:4])[0]))
+    return frames
+
+
+@fixtures.mark_usefixtures('test_env')
+@fixtures.uses_fixtures
+class case_reordercap(subprocesstest.SubprocessTestCase):
+    def check_reorder(self, cmd_reordercap, times, args=()):
+        '''Reorder a file with the given time stamps, and check that the frames
+        come out in time stamp order, with frames with the same time stamp in
+        their original order.'''
+        testin_file = self.filename_from_id(testin_pcap)
+        testout_file = self.filename_from_id(testout_pcap)
+        write_pcap(testin_file, times)
+        self.assertRun((cmd_reordercap,) + args + (testin_file, testout_file))
+        expected = sorted(((ts, num) for num, ts in enumerate(times, 1)),
+                          key=lambda frame: frame[0])
+        self.assertEqual(read_pcap(testout_file), expected)
+
+    def test_reordercap_in_memory(self, cmd_reordercap):
+        '''Reorder a file in memory'''
+        times = [(1000 + (i * 37) % 50, (i * 7919) % 1000000) for i in range(200)]
+        self.check_reorder(cmd_reordercap, times)
+
+    def test_reordercap_streaming_one_run(self, cmd_reordercap):
+        '''Reorder a slightly out of order file with -m'''
+        times = []
+        for i in range(0, 200, 2):
+            times += [(1000 + i + 1, 0), (1000 + i, 0)]
+        self.check_reorder(cmd_reordercap, times, ('-m', '4'))
+
+    def test_reordercap_streaming_runs(self, cmd_reordercap):
+        '''Reorder a file with -m that needs several runs, and ties between them'''
+        # Ten blocks of frames in order, each starting before the last one
+        # ended, with the same time stamps appearing in several blocks.
+        times = []
+        for block in range(10):
+            times += [(1000 + (9 - block) * 5 + i, 0) for i in range(20)]
+        self.check_reorder(cmd_reordercap, times, ('-m', '4'))
+
+    def test_reordercap_streaming_many_runs(self, cmd_reordercap):
+        '''Reorder a file with -m that needs more runs than are merged at once'''
+        # With room for one frame, each frame older than the one before it
+        # starts a new run.
+        times = [(2000 - i, (i * 7919) % 1000000) for i in range(150)]
+        self.check_reorder(cmd_reordercap, times, ('-m', '1'))
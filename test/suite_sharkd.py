@@ -25,9 +25,9 @@ def cmd_sharkd(program):
 def run_sharkd_session(cmd_sharkd, request):
     self = request.instance
 
-    def run_sharkd_session_real(sharkd_commands):
+    def run_sharkd_session_real(sharkd_commands, sharkd_args=('-',)):
         sharkd_proc = self.startProcess(
-            (cmd_sharkd, '-'), stdin=subprocess.PIPE)
+            (cmd_sharkd,) + tuple(sharkd_args), stdin=subprocess.PIPE)
         sharkd_proc.stdin.write('\n'.join(sharkd_commands).encode('utf8'))
         self.waitProcess(sharkd_proc)
 
@@ -51,9 +51,9 @@ def run_sharkd_session(cmd_sharkd, request):
 def check_sharkd_session(run_sharkd_session, request):
     self = request.instance
 
-    def check_sharkd_session_real(sharkd_commands, expected_outputs):
+    def check_sharkd_session_real(sharkd_commands, expected_outputs, sharkd_args=('-',)):
         sharkd_commands = [json.dumps(x) for x in sharkd_commands]
-        actual_outputs = run_sharkd_session(sharkd_commands)
+        actual_outputs = run_sharkd_session(sharkd_commands, sharkd_args)
         self.assertEqual(expected_outputs, actual_outputs)
     return check_sharkd_session_real
 
@@ -89,6 +89,20 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
                 "filename": "dhcp.pcap", "filesize": 1400}},
         ))
 
+    def test_sharkd_req_status_read_file(self, check_sharkd_session, capture_file):
+        # A capture file given on the command line is loaded before the session starts.
+        check_sharkd_session((
+            {"jsonrpc":"2.0", "id":1, "method":"status"},
+            {"jsonrpc":"2.0", "id":2, "method":"frames",
+            "params":{"filter": "frame.number == 2"}
+            },
+        ), (
+            {"jsonrpc":"2.0","id":1,"result":{"frames": 4, "duration": 0.070345000,
+                "filename": "dhcp.pcap", "filesize": 1400}},
+            {"jsonrpc":"2.0","id":2,"result":
+                MatchList(MatchObject({"num": 2}), n=1)},
+        ), ('-r', capture_file('dhcp.pcap')))
+
     def test_sharkd_req_analyse(self, check_sharkd_session, capture_file):
         check_sharkd_session((
             {"jsonrpc":"2.0", "id":1, "method":"load",
@@ -376,6 +390,36 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
             {"jsonrpc":"2.0","id":4,"result":{"intervals":[[0,2,656]],"last":0,"frames":2,"bytes":656}},
         ))
 
+    def test_sharkd_req_intervals_filter_combined(self, check_sharkd_session, capture_file):
+        # Filters combining ones used before are worked out from their results.
+        check_sharkd_session((
+            {"jsonrpc":"2.0", "id":1, "method":"load",
+            "params":{"file": capture_file('dhcp.pcap')}
+            },
+            {"jsonrpc":"2.0", "id":2, "method":"intervals",
+            "params":{"filter": "frame.number <= 2"}
+            },
+            {"jsonrpc":"2.0", "id":3, "method":"intervals",
+            "params":{"filter": "frame.number <= 2 && frame.number >= 2"}
+            },
+            {"jsonrpc":"2.0", "id":4, "method":"intervals",
+            "params":{"filter": "frame.number == 4 or (frame.number <= 2)"}
+            },
+            {"jsonrpc":"2.0", "id":5, "method":"intervals",
+            "params":{"filter": "!(frame.number <= 2)"}
+            },
+            {"jsonrpc":"2.0", "id":6, "method":"intervals",
+            "params":{"filter": "not (frame.number <= 2) and udp && !(frame.number == 4)"}
+            },
+        ), (
+            {"jsonrpc":"2.0","id":1,"result":{"status":"OK"}},
+            {"jsonrpc":"2.0","id":2,"result":{"intervals":[[0,2,656]],"last":0,"frames":2,"bytes":656}},
+            {"jsonrpc":"2.0","id":3,"result":{"intervals":[[0,1,328]],"last":0,"frames":1,"bytes":328}},
+            {"jsonrpc":"2.0","id":4,"result":{"intervals":[[0,3,984]],"last":0,"frames":3,"bytes":984}},
+            {"jsonrpc":"2.0","id":5,"result":{"intervals":[[0,2,656]],"last":0,"frames":2,"bytes":656}},
+            {"jsonrpc":"2.0","id":6,"result":{"intervals":[[0,1,328]],"last":0,"frames":1,"bytes":328}},
+        ))
+
     def test_sharkd_req_frame_basic(self, check_sharkd_session, capture_file):
         # XXX add more tests for other options (ref_frame, prev_frame, columns, color, bytes, hidden)
         check_sharkd_session((
@@ -441,6 +485,29 @@ class case_sharkd(subprocesstest.SubprocessTestCase):
             {"jsonrpc":"2.0","id":4,"result":{"comment":["foo\nbar"],"fol": MatchAny(list)}},
         ))
 
+    def test_sharkd_req_setcomment_no_options(self, check_sharkd_session, capture_file):
+        # The packets in dhcp.pcapng have no options, and thus no block.
+        check_sharkd_session((
+            {"jsonrpc":"2.0", "id":1, "method":"load",
+            "params":{"file": capture_file('dhcp.pcapng')}
+            },
+            {"jsonrpc":"2.0", "id":2, "method":"setcomment",
+            "params":{"frame": 2, "comment": "foo\nbar"}
+            },
+            {"jsonrpc":"2.0", "id":3, "method":"frame",
+            "params":{"frame": 2}
+            },
+            {"jsonrpc":"2.0", "id":4, "method":"frames",
+            "params":{"filter": "frame.comment"}
+            },
+        ), (
+            {"jsonrpc":"2.0","id":1,"result":{"status":"OK"}},
+            {"jsonrpc":"2.0","id":2,"result":{"status":"OK"}},
+            {"jsonrpc":"2.0","id":3,"result":{"comment":["foo\nbar"],"fol": MatchAny(list)}},
+            {"jsonrpc":"2.0","id":4,"result":
+                MatchList(MatchObject({"num": 2}), n=1)},
+        ))
+
     def test_sharkd_req_setconf_bad(self, check_sharkd_session):
         check_sharkd_session((
             {"jsonrpc":"2.0", "id":1, "method":"setconf",
@@ -19,6 +19,10 @@ import fixtures
 
 @fixtures.uses_fixtures
 class case_unittests(subprocesstest.SubprocessTestCase):
+    def test_unit_conversation_test(self, program, base_env):
+        '''conversation_test'''
+        self.assertRun(program('conversation_test'), env=base_env)
+
     def test_unit_exntest(self, program, base_env):
         '''exntest'''
         self.assertRun(program('exntest'), env=base_env)
@@ -27,10 +31,18 @@ class case_unittests(subprocesstest.SubprocessTestCase):
         '''oids_test'''
         self.assertRun(program('oids_test'), env=base_env)
 
+    def test_unit_pcapio_test(self, program, base_env):
+        '''pcapio_test'''
+        self.assertRun(program('pcapio_test'), env=base_env)
+
     def test_unit_reassemble_test(self, program, base_env):
         '''reassemble_test'''
         self.assertRun(program('reassemble_test'), env=base_env)
 
+    def test_unit_time_shift_test(self, program, base_env):
+        '''time_shift_test'''
+        self.assertRun(program('time_shift_test'), env=base_env)
+
     def test_unit_tvbtest(self, program, base_env):
         '''tvbtest'''
         self.assertRun(program('tvbtest'), env=base_env)
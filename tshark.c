@@ -52,6 +52,7 @@
 #include <cli_main.h>
 #include <ui/version_info.h>
 #include <wiretap/wtap_opttypes.h>
+#include <wiretap/frame_index.h>
 
 #include "globals.h"
 #include <epan/timestamp.h>
@@ -134,6 +135,8 @@
 #define LONGOPT_ELASTIC_MAPPING_FILTER  LONGOPT_BASE_APPLICATION+4
 #define LONGOPT_EXPORT_TLS_SESSION_KEYS LONGOPT_BASE_APPLICATION+5
 #define LONGOPT_CAPTURE_COMMENT         LONGOPT_BASE_APPLICATION+6
+#define LONGOPT_READ_AHEAD              LONGOPT_BASE_APPLICATION+7
+#define LONGOPT_FRAME_INDEX             LONGOPT_BASE_APPLICATION+8
 
 capture_file cfile;
 
@@ -143,6 +146,8 @@ static frame_data prev_dis_frame;
 static frame_data prev_cap_frame;
 
 static gboolean perform_two_pass_analysis;
+static guint read_ahead_count = 0;
+static gboolean use_frame_index = FALSE;
 static guint32 epan_auto_reset_count = 0;
 static gboolean epan_auto_reset = FALSE;
 
@@ -216,6 +221,8 @@ static void capture_input_new_packets(capture_session *cap_session,
                                       int to_read);
 static void capture_input_drops(capture_session *cap_session, guint32 dropped,
                                 const char* interface_name);
+static void capture_input_queued(capture_session *cap_session, guint32 queued,
+                                 guint32 queued_max, const char* interface_name);
 static void capture_input_error(capture_session *cap_session,
                                 char *error_msg, char *secondary_error_msg);
 static void capture_input_cfilter_error(capture_session *cap_session,
@@ -389,6 +396,10 @@ print_usage(FILE *output)
   fprintf(output, "\n");
   fprintf(output, "Processing:\n");
   fprintf(output, "  -2                       perform a two-pass analysis\n");
+  fprintf(output, "  --read-ahead <count>     prefetch up to <count> records in a separate thread\n");
+  fprintf(output, "                           during the second pass (requires -2)\n");
+  fprintf(output, "  --frame-index            use, or create, a frame index file next to the\n");
+  fprintf(output, "                           capture file to speed up the first pass (requires -2)\n");
   fprintf(output, "  -M <packet count>        perform session auto reset\n");
   fprintf(output, "  -R <read filter>, --read-filter <read filter>\n");
   fprintf(output, "                           packet Read filter in Wireshark display filter syntax\n");
@@ -671,6 +682,36 @@ must_do_dissection(dfilter_t *rfcode, dfilter_t *dfcode,
       tap_listeners_require_dissection() || dissect_color;
 }
 
+/*
+ * With "-T fields", only the values of the fields given with -e are
+ * printed.  Unless some of them are printed using their labels, or a
+ * tap wants the whole protocol tree, an invisible protocol tree primed
+ * with those fields has everything needed: dissectors then skip the
+ * items nobody asked for, don't format labels, and can skip protocols
+ * none of whose fields are wanted (see proto_field_is_referenced()).
+ */
+static gboolean
+only_output_fields_needed(guint tap_flags)
+{
+  return output_action == WRITE_FIELDS &&
+      !(tap_flags & TL_REQUIRES_PROTO_TREE) &&
+      !output_fields_need_labels(output_fields);
+}
+
+/*
+ * The protocol tree will be "visible", i.e., printed, only if we're
+ * printing packet details, which is true if we're printing stuff
+ * ("print_packet_info" is true) and we're in verbose mode
+ * ("packet_details" is true), and more than the values of some
+ * fields is printed.
+ */
+static gboolean
+proto_tree_is_visible(guint tap_flags)
+{
+  return print_packet_info && print_details &&
+      !only_output_fields_needed(tap_flags);
+}
+
 int
 main(int argc, char *argv[])
 {
@@ -700,6 +741,8 @@ main(int argc, char *argv[])
     {"no-duplicate-keys", ws_no_argument, NULL, LONGOPT_NO_DUPLICATE_KEYS},
     {"elastic-mapping-filter", ws_required_argument, NULL, LONGOPT_ELASTIC_MAPPING_FILTER},
     {"capture-comment", ws_required_argument, NULL, LONGOPT_CAPTURE_COMMENT},
+    {"read-ahead", ws_required_argument, NULL, LONGOPT_READ_AHEAD},
+    {"frame-index", ws_no_argument, NULL, LONGOPT_FRAME_INDEX},
     {0, 0, 0, 0 }
   };
   gboolean             arg_error = FALSE;
@@ -913,8 +956,9 @@ main(int argc, char *argv[])
   capture_opts_init(&global_capture_opts);
   capture_session_init(&global_capture_session, &cfile,
                        capture_input_new_file, capture_input_new_packets,
-                       capture_input_drops, capture_input_error,
-                       capture_input_cfilter_error, capture_input_closed);
+                       capture_input_drops, capture_input_queued,
+                       capture_input_error, capture_input_cfilter_error,
+                       capture_input_closed);
 #endif
 
   timestamp_set_type(TS_RELATIVE);
@@ -1475,6 +1519,12 @@ main(int argc, char *argv[])
       }
       g_ptr_array_add(capture_comments, g_strdup(ws_optarg));
       break;
+    case LONGOPT_READ_AHEAD:       /* --read-ahead */
+      read_ahead_count = get_positive_int(ws_optarg, "read-ahead record count");
+      break;
+    case LONGOPT_FRAME_INDEX:      /* --frame-index */
+      use_frame_index = TRUE;
+      break;
     default:
     case '?':        /* Bad flag - print usage message */
       switch(ws_optopt) {
@@ -1640,6 +1690,18 @@ main(int argc, char *argv[])
     goto clean_exit;
   }
 
+  if (read_ahead_count != 0 && !perform_two_pass_analysis) {
+    cmdarg_err("--read-ahead requires two-pass analysis (-2).");
+    exit_status = INVALID_OPTION;
+    goto clean_exit;
+  }
+
+  if (use_frame_index && !perform_two_pass_analysis) {
+    cmdarg_err("--frame-index requires two-pass analysis (-2).");
+    exit_status = INVALID_OPTION;
+    goto clean_exit;
+  }
+
 #ifdef HAVE_LIBPCAP
   if (caps_queries) {
     /* We're supposed to list the link-layer/timestamp types for an interface;
@@ -2717,6 +2779,8 @@ capture_input_new_file(capture_session *cap_session, gchar *new_file)
     /* Attempt to open the capture file and set up to read from it. */
     switch(cf_open(cap_session->cf, capture_opts->save_file, WTAP_TYPE_AUTO, is_tempfile, &err)) {
     case CF_OK:
+      /* Read what dumpcap writes from its live feed where we can. */
+      wtap_set_live_feed(cap_session->cf->provider.wth, cap_session->live_feed);
       break;
     case CF_ERROR:
       /* Don't unlink (delete) the save file - leave it around,
@@ -2795,11 +2859,7 @@ capture_input_new_packets(capture_session *cap_session, int to_read)
         (tap_flags & TL_REQUIRES_PROTO_TREE) || postdissectors_want_hfids() ||
         have_custom_cols(&cf->cinfo) || dissect_color);
 
-    /* The protocol tree will be "visible", i.e., printed, only if we're
-       printing packet details, which is true if we're printing stuff
-       ("print_packet_info" is true) and we're in verbose mode
-       ("packet_details" is true). */
-    edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+    edt = epan_dissect_new(cf->epan, create_proto_tree, proto_tree_is_visible(tap_flags));
 
     wtap_rec_init(&rec);
     ws_buffer_init(&buf, 1514);
@@ -2807,7 +2867,7 @@ capture_input_new_packets(capture_session *cap_session, int to_read)
     while (to_read-- && cf->provider.wth) {
       wtap_cleareof(cf->provider.wth);
       ret = wtap_read(cf->provider.wth, &rec, &buf, &err, &err_info, &data_offset);
-      reset_epan_mem(cf, edt, create_proto_tree, print_packet_info && print_details);
+      reset_epan_mem(cf, edt, create_proto_tree, proto_tree_is_visible(tap_flags));
       if (ret == FALSE) {
         /* read from file failed, tell the capture child to stop */
         sync_pipe_stop(cap_session);
@@ -2912,6 +2972,14 @@ capture_input_drops(capture_session *cap_session _U_, guint32 dropped, const cha
   }
 }
 
+/* capture child told us how many packets it has waiting to be written */
+static void
+capture_input_queued(capture_session *cap_session _U_, guint32 queued, guint32 queued_max, const char* interface_name)
+{
+  ws_info("%u packet%s queued by the capture child for %s, at most %u", queued, plurality(queued, "", "s"),
+          interface_name != NULL ? interface_name : "the capture", queued_max);
+}
+
 
 /*
  * Capture child closed its side of the pipe, report any error and
@@ -3115,6 +3183,27 @@ typedef enum {
   PASS_INTERRUPTED
 } pass_status_t;
 
+/*
+ * Can we use a frame index for this file?
+ *
+ * An index only holds the offsets wtap_seek_read() needs; for most
+ * file types, including pcapng, reading a record at random depends on
+ * state set up while reading the file sequentially (interface
+ * descriptions, section byte order, ...), so only use it for the
+ * pcap formats, where every record can be read on its own.
+ */
+static gboolean
+frame_index_supported(capture_file *cf)
+{
+  int file_type_subtype;
+
+  if (cf->filename == NULL || strcmp(cf->filename, "-") == 0)
+    return FALSE;
+  file_type_subtype = wtap_file_type_subtype(cf->provider.wth);
+  return file_type_subtype == wtap_pcap_file_type_subtype() ||
+         file_type_subtype == wtap_pcap_nsec_file_type_subtype();
+}
+
 static pass_status_t
 process_cap_file_first_pass(capture_file *cf, int max_packet_count,
                             gint64 max_byte_count, int *err, gchar **err_info)
@@ -3124,6 +3213,9 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
   epan_dissect_t *edt = NULL;
   gint64          data_offset;
   pass_status_t   status = PASS_SUCCEEDED;
+  frame_index_t  *fi = NULL;
+  frame_index_writer_t *fiw = NULL;
+  gboolean        read_all = FALSE;
 
   wtap_rec_init(&rec);
   ws_buffer_init(&buf, 1514);
@@ -3155,30 +3247,92 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
     edt = epan_dissect_new(cf->epan, create_proto_tree, FALSE);
   }
 
-  ws_debug("tshark: reading records for first pass");
+  if (use_frame_index && frame_index_supported(cf)) {
+    /*
+     * If we aren't dissecting on the first pass, all it does is build
+     * the frame list, and that needs only what's in the index.  If we
+     * are, we have to read the packets anyway; just refresh the index
+     * as we go.
+     */
+    if (edt == NULL)
+      fi = frame_index_open(cf->filename, cf->provider.wth);
+    if (fi == NULL) {
+      int index_err;
+
+      fiw = frame_index_writer_new(cf->filename, &index_err);
+      if (fiw == NULL)
+        ws_debug("tshark: can't create frame index: %s", g_strerror(index_err));
+    }
+  }
+
   *err = 0;
-  while (wtap_read(cf->provider.wth, &rec, &buf, err, err_info, &data_offset)) {
-    if (read_interrupted) {
-      status = PASS_INTERRUPTED;
-      break;
+  if (fi != NULL) {
+    guint32 count = frame_index_count(fi);
+    guint32 i;
+
+    ws_debug("tshark: building frame list for first pass from frame index");
+    for (i = 0; i < count; i++) {
+      if (read_interrupted) {
+        status = PASS_INTERRUPTED;
+        break;
+      }
+      frame_index_get_rec(fi, i, &rec, &data_offset);
+      if (process_packet_first_pass(cf, NULL, data_offset, &rec, &buf)) {
+        if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count))
+          break;
+      }
     }
-    if (process_packet_first_pass(cf, edt, data_offset, &rec, &buf)) {
-      /* Stop reading if we have the maximum number of packets;
-       * When the -c option has not been used, max_packet_count
-       * starts at 0, which practically means, never stop reading.
-       * (unless we roll over max_packet_count ?)
-       */
-      if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count)) {
-        ws_debug("tshark: max_packet_count (%d) or max_byte_count (%" G_GINT64_MODIFIER "d/%" G_GINT64_MODIFIER "d) reached",
-                      max_packet_count, data_offset, max_byte_count);
-        *err = 0; /* This is not an error */
+    frame_index_close(fi);
+  } else {
+    ws_debug("tshark: reading records for first pass");
+    read_all = TRUE;
+    while (wtap_read(cf->provider.wth, &rec, &buf, err, err_info, &data_offset)) {
+      if (read_interrupted) {
+        status = PASS_INTERRUPTED;
+        read_all = FALSE;
         break;
       }
+      if (fiw != NULL) {
+        int index_err;
+
+        if (!frame_index_writer_add(fiw, data_offset, &rec, &index_err)) {
+          frame_index_writer_abort(fiw);
+          fiw = NULL;
+        }
+      }
+      if (process_packet_first_pass(cf, edt, data_offset, &rec, &buf)) {
+        /* Stop reading if we have the maximum number of packets;
+         * When the -c option has not been used, max_packet_count
+         * starts at 0, which practically means, never stop reading.
+         * (unless we roll over max_packet_count ?)
+         */
+        if ( (--max_packet_count == 0) || (max_byte_count != 0 && data_offset >= max_byte_count)) {
+          ws_debug("tshark: max_packet_count (%d) or max_byte_count (%" G_GINT64_MODIFIER "d/%" G_GINT64_MODIFIER "d) reached",
+                        max_packet_count, data_offset, max_byte_count);
+          *err = 0; /* This is not an error */
+          read_all = FALSE;
+          break;
+        }
+      }
+      wtap_rec_reset(&rec);
     }
-    wtap_rec_reset(&rec);
   }
-  if (*err != 0)
+  if (*err != 0) {
     status = PASS_READ_ERROR;
+    read_all = FALSE;
+  }
+
+  if (fiw != NULL) {
+    /* Only keep an index that describes the whole file. */
+    if (read_all) {
+      int index_err;
+
+      if (!frame_index_writer_finish(fiw, &index_err))
+        ws_debug("tshark: can't write frame index: %s", g_strerror(index_err));
+    } else {
+      frame_index_writer_abort(fiw);
+    }
+  }
 
   if (edt)
     epan_dissect_free(edt);
@@ -3201,6 +3355,7 @@ process_cap_file_first_pass(capture_file *cf, int max_packet_count,
 
 static gboolean
 process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
+                           const struct packet_provider_data *prov,
                            frame_data *fdata, wtap_rec *rec,
                            Buffer *buf, guint tap_flags)
 {
@@ -3225,6 +3380,15 @@ process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
 
     col_custom_prime_edt(edt, &cf->cinfo);
 
+    /* If we're printing only the values of some fields, the protocol
+       tree isn't visible; prime it with those fields, and with the
+       ones postdissectors want, as they'd have had them all in a
+       visible tree. */
+    if (print_packet_info && only_output_fields_needed(tap_flags)) {
+      output_fields_prime_edt(output_fields, edt);
+      prime_epan_dissect_with_postdissector_wanted_hfids(edt);
+    }
+
     /* We only need the columns if either
          1) some tap needs the columns
        or
@@ -3249,7 +3413,7 @@ process_packet_second_pass(capture_file *cf, epan_dissect_t *edt,
     }
 
     epan_dissect_run_with_taps(edt, cf->cd_t, rec,
-                               frame_tvbuff_new_buffer(&cf->provider, fdata, buf),
+                               frame_tvbuff_new_buffer(prov, fdata, buf),
                                fdata, cinfo);
 
     /* Run the read/display filter if we have one. */
@@ -3309,6 +3473,167 @@ process_new_idbs(wtap *wth, wtap_dumper *pdh, int *err, gchar **err_info)
   return TRUE;
 }
 
+/*
+ * Process one record read during the second pass and, if it passes the
+ * filters, write it to the output file.  Returns FALSE on a write error.
+ */
+static gboolean
+process_second_pass_record(capture_file *cf, wtap_dumper *pdh,
+                           epan_dissect_t *edt,
+                           const struct packet_provider_data *prov,
+                           guint32 framenum, frame_data *fdata,
+                           wtap_rec *rec, Buffer *buf, guint tap_flags,
+                           int *err, gchar **err_info)
+{
+  ws_debug("tshark: invoking process_packet_second_pass() for frame #%d", framenum);
+  if (process_packet_second_pass(cf, edt, prov, fdata, rec, buf, tap_flags)) {
+    /* Either there's no read filtering or this packet passed the
+       filter, so, if we're writing to a capture file, write
+       this packet out. */
+    if (pdh != NULL) {
+      ws_debug("tshark: writing packet #%d to outfile", framenum);
+      if (!wtap_dump(pdh, rec, ws_buffer_start_ptr(buf), err, err_info)) {
+        /* Error writing to the output file. */
+        ws_debug("tshark: error writing to a capture file (%d)", *err);
+        return FALSE;
+      }
+    }
+  }
+  return TRUE;
+}
+
+/*
+ * Second-pass read-ahead.
+ *
+ * Random access reads (and, for compressed files, the decompression
+ * behind them) are done by a separate thread, which fills a fixed
+ * set of slots in frame number order; the main thread dissects and
+ * prints them in the order in which they arrive, so the output is the
+ * same as it is without read-ahead.  Dissection itself stays on the
+ * main thread, as libwireshark isn't thread-safe.
+ */
+typedef struct {
+  guint32     framenum;   /* 0 marks the end of the records */
+  frame_data *fdata;
+  gboolean    read_ok;
+  int         err;
+  gchar      *err_info;
+  wtap_rec    rec;
+  Buffer      buf;
+} read_ahead_slot_t;
+
+typedef struct {
+  capture_file *cf;
+  GAsyncQueue  *free_slots;     /* slots the reader may fill */
+  GAsyncQueue  *filled_slots;   /* slots waiting to be dissected */
+  gint          stop;           /* set by the main thread to stop reading */
+} read_ahead_t;
+
+static gpointer
+read_ahead_thread(gpointer data)
+{
+  read_ahead_t      *ra = (read_ahead_t *)data;
+  read_ahead_slot_t *slot;
+  guint32            framenum;
+
+  for (framenum = 1; framenum <= ra->cf->count; framenum++) {
+    slot = (read_ahead_slot_t *)g_async_queue_pop(ra->free_slots);
+    if (g_atomic_int_get(&ra->stop)) {
+      g_async_queue_push(ra->free_slots, slot);
+      break;
+    }
+    slot->framenum = framenum;
+    slot->fdata = frame_data_sequence_find(ra->cf->provider.frames, framenum);
+    slot->err = 0;
+    slot->err_info = NULL;
+    slot->read_ok = cap_file_provider_seek_read(&ra->cf->provider, slot->fdata->file_off,
+                                                &slot->rec, &slot->buf, &slot->err,
+                                                &slot->err_info);
+    g_async_queue_push(ra->filled_slots, slot);
+    if (!slot->read_ok)
+      break;
+  }
+
+  /* Tell the main thread that there are no more records. */
+  slot = (read_ahead_slot_t *)g_async_queue_pop(ra->free_slots);
+  slot->framenum = 0;
+  g_async_queue_push(ra->filled_slots, slot);
+  return NULL;
+}
+
+static pass_status_t
+process_records_with_read_ahead(capture_file *cf, wtap_dumper *pdh,
+                                epan_dissect_t *edt, guint tap_flags,
+                                int *err, gchar **err_info,
+                                volatile guint32 *err_framenum)
+{
+  read_ahead_t       ra;
+  read_ahead_slot_t *slots;
+  read_ahead_slot_t *slot;
+  GThread           *reader;
+  guint              i;
+  pass_status_t      status = PASS_SUCCEEDED;
+
+  ra.cf = cf;
+  ra.free_slots = g_async_queue_new();
+  ra.filled_slots = g_async_queue_new();
+  ra.stop = 0;
+
+  /* One more slot than requested, for the end-of-records marker. */
+  slots = g_new(read_ahead_slot_t, read_ahead_count + 1);
+  for (i = 0; i <= read_ahead_count; i++) {
+    wtap_rec_init(&slots[i].rec);
+    ws_buffer_init(&slots[i].buf, 1514);
+    g_async_queue_push(ra.free_slots, &slots[i]);
+  }
+
+  reader = g_thread_new("tshark read-ahead", read_ahead_thread, &ra);
+
+  for (;;) {
+    slot = (read_ahead_slot_t *)g_async_queue_pop(ra.filled_slots);
+    if (slot->framenum == 0) {
+      g_async_queue_push(ra.free_slots, slot);
+      break;
+    }
+    if (status != PASS_SUCCEEDED) {
+      /* Just drain whatever the reader has already read. */
+      if (!slot->read_ok)
+        g_free(slot->err_info);
+    } else if (read_interrupted) {
+      if (!slot->read_ok)
+        g_free(slot->err_info);
+      status = PASS_INTERRUPTED;
+      g_atomic_int_set(&ra.stop, 1);
+    } else if (!slot->read_ok) {
+      /* Error reading from the input file. */
+      *err = slot->err;
+      *err_info = slot->err_info;
+      status = PASS_READ_ERROR;
+    } else if (!process_second_pass_record(cf, pdh, edt, &cf->provider,
+                                           slot->framenum, slot->fdata,
+                                           &slot->rec, &slot->buf,
+                                           tap_flags, err, err_info)) {
+      *err_framenum = slot->framenum;
+      status = PASS_WRITE_ERROR;
+      g_atomic_int_set(&ra.stop, 1);
+    }
+    wtap_rec_reset(&slot->rec);
+    g_async_queue_push(ra.free_slots, slot);
+  }
+
+  g_thread_join(reader);
+
+  for (i = 0; i <= read_ahead_count; i++) {
+    ws_buffer_free(&slots[i].buf);
+    wtap_rec_cleanup(&slots[i].rec);
+  }
+  g_free(slots);
+  g_async_queue_unref(ra.free_slots);
+  g_async_queue_unref(ra.filled_slots);
+
+  return status;
+}
+
 static pass_status_t
 process_cap_file_second_pass(capture_file *cf, wtap_dumper *pdh,
                              int *err, gchar **err_info,
@@ -3364,11 +3689,7 @@ process_cap_file_second_pass(capture_file *cf, wtap_dumper *pdh,
 
     ws_debug("tshark: create_proto_tree = %s", create_proto_tree ? "TRUE" : "FALSE");
 
-    /* The protocol tree will be "visible", i.e., printed, only if we're
-       printing packet details, which is true if we're printing stuff
-       ("print_packet_info" is true) and we're in verbose mode
-       ("packet_details" is true). */
-    edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+    edt = epan_dissect_new(cf->epan, create_proto_tree, proto_tree_is_visible(tap_flags));
   }
 
   /*
@@ -3377,35 +3698,31 @@ process_cap_file_second_pass(capture_file *cf, wtap_dumper *pdh,
    */
   set_resolution_synchrony(TRUE);
 
-  for (framenum = 1; framenum <= cf->count; framenum++) {
-    if (read_interrupted) {
-      status = PASS_INTERRUPTED;
-      break;
-    }
-    fdata = frame_data_sequence_find(cf->provider.frames, framenum);
-    if (!wtap_seek_read(cf->provider.wth, fdata->file_off, &rec, &buf, err,
-                        err_info)) {
-      /* Error reading from the input file. */
-      status = PASS_READ_ERROR;
-      break;
-    }
-    ws_debug("tshark: invoking process_packet_second_pass() for frame #%d", framenum);
-    if (process_packet_second_pass(cf, edt, fdata, &rec, &buf, tap_flags)) {
-      /* Either there's no read filtering or this packet passed the
-         filter, so, if we're writing to a capture file, write
-         this packet out. */
-      if (pdh != NULL) {
-        ws_debug("tshark: writing packet #%d to outfile", framenum);
-        if (!wtap_dump(pdh, &rec, ws_buffer_start_ptr(&buf), err, err_info)) {
-          /* Error writing to the output file. */
-          ws_debug("tshark: error writing to a capture file (%d)", *err);
-          *err_framenum = framenum;
-          status = PASS_WRITE_ERROR;
-          break;
-        }
+  if (read_ahead_count != 0) {
+    status = process_records_with_read_ahead(cf, pdh, edt, tap_flags,
+                                             err, err_info, err_framenum);
+  } else {
+    for (framenum = 1; framenum <= cf->count; framenum++) {
+      if (read_interrupted) {
+        status = PASS_INTERRUPTED;
+        break;
+      }
+      fdata = frame_data_sequence_find(cf->provider.frames, framenum);
+      if (!wtap_seek_read(cf->provider.wth, fdata->file_off, &rec, &buf, err,
+                          err_info)) {
+        /* Error reading from the input file. */
+        status = PASS_READ_ERROR;
+        break;
+      }
+      if (!process_second_pass_record(cf, pdh, edt, &cf->provider, framenum,
+                                      fdata, &rec, &buf, tap_flags,
+                                      err, err_info)) {
+        *err_framenum = framenum;
+        status = PASS_WRITE_ERROR;
+        break;
       }
+      wtap_rec_reset(&rec);
     }
-    wtap_rec_reset(&rec);
   }
 
   if (edt)
@@ -3472,11 +3789,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
 
     ws_debug("tshark: create_proto_tree = %s", create_proto_tree ? "TRUE" : "FALSE");
 
-    /* The protocol tree will be "visible", i.e., printed, only if we're
-       printing packet details, which is true if we're printing stuff
-       ("print_packet_info" is true) and we're in verbose mode
-       ("packet_details" is true). */
-    edt = epan_dissect_new(cf->epan, create_proto_tree, print_packet_info && print_details);
+    edt = epan_dissect_new(cf->epan, create_proto_tree, proto_tree_is_visible(tap_flags));
   }
 
   /*
@@ -3505,7 +3818,7 @@ process_cap_file_single_pass(capture_file *cf, wtap_dumper *pdh,
 
     ws_debug("tshark: processing packet #%d", framenum);
 
-    reset_epan_mem(cf, edt, create_proto_tree, print_packet_info && print_details);
+    reset_epan_mem(cf, edt, create_proto_tree, proto_tree_is_visible(tap_flags));
 
     if (process_packet_single_pass(cf, edt, data_offset, &rec, &buf, tap_flags)) {
       /* Either there's no read filtering or this packet passed the
@@ -3836,6 +4149,11 @@ process_packet_single_pass(capture_file *cf, epan_dissect_t *edt, gint64 offset,
 
     col_custom_prime_edt(edt, &cf->cinfo);
 
+    /* If we're printing only the values of some fields, the protocol
+       tree isn't visible; prime it with those fields. */
+    if (print_packet_info && only_output_fields_needed(tap_flags))
+      output_fields_prime_edt(output_fields, edt);
+
     /* We only need the columns if either
          1) some tap needs the columns
        or
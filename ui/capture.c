@@ -421,6 +421,9 @@ capture_input_new_file(capture_session *cap_session, gchar *new_file)
         /* Attempt to open the capture file and set up to read from it. */
         switch(cf_open((capture_file *)cap_session->cf, capture_opts->save_file, WTAP_TYPE_AUTO, is_tempfile, &err)) {
             case CF_OK:
+                /* Read what dumpcap writes from its live feed where we can. */
+                wtap_set_live_feed(((capture_file *)cap_session->cf)->provider.wth,
+                                   cap_session->live_feed);
                 break;
             case CF_ERROR:
                 /* Don't unlink (delete) the save file - leave it around,
@@ -446,6 +449,7 @@ capture_input_new_file(capture_session *cap_session, gchar *new_file)
             g_free(err_msg);
             return FALSE;
         }
+        wtap_set_live_feed(cap_session->wtap, cap_session->live_feed);
     }
 
     if(capture_opts->real_time_mode) {
@@ -572,6 +576,20 @@ capture_input_drops(capture_session *cap_session, guint32 dropped, const char* i
 }
 
 
+/* Capture child told us how many packets it has waiting to be written
+ * for an interface.
+ */
+static void
+capture_input_queued(capture_session *cap_session _U_, guint32 queued, guint32 queued_max, const char* interface_name)
+{
+    if (interface_name != NULL) {
+        ws_info("%u packet%s queued for %s, at most %u", queued, plurality(queued, "", "s"), interface_name, queued_max);
+    } else {
+        ws_info("%u packet%s queued, at most %u", queued, plurality(queued, "", "s"), queued_max);
+    }
+}
+
+
 /* Capture child told us that an error has occurred while starting/running
    the capture.
    The buffer we're handed has *two* null-terminated strings in it - a
@@ -927,7 +945,8 @@ capture_input_init(capture_session *cap_session, capture_file *cf)
 {
     capture_session_init(cap_session, cf,
                          capture_input_new_file, capture_input_new_packets,
-                         capture_input_drops, capture_input_error,
-                         capture_input_cfilter_error, capture_input_closed);
+                         capture_input_drops, capture_input_queued,
+                         capture_input_error, capture_input_cfilter_error,
+                         capture_input_closed);
 }
 #endif /* HAVE_LIBPCAP */
@@ -8,6 +8,7 @@
  */
 
 #include <algorithm>
+#include <functional>
 #include <glib.h>
 
 #include "packet_list_model.h"
@@ -34,8 +35,12 @@
 #include <QColor>
 #include <QElapsedTimer>
 #include <QFontMetrics>
+#include <QHash>
 #include <QModelIndex>
 #include <QElapsedTimer>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
 
 // Print timing information
 //#define DEBUG_PACKET_LIST_MODEL 1
@@ -71,6 +76,9 @@ PacketListModel::PacketListModel(QObject *parent, capture_file *cf) :
     number_to_row_(QVector<int>()),
     max_row_height_(0),
     max_line_count_(1),
+    sorting_(false),
+    stop_sort_(FALSE),
+    sort_progress_(nullptr),
     idle_dissection_row_(0)
 {
     Q_ASSERT(glbl_plist_model == Q_NULLPTR);
@@ -162,6 +170,8 @@ guint PacketListModel::recreateVisibleRows()
 }
 
 void PacketListModel::clear() {
+    // If we're sorting (and processing events), the records are going away.
+    stop_sort_ = TRUE;
     emit beginResetModel();
     qDeleteAll(physical_rows_);
     physical_rows_.resize(0);
@@ -342,10 +352,44 @@ capture_file *PacketListModel::sort_cap_file_;
 
 QElapsedTimer busy_timer_;
 const int busy_timeout_ = 65; // ms, approximately 15 fps
+static QElapsedTimer sort_timer_;
+static const int sort_progress_delay_ = 500; // ms, don't flash the progress bar for quick sorts
+
+// Rows are sorted in parallel only if there are at least this many of them.
+static const int parallel_sort_min_rows_ = 10000;
+
+class PacketListSortTask : public QRunnable
+{
+public:
+    PacketListSortTask(std::function<void()> task) : task_(task) {}
+    void run() { task_(); }
+
+private:
+    std::function<void()> task_;
+};
+
+// Runs the tasks on as many threads as we have cores, and waits for all of
+// them. The tasks must not touch anything that the main thread changes.
+static void runSortTasks(const QVector<std::function<void()> > &tasks)
+{
+    if (tasks.count() == 1) {
+        tasks.first()();
+        return;
+    }
+
+    QThreadPool pool;
+    foreach (const std::function<void()> &task, tasks) {
+        pool.start(new PacketListSortTask(task));
+    }
+    pool.waitForDone();
+}
+
 void PacketListModel::sort(int column, Qt::SortOrder order)
 {
     if (!cap_file_ || visible_rows_.count() < 1) return;
     if (column < 0) return;
+    // We process events while sorting, which might get us here again.
+    if (sorting_) return;
 
     sort_column_ = column;
     text_sort_column_ = PacketListRecord::textColumn(column);
@@ -354,16 +398,46 @@ void PacketListModel::sort(int column, Qt::SortOrder order)
 
     QString col_title = get_column_title(column);
 
-    // XXX Use updateProgress instead. We'd have to switch from std::sort to
-    // something we can interrupt.
     if (!col_title.isEmpty()) {
         QString busy_msg = tr("Sorting \"%1\"…").arg(col_title);
         wsApp->pushStatus(WiresharkApplication::BusyStatus, busy_msg);
     }
 
+    sorting_ = true;
+    stop_sort_ = FALSE;
+    sort_title_ = col_title;
+    sort_progress_ = nullptr;
     busy_timer_.start();
+    sort_timer_.start();
     sort_column_is_numeric_ = isNumericColumn(sort_column_);
-    std::sort(physical_rows_.begin(), physical_rows_.end(), recordLessThan);
+
+    // Comparing rows directly means getting (and for custom columns,
+    // parsing) their column strings on every comparison. Get what we sort
+    // on from each row once instead, then sort that in parallel.
+    QVector<SortKey> keys(physical_rows_.count());
+    bool sorted = extractSortKeys(keys) && sortKeys(keys);
+
+    if (sort_progress_) {
+        destroy_progress_dlg(sort_progress_);
+        sort_progress_ = nullptr;
+    }
+    sorting_ = false;
+
+    if (!col_title.isEmpty()) {
+        wsApp->popStatus(WiresharkApplication::BusyStatus);
+    }
+
+    // If we were stopped, leave the rows as they were.
+    if (!sorted) return;
+
+    QVector<PacketListRecord *> sorted_rows;
+    sorted_rows.reserve(physical_rows_.capacity());
+    foreach (const SortKey &key, keys) {
+        sorted_rows << key.record;
+    }
+    // Packets appended while we were sorting go at the end.
+    sorted_rows << physical_rows_.mid(keys.count());
+    physical_rows_.swap(sorted_rows);
 
     emit beginResetModel();
     visible_rows_.resize(0);
@@ -381,15 +455,174 @@ void PacketListModel::sort(int column, Qt::SortOrder order)
     }
     emit endResetModel();
 
-    if (!col_title.isEmpty()) {
-        wsApp->popStatus(WiresharkApplication::BusyStatus);
-    }
-
     if (cap_file_->current_frame) {
         emit goToPacket(cap_file_->current_frame->num);
     }
 }
 
+// Shows how far we got, and processes events. Returns false if we should
+// stop sorting, either because the user asked us to or because the rows
+// have been cleared.
+bool PacketListModel::updateSortProgress(float progress)
+{
+    if (busy_timer_.elapsed() < busy_timeout_) {
+        return !stop_sort_;
+    }
+
+    if (!sort_progress_ && cap_file_->window && sort_timer_.elapsed() > sort_progress_delay_) {
+        sort_progress_ = delayed_create_progress_dlg(cap_file_->window, "Sorting",
+                                                     qUtf8Printable(sort_title_),
+                                                     TRUE, &stop_sort_, progress);
+    } else if (sort_progress_) {
+        update_progress_dlg(sort_progress_, progress, NULL);
+    }
+
+    if (!sort_progress_) {
+        // What's the least amount of processing that we can do which will draw
+        // the busy indicator?
+        wsApp->processEvents(QEventLoop::ExcludeUserInputEvents | QEventLoop::ExcludeSocketNotifiers, 1);
+    }
+    busy_timer_.restart();
+
+    return !stop_sort_;
+}
+
+// Fills in the sort key of each physical row. This has to be done on the
+// main thread, as getting column strings might mean dissecting.
+bool PacketListModel::extractSortKeys(QVector<SortKey> &keys)
+{
+    int count = keys.count();
+    QVector<QString> col_strings;
+
+    if (text_sort_column_ >= 0) {
+        col_strings.resize(count);
+    }
+
+    for (int i = 0; i < count; i++) {
+        SortKey &key = keys[i];
+
+        key.record = physical_rows_[i];
+        key.number = 0.0;
+        key.number_ok = false;
+        key.text_rank = 0;
+
+        if (text_sort_column_ >= 0) {
+            col_strings[i] = key.record->columnString(sort_cap_file_, sort_column_);
+            if (!updateSortProgress(0.5f * i / count)) {
+                return false;
+            }
+        }
+    }
+
+    if (text_sort_column_ < 0) {
+        // Column comes directly from frame data
+        return true;
+    }
+
+    if (sort_column_is_numeric_) {
+        // Custom column with numeric data (or something like a port number).
+        // Parse the strings in parallel.
+        int num_tasks = count < parallel_sort_min_rows_ ? 1 : qMax(1, QThread::idealThreadCount());
+        SortKey *key_data = keys.data();
+        const QString *string_data = col_strings.constData();
+        QVector<std::function<void()> > tasks;
+        for (int i = 0; i < num_tasks; i++) {
+            int first = (int)((gint64)count * i / num_tasks);
+            int last = (int)((gint64)count * (i + 1) / num_tasks);
+            tasks << [key_data, string_data, first, last]() {
+                for (int j = first; j < last; j++) {
+                    key_data[j].number = parseNumericColumn(string_data[j], &key_data[j].number_ok);
+                }
+            };
+        }
+        runSortTasks(tasks);
+    } else {
+        // Replace each string with its rank among all of them, so that we
+        // compare integers while sorting rows. Rows often share column
+        // strings, so there are usually far fewer of them than rows.
+        QHash<QString, int> ranks;
+        foreach (const QString &col_string, col_strings) {
+            ranks.insert(col_string, 0);
+        }
+        QVector<QString> unique_strings;
+        unique_strings.reserve(ranks.count());
+        for (QHash<QString, int>::const_iterator it = ranks.constBegin(); it != ranks.constEnd(); ++it) {
+            unique_strings << it.key();
+        }
+        std::sort(unique_strings.begin(), unique_strings.end());
+        for (int i = 0; i < unique_strings.count(); i++) {
+            ranks[unique_strings[i]] = i;
+        }
+        for (int i = 0; i < count; i++) {
+            keys[i].text_rank = ranks.value(col_strings[i]);
+        }
+    }
+
+    return updateSortProgress(0.5f);
+}
+
+// Sorts the keys with a parallel merge sort: each thread sorts a run of
+// keys, then pairs of runs are merged in parallel until there's one left.
+// We only process events between passes, while no other thread is running.
+bool PacketListModel::sortKeys(QVector<SortKey> &keys)
+{
+    int count = keys.count();
+    int num_runs = count < parallel_sort_min_rows_ ? 1 : qMax(1, QThread::idealThreadCount());
+    QVector<int> bounds;
+    for (int i = 0; i <= num_runs; i++) {
+        bounds << (int)((gint64)count * i / num_runs);
+    }
+
+    int num_passes = 1;
+    for (int runs = num_runs; runs > 1; runs = (runs + 1) / 2) {
+        num_passes++;
+    }
+    int pass = 0;
+
+    SortKey *key_data = keys.data();
+    QVector<std::function<void()> > tasks;
+    for (int i = 0; i < num_runs; i++) {
+        int first = bounds[i];
+        int last = bounds[i + 1];
+        tasks << [key_data, first, last]() {
+            std::sort(key_data + first, key_data + last, sortKeyLessThan);
+        };
+    }
+    runSortTasks(tasks);
+    if (!updateSortProgress(0.5f + 0.5f * ++pass / num_passes)) {
+        return false;
+    }
+
+    QVector<SortKey> merged(count);
+    while (bounds.count() > 2) {
+        SortKey *src = keys.data();
+        SortKey *dst = merged.data();
+        QVector<int> merged_bounds;
+
+        tasks.clear();
+        for (int i = 0; i < bounds.count() - 1; i += 2) {
+            int first = bounds[i];
+            int middle = bounds[i + 1];
+            int last = i + 2 < bounds.count() ? bounds[i + 2] : middle;
+            tasks << [src, dst, first, middle, last]() {
+                std::merge(src + first, src + middle, src + middle, src + last,
+                           dst + first, sortKeyLessThan);
+            };
+            merged_bounds << first;
+        }
+        merged_bounds << count;
+        runSortTasks(tasks);
+
+        keys.swap(merged);
+        bounds = merged_bounds;
+        if (!updateSortProgress(0.5f + 0.5f * ++pass / num_passes)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool PacketListModel::isNumericColumn(int column)
 {
     if (column < 0) {
@@ -457,53 +690,37 @@ bool PacketListModel::isNumericColumn(int column)
     return true;
 }
 
-bool PacketListModel::recordLessThan(PacketListRecord *r1, PacketListRecord *r2)
+// Must be safe to call from any thread.
+bool PacketListModel::sortKeyLessThan(const SortKey &k1, const SortKey &k2)
 {
     int cmp_val = 0;
+    const frame_data *fdata1 = k1.record->frameData();
+    const frame_data *fdata2 = k2.record->frameData();
 
-    // Wherein we try to cram the logic of packet_list_compare_records,
-    // _packet_list_compare_records, and packet_list_compare_custom from
-    // gtk/packet_list_store.c into one function
-
-    if (busy_timer_.elapsed() > busy_timeout_) {
-        // What's the least amount of processing that we can do which will draw
-        // the busy indicator?
-        wsApp->processEvents(QEventLoop::ExcludeUserInputEvents | QEventLoop::ExcludeSocketNotifiers, 1);
-        busy_timer_.restart();
-    }
     if (sort_column_ < 0) {
         // No column.
-        cmp_val = frame_data_compare(sort_cap_file_->epan, r1->frameData(), r2->frameData(), COL_NUMBER);
+        cmp_val = frame_data_compare(sort_cap_file_->epan, fdata1, fdata2, COL_NUMBER);
     } else if (text_sort_column_ < 0) {
         // Column comes directly from frame data
-        cmp_val = frame_data_compare(sort_cap_file_->epan, r1->frameData(), r2->frameData(), sort_cap_file_->cinfo.columns[sort_column_].col_fmt);
+        cmp_val = frame_data_compare(sort_cap_file_->epan, fdata1, fdata2, sort_cap_file_->cinfo.columns[sort_column_].col_fmt);
     } else  {
-        if (r1->columnString(sort_cap_file_, sort_column_).constData() == r2->columnString(sort_cap_file_, sort_column_).constData()) {
-            cmp_val = 0;
-        } else if (sort_column_is_numeric_) {
-            // Custom column with numeric data (or something like a port number).
-            // Attempt to convert to numbers.
-            // XXX This is slow. Can we avoid doing this?
-            bool ok_r1, ok_r2;
-            double num_r1 = parseNumericColumn(r1->columnString(sort_cap_file_, sort_column_), &ok_r1);
-            double num_r2 = parseNumericColumn(r2->columnString(sort_cap_file_, sort_column_), &ok_r2);
-
-            if (!ok_r1 && !ok_r2) {
+        if (sort_column_is_numeric_) {
+            if (!k1.number_ok && !k2.number_ok) {
                 cmp_val = 0;
-            } else if (!ok_r1 || (ok_r2 && num_r1 < num_r2)) {
+            } else if (!k1.number_ok || (k2.number_ok && k1.number < k2.number)) {
                 // either r1 is invalid (and sort it before others) or both
                 // r1 and r2 are valid (sort normally)
                 cmp_val = -1;
-            } else if (!ok_r2 || (num_r1 > num_r2)) {
+            } else if (!k2.number_ok || (k1.number > k2.number)) {
                 cmp_val = 1;
             }
-        } else {
-            cmp_val = r1->columnString(sort_cap_file_, sort_column_).compare(r2->columnString(sort_cap_file_, sort_column_));
+        } else if (k1.text_rank != k2.text_rank) {
+            cmp_val = k1.text_rank < k2.text_rank ? -1 : 1;
         }
 
         if (cmp_val == 0) {
             // All else being equal, compare column numbers.
-            cmp_val = frame_data_compare(sort_cap_file_->epan, r1->frameData(), r2->frameData(), COL_NUMBER);
+            cmp_val = frame_data_compare(sort_cap_file_->epan, fdata1, fdata2, COL_NUMBER);
         }
     }
 
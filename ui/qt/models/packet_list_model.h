@@ -25,6 +25,7 @@
 #include "packet_list_record.h"
 
 #include "cfile.h"
+#include "ui/progress_dlg.h"
 
 class QElapsedTimer;
 
@@ -93,14 +94,30 @@ private:
     int max_row_height_; // px
     int max_line_count_;
 
+    // What we sort rows on, extracted from each row once before sorting.
+    struct SortKey {
+        PacketListRecord *record;
+        double number;      // numeric column value
+        bool number_ok;     // number was parsed
+        int text_rank;      // rank of the column string among all rows'
+    };
+
     static int sort_column_;
     static int sort_column_is_numeric_;
     static int text_sort_column_;
     static Qt::SortOrder sort_order_;
     static capture_file *sort_cap_file_;
-    static bool recordLessThan(PacketListRecord *r1, PacketListRecord *r2);
+    static bool sortKeyLessThan(const SortKey &k1, const SortKey &k2);
     static double parseNumericColumn(const QString &val, bool *ok);
 
+    bool sorting_;
+    gboolean stop_sort_;
+    QString sort_title_;
+    progdlg_t *sort_progress_;
+    bool extractSortKeys(QVector<SortKey> &keys);
+    bool sortKeys(QVector<SortKey> &keys);
+    bool updateSortProgress(float progress);
+
     QElapsedTimer *idle_dissection_timer_;
     int idle_dissection_row_;
 
@@ -55,23 +55,40 @@
     }
 
 static void
-modify_time_perform(frame_data *fd, int neg, nstime_t *offset, int settozero)
+get_shift_offset(capture_file *cf, const frame_data *fd, nstime_t *shift_offset)
 {
+    const nstime_t *offset = cap_file_provider_get_shift_offset(&cf->provider, fd);
+
+    if (offset)
+        nstime_copy(shift_offset, offset);
+    else
+        nstime_set_zero(shift_offset);
+}
+
+static void
+modify_time_perform(capture_file *cf, frame_data *fd, int neg, nstime_t *offset, int settozero)
+{
+    nstime_t shift_offset;
+
+    get_shift_offset(cf, fd, &shift_offset);
+
     /* The actual shift */
     if (settozero == SHIFT_SETTOZERO) {
-        nstime_subtract(&(fd->abs_ts), &(fd->shift_offset));
-        nstime_set_zero(&(fd->shift_offset));
+        nstime_subtract(&(fd->abs_ts), &shift_offset);
+        nstime_set_zero(&shift_offset);
     }
 
     if (neg == SHIFT_POS) {
         nstime_add(&(fd->abs_ts), offset);
-        nstime_add(&(fd->shift_offset), offset);
+        nstime_add(&shift_offset, offset);
     } else if (neg == SHIFT_NEG) {
         nstime_subtract(&(fd->abs_ts), offset);
-        nstime_subtract(&(fd->shift_offset), offset);
+        nstime_subtract(&shift_offset, offset);
     } else {
         fprintf(stderr, "Modify_time_perform: neg = %d?\n", neg);
     }
+
+    cap_file_provider_set_shift_offset(&cf->provider, fd, &shift_offset);
 }
 
 /*
@@ -287,7 +304,7 @@ time_shift_all(capture_file *cf, const gchar *offset_text)
     for (i = 1; i <= cf->count; i++) {
         if ((fd = frame_data_sequence_find(cf->provider.frames, i)) == NULL)
             continue;   /* Shouldn't happen */
-        modify_time_perform(fd, neg ? SHIFT_NEG : SHIFT_POS, &offset, SHIFT_KEEPOFFSET);
+        modify_time_perform(cf, fd, neg ? SHIFT_NEG : SHIFT_POS, &offset, SHIFT_KEEPOFFSET);
     }
     cf->unsaved_changes = TRUE;
     packet_list_queue_draw();
@@ -298,7 +315,7 @@ time_shift_all(capture_file *cf, const gchar *offset_text)
 const gchar *
 time_shift_settime(capture_file *cf, guint packet_num, const gchar *time_text)
 {
-    nstime_t    set_time, diff_time, packet_time;
+    nstime_t    set_time, diff_time, packet_time, shift_offset;
     frame_data  *fd, *packetfd;
     guint32     i;
     const gchar *err_str;
@@ -315,7 +332,8 @@ time_shift_settime(capture_file *cf, guint packet_num, const gchar *time_text)
      */
     if ((packetfd = frame_data_sequence_find(cf->provider.frames, packet_num)) == NULL)
         return "No packets found.";
-    nstime_delta(&packet_time, &(packetfd->abs_ts), &(packetfd->shift_offset));
+    get_shift_offset(cf, packetfd, &shift_offset);
+    nstime_delta(&packet_time, &(packetfd->abs_ts), &shift_offset);
 
     if ((err_str = time_string_to_nstime(time_text, &packet_time, &set_time)) != NULL)
         return err_str;
@@ -332,7 +350,7 @@ time_shift_settime(capture_file *cf, guint packet_num, const gchar *time_text)
     for (i = 1; i <= cf->count; i++) {
         if ((fd = frame_data_sequence_find(cf->provider.frames, i)) == NULL)
             continue;   /* Shouldn't happen */
-        modify_time_perform(fd, SHIFT_POS, &diff_time, SHIFT_SETTOZERO);
+        modify_time_perform(cf, fd, SHIFT_POS, &diff_time, SHIFT_SETTOZERO);
     }
 
     cf->unsaved_changes = TRUE;
@@ -344,7 +362,7 @@ const gchar *
 time_shift_adjtime(capture_file *cf, guint packet1_num, const gchar *time1_text, guint packet2_num, const gchar *time2_text)
 {
     nstime_t    nt1, nt2, ot1, ot2, nt3;
-    nstime_t    dnt, dot, d3t;
+    nstime_t    dnt, dot, d3t, shift_offset;
     frame_data  *fd, *packet1fd, *packet2fd;
     guint32     i;
     const gchar *err_str;
@@ -375,7 +393,8 @@ time_shift_adjtime(capture_file *cf, guint packet1_num, const gchar *time1_text,
     if ((packet1fd = frame_data_sequence_find(cf->provider.frames, packet1_num)) == NULL)
         return "No frames found.";
     nstime_copy(&ot1, &(packet1fd->abs_ts));
-    nstime_subtract(&ot1, &(packet1fd->shift_offset));
+    get_shift_offset(cf, packet1fd, &shift_offset);
+    nstime_subtract(&ot1, &shift_offset);
 
     if ((err_str = time_string_to_nstime(time1_text, &ot1, &nt1)) != NULL)
         return err_str;
@@ -387,7 +406,8 @@ time_shift_adjtime(capture_file *cf, guint packet1_num, const gchar *time1_text,
     if ((packet2fd = frame_data_sequence_find(cf->provider.frames, packet2_num)) == NULL)
         return "No frames found.";
     nstime_copy(&ot2, &(packet2fd->abs_ts));
-    nstime_subtract(&ot2, &(packet2fd->shift_offset));
+    get_shift_offset(cf, packet2fd, &shift_offset);
+    nstime_subtract(&ot2, &shift_offset);
 
     if ((err_str = time_string_to_nstime(time2_text, &ot2, &nt2)) != NULL)
         return err_str;
@@ -407,8 +427,10 @@ time_shift_adjtime(capture_file *cf, guint packet1_num, const gchar *time1_text,
             continue;   /* Shouldn't happen */
 
         /* Set everything back to the original time */
-        nstime_subtract(&(fd->abs_ts), &(fd->shift_offset));
-        nstime_set_zero(&(fd->shift_offset));
+        get_shift_offset(cf, fd, &shift_offset);
+        nstime_subtract(&(fd->abs_ts), &shift_offset);
+        nstime_set_zero(&shift_offset);
+        cap_file_provider_set_shift_offset(&cf->provider, fd, &shift_offset);
 
         /* Add the difference to each packet */
         calcNT3(&ot1, &(fd->abs_ts), &nt1, &nt3, &dot, &dnt);
@@ -416,7 +438,7 @@ time_shift_adjtime(capture_file *cf, guint packet1_num, const gchar *time1_text,
         nstime_copy(&d3t, &nt3);
         nstime_subtract(&d3t, &(fd->abs_ts));
 
-        modify_time_perform(fd, SHIFT_POS, &d3t, SHIFT_SETTOZERO);
+        modify_time_perform(cf, fd, SHIFT_POS, &d3t, SHIFT_SETTOZERO);
     }
 
     cf->unsaved_changes = TRUE;
@@ -442,7 +464,7 @@ time_shift_undo(capture_file *cf)
     for (i = 1; i <= cf->count; i++) {
         if ((fd = frame_data_sequence_find(cf->provider.frames, i)) == NULL)
             continue;   /* Shouldn't happen */
-        modify_time_perform(fd, SHIFT_NEG, &nulltime, SHIFT_SETTOZERO);
+        modify_time_perform(cf, fd, SHIFT_NEG, &nulltime, SHIFT_SETTOZERO);
     }
     packet_list_queue_draw();
     return NULL;
@@ -0,0 +1,175 @@
+/* time_shift_test.c
+ * Unit tests for shifting packet times
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib.h>
+
+#include "cfile.h"
+#include "ui/time_shift.h"
+#include "ui/ws_ui_util.h"
+
+#define TEST_FRAMES 10
+
+/* time_shift.c redraws the packet list; there's none here. */
+void
+packet_list_queue_draw(void)
+{
+}
+
+static void
+test_capture_file_init(capture_file *cf)
+{
+    frame_data fdata;
+    guint32 i;
+
+    memset(cf, 0, sizeof *cf);
+    cf->provider.frames = new_frame_data_sequence();
+    for (i = 1; i <= TEST_FRAMES; i++) {
+        memset(&fdata, 0, sizeof fdata);
+        fdata.num = i;
+        fdata.has_ts = TRUE;
+        fdata.abs_ts.secs = 1000000000 + i;
+        fdata.abs_ts.nsecs = 250000000;
+        frame_data_sequence_add(cf->provider.frames, &fdata);
+    }
+    cf->count = TEST_FRAMES;
+}
+
+static void
+test_capture_file_cleanup(capture_file *cf)
+{
+    if (cf->provider.frames_shift_offsets)
+        g_tree_destroy(cf->provider.frames_shift_offsets);
+    free_frame_data_sequence(cf->provider.frames);
+}
+
+/* Check that every frame is offset from its original time. */
+static void
+check_shift(capture_file *cf, time_t secs, int nsecs)
+{
+    frame_data *fd;
+    const nstime_t *offset;
+    nstime_t expected;
+    guint32 i;
+
+    for (i = 1; i <= TEST_FRAMES; i++) {
+        fd = frame_data_sequence_find(cf->provider.frames, i);
+        g_assert_nonnull(fd);
+        expected.secs = 1000000000 + i + secs;
+        expected.nsecs = 250000000 + nsecs;
+        if (expected.nsecs >= 1000000000) {
+            expected.secs++;
+            expected.nsecs -= 1000000000;
+        } else if (expected.nsecs < 0) {
+            expected.secs--;
+            expected.nsecs += 1000000000;
+        }
+        g_assert_cmpint(fd->abs_ts.secs, ==, expected.secs);
+        g_assert_cmpint(fd->abs_ts.nsecs, ==, expected.nsecs);
+
+        offset = cap_file_provider_get_shift_offset(&cf->provider, fd);
+        if (secs == 0 && nsecs == 0) {
+            /* Unshifted frames aren't in the table. */
+            g_assert_false(fd->has_shift_offset);
+            g_assert_null(offset);
+        } else {
+            g_assert_true(fd->has_shift_offset);
+            g_assert_nonnull(offset);
+            g_assert_cmpint(offset->secs, ==, secs);
+            g_assert_cmpint(offset->nsecs, ==, nsecs);
+        }
+    }
+}
+
+static void
+test_time_shift_all(void)
+{
+    capture_file cf;
+
+    test_capture_file_init(&cf);
+    check_shift(&cf, 0, 0);
+
+    g_assert_null(time_shift_all(&cf, "1.5"));
+    check_shift(&cf, 1, 500000000);
+    g_assert_true(cf.unsaved_changes);
+
+    /* Shifts add up. */
+    g_assert_null(time_shift_all(&cf, "1:00"));
+    check_shift(&cf, 61, 500000000);
+
+    g_assert_null(time_shift_all(&cf, "-1:01.75"));
+    check_shift(&cf, 0, -250000000);
+
+    /* Shifting back to where we started drops the offsets. */
+    g_assert_null(time_shift_all(&cf, "0.25"));
+    check_shift(&cf, 0, 0);
+
+    g_assert_nonnull(time_shift_all(&cf, "0"));
+    check_shift(&cf, 0, 0);
+
+    test_capture_file_cleanup(&cf);
+}
+
+static void
+test_time_shift_undo(void)
+{
+    capture_file cf;
+    frame_data *fd;
+    nstime_t ten_secs = NSTIME_INIT_SECS(10);
+
+    test_capture_file_init(&cf);
+
+    g_assert_null(time_shift_all(&cf, "2:03:04.5"));
+    check_shift(&cf, 7384, 500000000);
+
+    g_assert_null(time_shift_undo(&cf));
+    check_shift(&cf, 0, 0);
+
+    /* Frames shifted on their own are undone too. */
+    fd = frame_data_sequence_find(cf.provider.frames, 3);
+    g_assert_nonnull(fd);
+    fd->abs_ts.secs += 10;
+    cap_file_provider_set_shift_offset(&cf.provider, fd, &ten_secs);
+    g_assert_true(fd->has_shift_offset);
+    g_assert_null(time_shift_undo(&cf));
+    check_shift(&cf, 0, 0);
+
+    test_capture_file_cleanup(&cf);
+}
+
+int
+main(int argc, char **argv)
+{
+    int ret;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/time_shift/all", test_time_shift_all);
+    g_test_add_func("/time_shift/undo", test_time_shift_undo);
+
+    ret = g_test_run();
+
+    return ret;
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -19,10 +19,19 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stddef.h>
 #include <string.h>
 #include "wtap-int.h"
 
 #include <wsutil/file_util.h>
+#include <wsutil/live_feed.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <setjmp.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 
 #ifdef HAVE_ZLIB
 #define ZLIB_CONST
@@ -159,6 +168,12 @@ typedef enum {
  */
 #define MAX_READ_BUF_SIZE	(1U << 30)
 
+/*
+ * How much we copy from the mapping of a file before checking, with
+ * fstat(), that the file hasn't changed size.
+ */
+#define MAP_CHECK_INTERVAL	(1024 * 1024)
+
 struct wtap_reader_buf {
     guint8 *buf;  /* buffer */
     guint8 *next; /* next byte to deliver from buffer */
@@ -168,6 +183,7 @@ struct wtap_reader_buf {
 struct wtap_reader {
     int fd;                     /* file descriptor */
     gint64 raw_pos;             /* current position in file (just to not call lseek()) */
+    gboolean fd_stale;          /* TRUE if fd isn't at raw_pos, as we read from the mapping */
     gint64 pos;                 /* current position in uncompressed data */
     guint size;                 /* buffer size */
 
@@ -203,6 +219,14 @@ struct wtap_reader {
 #ifdef USE_LZ4
     LZ4F_dctx *lz4_dctx;
 #endif
+    /* memory-mapped uncompressed file */
+    gboolean try_mmap;          /* TRUE if we should map the file once we know it's uncompressed */
+    const guint8 *map;          /* mapping of the file, or NULL */
+    gint64 map_size;            /* number of bytes mapped */
+    gint64 map_unchecked;       /* bytes we can copy from the mapping before checking the file's size again */
+    /* live feed of the file from the process writing it */
+    live_feed_t *feed;          /* live feed, or NULL */
+    guint64 feed_generation;    /* generation of the file in the feed */
 };
 
 /* Current read offset within a buffer. */
@@ -241,6 +265,175 @@ buf_reset(struct wtap_reader_buf *buf)
     buf->avail = 0;
 }
 
+/*
+ * If we've been reading from the mapping of the file, the file
+ * descriptor is still where we left it; move it to where we are,
+ * before reading from it or seeking relative to its position.
+ */
+static int
+sync_fd(FILE_T state)
+{
+    if (state->fd_stale) {
+        if (ws_lseek64(state->fd, state->raw_pos, SEEK_SET) == -1)
+            return -1;
+        state->fd_stale = FALSE;
+    }
+    return 0;
+}
+
+#ifdef HAVE_SYS_MMAN_H
+static void
+file_unmap(FILE_T state)
+{
+    if (state->map != NULL) {
+        munmap((void *)state->map, (size_t)state->map_size);
+        state->map = NULL;
+        state->map_size = 0;
+    }
+}
+
+/*
+ * Where to jump to if copying from a mapping on this thread faults, or
+ * NULL if this thread isn't copying from a mapping.
+ */
+static _Thread_local sigjmp_buf *map_fault_env;
+
+/* What SIGBUS did before we installed our handler. */
+static struct sigaction map_fault_old_action;
+
+static void
+map_fault_handler(int sig _U_)
+{
+    if (map_fault_env != NULL)
+        siglongjmp(*map_fault_env, 1);
+
+    /*
+     * Not a fault copying from a mapping; put back the previous
+     * handling of SIGBUS and return, so that the faulting instruction
+     * gets it when it's run again.
+     */
+    sigaction(SIGBUS, &map_fault_old_action, NULL);
+}
+
+static void
+map_fault_handler_install(void)
+{
+    static gsize installed = 0;
+
+    if (g_once_init_enter(&installed)) {
+        struct sigaction action;
+
+        memset(&action, 0, sizeof action);
+        action.sa_handler = map_fault_handler;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGBUS, &action, &map_fault_old_action);
+        g_once_init_leave(&installed, 1);
+    }
+}
+
+/*
+ * Map an uncompressed regular file into memory.  We then copy data
+ * straight from the mapping rather than read() it into the output
+ * buffer and copy it from there, and seeking within the file needs no
+ * system calls.
+ *
+ * Accessing a mapped page past the end of a file raises SIGBUS, and
+ * the file can be truncated by another process at any time, so we copy
+ * from the mapping with file_map_copy(), which recovers from that.  In
+ * addition, we check, with fstat(), that the file is still the size it
+ * was when we mapped it before we start copying from the mapping and
+ * after every MAP_CHECK_INTERVAL bytes we copy; if it has changed size,
+ * e.g. because it's being captured to, we unmap it and read it with
+ * read() from then on.  A file that we have a live feed for is being
+ * captured to, so we don't map it at all.
+ */
+static void
+file_map(FILE_T state)
+{
+    ws_statb64 st;
+    void *map;
+
+    if (state->map != NULL || state->feed != NULL)
+        return;
+    if (ws_fstat64(state->fd, &st) == -1 || !S_ISREG(st.st_mode))
+        return;
+    if (st.st_size == 0 || (guint64)st.st_size > G_MAXSIZE)
+        return;
+
+    map_fault_handler_install();
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, state->fd, 0);
+    if (map == MAP_FAILED)
+        return;
+
+    state->map = (const guint8 *)map;
+    state->map_size = st.st_size;
+    state->map_unchecked = MAP_CHECK_INTERVAL;
+}
+
+/*
+ * Check that a mapped file is still the size it was when we mapped it.
+ * If it isn't, unmap it, and don't map it again; returns FALSE in that
+ * case.
+ */
+static gboolean
+file_map_check(FILE_T state)
+{
+    ws_statb64 st;
+
+    if (ws_fstat64(state->fd, &st) == -1 || st.st_size != state->map_size) {
+        file_unmap(state);
+        state->try_mmap = FALSE;
+        return FALSE;
+    }
+    state->map_unchecked = MAP_CHECK_INTERVAL;
+    return TRUE;
+}
+
+/*
+ * Copy len bytes at offset in the file from its mapping.  If the file
+ * has been truncated, so that some of them are no longer there, unmap
+ * it, don't map it again, and return FALSE.
+ */
+static gboolean
+file_map_copy(FILE_T state, void *buf, gint64 offset, guint len)
+{
+    sigjmp_buf env;
+
+    if (sigsetjmp(env, 1) != 0) {
+        map_fault_env = NULL;
+        file_unmap(state);
+        state->try_mmap = FALSE;
+        return FALSE;
+    }
+    map_fault_env = &env;
+    memcpy(buf, state->map + offset, len);
+    map_fault_env = NULL;
+    return TRUE;
+}
+#else
+static void
+file_unmap(FILE_T state _U_)
+{
+}
+
+static void
+file_map(FILE_T state _U_)
+{
+}
+
+static gboolean
+file_map_check(FILE_T state _U_)
+{
+    return FALSE;
+}
+
+static gboolean
+file_map_copy(FILE_T state _U_, void *buf _U_, gint64 offset _U_, guint len _U_)
+{
+    return FALSE;
+}
+#endif
+
 static int
 buf_read(FILE_T state, struct wtap_reader_buf *buf)
 {
@@ -266,6 +459,12 @@ buf_read(FILE_T state, struct wtap_reader_buf *buf)
         to_read = space_left;
     }
 
+    if (sync_fd(state) == -1) {
+        state->err = errno;
+        state->err_info = NULL;
+        return -1;
+    }
+
     ret = ws_read(state->fd, read_ptr, to_read);
     if (ret < 0) {
         state->err = errno;
@@ -291,6 +490,27 @@ fill_in_buffer(FILE_T state)
     return 0;
 }
 
+/*
+ * Try to get at least "needed" bytes into the input buffer, moving what's
+ * left in it to the beginning of the buffer if necessary; fewer bytes
+ * will be available only at the end of the file.
+ */
+static int
+fill_in_buffer_min(FILE_T state, guint needed)
+{
+    while (state->in.avail < needed && !state->eof) {
+        if (state->err != 0)
+            return -1;
+        if (state->in.next != state->in.buf) {
+            memmove(state->in.buf, state->in.next, state->in.avail);
+            state->in.next = state->in.buf;
+        }
+        if (buf_read(state, &state->in) < 0)
+            return -1;
+    }
+    return 0;
+}
+
 #define ZLIB_WINSIZE 32768
 
 struct fast_seek_point {
@@ -355,7 +575,13 @@ fast_seek_header(FILE_T file, gint64 in_pos, gint64 out_pos,
         item = (struct fast_seek_point *)file->fast_seek->pdata[file->fast_seek->len - 1];
 
     if (!item || item->out < out_pos) {
-        struct fast_seek_point *val = g_new(struct fast_seek_point,1);
+        /*
+         * Only zlib seek points, added by zlib_fast_seek_add(), need
+         * the data union, with its 32K window; for the others, which
+         * can be numerous (one per frame of a zstd or lz4 file), just
+         * allocate the part before it.
+         */
+        struct fast_seek_point *val = (struct fast_seek_point *)g_malloc(offsetof(struct fast_seek_point, data));
         val->in = in_pos;
         val->out = out_pos;
         val->compression = compression;
@@ -861,9 +1087,24 @@ gz_head(FILE_T state)
     /* FD 37 7A 58 5A 00 */
 #endif
 
+    /*
+     * The zstd and lz4 magic numbers are 4 bytes long; make sure we have
+     * all of them, even if this is a frame following another one and
+     * it straddles the end of the input buffer.
+     */
+    if (fill_in_buffer_min(state, 4) == -1)
+        return -1;
+
+    /*
+     * A zstd frame, or a zstd skippable frame (magic 0x184D2A5?), which
+     * ZSTD_decompressStream() skips over, such as the seek table of the
+     * zstd seekable format.
+     */
     if (state->in.avail >= 4
-        && state->in.buf[0] == 0x28 && state->in.buf[1] == 0xb5
-        && state->in.buf[2] == 0x2f && state->in.buf[3] == 0xfd) {
+        && ((state->in.next[0] == 0x28 && state->in.next[1] == 0xb5
+             && state->in.next[2] == 0x2f && state->in.next[3] == 0xfd)
+            || ((state->in.next[0] & 0xf0) == 0x50 && state->in.next[1] == 0x2a
+                && state->in.next[2] == 0x4d && state->in.next[3] == 0x18))) {
 #ifdef HAVE_ZSTD
         const size_t ret = ZSTD_initDStream(state->zstd_dctx);
         if (ZSTD_isError(ret)) {
@@ -872,6 +1113,13 @@ gz_head(FILE_T state)
             return -1;
         }
 
+        /*
+         * zstd frames are decompressed independently of each other, so
+         * the start of each one is a point we can seek to directly.
+         */
+        if (state->fast_seek)
+            fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, ZSTD);
+
         state->compression = ZSTD;
         state->is_compressed = TRUE;
         return 0;
@@ -883,8 +1131,8 @@ gz_head(FILE_T state)
     }
 
     if (state->in.avail >= 4
-        && state->in.buf[0] == 0x04 && state->in.buf[1] == 0x22
-        && state->in.buf[2] == 0x4d && state->in.buf[3] == 0x18) {
+        && state->in.next[0] == 0x04 && state->in.next[1] == 0x22
+        && state->in.next[2] == 0x4d && state->in.next[3] == 0x18) {
 #ifdef USE_LZ4
 #if LZ4_VERSION_NUMBER >= 10800
         LZ4F_resetDecompressionContext(state->lz4_dctx);
@@ -897,6 +1145,10 @@ gz_head(FILE_T state)
             return -1;
         }
 #endif
+        /* As with zstd, each lz4 frame can be decompressed on its own. */
+        if (state->fast_seek)
+            fast_seek_header(state, state->raw_pos - state->in.avail, state->pos, LZ4);
+
         state->compression = LZ4;
         state->is_compressed = TRUE;
         return 0;
@@ -926,6 +1178,8 @@ gz_head(FILE_T state)
         buf_reset(&state->in);
     }
     state->compression = UNCOMPRESSED;
+    if (state->try_mmap && !state->is_compressed)
+        file_map(state);
     return 0;
 }
 
@@ -1294,6 +1548,40 @@ file_set_random_access(FILE_T stream, gboolean random_flag _U_, GPtrArray *seek)
     stream->fast_seek = seek;
 }
 
+void
+file_try_mmap(FILE_T stream)
+{
+    stream->try_mmap = TRUE;
+
+    /* If we already know the file is uncompressed, map it now. */
+    if (stream->compression == UNCOMPRESSED && !stream->is_compressed)
+        file_map(stream);
+}
+
+void
+file_set_live_feed(FILE_T stream, live_feed_t *feed)
+{
+    ws_statb64 statb;
+    guint64 generation;
+
+    if (stream->feed != NULL) {
+        live_feed_unref(stream->feed);
+        stream->feed = NULL;
+    }
+    if (feed == NULL || ws_fstat64(stream->fd, &statb) == -1)
+        return;
+    /* If the feed isn't for this file, it's no use to us. */
+    generation = live_feed_file_generation(feed, (guint64)statb.st_dev,
+                                           (guint64)statb.st_ino);
+    if (generation == 0)
+        return;
+    /* The file is being captured to; don't read it through a mapping. */
+    file_unmap(stream);
+    stream->try_mmap = FALSE;
+    stream->feed = live_feed_ref(feed);
+    stream->feed_generation = generation;
+}
+
 gint64
 file_seek(FILE_T file, gint64 offset, int whence, int *err)
 {
@@ -1344,6 +1632,33 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
         return file->pos;
     }
 
+    /*
+     * Is the file mapped, and are we seeking within the mapping?  If
+     * so, just go there; we'll read from the mapping.
+     */
+    if (file->map != NULL && file->compression == UNCOMPRESSED &&
+        !file->is_compressed && file->pos + offset >= 0) {
+        gint64 target = file->start + file->pos + offset;
+
+        if (target <= file->map_size) {
+            buf_reset(&file->out);
+            buf_reset(&file->in);
+            file->raw_pos = target;
+            file->fd_stale = TRUE;
+            file->eof = FALSE;
+            file->err = 0;
+            file->err_info = NULL;
+            file->pos += offset;
+            return file->pos;
+        }
+    }
+
+    /* The code below expects the descriptor to be at raw_pos. */
+    if (sync_fd(file) == -1) {
+        *err = errno;
+        return -1;
+    }
+
     /*
      * Are we seeking backwards?
      */
@@ -1429,7 +1744,11 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             off2 = here->out;
         } else
 #endif
-        {
+        if (here->compression == ZSTD || here->compression == LZ4) {
+            /* Restart decompression at the beginning of the frame. */
+            off = here->in;
+            off2 = here->out;
+        } else {
             off2 = (file->pos + offset);
             off = here->in + (off2 - here->out);
         }
@@ -1481,6 +1800,10 @@ file_seek(FILE_T file, gint64 offset, int whence, int *err)
             file->compression = ZLIB;
         } else
 #endif
+        if (here->compression == ZSTD || here->compression == LZ4) {
+            /* Have gz_head() find the frame header and reset the decompressor. */
+            file->compression = UNKNOWN;
+        } else
             file->compression = here->compression;
 
         offset = (file->pos + offset) - off2;
@@ -1684,6 +2007,56 @@ file_read(void *buf, unsigned int len, FILE_T file)
                any more data into the output buffer, so
                return an error indication. */
             return -1;
+        } else if (file->map != NULL && file->compression == UNCOMPRESSED &&
+                   !file->is_compressed &&
+                   file->start + file->pos < file->map_size &&
+                   (file->map_unchecked > 0 || file_map_check(file))) {
+            /* We have nothing in the output buffer, and
+               the file is mapped (and, as far as we know,
+               hasn't changed size since); copy what we need
+               (or as much of it as is mapped, or we can copy
+               before checking the file again) from the
+               mapping. */
+            gint64 mapped = MIN(file->map_size - (file->start + file->pos),
+                                file->map_unchecked);
+
+            n = (gint64)len > mapped ? (guint)mapped : len;
+            if (buf != NULL) {
+                if (!file_map_copy(file, buf, file->start + file->pos, n)) {
+                    /* The file was truncated under us; read
+                       what's left of it with read(). */
+                    continue;
+                }
+                buf = (char *)buf + n;
+            }
+            file->map_unchecked -= n;
+            len -= n;
+            got += n;
+            file->pos += n;
+            file->raw_pos = file->start + file->pos;
+            file->fd_stale = TRUE;
+            /* Anything read ahead into the input buffer is
+               behind us now. */
+            buf_reset(&file->in);
+        } else if (file->feed != NULL && file->compression == UNCOMPRESSED &&
+                   !file->is_compressed &&
+                   (n = live_feed_read(file->feed, file->feed_generation,
+                                       file->start + file->pos, buf, len)) != 0) {
+            /* We have nothing in the output buffer, and
+               the process writing the file still has
+               what we need (or some of it) in its live
+               feed; copy it from there rather than read
+               it back from the file. */
+            if (buf != NULL)
+                buf = (char *)buf + n;
+            len -= n;
+            got += n;
+            file->pos += n;
+            file->raw_pos = file->start + file->pos;
+            file->fd_stale = TRUE;
+            /* Anything read ahead into the input buffer is
+               behind us now. */
+            buf_reset(&file->in);
         } else if (file->eof && file->in.avail == 0) {
             /* We have nothing in the output buffer, and
                we're at the end of the input; just return
@@ -1896,7 +2269,23 @@ file_fdreopen(FILE_T file, const char *path)
 
     if ((fd = ws_open(path, O_RDONLY|O_BINARY, 0000)) == -1)
         return FALSE;
+    /*
+     * The file at that path might not be the one we mapped; read
+     * it with read() (we could map it again, but this is done after
+     * saving over the file, after which it's read again anyway).
+     */
+    file_unmap(file);
+    /*
+     * Put the new descriptor where the old one was, as we seek
+     * relative to the current position, and read from it, assuming
+     * the descriptor is at raw_pos.
+     */
+    if (ws_lseek64(fd, file->raw_pos, SEEK_SET) == -1) {
+        ws_close(fd);
+        return FALSE;
+    }
     file->fd = fd;
+    file->fd_stale = FALSE;
     return TRUE;
 }
 
@@ -1920,6 +2309,9 @@ file_close(FILE_T file)
         g_free(file->in.buf);
     }
     g_free(file->fast_seek_cur);
+    file_unmap(file);
+    if (file->feed != NULL)
+        live_feed_unref(file->feed);
     file->err = 0;
     file->err_info = NULL;
     g_free(file);
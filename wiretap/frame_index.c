@@ -0,0 +1,418 @@
+/* frame_index.c
+ * Routines for the persistent frame index ("sidecar") for capture files.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#define WS_LOG_DOMAIN LOG_DOMAIN_WIRETAP
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "frame_index.h"
+
+#include <wsutil/file_util.h>
+#include <wsutil/pint.h>
+#include <wsutil/wslog.h>
+
+/*
+ * On-disk format; all values are little-endian.
+ *
+ * Header:
+ *
+ *   0  magic           8 bytes, FRAME_INDEX_MAGIC
+ *   8  version         4 bytes, FRAME_INDEX_VERSION
+ *  12  entry size      4 bytes, FRAME_INDEX_ENTRY_SIZE
+ *  16  capture size    8 bytes, size of the capture file
+ *  24  capture mtime   8 bytes, modification time of the capture file,
+ *                      in seconds
+ *  32  entry count     4 bytes
+ *  36  mtime nsecs     4 bytes, nanoseconds part of the modification
+ *                      time, or zero if the OS doesn't provide it
+ *
+ * followed by "entry count" entries of:
+ *
+ *   0  offset          8 bytes, offset to pass to wtap_seek_read()
+ *   8  ts secs         8 bytes
+ *  16  ts nsecs        4 bytes
+ *  20  caplen          4 bytes
+ *  24  len             4 bytes
+ *  28  interface ID    2 bytes
+ *  30  presence flags  1 byte
+ *  31  ts precision    1 byte
+ *
+ * The entries are fixed-size, so the file can be mapped and any entry
+ * looked up directly.
+ */
+#define FRAME_INDEX_MAGIC        "WSFRMIDX"
+#define FRAME_INDEX_VERSION      2
+#define FRAME_INDEX_HEADER_SIZE  40
+#define FRAME_INDEX_ENTRY_SIZE   32
+
+#define FRAME_INDEX_COUNT_OFFSET 32
+
+struct frame_index {
+    GMappedFile  *mapped;
+    const guint8 *entries;
+    guint32       count;
+};
+
+struct frame_index_writer {
+    gchar   *capture_filename;
+    gchar   *index_filename;
+    gchar   *tmp_filename;
+    FILE    *fh;
+    gint64   capture_size;
+    gint64   capture_mtime;
+    guint32  capture_mtime_nsecs;
+    guint32  count;
+};
+
+gchar *
+frame_index_filename(const char *capture_filename)
+{
+    return g_strconcat(capture_filename, FRAME_INDEX_SUFFIX, NULL);
+}
+
+/*
+ * Get the size and modification time of a capture file.  The time is
+ * as precise as the OS gives it to us, so that a capture rewritten
+ * within the same second as the index was built, with the same size,
+ * is still seen as changed.
+ */
+static gboolean
+capture_file_stat(const char *capture_filename, gint64 *size, gint64 *mtime,
+                  guint32 *mtime_nsecs, int *err)
+{
+    ws_statb64 statb;
+
+    if (ws_stat64(capture_filename, &statb) != 0) {
+        *err = errno;
+        return FALSE;
+    }
+    *size = (gint64)statb.st_size;
+    *mtime = (gint64)statb.st_mtime;
+#if defined(HAVE_STRUCT_STAT_ST_MTIM)
+    *mtime_nsecs = (guint32)statb.st_mtim.tv_nsec;
+#elif defined(HAVE_STRUCT_STAT_ST_MTIMESPEC)
+    *mtime_nsecs = (guint32)statb.st_mtimespec.tv_nsec;
+#else
+    *mtime_nsecs = 0;
+#endif
+    return TRUE;
+}
+
+/*
+ * Check that an entry holds values the file's reader could have
+ * handed us, so a damaged or hand-crafted index can't feed
+ * frame_data_init() something it would choke on, or send
+ * wtap_seek_read() outside the file.
+ */
+static gboolean
+entry_is_valid(const guint8 *entry, gint64 capture_size, guint32 max_caplen,
+               guint num_interfaces)
+{
+    guint8 presence_flags = entry[30];
+    guint8 tsprec = entry[31];
+
+    if (pletoh64(entry) >= (guint64)capture_size)
+        return FALSE;
+    if (pletoh32(entry + 16) >= 1000000000)
+        return FALSE;
+    if (pletoh32(entry + 20) > max_caplen)
+        return FALSE;
+    if ((presence_flags & ~(WTAP_HAS_TS|WTAP_HAS_CAP_LEN|WTAP_HAS_INTERFACE_ID)) != 0)
+        return FALSE;
+    if ((presence_flags & WTAP_HAS_INTERFACE_ID) &&
+        pletoh16(entry + 28) >= num_interfaces)
+        return FALSE;
+    if (tsprec > WTAP_TSPREC_NSEC)
+        return FALSE;
+    return TRUE;
+}
+
+frame_index_t *
+frame_index_open(const char *capture_filename, wtap *wth)
+{
+    gchar *index_filename;
+    GMappedFile *mapped;
+    const guint8 *data;
+    gsize length;
+    gint64 capture_size, capture_mtime;
+    guint32 capture_mtime_nsecs;
+    guint32 count, max_caplen, i;
+    wtapng_iface_descriptions_t *idb_info;
+    guint num_interfaces;
+    int err;
+    frame_index_t *fi;
+
+    if (!capture_file_stat(capture_filename, &capture_size, &capture_mtime,
+                           &capture_mtime_nsecs, &err))
+        return NULL;
+
+    index_filename = frame_index_filename(capture_filename);
+    mapped = g_mapped_file_new(index_filename, FALSE, NULL);
+    if (mapped == NULL) {
+        /* No index; that's the common case, so don't complain. */
+        g_free(index_filename);
+        return NULL;
+    }
+
+    data = (const guint8 *)g_mapped_file_get_contents(mapped);
+    length = g_mapped_file_get_length(mapped);
+    if (length < FRAME_INDEX_HEADER_SIZE ||
+        memcmp(data, FRAME_INDEX_MAGIC, 8) != 0 ||
+        pletoh32(data + 8) != FRAME_INDEX_VERSION ||
+        pletoh32(data + 12) != FRAME_INDEX_ENTRY_SIZE) {
+        ws_debug("%s is not a usable frame index", index_filename);
+        goto fail;
+    }
+    if ((gint64)pletoh64(data + 16) != capture_size ||
+        (gint64)pletoh64(data + 24) != capture_mtime ||
+        pletoh32(data + 36) != capture_mtime_nsecs) {
+        ws_debug("%s is stale", index_filename);
+        goto fail;
+    }
+    count = pletoh32(data + FRAME_INDEX_COUNT_OFFSET);
+    if ((length - FRAME_INDEX_HEADER_SIZE) / FRAME_INDEX_ENTRY_SIZE < count) {
+        ws_debug("%s is truncated", index_filename);
+        goto fail;
+    }
+
+    /*
+     * Check every entry now, so that frame_index_get_rec() can hand
+     * them out as they are; the reader rejects packets bigger than
+     * the maximum snapshot length for the file's encapsulation.
+     */
+    max_caplen = wtap_max_snaplen_for_encap(wtap_file_encap(wth));
+    idb_info = wtap_file_get_idb_info(wth);
+    num_interfaces = idb_info->interface_data->len;
+    wtap_free_idb_info(idb_info);
+    for (i = 0; i < count; i++) {
+        if (!entry_is_valid(data + FRAME_INDEX_HEADER_SIZE + (gsize)i * FRAME_INDEX_ENTRY_SIZE,
+                            capture_size, max_caplen, num_interfaces)) {
+            ws_debug("%s has a bad entry for frame %u", index_filename, i + 1);
+            goto fail;
+        }
+    }
+    g_free(index_filename);
+
+    fi = g_new(frame_index_t, 1);
+    fi->mapped = mapped;
+    fi->entries = data + FRAME_INDEX_HEADER_SIZE;
+    fi->count = count;
+    return fi;
+
+fail:
+    g_mapped_file_unref(mapped);
+    g_free(index_filename);
+    return NULL;
+}
+
+guint32
+frame_index_count(const frame_index_t *fi)
+{
+    return fi->count;
+}
+
+gboolean
+frame_index_get_rec(const frame_index_t *fi, guint32 idx, wtap_rec *rec,
+                    gint64 *offset)
+{
+    const guint8 *entry;
+
+    if (idx >= fi->count)
+        return FALSE;
+
+    entry = fi->entries + (gsize)idx * FRAME_INDEX_ENTRY_SIZE;
+    *offset = (gint64)pletoh64(entry);
+    rec->rec_type = REC_TYPE_PACKET;
+    rec->ts.secs = (time_t)(gint64)pletoh64(entry + 8);
+    rec->ts.nsecs = (int)pletoh32(entry + 16);
+    rec->rec_header.packet_header.caplen = pletoh32(entry + 20);
+    rec->rec_header.packet_header.len = pletoh32(entry + 24);
+    rec->rec_header.packet_header.interface_id = pletoh16(entry + 28);
+    rec->presence_flags = entry[30];
+    rec->tsprec = entry[31];
+    return TRUE;
+}
+
+void
+frame_index_close(frame_index_t *fi)
+{
+    g_mapped_file_unref(fi->mapped);
+    g_free(fi);
+}
+
+static void
+write_header(guint8 *hdr, const frame_index_writer_t *fiw)
+{
+    memcpy(hdr, FRAME_INDEX_MAGIC, 8);
+    phtole32(hdr + 8, FRAME_INDEX_VERSION);
+    phtole32(hdr + 12, FRAME_INDEX_ENTRY_SIZE);
+    phtole64(hdr + 16, (guint64)fiw->capture_size);
+    phtole64(hdr + 24, (guint64)fiw->capture_mtime);
+    phtole32(hdr + FRAME_INDEX_COUNT_OFFSET, fiw->count);
+    phtole32(hdr + 36, fiw->capture_mtime_nsecs);
+}
+
+frame_index_writer_t *
+frame_index_writer_new(const char *capture_filename, int *err)
+{
+    frame_index_writer_t *fiw;
+    guint8 hdr[FRAME_INDEX_HEADER_SIZE];
+
+    fiw = g_new0(frame_index_writer_t, 1);
+    if (!capture_file_stat(capture_filename, &fiw->capture_size,
+                           &fiw->capture_mtime, &fiw->capture_mtime_nsecs,
+                           err)) {
+        g_free(fiw);
+        return NULL;
+    }
+    fiw->capture_filename = g_strdup(capture_filename);
+    fiw->index_filename = frame_index_filename(capture_filename);
+    fiw->tmp_filename = g_strconcat(fiw->index_filename, ".tmp", NULL);
+    fiw->fh = ws_fopen(fiw->tmp_filename, "wb");
+    if (fiw->fh == NULL) {
+        *err = errno;
+        g_free(fiw->tmp_filename);
+        g_free(fiw->index_filename);
+        g_free(fiw->capture_filename);
+        g_free(fiw);
+        return NULL;
+    }
+
+    /* The count is filled in by frame_index_writer_finish(). */
+    write_header(hdr, fiw);
+    if (fwrite(hdr, 1, sizeof hdr, fiw->fh) != sizeof hdr) {
+        *err = errno;
+        frame_index_writer_abort(fiw);
+        return NULL;
+    }
+    return fiw;
+}
+
+gboolean
+frame_index_writer_add(frame_index_writer_t *fiw, gint64 offset,
+                       const wtap_rec *rec, int *err)
+{
+    guint8 entry[FRAME_INDEX_ENTRY_SIZE];
+
+    /*
+     * Only packet records have everything frame_data_init() needs
+     * in a fixed-size form.
+     */
+    if (rec->rec_type != REC_TYPE_PACKET ||
+        rec->rec_header.packet_header.interface_id > G_MAXUINT16 ||
+        rec->presence_flags > G_MAXUINT8 ||
+        rec->tsprec < 0 || rec->tsprec > WTAP_TSPREC_NSEC ||
+        fiw->count == G_MAXUINT32) {
+        *err = WTAP_ERR_UNWRITABLE_REC_TYPE;
+        return FALSE;
+    }
+
+    phtole64(entry, (guint64)offset);
+    phtole64(entry + 8, (guint64)(gint64)rec->ts.secs);
+    phtole32(entry + 16, (guint32)rec->ts.nsecs);
+    phtole32(entry + 20, rec->rec_header.packet_header.caplen);
+    phtole32(entry + 24, rec->rec_header.packet_header.len);
+    entry[28] = (guint8)(rec->rec_header.packet_header.interface_id >> 0);
+    entry[29] = (guint8)(rec->rec_header.packet_header.interface_id >> 8);
+    entry[30] = (guint8)rec->presence_flags;
+    entry[31] = (guint8)rec->tsprec;
+    if (fwrite(entry, 1, sizeof entry, fiw->fh) != sizeof entry) {
+        *err = errno;
+        return FALSE;
+    }
+    fiw->count++;
+    return TRUE;
+}
+
+static void
+frame_index_writer_free(frame_index_writer_t *fiw)
+{
+    g_free(fiw->tmp_filename);
+    g_free(fiw->index_filename);
+    g_free(fiw->capture_filename);
+    g_free(fiw);
+}
+
+gboolean
+frame_index_writer_finish(frame_index_writer_t *fiw, int *err)
+{
+    guint8 hdr[FRAME_INDEX_HEADER_SIZE];
+    gint64 capture_size, capture_mtime;
+    guint32 capture_mtime_nsecs;
+
+    /*
+     * If the capture changed while we were reading it (for example,
+     * a capture still being written to), the entries we have may not
+     * describe all of it; don't write an index that would look fresh.
+     */
+    if (!capture_file_stat(fiw->capture_filename, &capture_size,
+                           &capture_mtime, &capture_mtime_nsecs, err)) {
+        frame_index_writer_abort(fiw);
+        return FALSE;
+    }
+    if (capture_size != fiw->capture_size ||
+        capture_mtime != fiw->capture_mtime ||
+        capture_mtime_nsecs != fiw->capture_mtime_nsecs) {
+        *err = EAGAIN;
+        frame_index_writer_abort(fiw);
+        return FALSE;
+    }
+
+    write_header(hdr, fiw);
+    if (fseek(fiw->fh, 0, SEEK_SET) != 0 ||
+        fwrite(hdr, 1, sizeof hdr, fiw->fh) != sizeof hdr) {
+        *err = errno;
+        frame_index_writer_abort(fiw);
+        return FALSE;
+    }
+    if (fclose(fiw->fh) != 0) {
+        *err = errno;
+        fiw->fh = NULL;
+        frame_index_writer_abort(fiw);
+        return FALSE;
+    }
+    fiw->fh = NULL;
+
+    /* Remove any old index first; rename() won't replace it on Windows. */
+    ws_unlink(fiw->index_filename);
+    if (ws_rename(fiw->tmp_filename, fiw->index_filename) != 0) {
+        *err = errno;
+        frame_index_writer_abort(fiw);
+        return FALSE;
+    }
+    frame_index_writer_free(fiw);
+    return TRUE;
+}
+
+void
+frame_index_writer_abort(frame_index_writer_t *fiw)
+{
+    if (fiw->fh != NULL)
+        fclose(fiw->fh);
+    ws_unlink(fiw->tmp_filename);
+    frame_index_writer_free(fiw);
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -0,0 +1,163 @@
+/** @file
+ * Definitions for the persistent frame index ("sidecar") for capture files.
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __FRAME_INDEX_H__
+#define __FRAME_INDEX_H__
+
+#include "wiretap/wtap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/*
+ * A frame index is a file stored next to a capture file, named
+ * "<capture file name>" FRAME_INDEX_SUFFIX, that holds, for every
+ * record in the capture, the file offset that wtap_seek_read() needs
+ * along with the record's time stamp, lengths and interface ID.
+ *
+ * It lets a program that only needs that per-frame metadata on its
+ * first pass (for example, TShark doing two-pass analysis without a
+ * read or display filter) build its frame list without reading the
+ * whole capture sequentially.
+ *
+ * The index records the size and modification time (to the nanosecond,
+ * where the OS provides it) of the capture file it was built from; if
+ * either has changed, the index is considered stale and isn't used.
+ *
+ * Only packet records are indexed; if a capture contains any other
+ * type of record, no index is written for it.
+ */
+#define FRAME_INDEX_SUFFIX ".frameidx"
+
+typedef struct frame_index frame_index_t;
+typedef struct frame_index_writer frame_index_writer_t;
+
+/**
+ * Return the name of the frame index file for a capture file.
+ *
+ * @param capture_filename The name of the capture file.
+ * @return A newly-allocated string; free it with g_free().
+ */
+WS_DLL_PUBLIC
+gchar *frame_index_filename(const char *capture_filename);
+
+/**
+ * Open and map the frame index for a capture file.
+ *
+ * Every entry is checked against the open capture file (lengths against
+ * the maximum snapshot length for its encapsulation, interface IDs
+ * against its interfaces, offsets against its size) and against what
+ * frame_data_init() accepts; if any is out of range, the index isn't used.
+ *
+ * @param capture_filename The name of the capture file.
+ * @param wth The capture file, opened with wtap_open_offline().
+ * @return The frame index, or NULL if there is no index for the capture,
+ *         the index is stale (the capture was modified after the index
+ *         was written), or the index is damaged.
+ */
+WS_DLL_PUBLIC
+frame_index_t *frame_index_open(const char *capture_filename, wtap *wth);
+
+/**
+ * Get the number of records in a frame index.
+ */
+WS_DLL_PUBLIC
+guint32 frame_index_count(const frame_index_t *fi);
+
+/**
+ * Fill in the record header for an entry in a frame index.
+ *
+ * Only the metadata of the record is filled in; the record's data must
+ * be read with wtap_seek_read() at the returned offset.
+ *
+ * @param fi The frame index.
+ * @param idx The zero-based index of the record.
+ * @param rec The record to fill in; its rec_type, presence_flags,
+ *            tsprec, ts and packet header lengths and interface ID
+ *            are set.
+ * @param[out] offset Set to the offset to pass to wtap_seek_read().
+ * @return TRUE on success, FALSE if idx is out of range.
+ */
+WS_DLL_PUBLIC
+gboolean frame_index_get_rec(const frame_index_t *fi, guint32 idx,
+                             wtap_rec *rec, gint64 *offset);
+
+/**
+ * Unmap and free a frame index.
+ */
+WS_DLL_PUBLIC
+void frame_index_close(frame_index_t *fi);
+
+/**
+ * Start writing a frame index for a capture file.
+ *
+ * The index is written to a temporary file, and only renamed to its
+ * final name by frame_index_writer_finish(), so a partially-written
+ * index is never picked up.
+ *
+ * @param capture_filename The name of the capture file.
+ * @param[out] err Set to an errno value on failure.
+ * @return The writer, or NULL on failure.
+ */
+WS_DLL_PUBLIC
+frame_index_writer_t *frame_index_writer_new(const char *capture_filename,
+                                             int *err);
+
+/**
+ * Add a record to a frame index.
+ *
+ * @param fiw The writer.
+ * @param offset The offset of the record, as returned by wtap_read().
+ * @param rec The record.
+ * @param[out] err Set to an errno value on failure.
+ * @return TRUE on success, FALSE if the record can't be indexed or
+ *         couldn't be written; in that case, the caller should call
+ *         frame_index_writer_abort().
+ */
+WS_DLL_PUBLIC
+gboolean frame_index_writer_add(frame_index_writer_t *fiw, gint64 offset,
+                                const wtap_rec *rec, int *err);
+
+/**
+ * Finish writing a frame index, and put it in place.  The writer
+ * is freed.
+ *
+ * @param fiw The writer.
+ * @param[out] err Set to an errno value on failure.
+ * @return TRUE on success, FALSE on failure.
+ */
+WS_DLL_PUBLIC
+gboolean frame_index_writer_finish(frame_index_writer_t *fiw, int *err);
+
+/**
+ * Discard a partially-written frame index.  The writer is freed.
+ */
+WS_DLL_PUBLIC
+void frame_index_writer_abort(frame_index_writer_t *fiw);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __FRAME_INDEX_H__ */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
@@ -347,6 +347,14 @@ wtap_open_return_val libpcap_open(wtap *wth, int *err, gchar **err_info)
 	wth->file_encap = file_encap;
 	wth->snapshot_length = hdr.snaplen;
 
+	/*
+	 * If the file is uncompressed, read packets from a mapping
+	 * of it rather than with read().
+	 */
+	file_try_mmap(wth->fh);
+	if (wth->random_fh != NULL)
+		file_try_mmap(wth->random_fh);
+
 	/* In file format version 2.3, the order of the "incl_len" and
 	   "orig_len" fields in the per-packet header was reversed,
 	   in order to match the BPF header layout.
@@ -68,11 +68,175 @@ merge_idb_merge_mode_to_string(const int mode)
 }
 
 
+/*
+ * Number of records read ahead for each input file, when reading ahead.
+ */
+#define MERGE_READ_AHEAD_RECORDS 32
+
+/*
+ * A record read ahead by a reader thread.
+ */
+typedef struct {
+    in_file_state_e state;          /* RECORD_PRESENT, AT_EOF, or GOT_ERROR */
+    int             err;
+    gchar          *err_info;
+    gint64          read_so_far;
+    guint           dsbs_len;       /* length of wth->dsbs after reading this record */
+    wtap_rec        rec;
+    Buffer          frame_buffer;
+} merge_read_ahead_slot_t;
+
+/*
+ * When merging chronologically, each input file gets a thread that reads,
+ * and decompresses, records from it into a bounded queue, so that reading
+ * the inputs is spread over several cores and the merge loop doesn't wait
+ * for I/O.  The records come out of the queue in file order, so the
+ * merged output is the same as without reading ahead.
+ */
+struct merge_read_ahead_s {
+    wtap           *wth;
+    GMutex          dsbs_lock;      /* held while the reader may append to wth->dsbs */
+    GAsyncQueue    *free_slots;
+    GAsyncQueue    *filled_slots;
+    merge_read_ahead_slot_t slots[MERGE_READ_AHEAD_RECORDS];
+    GThread        *thread;
+    gint            stop;
+};
+
+static gpointer
+merge_read_ahead_thread(gpointer data)
+{
+    struct merge_read_ahead_s *ra = (struct merge_read_ahead_s *)data;
+    merge_read_ahead_slot_t *slot;
+    gint64 data_offset;
+
+    for (;;) {
+        slot = (merge_read_ahead_slot_t *)g_async_queue_pop(ra->free_slots);
+        if (g_atomic_int_get(&ra->stop))
+            break;
+
+        slot->err = 0;
+        slot->err_info = NULL;
+        g_mutex_lock(&ra->dsbs_lock);
+        if (wtap_read(ra->wth, &slot->rec, &slot->frame_buffer, &slot->err,
+                      &slot->err_info, &data_offset))
+            slot->state = RECORD_PRESENT;
+        else
+            slot->state = (slot->err != 0) ? GOT_ERROR : AT_EOF;
+        slot->dsbs_len = ra->wth->dsbs ? ra->wth->dsbs->len : 0;
+        g_mutex_unlock(&ra->dsbs_lock);
+        slot->read_so_far = wtap_read_so_far(ra->wth);
+
+        g_async_queue_push(ra->filled_slots, slot);
+        if (slot->state != RECORD_PRESENT)
+            break;
+    }
+    return NULL;
+}
+
+static void
+merge_read_ahead_start(merge_in_file_t *in_file)
+{
+    struct merge_read_ahead_s *ra;
+    guint i;
+
+    ra = g_new0(struct merge_read_ahead_s, 1);
+    ra->wth = in_file->wth;
+    g_mutex_init(&ra->dsbs_lock);
+    ra->free_slots = g_async_queue_new();
+    ra->filled_slots = g_async_queue_new();
+    for (i = 0; i < MERGE_READ_AHEAD_RECORDS; i++) {
+        wtap_rec_init(&ra->slots[i].rec);
+        ws_buffer_init(&ra->slots[i].frame_buffer, 1514);
+        g_async_queue_push(ra->free_slots, &ra->slots[i]);
+    }
+    ra->thread = g_thread_new("merge read-ahead", merge_read_ahead_thread, ra);
+    in_file->read_ahead = ra;
+}
+
+static void
+merge_read_ahead_stop(merge_in_file_t *in_file)
+{
+    struct merge_read_ahead_s *ra = in_file->read_ahead;
+    merge_read_ahead_slot_t *slot;
+    guint i;
+
+    /*
+     * Tell the reader to stop, and give it back every record it has
+     * filled, so that it isn't left waiting for a free one.
+     */
+    g_atomic_int_set(&ra->stop, 1);
+    while ((slot = (merge_read_ahead_slot_t *)g_async_queue_try_pop(ra->filled_slots)) != NULL)
+        g_async_queue_push(ra->free_slots, slot);
+    g_thread_join(ra->thread);
+
+    for (i = 0; i < MERGE_READ_AHEAD_RECORDS; i++) {
+        g_free(ra->slots[i].err_info);
+        wtap_rec_cleanup(&ra->slots[i].rec);
+        ws_buffer_free(&ra->slots[i].frame_buffer);
+    }
+    g_async_queue_unref(ra->free_slots);
+    g_async_queue_unref(ra->filled_slots);
+    g_mutex_clear(&ra->dsbs_lock);
+    g_free(ra);
+    in_file->read_ahead = NULL;
+}
+
+/*
+ * Read the next record from an input file into in_file->rec and
+ * in_file->frame_buffer, and set in_file->state accordingly.
+ */
+static void
+merge_in_file_read(merge_in_file_t *in_file, int *err, gchar **err_info)
+{
+    struct merge_read_ahead_s *ra = in_file->read_ahead;
+    merge_read_ahead_slot_t *slot;
+    gint64 data_offset;
+    wtap_rec tmp_rec;
+    Buffer tmp_buffer;
+
+    if (ra == NULL) {
+        if (wtap_read(in_file->wth, &in_file->rec, &in_file->frame_buffer,
+                      err, err_info, &data_offset))
+            in_file->state = RECORD_PRESENT;
+        else
+            in_file->state = (*err != 0) ? GOT_ERROR : AT_EOF;
+        in_file->dsbs_read = in_file->wth->dsbs ? in_file->wth->dsbs->len : 0;
+        in_file->read_so_far = wtap_read_so_far(in_file->wth);
+        return;
+    }
+
+    /*
+     * Swap the record the reader filled in with the one we're done
+     * with, and hand the slot back to the reader.
+     */
+    slot = (merge_read_ahead_slot_t *)g_async_queue_pop(ra->filled_slots);
+    tmp_rec = in_file->rec;
+    in_file->rec = slot->rec;
+    slot->rec = tmp_rec;
+    tmp_buffer = in_file->frame_buffer;
+    in_file->frame_buffer = slot->frame_buffer;
+    slot->frame_buffer = tmp_buffer;
+
+    in_file->state = slot->state;
+    in_file->dsbs_read = slot->dsbs_len;
+    in_file->read_so_far = slot->read_so_far;
+    *err = slot->err;
+    *err_info = slot->err_info;
+    slot->err_info = NULL;
+
+    if (slot->state == RECORD_PRESENT)
+        g_async_queue_push(ra->free_slots, slot);
+}
+
 static void
 cleanup_in_file(merge_in_file_t *in_file)
 {
     ws_assert(in_file != NULL);
 
+    if (in_file->read_ahead != NULL)
+        merge_read_ahead_stop(in_file);
+
     wtap_close(in_file->wth);
     in_file->wth = NULL;
 
@@ -204,21 +368,106 @@ merge_select_frame_type(int in_file_count, merge_in_file_t in_files[])
 }
 
 /*
- * returns TRUE if first argument is earlier than second
+ * Records are merged in time stamp order; records with no time stamp
+ * are treated as earlier than all other records.  Yes, this means you
+ * won't get a chronological merge of those records, but you obviously
+ * *can't* get that.
+ *
+ * Ties are broken the way a linear scan of the files, keeping the last
+ * of the earliest records, would break them: among records with no time
+ * stamp the one from the first file wins, and among records with equal
+ * time stamps the one from the last file wins.
  */
 static gboolean
-is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
+merge_in_file_before(const merge_in_file_t in_files[], guint a, guint b)
 {
-    if (l->secs > r->secs) {  /* left is later */
-        return FALSE;
-    } else if (l->secs < r->secs) { /* left is earlier */
+    const wtap_rec *rec_a = &in_files[a].rec;
+    const wtap_rec *rec_b = &in_files[b].rec;
+    gboolean a_has_ts = (rec_a->presence_flags & WTAP_HAS_TS) != 0;
+    gboolean b_has_ts = (rec_b->presence_flags & WTAP_HAS_TS) != 0;
+
+    if (!a_has_ts || !b_has_ts) {
+        if (a_has_ts != b_has_ts)
+            return !a_has_ts;
+        return a < b;
+    }
+    if (rec_a->ts.secs != rec_b->ts.secs)
+        return rec_a->ts.secs < rec_b->ts.secs;
+    if (rec_a->ts.nsecs != rec_b->ts.nsecs)
+        return rec_a->ts.nsecs < rec_b->ts.nsecs;
+    return a > b;
+}
+
+/*
+ * Min-heap of the input files that have a record available, ordered by
+ * merge_in_file_before(), so that picking the next record to write is
+ * O(log n) in the number of input files rather than O(n).
+ */
+typedef struct {
+    guint  *files;          /* indices into the in_files array */
+    guint   count;
+    int     last;           /* file the previous record came from, or -1 */
+    gboolean primed;        /* TRUE once every file has been read from */
+} merge_heap_t;
+
+static void
+merge_heap_push(merge_heap_t *heap, const merge_in_file_t in_files[], guint file)
+{
+    guint i = heap->count++;
+
+    while (i > 0) {
+        guint parent = (i - 1) / 2;
+
+        if (!merge_in_file_before(in_files, file, heap->files[parent]))
+            break;
+        heap->files[i] = heap->files[parent];
+        i = parent;
+    }
+    heap->files[i] = file;
+}
+
+static guint
+merge_heap_pop(merge_heap_t *heap, const merge_in_file_t in_files[])
+{
+    guint top = heap->files[0];
+    guint file = heap->files[--heap->count];
+    guint i = 0;
+
+    for (;;) {
+        guint child = 2 * i + 1;
+
+        if (child >= heap->count)
+            break;
+        if (child + 1 < heap->count &&
+            merge_in_file_before(in_files, heap->files[child + 1], heap->files[child]))
+            child++;
+        if (!merge_in_file_before(in_files, heap->files[child], file))
+            break;
+        heap->files[i] = heap->files[child];
+        i = child;
+    }
+    if (heap->count > 0)
+        heap->files[i] = file;
+    return top;
+}
+
+/*
+ * If an input file has no record available, and we haven't seen an error
+ * or EOF on it yet, read its next record, and add it to the heap if there
+ * is one.  Returns FALSE on a read error.
+ */
+static gboolean
+merge_heap_refill(merge_heap_t *heap, merge_in_file_t in_files[], guint file,
+                  int *err, gchar **err_info)
+{
+    if (in_files[file].state != RECORD_NOT_PRESENT)
         return TRUE;
-    } else if (l->nsecs > r->nsecs) { /* tv_sec equal, l.usec later */
+
+    merge_in_file_read(&in_files[file], err, err_info);
+    if (in_files[file].state == GOT_ERROR)
         return FALSE;
-    }
-    /* either one < two or one == two
-     * either way, return one
-     */
+    if (in_files[file].state == RECORD_PRESENT)
+        merge_heap_push(heap, in_files, file);
     return TRUE;
 }
 
@@ -234,6 +483,7 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * On an EOF (meaning all the files are at EOF), set *err to 0 and return
  * NULL.
  *
+ * @param heap the files that have a record available
  * @param in_file_count number of entries in in_files
  * @param in_files input file array
  * @param err wiretap error, if failed
@@ -243,68 +493,37 @@ is_earlier(nstime_t *l, nstime_t *r) /* XXX, move to nstime.c */
  * all files
  */
 static merge_in_file_t *
-merge_read_packet(int in_file_count, merge_in_file_t in_files[],
-                  int *err, gchar **err_info)
+merge_read_packet(merge_heap_t *heap, int in_file_count,
+                  merge_in_file_t in_files[], int *err, gchar **err_info)
 {
     int i;
-    int ei = -1;
-    nstime_t tv = NSTIME_INIT_MAX;
-    wtap_rec *rec;
+    guint ei;
 
     /*
      * Make sure we have a record available from each file that's not at
-     * EOF, and search for the record with the earliest time stamp or
-     * with no time stamp (those records are treated as earlier than
-     * all other records).  Yes, this means you won't get a chronological
-     * merge of those records, but you obviously *can't* get that.
+     * EOF; after the first call, the only file that can be missing one is
+     * the file the previous record came from.
      */
-    for (i = 0; i < in_file_count; i++) {
-        gint64 data_offset;
-
-        if (in_files[i].state == RECORD_NOT_PRESENT) {
-            /*
-             * No packet available, and we haven't seen an error or EOF yet,
-             * so try to read the next packet.
-             */
-            if (!wtap_read(in_files[i].wth, &in_files[i].rec,
-                           &in_files[i].frame_buffer, err, err_info,
-                           &data_offset)) {
-                if (*err != 0) {
-                    in_files[i].state = GOT_ERROR;
-                    return &in_files[i];
-                }
-                in_files[i].state = AT_EOF;
-            } else
-                in_files[i].state = RECORD_PRESENT;
-        }
-
-        if (in_files[i].state == RECORD_PRESENT) {
-            rec = &in_files[i].rec;
-            if (!(rec->presence_flags & WTAP_HAS_TS)) {
-                /*
-                 * No time stamp.  Pick this record, and stop looking.
-                 */
-                ei = i;
-                break;
-            }
-            if (is_earlier(&rec->ts, &tv)) {
-                /*
-                 * This record's time stamp is earlier than any of the
-                 * records we've seen so far.  Pick it, for now, but
-                 * keep looking.
-                 */
-                tv = rec->ts;
-                ei = i;
-            }
+    if (!heap->primed) {
+        for (i = 0; i < in_file_count; i++) {
+            if (!merge_heap_refill(heap, in_files, i, err, err_info))
+                return &in_files[i];
         }
+        heap->primed = TRUE;
+    } else if (heap->last != -1) {
+        if (!merge_heap_refill(heap, in_files, heap->last, err, err_info))
+            return &in_files[heap->last];
     }
 
-    if (ei == -1) {
+    if (heap->count == 0) {
         /* All the streams are at EOF.  Return an EOF indication. */
         *err = 0;
         return NULL;
     }
 
+    ei = merge_heap_pop(heap, in_files);
+    heap->last = ei;
+
     /* We'll need to read another packet from this file. */
     in_files[ei].state = RECORD_NOT_PRESENT;
 
@@ -344,7 +563,6 @@ merge_append_read_packet(int in_file_count, merge_in_file_t in_files[],
                          int *err, gchar **err_info)
 {
     int i;
-    gint64 data_offset;
 
     /*
      * Find the first file not at EOF, and read the next packet from it.
@@ -352,17 +570,14 @@ merge_append_read_packet(int in_file_count, merge_in_file_t in_files[],
     for (i = 0; i < in_file_count; i++) {
         if (in_files[i].state == AT_EOF)
             continue; /* This file is already at EOF */
-        if (wtap_read(in_files[i].wth, &in_files[i].rec,
-                      &in_files[i].frame_buffer, err, err_info,
-                      &data_offset))
+        merge_in_file_read(&in_files[i], err, err_info);
+        if (in_files[i].state == RECORD_PRESENT)
             break; /* We have a packet */
-        if (*err != 0) {
+        if (in_files[i].state == GOT_ERROR) {
             /* Read error - quit immediately. */
-            in_files[i].state = GOT_ERROR;
             return &in_files[i];
         }
-        /* EOF - flag this file as being at EOF, and try the next one. */
-        in_files[i].state = AT_EOF;
+        /* EOF - this file is now flagged as being at EOF; try the next one. */
     }
     if (i == in_file_count) {
         /* All the streams are at EOF.  Return an EOF indication. */
@@ -848,6 +1063,25 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
     int                 count = 0;
     gboolean            stop_flag = FALSE;
     wtap_rec *rec,      snap_rec;
+    merge_heap_t        heap;
+    guint               i;
+
+    heap.files = NULL;
+    heap.count = 0;
+    heap.last = -1;
+    heap.primed = FALSE;
+    if (!do_append) {
+        heap.files = g_new(guint, in_file_count);
+
+        /*
+         * Merging chronologically reads from all the files in turn;
+         * read ahead in each of them in a separate thread.
+         */
+        if (in_file_count > 1) {
+            for (i = 0; i < in_file_count; i++)
+                merge_read_ahead_start(&in_files[i]);
+        }
+    }
 
     for (;;) {
         *err = 0;
@@ -857,7 +1091,7 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
                                                err_info);
         }
         else {
-            in_file = merge_read_packet(in_file_count, in_files, err,
+            in_file = merge_read_packet(&heap, in_file_count, in_files, err,
                                         err_info);
         }
 
@@ -931,13 +1165,20 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
          * If any DSBs were read before this record, be sure to pass those now
          * such that wtap_dump can pick it up.
          */
-        if (dsb_combined && in_file->wth->dsbs) {
-            GArray *in_dsb = in_file->wth->dsbs;
-            for (guint i = in_file->dsbs_seen; i < in_dsb->len; i++) {
+        if (dsb_combined && in_file->dsbs_seen < in_file->dsbs_read) {
+            GArray *in_dsb;
+
+            /* A reader thread may be appending DSBs it read after this record. */
+            if (in_file->read_ahead)
+                g_mutex_lock(&in_file->read_ahead->dsbs_lock);
+            in_dsb = in_file->wth->dsbs;
+            for (i = in_file->dsbs_seen; i < in_file->dsbs_read; i++) {
                 wtap_block_t wblock = g_array_index(in_dsb, wtap_block_t, i);
                 g_array_append_val(dsb_combined, wblock);
                 in_file->dsbs_seen++;
             }
+            if (in_file->read_ahead)
+                g_mutex_unlock(&in_file->read_ahead->dsbs_lock);
         }
 
         if (!wtap_dump(pdh, rec, ws_buffer_start_ptr(&in_file->frame_buffer),
@@ -972,6 +1213,7 @@ merge_process_packets(wtap_dumper *pdh, const int file_type,
      * those DSBs are only written when wtap_dump is called and nothing bad will
      * happen now, let's keep all pointers in pdh valid for correctness sake. */
     merge_close_in_files(in_file_count, in_files);
+    g_free(heap.files);
 
     if (status == MERGE_OK || in_file == NULL) {
         *err_fileno = 0;
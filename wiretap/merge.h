@@ -37,6 +37,9 @@ typedef struct merge_in_file_s {
     gint64          size;           /* file size */
     GArray         *idb_index_map;  /* used for mapping the old phdr interface_id values to new during merge */
     guint           dsbs_seen;      /* number of elements processed so far from wth->dsbs */
+    guint           dsbs_read;      /* number of elements of wth->dsbs read before the current record */
+    gint64          read_so_far;    /* bytes read from the file so far, up to the current record */
+    struct merge_read_ahead_s *read_ahead; /* reader thread state, if records are read ahead */
 } merge_in_file_t;
 
 /** Return values from merge_files(). */
@@ -244,6 +244,8 @@ typedef struct {
     GArray *sections;             /**< Sections found in the capture file. */
     wtap_new_ipv4_callback_t add_new_ipv4;
     wtap_new_ipv6_callback_t add_new_ipv6;
+    wtap_block_t seq_packet_block;    /**< Packet block to reuse for the next sequential read */
+    wtap_block_t random_packet_block; /**< Packet block to reuse for the next random read */
 } pcapng_t;
 
 /*
@@ -1799,6 +1801,7 @@ static gboolean
 pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh,
                          section_info_t *section_info,
                          wtapng_block_t *wblock,
+                         wtap_block_t *recycled_block,
                          int *err, gchar **err_info, gboolean enhanced)
 {
     guint block_read;
@@ -1814,8 +1817,6 @@ pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh,
     int pseudo_header_len;
     int fcslen;
 
-    wblock->block = wtap_block_create(WTAP_BLOCK_PACKET);
-
     /* "(Enhanced) Packet Block" read fixed part */
     if (enhanced) {
         /*
@@ -2001,6 +2002,18 @@ pcapng_read_packet_block(FILE_T fh, pcapng_block_header_t *bh,
         (int)sizeof(pcapng_block_header_t) -
         block_read -    /* fixed and variable part, including padding */
         (int)sizeof(bh->block_total_length);
+
+    /*
+     * Most packets have no options, and thus nothing to put in a
+     * block; don't create one for them.  Otherwise, reuse the block
+     * we returned for the previous packet, if our caller is done
+     * with it, rather than allocating a new one for each packet.
+     */
+    if (opt_cont_buf_len != 0 || packet.drops_count != 0xFFFF) {
+        wblock->block = wtap_block_recycle(*recycled_block, WTAP_BLOCK_PACKET);
+        *recycled_block = wtap_block_ref(wblock->block);
+    }
+
     if (!pcapng_process_options(fh, wblock, section_info, opt_cont_buf_len,
                                 pcapng_process_packet_block_option,
                                 OPT_SECTION_BYTE_ORDER, err, err_info))
@@ -3116,9 +3129,16 @@ pcapng_read_block(wtap *wth, FILE_T fh, pcapng_t *pn,
 {
     block_return_val ret;
     pcapng_block_header_t bh;
+    wtap_block_t *recycled_block;
 
     wblock->block = NULL;
 
+    /*
+     * The sequential and random streams may be read by different
+     * threads, so each of them reuses its own packet block.
+     */
+    recycled_block = (fh == wth->random_fh) ? &pn->random_packet_block : &pn->seq_packet_block;
+
     /* Try to read the (next) block header */
     if (!wtap_read_bytes_or_eof(fh, &bh, sizeof bh, err, err_info)) {
         ws_debug("wtap_read_bytes_or_eof() failed, err = %d.", *err);
@@ -3237,7 +3257,7 @@ pcapng_read_block(wtap *wth, FILE_T fh, pcapng_t *pn,
                     return FALSE;
                 break;
             case(BLOCK_TYPE_PB):
-                if (!pcapng_read_packet_block(fh, &bh, section_info, wblock, err, err_info, FALSE))
+                if (!pcapng_read_packet_block(fh, &bh, section_info, wblock, recycled_block, err, err_info, FALSE))
                     return FALSE;
                 break;
             case(BLOCK_TYPE_SPB):
@@ -3245,7 +3265,7 @@ pcapng_read_block(wtap *wth, FILE_T fh, pcapng_t *pn,
                     return FALSE;
                 break;
             case(BLOCK_TYPE_EPB):
-                if (!pcapng_read_packet_block(fh, &bh, section_info, wblock, err, err_info, TRUE))
+                if (!pcapng_read_packet_block(fh, &bh, section_info, wblock, recycled_block, err, err_info, TRUE))
                     return FALSE;
                 break;
             case(BLOCK_TYPE_NRB):
@@ -3489,11 +3509,22 @@ pcapng_open(wtap *wth, int *err, gchar **err_info)
     pcapng->add_new_ipv4 = NULL;
     pcapng->add_new_ipv6 = NULL;
 
+    pcapng->seq_packet_block = NULL;
+    pcapng->random_packet_block = NULL;
+
     wth->subtype_read = pcapng_read;
     wth->subtype_seek_read = pcapng_seek_read;
     wth->subtype_close = pcapng_close;
     wth->file_type_subtype = pcapng_file_type_subtype;
 
+    /*
+     * If the file is uncompressed, read blocks from a mapping of it
+     * rather than with read().
+     */
+    file_try_mmap(wth->fh);
+    if (wth->random_fh != NULL)
+        file_try_mmap(wth->random_fh);
+
     /* Always initialize the list of Decryption Secret Blocks such that a
      * wtap_dumper can refer to it right after opening the capture file. */
     wth->dsbs = g_array_new(FALSE, FALSE, sizeof(wtap_block_t));
@@ -3800,6 +3831,9 @@ pcapng_close(wtap *wth)
         g_array_free(section_info->interfaces, TRUE);
     }
     g_array_free(pcapng->sections, TRUE);
+
+    wtap_block_unref(pcapng->seq_packet_block);
+    wtap_block_unref(pcapng->random_packet_block);
 }
 
 typedef guint32 (*compute_option_size_func)(wtap_block_t, guint, wtap_opttype_e, wtap_optval_t*);
@@ -4793,6 +4827,8 @@ pcapng_write_enhanced_packet_block(wtap_dumper *wdh, const wtap_rec *rec,
     const union wtap_pseudo_header *pseudo_header = &rec->rec_header.packet_header.pseudo_header;
     pcapng_block_header_t bh;
     pcapng_enhanced_packet_block_t epb;
+    guint8 hdr_buf[sizeof bh + sizeof epb];
+    guint8 trailer_buf[3 + sizeof bh.block_total_length];
     guint32 options_size = 0;
     guint64 ts;
     const guint32 zero_pad = 0;
@@ -4824,11 +4860,7 @@ pcapng_write_enhanced_packet_block(wtap_dumper *wdh, const wtap_rec *rec,
     bh.block_type = BLOCK_TYPE_EPB;
     bh.block_total_length = (guint32)sizeof(bh) + (guint32)sizeof(epb) + phdr_len + rec->rec_header.packet_header.caplen + pad_len + options_total_length + options_size + 4;
 
-    if (!wtap_dump_file_write(wdh, &bh, sizeof bh, err))
-        return FALSE;
-    wdh->bytes_dumped += sizeof bh;
-
-    /* write block fixed content */
+    /* block fixed content */
     if (rec->presence_flags & WTAP_HAS_INTERFACE_ID)
         epb.interface_id        = rec->rec_header.packet_header.interface_id;
     else {
@@ -4873,9 +4905,12 @@ pcapng_write_enhanced_packet_block(wtap_dumper *wdh, const wtap_rec *rec,
     epb.captured_len        = rec->rec_header.packet_header.caplen + phdr_len;
     epb.packet_len          = rec->rec_header.packet_header.len + phdr_len;
 
-    if (!wtap_dump_file_write(wdh, &epb, sizeof epb, err))
+    /* write the block header and fixed content with one write */
+    memcpy(hdr_buf, &bh, sizeof bh);
+    memcpy(hdr_buf + sizeof bh, &epb, sizeof epb);
+    if (!wtap_dump_file_write(wdh, hdr_buf, sizeof hdr_buf, err))
         return FALSE;
-    wdh->bytes_dumped += sizeof epb;
+    wdh->bytes_dumped += sizeof hdr_buf;
 
     /* write pseudo header */
     if (!pcap_write_phdr(wdh, rec->rec_header.packet_header.pkt_encap, pseudo_header, err)) {
@@ -4888,6 +4923,21 @@ pcapng_write_enhanced_packet_block(wtap_dumper *wdh, const wtap_rec *rec,
         return FALSE;
     wdh->bytes_dumped += rec->rec_header.packet_header.caplen;
 
+    /*
+     * If there are no options, which is usually the case, write the
+     * padding and the block footer with one write.
+     */
+    if (options_size == 0) {
+        memset(trailer_buf, 0, pad_len);
+        memcpy(trailer_buf + pad_len, &bh.block_total_length,
+               sizeof bh.block_total_length);
+        if (!wtap_dump_file_write(wdh, trailer_buf,
+                                  pad_len + sizeof bh.block_total_length, err))
+            return FALSE;
+        wdh->bytes_dumped += pad_len + sizeof bh.block_total_length;
+        return TRUE;
+    }
+
     /* write padding (if any) */
     if (pad_len != 0) {
         if (!wtap_dump_file_write(wdh, &zero_pad, pad_len, err))
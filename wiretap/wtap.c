@@ -1469,6 +1469,14 @@ wtap_cleareof(wtap *wth) {
 	file_clearerr(wth->fh);
 }
 
+void
+wtap_set_live_feed(wtap *wth, live_feed_t *feed)
+{
+	/* Only sequential reads follow the end of the file. */
+	if (wth->fh != NULL)
+		file_set_live_feed(wth->fh, feed);
+}
+
 void wtap_set_cb_new_ipv4(wtap *wth, wtap_new_ipv4_callback_t add_new_ipv4) {
 	if (wth)
 		wth->add_new_ipv4 = add_new_ipv4;
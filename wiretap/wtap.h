@@ -14,6 +14,7 @@
 #include <wsutil/buffer.h>
 #include <wsutil/nstime.h>
 #include <wsutil/inet_addr.h>
+#include <wsutil/live_feed.h>
 #include "wtap_opttypes.h"
 #include "ws_symbol_export.h"
 #include "ws_attributes.h"
@@ -1699,6 +1700,14 @@ struct wtap* wtap_open_offline(const char *filename, unsigned int type, int *err
 WS_DLL_PUBLIC
 void wtap_cleareof(wtap *wth);
 
+/**
+ * While tailing a file, copy what the process writing it has put in a
+ * live feed from there rather than read it back from the file, when
+ * the live feed still has it.  Pass NULL to stop using a live feed.
+ */
+WS_DLL_PUBLIC
+void wtap_set_live_feed(wtap *wth, live_feed_t *feed);
+
 /**
  * Set callback functions to add new hostnames. Currently pcapng-only.
  * MUST match add_ipv4_name and add_ipv6_name in addr_resolv.c.
@@ -423,6 +423,39 @@ void wtap_block_unref(wtap_block_t block)
     }
 }
 
+wtap_block_t wtap_block_recycle(wtap_block_t block, wtap_block_type_t block_type)
+{
+    if (block_type >= MAX_WTAP_BLOCK_TYPE_VALUE) {
+        wtap_block_unref(block);
+        return NULL;
+    }
+
+    /*
+     * If anybody else still holds a reference to the block, or it's
+     * of another type, we can't reuse it; drop our reference and
+     * create a new one.
+     */
+    if (block == NULL || block->info != blocktype_list[block_type] ||
+        g_atomic_int_get(&block->ref_count) != 1) {
+        wtap_block_unref(block);
+        return wtap_block_create(block_type);
+    }
+
+#ifdef DEBUG_COUNT_REFS
+    wtap_debug("Recycle #%d %s", block->id, block->info->name);
+#endif /* DEBUG_COUNT_REFS */
+
+    /* Free the option values, but keep the array they were in. */
+    wtap_block_free_options(block);
+
+    if (block->info->free_mand != NULL)
+        block->info->free_mand(block);
+    g_free(block->mandatory_data);
+    block->info->create(block);
+
+    return block;
+}
+
 void wtap_block_array_free(GArray* block_array)
 {
     guint block;
@@ -561,6 +561,25 @@ wtap_block_ref(wtap_block_t block);
 WS_DLL_PUBLIC void
 wtap_block_unref(wtap_block_t block);
 
+/** Reuse a block for a new record
+ *
+ * If the caller holds the only reference to the block, and the block is
+ * of the requested type, remove its options and reinitialize its
+ * mandatory data, keeping the memory allocated for them, and return it.
+ * Otherwise, drop the caller's reference to the block, and return a
+ * newly allocated one.
+ *
+ * This lets a file reader that keeps a reference to the block it
+ * returned for the previous record fill in the same block for the next
+ * one, once its caller is done with it.
+ *
+ * @param[in] block Block to be reused, or NULL
+ * @param[in] block_type Block type to be returned
+ * @return The reused block, or a newly allocated one
+ */
+WS_DLL_PUBLIC wtap_block_t
+wtap_block_recycle(wtap_block_t block, wtap_block_type_t block_type);
+
 /** Free an array of blocks
  *
  * Needs to be called to clean up blocks allocated
@@ -167,6 +167,16 @@ struct ws_option {
 #define ISB_USRDELIV      8
 #define ADD_PADDING(x) ((((x) + 3) >> 2) << 2)
 
+static pcapio_write_observer_func write_observer;
+static void *write_observer_data;
+
+void
+pcapio_set_write_observer(pcapio_write_observer_func func, void *user_data)
+{
+        write_observer = func;
+        write_observer_data = user_data;
+}
+
 /* Write to capture file */
 static gboolean
 write_to_file(FILE* pfile, const guint8* data, size_t data_length,
@@ -184,6 +194,9 @@ write_to_file(FILE* pfile, const guint8* data, size_t data_length,
                 return FALSE;
         }
 
+        if (write_observer != NULL)
+                (*write_observer)(data, data_length, write_observer_data);
+
         (*bytes_written) += data_length;
         return TRUE;
 }
@@ -535,6 +548,26 @@ pcapng_write_interface_description_block(FILE* pfile,
         return write_to_file(pfile, (const guint8*)&block_total_length, sizeof(guint32), bytes_written, err);
 }
 
+/* The length of the options of an enhanced packet block, including the
+   end-of-options, or 0 if it has none */
+static guint32
+pcapng_count_epb_options(const char *comment, guint32 flags)
+{
+        guint32 options_length;
+
+        options_length = 0;
+        options_length += pcapng_count_string_option(comment);
+        if (flags != 0) {
+                options_length += (guint32)(sizeof(struct ws_option) +
+                                            sizeof(guint32));
+        }
+        /* If we have options add size of end-of-options */
+        if (options_length != 0) {
+                options_length += (guint32)sizeof(struct ws_option);
+        }
+        return options_length;
+}
+
 /* Write a record for a packet to a dump file.
    Returns TRUE on success, FALSE on failure. */
 gboolean
@@ -562,16 +595,7 @@ pcapng_write_enhanced_packet_block(FILE* pfile,
         block_total_length = (guint32)(sizeof(struct epb) +
                                        ADD_PADDING(caplen) +
                                        sizeof(guint32));
-        options_length = 0;
-        options_length += pcapng_count_string_option(comment);
-        if (flags != 0) {
-                options_length += (guint32)(sizeof(struct ws_option) +
-                                            sizeof(guint32));
-        }
-        /* If we have options add size of end-of-options */
-        if (options_length != 0) {
-                options_length += (guint32)sizeof(struct ws_option);
-        }
+        options_length = pcapng_count_epb_options(comment, flags);
         block_total_length += options_length;
         timestamp = (guint64)sec * ts_mul + (guint64)usec;
         epb.block_type = ENHANCED_PACKET_BLOCK_TYPE;
@@ -790,6 +814,209 @@ pcapng_write_interface_statistics_block(FILE* pfile,
         return write_to_file(pfile, (const guint8*)&block_total_length, sizeof(guint32), bytes_written, err);
 }
 
+/* Writing batches of records */
+
+/*
+ * A batch is a buffer that packet records are put in one after another,
+ * exactly as they're to appear in the file, and written out together;
+ * records are usually small, so this is much cheaper than writing each
+ * part of each of them with its own fwrite(), and it lets the stdio
+ * layer hand the batch to the OS in large writes rather than copying it
+ * into its own buffer first.
+ */
+struct pcapio_batch {
+        guint8 *buf;
+        size_t  size;           /* bytes allocated for buf */
+        size_t  len;            /* bytes of records in buf, not yet written */
+};
+
+/* Batches are a multiple of this, the page size and the usual file system
+   block size, so whole batches are written in whole blocks. */
+#define PCAPIO_BATCH_ALIGN 4096
+
+pcapio_batch *
+pcapio_batch_new(size_t size)
+{
+        pcapio_batch *batch;
+
+        if (size < PCAPIO_BATCH_ALIGN)
+                size = PCAPIO_BATCH_ALIGN;
+        batch = g_new(pcapio_batch, 1);
+        batch->size = (size + PCAPIO_BATCH_ALIGN - 1) & ~(size_t)(PCAPIO_BATCH_ALIGN - 1);
+        batch->buf = (guint8 *)g_malloc(batch->size);
+        batch->len = 0;
+        return batch;
+}
+
+void
+pcapio_batch_free(pcapio_batch *batch)
+{
+        if (batch != NULL) {
+                g_free(batch->buf);
+                g_free(batch);
+        }
+}
+
+size_t
+pcapio_batch_size(const pcapio_batch *batch)
+{
+        return batch->size;
+}
+
+/* Write out the records in a batch.
+   Returns TRUE on success, FALSE on failure; the records are discarded
+   either way. */
+gboolean
+pcapio_batch_flush(FILE* pfile, pcapio_batch *batch, int *err)
+{
+        size_t len = batch->len;
+        guint64 flushed = 0;    /* already counted when they were batched */
+
+        if (len == 0)
+                return TRUE;
+        batch->len = 0;
+        return write_to_file(pfile, batch->buf, len, &flushed, err);
+}
+
+/* Make sure there's room for a record of "length" bytes at the end of
+   a batch, writing out what's in it if there isn't. */
+static gboolean
+pcapio_batch_make_room(FILE* pfile, pcapio_batch *batch, size_t length, int *err)
+{
+        if (batch->size - batch->len >= length)
+                return TRUE;
+        return pcapio_batch_flush(pfile, batch, err);
+}
+
+static guint8 *
+pcapio_batch_put(guint8 *p, const void *data, size_t length)
+{
+        memcpy(p, data, length);
+        return p + length;
+}
+
+/* Add a record for a packet to a batch, writing it out first if it's full.
+   Returns TRUE on success, FALSE on failure. */
+gboolean
+libpcap_batch_packet(FILE* pfile,
+                     pcapio_batch *batch,
+                     time_t sec, guint32 usec,
+                     guint32 caplen, guint32 len,
+                     const guint8 *pd,
+                     guint64 *bytes_written, int *err)
+{
+        struct pcaprec_hdr rec_hdr;
+        size_t record_length = sizeof(rec_hdr) + caplen;
+        guint8 *p;
+
+        if (record_length > batch->size) {
+                /* It won't fit in any batch; write it after what's before it. */
+                if (!pcapio_batch_flush(pfile, batch, err))
+                        return FALSE;
+                return libpcap_write_packet(pfile, sec, usec, caplen, len, pd,
+                                            bytes_written, err);
+        }
+        if (!pcapio_batch_make_room(pfile, batch, record_length, err))
+                return FALSE;
+
+        rec_hdr.ts_sec = (guint32)sec; /* Y2.038K issue in pcap format.... */
+        rec_hdr.ts_usec = usec;
+        rec_hdr.incl_len = caplen;
+        rec_hdr.orig_len = len;
+        p = batch->buf + batch->len;
+        p = pcapio_batch_put(p, &rec_hdr, sizeof(rec_hdr));
+        memcpy(p, pd, caplen);
+        batch->len += record_length;
+        (*bytes_written) += record_length;
+        return TRUE;
+}
+
+/* Add an enhanced packet block to a batch, writing it out first if it's
+   full.  Returns TRUE on success, FALSE on failure. */
+gboolean
+pcapng_batch_enhanced_packet_block(FILE* pfile,
+                                   pcapio_batch *batch,
+                                   const char *comment,
+                                   time_t sec, guint32 usec,
+                                   guint32 caplen, guint32 len,
+                                   guint32 interface_id,
+                                   guint ts_mul,
+                                   const guint8 *pd,
+                                   guint32 flags,
+                                   guint64 *bytes_written,
+                                   int *err)
+{
+        struct epb epb;
+        struct ws_option option;
+        guint32 block_total_length;
+        guint64 timestamp;
+        guint32 options_length;
+        size_t comment_length;
+        guint8 *p;
+
+        options_length = pcapng_count_epb_options(comment, flags);
+        block_total_length = (guint32)(sizeof(struct epb) +
+                                       ADD_PADDING(caplen) +
+                                       options_length +
+                                       sizeof(guint32));
+        if (block_total_length > batch->size) {
+                /* It won't fit in any batch; write it after what's before it. */
+                if (!pcapio_batch_flush(pfile, batch, err))
+                        return FALSE;
+                return pcapng_write_enhanced_packet_block(pfile, comment, sec, usec,
+                                                          caplen, len, interface_id,
+                                                          ts_mul, pd, flags,
+                                                          bytes_written, err);
+        }
+        if (!pcapio_batch_make_room(pfile, batch, block_total_length, err))
+                return FALSE;
+
+        timestamp = (guint64)sec * ts_mul + (guint64)usec;
+        epb.block_type = ENHANCED_PACKET_BLOCK_TYPE;
+        epb.block_total_length = block_total_length;
+        epb.interface_id = interface_id;
+        epb.timestamp_high = (guint32)((timestamp>>32) & 0xffffffff);
+        epb.timestamp_low = (guint32)(timestamp & 0xffffffff);
+        epb.captured_len = caplen;
+        epb.packet_len = len;
+
+        /* The padding, and that of the options, is zeroed along the way. */
+        p = batch->buf + batch->len;
+        p = pcapio_batch_put(p, &epb, sizeof(struct epb));
+        p = pcapio_batch_put(p, pd, caplen);
+        while (caplen % 4) {
+                *p++ = 0;
+                caplen++;
+        }
+        if (options_length != 0) {
+                if (pcapng_count_string_option(comment) != 0) {
+                        comment_length = strlen(comment);
+                        option.type = OPT_COMMENT;
+                        option.value_length = (guint16)comment_length;
+                        p = pcapio_batch_put(p, &option, sizeof(struct ws_option));
+                        p = pcapio_batch_put(p, comment, comment_length);
+                        while (comment_length % 4) {
+                                *p++ = 0;
+                                comment_length++;
+                        }
+                }
+                if (flags != 0) {
+                        option.type = EPB_FLAGS;
+                        option.value_length = sizeof(guint32);
+                        p = pcapio_batch_put(p, &option, sizeof(struct ws_option));
+                        p = pcapio_batch_put(p, &flags, sizeof(guint32));
+                }
+                option.type = OPT_ENDOFOPT;
+                option.value_length = 0;
+                p = pcapio_batch_put(p, &option, sizeof(struct ws_option));
+        }
+        pcapio_batch_put(p, &block_total_length, sizeof(guint32));
+
+        batch->len += block_total_length;
+        (*bytes_written) += block_total_length;
+        return TRUE;
+}
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
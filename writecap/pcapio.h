@@ -12,6 +12,15 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 
+/** Called with everything written to capture files, in the order in
+   which it's written, e.g. to pass it on to another process. */
+typedef void (*pcapio_write_observer_func)(const guint8 *data, size_t data_length,
+                                           void *user_data);
+
+/** Set the routine to call with everything written, or NULL for none. */
+extern void
+pcapio_set_write_observer(pcapio_write_observer_func func, void *user_data);
+
 /* Writing pcap files */
 
 /** Write the file header to a dump file.
@@ -100,6 +109,56 @@ pcapng_write_enhanced_packet_block(FILE* pfile,
                                    guint64 *bytes_written,
                                    int *err);
 
+/* Writing batches of records */
+
+/** A buffer that packet records are put in and written out from together,
+   rather than with several writes for each of them.  Nothing else may be
+   written to the file while there are records in it. */
+typedef struct pcapio_batch pcapio_batch;
+
+/** Allocate a batch of at least "size" bytes. */
+extern pcapio_batch *
+pcapio_batch_new(size_t size);
+
+extern void
+pcapio_batch_free(pcapio_batch *batch);
+
+/** The number of bytes of records a batch holds. */
+extern size_t
+pcapio_batch_size(const pcapio_batch *batch);
+
+/** Write out the records in a batch; do this before writing anything else
+   to the file, flushing it or closing it.
+   Returns TRUE on success, FALSE on failure. */
+extern gboolean
+pcapio_batch_flush(FILE* pfile, pcapio_batch *batch, int *err);
+
+/** Add a record for a packet to a batch, writing the batch out first if
+   the record doesn't fit.  "bytes_written" includes the record as soon
+   as it's added.
+   Returns TRUE on success, FALSE on failure. */
+extern gboolean
+libpcap_batch_packet(FILE* pfile,
+                     pcapio_batch *batch,
+                     time_t sec, guint32 usec,
+                     guint32 caplen, guint32 len,
+                     const guint8 *pd,
+                     guint64 *bytes_written, int *err);
+
+/** Add an enhanced packet block to a batch; see libpcap_batch_packet(). */
+extern gboolean
+pcapng_batch_enhanced_packet_block(FILE* pfile,
+                                   pcapio_batch *batch,
+                                   const char *comment,
+                                   time_t sec, guint32 usec,
+                                   guint32 caplen, guint32 len,
+                                   guint32 interface_id,
+                                   guint ts_mul,
+                                   const guint8 *pd,
+                                   guint32 flags,
+                                   guint64 *bytes_written,
+                                   int *err);
+
 /*
  * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
  *
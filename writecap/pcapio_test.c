@@ -0,0 +1,235 @@
+/* pcapio_test.c
+ * Tests and benchmarks for writing capture files in batches
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+
+#include "pcapio.h"
+
+#define TEST_BATCH_SIZE     4096
+#define TEST_PACKETS        1000
+#define PERF_BATCH_SIZE     (256 * 1024)
+#define PERF_IO_BUF_SIZE    (64 * 1024)
+#define PERF_PACKETS        (2 * 1000 * 1000)
+#define PERF_PACKET_LEN     64
+
+static guint8 packet_data[16384];
+
+/* The contents of a file we've written */
+static GByteArray *
+read_back(FILE *fh)
+{
+    GByteArray *contents = g_byte_array_new();
+    guint8 buf[8192];
+    size_t nread;
+
+    g_assert_cmpint(fflush(fh), ==, 0);
+    rewind(fh);
+    while ((nread = fread(buf, 1, sizeof buf, fh)) != 0)
+        g_byte_array_append(contents, buf, (guint)nread);
+    g_assert_false(ferror(fh));
+    return contents;
+}
+
+static void
+assert_same_contents(FILE *expected_fh, FILE *actual_fh)
+{
+    GByteArray *expected = read_back(expected_fh);
+    GByteArray *actual = read_back(actual_fh);
+
+    g_assert_cmpmem(actual->data, actual->len, expected->data, expected->len);
+    g_byte_array_free(expected, TRUE);
+    g_byte_array_free(actual, TRUE);
+}
+
+/* Packet i's length; every so often, one too big for a batch. */
+static guint32
+test_caplen(guint i)
+{
+    if (i % 97 == 0)
+        return TEST_BATCH_SIZE + 1 + i % 4;
+    return 1 + (i * 7) % 300;
+}
+
+static void
+test_batch_pcapng(void)
+{
+    FILE *direct_fh = tmpfile();
+    FILE *batch_fh = tmpfile();
+    pcapio_batch *batch = pcapio_batch_new(TEST_BATCH_SIZE);
+    guint64 direct_bytes = 0, batch_bytes = 0;
+    const char *comment;
+    guint32 caplen, flags;
+    int err;
+    guint i;
+
+    g_assert_nonnull(direct_fh);
+    g_assert_nonnull(batch_fh);
+    g_assert_cmpuint(pcapio_batch_size(batch), ==, TEST_BATCH_SIZE);
+
+    for (i = 0; i < TEST_PACKETS; i++) {
+        caplen = test_caplen(i);
+        comment = (i % 5 == 0) ? "a comment" : (i % 11 == 0) ? "" : NULL;
+        flags = (i % 3 == 0) ? 0x00000001 : 0;
+        g_assert_true(pcapng_write_enhanced_packet_block(direct_fh, comment,
+                                                         1000000000 + i, i % 1000000,
+                                                         caplen, caplen + 10,
+                                                         i % 2, 1000000,
+                                                         packet_data, flags,
+                                                         &direct_bytes, &err));
+        g_assert_true(pcapng_batch_enhanced_packet_block(batch_fh, batch, comment,
+                                                         1000000000 + i, i % 1000000,
+                                                         caplen, caplen + 10,
+                                                         i % 2, 1000000,
+                                                         packet_data, flags,
+                                                         &batch_bytes, &err));
+        g_assert_cmpuint(batch_bytes, ==, direct_bytes);
+    }
+    g_assert_true(pcapio_batch_flush(batch_fh, batch, &err));
+    /* Flushing an empty batch writes nothing. */
+    g_assert_true(pcapio_batch_flush(batch_fh, batch, &err));
+
+    assert_same_contents(direct_fh, batch_fh);
+
+    pcapio_batch_free(batch);
+    fclose(direct_fh);
+    fclose(batch_fh);
+}
+
+static void
+test_batch_pcap(void)
+{
+    FILE *direct_fh = tmpfile();
+    FILE *batch_fh = tmpfile();
+    pcapio_batch *batch = pcapio_batch_new(TEST_BATCH_SIZE);
+    guint64 direct_bytes = 0, batch_bytes = 0;
+    guint32 caplen;
+    int err;
+    guint i;
+
+    g_assert_nonnull(direct_fh);
+    g_assert_nonnull(batch_fh);
+
+    for (i = 0; i < TEST_PACKETS; i++) {
+        caplen = test_caplen(i);
+        g_assert_true(libpcap_write_packet(direct_fh, 1000000000 + i, i % 1000000,
+                                           caplen, caplen + 10, packet_data,
+                                           &direct_bytes, &err));
+        g_assert_true(libpcap_batch_packet(batch_fh, batch, 1000000000 + i, i % 1000000,
+                                           caplen, caplen + 10, packet_data,
+                                           &batch_bytes, &err));
+        g_assert_cmpuint(batch_bytes, ==, direct_bytes);
+    }
+    g_assert_true(pcapio_batch_flush(batch_fh, batch, &err));
+
+    assert_same_contents(direct_fh, batch_fh);
+
+    pcapio_batch_free(batch);
+    fclose(direct_fh);
+    fclose(batch_fh);
+}
+
+/* Write PERF_PACKETS small packets as dumpcap does, returning packets per second. */
+static double
+perf_write_packets(pcapio_batch *batch)
+{
+    FILE *fh = tmpfile();
+    char *io_buffer = (char *)g_malloc(PERF_IO_BUF_SIZE);
+    guint64 bytes_written = 0;
+    GTimer *timer;
+    double elapsed;
+    int err;
+    guint i;
+
+    g_assert_nonnull(fh);
+    setvbuf(fh, io_buffer, _IOFBF, PERF_IO_BUF_SIZE);
+
+    timer = g_timer_new();
+    for (i = 0; i < PERF_PACKETS; i++) {
+        if (batch != NULL) {
+            g_assert_true(pcapng_batch_enhanced_packet_block(fh, batch, NULL,
+                                                             1000000000 + i / 1000000, i % 1000000,
+                                                             PERF_PACKET_LEN, PERF_PACKET_LEN,
+                                                             0, 1000000, packet_data, 0,
+                                                             &bytes_written, &err));
+        } else {
+            g_assert_true(pcapng_write_enhanced_packet_block(fh, NULL,
+                                                             1000000000 + i / 1000000, i % 1000000,
+                                                             PERF_PACKET_LEN, PERF_PACKET_LEN,
+                                                             0, 1000000, packet_data, 0,
+                                                             &bytes_written, &err));
+        }
+    }
+    if (batch != NULL)
+        g_assert_true(pcapio_batch_flush(fh, batch, &err));
+    g_assert_cmpint(fflush(fh), ==, 0);
+    elapsed = g_timer_elapsed(timer, NULL);
+    g_timer_destroy(timer);
+
+    fclose(fh);
+    g_free(io_buffer);
+    return PERF_PACKETS / elapsed;
+}
+
+static void
+test_perf_pcapng(void)
+{
+    pcapio_batch *batch = pcapio_batch_new(PERF_BATCH_SIZE);
+    double direct_pps, batch_pps;
+
+    direct_pps = perf_write_packets(NULL);
+    g_test_maximized_result(direct_pps,
+                            "%u-byte EPBs written one at a time: %.0f packets/s",
+                            PERF_PACKET_LEN, direct_pps);
+    batch_pps = perf_write_packets(batch);
+    g_test_maximized_result(batch_pps,
+                            "%u-byte EPBs written in %u KiB batches: %.0f packets/s",
+                            PERF_PACKET_LEN, PERF_BATCH_SIZE / 1024, batch_pps);
+
+    pcapio_batch_free(batch);
+}
+
+int
+main(int argc, char **argv)
+{
+    guint i;
+
+    for (i = 0; i < sizeof packet_data; i++)
+        packet_data[i] = (guint8)i;
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/pcapio/batch/pcapng", test_batch_pcapng);
+    g_test_add_func("/pcapio/batch/pcap",   test_batch_pcap);
+
+    if (g_test_perf()) {
+        g_test_add_func("/pcapio/perf/pcapng", test_perf_pcapng);
+    }
+
+    return g_test_run();
+}
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
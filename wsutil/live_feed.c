@@ -0,0 +1,374 @@
+/* live_feed.c
+ * Routines to share what's written to a capture file with a process
+ * reading it while it's being written
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "config.h"
+
+#include <errno.h>
+#include <string.h>
+
+#include <glib.h>
+
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "ws_attributes.h"
+#include "file_util.h"
+#include "tempfile.h"
+#include "live_feed.h"
+
+#ifdef HAVE_SYS_MMAN_H
+
+#define LIVE_FEED_MAGIC         0x57534c46      /* "WSLF" */
+#define LIVE_FEED_DATA_SIZE     (8 * 1024 * 1024)
+#define LIVE_FEED_DATA_OFFSET   64              /* keep the data away from the header's cache line */
+#define LIVE_FEED_STATE_TRIES   100             /* times to look for a consistent header */
+
+/*
+ * The start of the shared memory.  Only the writer changes it; seq is
+ * odd while it's changing the data or the other fields, so a reader
+ * that sees the same even value of seq before and after looking at
+ * them knows they're consistent.
+ */
+struct live_feed_header {
+    guint32           magic;
+    guint32           size;         /* bytes of data */
+    volatile gint     seq;
+    guint32           pad;
+    volatile guint64  file_dev;     /* device and inode number of the file being written */
+    volatile guint64  file_ino;
+    volatile guint64  head;         /* bytes written to that file so far */
+    volatile guint64  generation;   /* bumped for each file started */
+};
+
+/*
+ * The data and the header fields other than seq aren't accessed
+ * atomically, so keep those accesses from being moved past the
+ * accesses to seq around them, by the compiler or the CPU.
+ */
+#define live_feed_fence()       __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+struct live_feed {
+    gint                     ref_count;
+    struct live_feed_header *hdr;
+    guint8                  *data;
+    size_t                   map_size;
+};
+
+typedef struct {
+    guint64 file_dev;
+    guint64 file_ino;
+    guint64 head;
+    guint64 generation;
+} live_feed_state_t;
+
+static void
+live_feed_set_error(GError **err, const char *what, int errnum)
+{
+    g_set_error(err, G_FILE_ERROR, g_file_error_from_errno(errnum),
+                "%s: %s", what, g_strerror(errnum));
+}
+
+static live_feed_t *
+live_feed_map(int fd, size_t map_size, GError **err)
+{
+    live_feed_t *feed;
+    void *map;
+
+    map = mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        live_feed_set_error(err, "Couldn't map the live feed", errno);
+        return NULL;
+    }
+    feed = g_new(live_feed_t, 1);
+    feed->ref_count = 1;
+    feed->hdr = (struct live_feed_header *)map;
+    feed->data = (guint8 *)map + LIVE_FEED_DATA_OFFSET;
+    feed->map_size = map_size;
+    return feed;
+}
+
+live_feed_t *
+live_feed_create(gchar **namebuf, GError **err)
+{
+    size_t map_size = LIVE_FEED_DATA_OFFSET + LIVE_FEED_DATA_SIZE;
+    live_feed_t *feed;
+    int fd;
+
+    fd = create_tempfile(namebuf, "wireshark_feed", NULL, err);
+    if (fd == -1)
+        return NULL;
+    if (ftruncate(fd, (off_t)map_size) == -1) {
+        live_feed_set_error(err, "Couldn't size the live feed", errno);
+        feed = NULL;
+    } else {
+        feed = live_feed_map(fd, map_size, err);
+    }
+    ws_close(fd);
+    if (feed == NULL) {
+        ws_unlink(*namebuf);
+        g_free(*namebuf);
+        *namebuf = NULL;
+        return NULL;
+    }
+
+    /* The file is all zeroes, so there's no file being written yet. */
+    feed->hdr->magic = LIVE_FEED_MAGIC;
+    feed->hdr->size = LIVE_FEED_DATA_SIZE;
+    return feed;
+}
+
+live_feed_t *
+live_feed_attach(const char *path, GError **err)
+{
+    ws_statb64 statb;
+    live_feed_t *feed;
+    int fd;
+
+    fd = ws_open(path, O_RDWR|O_BINARY, 0);
+    if (fd == -1) {
+        live_feed_set_error(err, "Couldn't open the live feed", errno);
+        return NULL;
+    }
+    if (ws_fstat64(fd, &statb) == -1) {
+        live_feed_set_error(err, "Couldn't open the live feed", errno);
+        ws_close(fd);
+        return NULL;
+    }
+    if (statb.st_size <= LIVE_FEED_DATA_OFFSET || (guint64)statb.st_size > G_MAXSIZE) {
+        live_feed_set_error(err, "Not a live feed", EINVAL);
+        ws_close(fd);
+        return NULL;
+    }
+    feed = live_feed_map(fd, (size_t)statb.st_size, err);
+    ws_close(fd);
+    if (feed == NULL)
+        return NULL;
+
+    if (feed->hdr->magic != LIVE_FEED_MAGIC ||
+        (size_t)feed->hdr->size != feed->map_size - LIVE_FEED_DATA_OFFSET) {
+        live_feed_set_error(err, "Not a live feed", EINVAL);
+        live_feed_unref(feed);
+        return NULL;
+    }
+    return feed;
+}
+
+live_feed_t *
+live_feed_ref(live_feed_t *feed)
+{
+    g_atomic_int_inc(&feed->ref_count);
+    return feed;
+}
+
+void
+live_feed_unref(live_feed_t *feed)
+{
+    if (g_atomic_int_dec_and_test(&feed->ref_count)) {
+        munmap(feed->hdr, feed->map_size);
+        g_free(feed);
+    }
+}
+
+void
+live_feed_start_file(live_feed_t *feed, int fd)
+{
+    struct live_feed_header *hdr = feed->hdr;
+    ws_statb64 statb;
+
+    g_atomic_int_inc(&hdr->seq);
+    live_feed_fence();
+    if (fd != -1 && ws_fstat64(fd, &statb) == 0 && S_ISREG(statb.st_mode)) {
+        hdr->file_dev = (guint64)statb.st_dev;
+        hdr->file_ino = (guint64)statb.st_ino;
+    } else {
+        hdr->file_dev = 0;
+        hdr->file_ino = 0;
+    }
+    hdr->head = 0;
+    hdr->generation++;
+    live_feed_fence();
+    g_atomic_int_inc(&hdr->seq);
+}
+
+void
+live_feed_write(live_feed_t *feed, const void *data, size_t len)
+{
+    struct live_feed_header *hdr = feed->hdr;
+    const guint8 *src = (const guint8 *)data;
+    guint64 head = hdr->head;     /* only we change it */
+    guint64 new_head = head + len;
+    size_t size = hdr->size;
+    size_t pos, n;
+
+    if (hdr->file_ino == 0 || len == 0)
+        return;
+
+    /* Only the last "size" bytes will still be there afterwards. */
+    if (len > size) {
+        src += len - size;
+        head += len - size;
+        len = size;
+    }
+
+    g_atomic_int_inc(&hdr->seq);
+    live_feed_fence();
+    pos = (size_t)(head % size);
+    n = MIN(len, size - pos);
+    memcpy(feed->data + pos, src, n);
+    if (n < len)
+        memcpy(feed->data, src + n, len - n);
+    hdr->head = new_head;
+    live_feed_fence();
+    g_atomic_int_inc(&hdr->seq);
+}
+
+/* Get a consistent view of the header, if the writer isn't changing it. */
+static gboolean
+live_feed_get_state(const live_feed_t *feed, live_feed_state_t *state)
+{
+    struct live_feed_header *hdr = feed->hdr;
+    gint seq;
+
+    seq = g_atomic_int_get(&hdr->seq);
+    if (seq & 1)
+        return FALSE;
+    live_feed_fence();
+    state->file_dev = hdr->file_dev;
+    state->file_ino = hdr->file_ino;
+    state->head = hdr->head;
+    state->generation = hdr->generation;
+    live_feed_fence();
+    return g_atomic_int_get(&hdr->seq) == seq;
+}
+
+guint64
+live_feed_file_generation(live_feed_t *feed, guint64 file_dev, guint64 file_ino)
+{
+    live_feed_state_t state;
+    int tries;
+
+    /* The writer doesn't keep the header inconsistent for long. */
+    for (tries = 0; tries < LIVE_FEED_STATE_TRIES; tries++) {
+        if (live_feed_get_state(feed, &state)) {
+            if (state.file_ino == 0 || state.file_dev != file_dev || state.file_ino != file_ino)
+                return 0;
+            return state.generation;
+        }
+        g_thread_yield();
+    }
+    return 0;
+}
+
+unsigned int
+live_feed_read(live_feed_t *feed, guint64 generation,
+               gint64 offset, void *buf, unsigned int len)
+{
+    live_feed_state_t state;
+    size_t size = feed->hdr->size;
+    size_t pos, n, count;
+
+    if (offset < 0 || generation == 0 || !live_feed_get_state(feed, &state))
+        return 0;
+    if (state.generation != generation)
+        return 0;
+    /* The feed has the bytes from head - size up to head. */
+    if ((guint64)offset >= state.head || (guint64)offset + size < state.head)
+        return 0;
+
+    count = (size_t)MIN((guint64)len, state.head - (guint64)offset);
+    if (buf != NULL) {
+        pos = (size_t)((guint64)offset % size);
+        n = MIN(count, size - pos);
+        memcpy(buf, feed->data + pos, n);
+        if (n < count)
+            memcpy((guint8 *)buf + n, feed->data, count - n);
+
+        /*
+         * The writer doesn't wait for us, so make sure it didn't
+         * overwrite what we copied while we were copying it.
+         */
+        live_feed_fence();
+        if (!live_feed_get_state(feed, &state) ||
+            state.generation != generation ||
+            (guint64)offset + size < state.head)
+            return 0;
+    }
+    return (unsigned int)count;
+}
+
+#else /* HAVE_SYS_MMAN_H */
+
+live_feed_t *
+live_feed_create(gchar **namebuf, GError **err)
+{
+    *namebuf = NULL;
+    g_set_error(err, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+                "Live feeds aren't supported on this platform");
+    return NULL;
+}
+
+live_feed_t *
+live_feed_attach(const char *path _U_, GError **err)
+{
+    g_set_error(err, G_FILE_ERROR, G_FILE_ERROR_NOSYS,
+                "Live feeds aren't supported on this platform");
+    return NULL;
+}
+
+live_feed_t *
+live_feed_ref(live_feed_t *feed)
+{
+    return feed;
+}
+
+void
+live_feed_unref(live_feed_t *feed _U_)
+{
+}
+
+void
+live_feed_start_file(live_feed_t *feed _U_, int fd _U_)
+{
+}
+
+void
+live_feed_write(live_feed_t *feed _U_, const void *data _U_, size_t len _U_)
+{
+}
+
+guint64
+live_feed_file_generation(live_feed_t *feed _U_, guint64 file_dev _U_, guint64 file_ino _U_)
+{
+    return 0;
+}
+
+unsigned int
+live_feed_read(live_feed_t *feed _U_, guint64 generation _U_,
+               gint64 offset _U_, void *buf _U_, unsigned int len _U_)
+{
+    return 0;
+}
+
+#endif /* HAVE_SYS_MMAN_H */
+
+/*
+ * Editor modelines  -  https://www.wireshark.org/tools/modelines.html
+ *
+ * Local variables:
+ * c-basic-offset: 4
+ * tab-width: 8
+ * indent-tabs-mode: nil
+ * End:
+ *
+ * vi: set shiftwidth=4 tabstop=8 expandtab:
+ * :indentSize=4:tabSize=8:noTabs=true:
+ */
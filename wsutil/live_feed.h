@@ -0,0 +1,104 @@
+/* live_feed.h
+ * Declarations of routines to share what's written to a capture file
+ * with a process reading it while it's being written
+ *
+ * Wireshark - Network traffic analyzer
+ * By Gerald Combs <gerald@wireshark.org>
+ * Copyright 1998 Gerald Combs
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef __LIVE_FEED_H__
+#define __LIVE_FEED_H__
+
+#include <glib.h>
+
+#include "ws_symbol_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif /* __cplusplus */
+
+/** @file
+ * A live feed is a ring buffer in shared memory holding the most
+ * recently written bytes of the capture file dumpcap is writing, so
+ * that a process reading that file as it's written (e.g. Wireshark or
+ * TShark in a live capture) can copy them from memory rather than
+ * read them back from the file.
+ *
+ * The writer never waits for the reader; if the reader falls so far
+ * behind that the data it wants has been overwritten, or the writer
+ * has moved on to another file, it reads from the file as usual.
+ *
+ * Live feeds are only supported on platforms with mmap(); elsewhere,
+ * live_feed_create() and live_feed_attach() fail.
+ */
+
+typedef struct live_feed live_feed_t;
+
+/**
+ * Create a live feed, in a temporary file, for a capture child to
+ * attach to.
+ *
+ * @param namebuf [out] Receives the path of the file, to pass to the
+ *                capture child and to remove when the capture is done.
+ *                Must be freed.
+ * @param err [out] Receives the reason for failure. May be NULL.
+ * @return The live feed, with a reference for the caller, or NULL.
+ */
+WS_DLL_PUBLIC live_feed_t *live_feed_create(gchar **namebuf, GError **err);
+
+/**
+ * Attach to a live feed created by live_feed_create(), to write to it.
+ *
+ * @param path [in] The path of the live feed's file.
+ * @param err [out] Receives the reason for failure. May be NULL.
+ * @return The live feed, with a reference for the caller, or NULL.
+ */
+WS_DLL_PUBLIC live_feed_t *live_feed_attach(const char *path, GError **err);
+
+WS_DLL_PUBLIC live_feed_t *live_feed_ref(live_feed_t *feed);
+WS_DLL_PUBLIC void live_feed_unref(live_feed_t *feed);
+
+/**
+ * Tell readers that the data written from now on is that of the file
+ * open on fd, starting at its beginning.  Until this is called, or if
+ * fd isn't a regular file, nothing written is shared.
+ */
+WS_DLL_PUBLIC void live_feed_start_file(live_feed_t *feed, int fd);
+
+/**
+ * Add data written to the current file.
+ */
+WS_DLL_PUBLIC void live_feed_write(live_feed_t *feed, const void *data, size_t len);
+
+/**
+ * Find out whether the file with the given device and inode numbers is
+ * the one being written now.  As those numbers can be reused for a new
+ * file once the file is removed, each file started with
+ * live_feed_start_file() gets a new generation number, which the reader
+ * then passes to live_feed_read().
+ *
+ * @return The generation of the file, or 0 if that file isn't being
+ *         written.
+ */
+WS_DLL_PUBLIC guint64 live_feed_file_generation(live_feed_t *feed,
+    guint64 file_dev, guint64 file_ino);
+
+/**
+ * Copy data at offset in the file with the given generation from the
+ * live feed, if it's there.
+ *
+ * @param buf [out] Where to copy it, or NULL just to skip it.
+ * @return The number of bytes copied, at most len; 0 if the feed
+ *         doesn't have the data at offset in that file.
+ */
+WS_DLL_PUBLIC unsigned int live_feed_read(live_feed_t *feed, guint64 generation,
+    gint64 offset, void *buf, unsigned int len);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+#endif /* __LIVE_FEED_H__ */
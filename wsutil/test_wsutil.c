@@ -534,6 +534,178 @@ static void test_getopt_opterr1(void)
     g_test_trap_assert_stderr("/bin/ls: unrecognized option: z\n");
 }
 
+#ifdef HAVE_SYS_MMAN_H
+#include "file_util.h"
+#include "tempfile.h"
+#include "live_feed.h"
+
+#define LIVE_FEED_TEST_SIZE     (8 * 1024 * 1024)   /* data bytes in a feed */
+
+static guint8 live_feed_byte(guint64 offset)
+{
+    return (guint8)((offset * 2654435761U) >> 24);
+}
+
+static void live_feed_write_pattern(live_feed_t *feed, guint64 from, guint64 to)
+{
+    guint8 buf[65536];
+    size_t i, n;
+
+    while (from < to) {
+        n = (size_t)MIN(sizeof buf, to - from);
+        for (i = 0; i < n; i++)
+            buf[i] = live_feed_byte(from + i);
+        live_feed_write(feed, buf, n);
+        from += n;
+    }
+}
+
+static void live_feed_check_pattern(const guint8 *buf, guint64 offset, size_t len)
+{
+    size_t i;
+
+    for (i = 0; i < len; i++)
+        g_assert_cmpuint(buf[i], ==, live_feed_byte(offset + i));
+}
+
+typedef struct {
+    int fd;
+    gchar *path;
+    guint64 dev;
+    guint64 ino;
+} live_feed_test_file;
+
+static void live_feed_test_file_open(live_feed_test_file *file)
+{
+    ws_statb64 statb;
+
+    file->fd = create_tempfile(&file->path, "test_live_feed", NULL, NULL);
+    g_assert_cmpint(file->fd, !=, -1);
+    g_assert_cmpint(ws_fstat64(file->fd, &statb), ==, 0);
+    file->dev = (guint64)statb.st_dev;
+    file->ino = (guint64)statb.st_ino;
+}
+
+static void live_feed_test_file_close(live_feed_test_file *file)
+{
+    ws_close(file->fd);
+    ws_unlink(file->path);
+    g_free(file->path);
+}
+
+static void test_live_feed_wrap(void)
+{
+    live_feed_t *feed;
+    gchar *feed_path;
+    live_feed_test_file file;
+    guint64 generation;
+    guint64 head = LIVE_FEED_TEST_SIZE + 1024 * 1024;
+    guint64 oldest = head - LIVE_FEED_TEST_SIZE;
+    guint8 *buf;
+
+    feed = live_feed_create(&feed_path, NULL);
+    g_assert_nonnull(feed);
+    live_feed_test_file_open(&file);
+
+    /* Nothing is shared until the file is started. */
+    g_assert_cmpuint(live_feed_file_generation(feed, file.dev, file.ino), ==, 0);
+    live_feed_start_file(feed, file.fd);
+    generation = live_feed_file_generation(feed, file.dev, file.ino);
+    g_assert_cmpuint(generation, !=, 0);
+
+    live_feed_write_pattern(feed, 0, head);
+    buf = (guint8 *)g_malloc(2 * 65536);
+
+    /* The newest data, up to the head. */
+    g_assert_cmpuint(live_feed_read(feed, generation, head - 4096, buf, 65536), ==, 4096);
+    live_feed_check_pattern(buf, head - 4096, 4096);
+    g_assert_cmpuint(live_feed_read(feed, generation, head, buf, 65536), ==, 0);
+
+    /* Data that wraps around the end of the ring. */
+    g_assert_cmpuint(live_feed_read(feed, generation, LIVE_FEED_TEST_SIZE - 65536, buf, 2 * 65536), ==, 2 * 65536);
+    live_feed_check_pattern(buf, LIVE_FEED_TEST_SIZE - 65536, 2 * 65536);
+
+    /* The oldest data still there, and data that's been overwritten. */
+    g_assert_cmpuint(live_feed_read(feed, generation, oldest, buf, 100), ==, 100);
+    live_feed_check_pattern(buf, oldest, 100);
+    g_assert_cmpuint(live_feed_read(feed, generation, oldest - 1, buf, 100), ==, 0);
+    g_assert_cmpuint(live_feed_read(feed, generation, 0, buf, 100), ==, 0);
+
+    /* Skipping data doesn't copy it. */
+    g_assert_cmpuint(live_feed_read(feed, generation, head - 10, NULL, 100), ==, 10);
+
+    /* A write bigger than the ring keeps only its end. */
+    live_feed_write_pattern(feed, head, head + LIVE_FEED_TEST_SIZE + 1);
+    head += LIVE_FEED_TEST_SIZE + 1;
+    g_assert_cmpuint(live_feed_read(feed, generation, head - LIVE_FEED_TEST_SIZE - 1, buf, 100), ==, 0);
+    g_assert_cmpuint(live_feed_read(feed, generation, head - LIVE_FEED_TEST_SIZE, buf, 100), ==, 100);
+    live_feed_check_pattern(buf, head - LIVE_FEED_TEST_SIZE, 100);
+
+    g_free(buf);
+    live_feed_test_file_close(&file);
+    live_feed_unref(feed);
+    ws_unlink(feed_path);
+    g_free(feed_path);
+}
+
+static void test_live_feed_file_switch(void)
+{
+    live_feed_t *feed;
+    gchar *feed_path;
+    live_feed_test_file file1, file2;
+    guint64 generation1, generation2, generation3;
+    guint8 buf[100];
+
+    feed = live_feed_create(&feed_path, NULL);
+    g_assert_nonnull(feed);
+    live_feed_test_file_open(&file1);
+    live_feed_test_file_open(&file2);
+
+    live_feed_start_file(feed, file1.fd);
+    generation1 = live_feed_file_generation(feed, file1.dev, file1.ino);
+    g_assert_cmpuint(generation1, !=, 0);
+    g_assert_cmpuint(live_feed_file_generation(feed, file2.dev, file2.ino), ==, 0);
+    live_feed_write_pattern(feed, 0, 1000);
+    g_assert_cmpuint(live_feed_read(feed, generation1, 900, buf, sizeof buf), ==, 100);
+
+    /* Once the writer moves on, the old file isn't in the feed. */
+    live_feed_start_file(feed, file2.fd);
+    generation2 = live_feed_file_generation(feed, file2.dev, file2.ino);
+    g_assert_cmpuint(generation2, !=, 0);
+    g_assert_cmpuint(generation2, !=, generation1);
+    g_assert_cmpuint(live_feed_file_generation(feed, file1.dev, file1.ino), ==, 0);
+    g_assert_cmpuint(live_feed_read(feed, generation1, 900, buf, sizeof buf), ==, 0);
+    live_feed_write_pattern(feed, 0, 1000);
+    g_assert_cmpuint(live_feed_read(feed, generation1, 900, buf, sizeof buf), ==, 0);
+    g_assert_cmpuint(live_feed_read(feed, generation2, 900, buf, sizeof buf), ==, 100);
+    live_feed_check_pattern(buf, 900, sizeof buf);
+
+    /*
+     * Starting a file with the same device and inode numbers, as a
+     * new file can get once the old one is removed, doesn't make the
+     * old file's readers see the new file's data.
+     */
+    live_feed_start_file(feed, file1.fd);
+    generation3 = live_feed_file_generation(feed, file1.dev, file1.ino);
+    g_assert_cmpuint(generation3, !=, 0);
+    g_assert_cmpuint(generation3, !=, generation1);
+    live_feed_write_pattern(feed, 0, 1000);
+    g_assert_cmpuint(live_feed_read(feed, generation1, 900, buf, sizeof buf), ==, 0);
+    g_assert_cmpuint(live_feed_read(feed, generation3, 900, buf, sizeof buf), ==, 100);
+
+    /* Nor is anything shared for something that isn't a regular file. */
+    live_feed_start_file(feed, -1);
+    live_feed_write_pattern(feed, 0, 1000);
+    g_assert_cmpuint(live_feed_read(feed, generation3, 900, buf, sizeof buf), ==, 0);
+
+    live_feed_test_file_close(&file1);
+    live_feed_test_file_close(&file2);
+    live_feed_unref(feed);
+    ws_unlink(feed_path);
+    g_free(feed_path);
+}
+#endif /* HAVE_SYS_MMAN_H */
+
 int main(int argc, char **argv)
 {
     int ret;
@@ -566,6 +738,11 @@ int main(int argc, char **argv)
     g_test_add_func("/ws_getopt/optional1", test_getopt_optional_argument1);
     g_test_add_func("/ws_getopt/opterr1", test_getopt_opterr1);
 
+#ifdef HAVE_SYS_MMAN_H
+    g_test_add_func("/live_feed/wrap", test_live_feed_wrap);
+    g_test_add_func("/live_feed/file_switch", test_live_feed_file_switch);
+#endif
+
     ret = g_test_run();
 
     return ret;